@@ -0,0 +1,22 @@
+#include "Instance.hlsli"
+
+cbuffer ConstantBuffer : register(b0)
+{
+	float4x4 ViewProjection;
+	float4x4 ViewProjectInverse;
+}
+
+// Scene::PositionBuffer, 12 bytes a vertex instead of the whole vertex
+struct VSIn
+{
+	float3 Position : POSITION;
+	float4 TransformX : TRANSFORM_X;
+	float4 TransformY : TRANSFORM_Y;
+	float4 TransformZ : TRANSFORM_Z;
+};
+
+float4 main(VSIn input) : SV_Position
+{
+	InstanceTransform transform = { input.TransformX, input.TransformY, input.TransformZ };
+	return mul(float4(TransformPosition(transform, input.Position), 1.f), ViewProjection);
+}
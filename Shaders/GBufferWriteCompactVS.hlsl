@@ -0,0 +1,33 @@
+#include "VertexFormat.hlsli"
+
+cbuffer ConstantBuffer : register(b0)
+{
+	float4x4 ViewProjection;
+	float4x4 ViewProjectInverse;
+}
+
+struct VSOut
+{
+	float3 WorldPosition : POSITION;
+	float3 Normal : NORMAL;
+	float3 Tangent : TANGENT;
+	float3 Bitangent : BITANGENT;
+	float2 UV : UV;
+	float4 Position : SV_Position;
+};
+
+VSOut main(CompactVSIn input)
+{
+	DecodedVertex vertex = DecodeVertex(input);
+	InstanceTransform transform = GetTransform(input);
+
+	VSOut output;
+	output.WorldPosition = TransformPosition(transform, vertex.Position);
+	output.Position = mul(float4(output.WorldPosition, 1.f), ViewProjection);
+	output.Normal = TransformNormal(transform, vertex.Normal);
+	output.Tangent = TransformDirection(transform, vertex.Tangent);
+	output.Bitangent = TransformDirection(transform, vertex.Bitangent);
+	output.UV = vertex.UV;
+	
+	return output;
+}
@@ -0,0 +1,3 @@
+// GBufferWritePS for batches whose albedo alpha discards texels
+#define ALPHA_MASK
+#include "GBufferWritePS.hlsl"
@@ -1,13 +1,13 @@
-cbuffer ConstantBuffer : register(b0)
-{
-	float2 BumpMapSize;
-}
+#include "VirtualTexture.hlsli"
+#include "../Source/MaterialLayout.h"
 
 SamplerState Sampler : register(s0);
 
 Texture2D AlbedoMap : register(t0);
-Texture2D SpecularMap : register(t1);
-Texture2D BumpMap : register(t2);
+Texture2D SurfaceMap : register(t1);
+
+// One page request per FeedbackScale square of pixels, after the two targets
+RWTexture2D<uint> Feedback : register(u2);
 
 struct PSIn
 {
@@ -16,6 +16,7 @@ struct PSIn
 	float3 Tangent : TANGENT;
 	float3 Bitangent : BITANGENT;
 	float2 UV : UV;
+	float4 Position : SV_Position;
 };
 
 struct PSOut
@@ -24,32 +25,41 @@ struct PSOut
 	float4 Normal : SV_Target1;
 };
 
-float3 CalcBumpMap(float3 normal, float3 tangent, float3 bitangent, float2 uv)
+// The importer turns bump maps into normal maps with x along the tangent and z along the bitangent
+float3 CalcBumpMap(float3 normal, float3 tangent, float3 bitangent, float4 surface)
 {
 	float3x3 tangentToWorld = float3x3(tangent, normal, bitangent);
 	
-	float2 offset = float2(1.f, 1.f) / BumpMapSize;
-	float current = BumpMap.Sample(Sampler, uv).r;
-	float dx = BumpMap.Sample(Sampler, uv + float2(offset.x, 0.f)).r - current;
-	float dy = BumpMap.Sample(Sampler, uv + float2(0.f, offset.y)).r - current;
-
-	float bumpMult = -3.f;
-	float3 calc = normalize(float3(bumpMult * dx, 1.f, bumpMult * dy));
+	float2 xz = float2(surface[SURFACE_NORMAL_X], surface[SURFACE_NORMAL_Z]) * 2.f - 1.f;
+	float3 calc = float3(xz.x, sqrt(saturate(1.f - dot(xz, xz))), xz.y);
 
 	return mul(calc, tangentToWorld);
 }
 
+// The feedback write turns early depth off unless it is forced, only the alpha test needs it late
+#ifndef ALPHA_MASK
+[earlydepthstencil]
+#endif
 PSOut main(PSIn input)
 {
 	PSOut output;
 	
 	float2 uv = input.UV;
 	
-	float4 albedo = AlbedoMap.Sample(Sampler, uv);
+	uint2 pixel = uint2(input.Position.xy);
+	uint pages = FeedbackSlot == 0 ? AlbedoPages : SurfacePages;
+	if (pages != NO_PAGES && all(pixel % FeedbackScale == FeedbackOffset))
+	{
+		Feedback[pixel / FeedbackScale] = GetPageRequest(pages, uv);
+	}
+
+	float4 albedo = SampleMaterial(AlbedoMap, Sampler, AlbedoPages, uv);
+#ifdef ALPHA_MASK
 	if (albedo.a < 0.5f) discard;
-	float4 specular = SpecularMap.Sample(Sampler, uv);
-	output.Material = float4(albedo.rgb, specular.r);
-	output.Normal = float4(CalcBumpMap(input.Normal, input.Tangent, input.Bitangent, uv), 1.f);
+#endif
+	float4 surface = SampleMaterial(SurfaceMap, Sampler, SurfacePages, uv);
+	output.Material = float4(albedo.rgb, surface[SURFACE_SPECULAR]);
+	output.Normal = float4(CalcBumpMap(input.Normal, input.Tangent, input.Bitangent, surface), 1.f);
 	
 	return output;
 }
@@ -1,3 +1,5 @@
+#include "Instance.hlsli"
+
 cbuffer ConstantBuffer : register(b0)
 {
 	float4x4 ViewProjection;
@@ -11,6 +13,9 @@ struct VSIn
 	float3 Tangent : TANGENT;
 	float3 Bitangent : BITANGENT;
 	float2 UV : UV;
+	float4 TransformX : TRANSFORM_X;
+	float4 TransformY : TRANSFORM_Y;
+	float4 TransformZ : TRANSFORM_Z;
 };
 
 struct VSOut
@@ -25,12 +30,14 @@ struct VSOut
 
 VSOut main(VSIn input)
 {
+	InstanceTransform transform = { input.TransformX, input.TransformY, input.TransformZ };
+
 	VSOut output;
-	output.WorldPosition = input.Position;
-	output.Position = mul(float4(input.Position, 1.f), ViewProjection);
-	output.Normal = input.Normal;
-	output.Tangent = input.Tangent;
-	output.Bitangent = input.Bitangent;
+	output.WorldPosition = TransformPosition(transform, input.Position);
+	output.Position = mul(float4(output.WorldPosition, 1.f), ViewProjection);
+	output.Normal = TransformNormal(transform, input.Normal);
+	output.Tangent = TransformDirection(transform, input.Tangent);
+	output.Bitangent = TransformDirection(transform, input.Bitangent);
 	output.UV = input.UV;
 	
 	return output;
@@ -0,0 +1,31 @@
+// Per-instance object to world transform, see VertexFormat::InstanceRecord in Source/VertexFormat.h.
+// The rows are the columns of the row vector matrix, so world = float3(dot(X, p), dot(Y, p), dot(Z, p)).
+
+struct InstanceTransform
+{
+	float4 X;
+	float4 Y;
+	float4 Z;
+};
+
+float3 TransformPosition(InstanceTransform transform, float3 position)
+{
+	float4 p = float4(position, 1.f);
+	return float3(dot(transform.X, p), dot(transform.Y, p), dot(transform.Z, p));
+}
+
+// Tangents and bitangents follow the surface
+float3 TransformDirection(InstanceTransform transform, float3 direction)
+{
+	return normalize(float3(dot(transform.X.xyz, direction), dot(transform.Y.xyz, direction), dot(transform.Z.xyz, direction)));
+}
+
+// Inverse transpose through the cofactors, signed so mirrored instances keep their normals outside
+float3 TransformNormal(InstanceTransform transform, float3 normal)
+{
+	float3 x = cross(transform.Y.xyz, transform.Z.xyz);
+	float3 y = cross(transform.Z.xyz, transform.X.xyz);
+	float3 z = cross(transform.X.xyz, transform.Y.xyz);
+	float determinant = dot(transform.X.xyz, x);
+	return normalize(float3(dot(x, normal), dot(y, normal), dot(z, normal))) * (determinant < 0.f ? -1.f : 1.f);
+}
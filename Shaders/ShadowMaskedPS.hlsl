@@ -0,0 +1,21 @@
+#include "VirtualTexture.hlsli"
+
+SamplerState Sampler : register(s0);
+
+Texture2D AlbedoMap : register(t0);
+
+struct PSIn
+{
+	float3 WorldPosition : POSITION;
+	float3 Normal : NORMAL;
+	float3 Tangent : TANGENT;
+	float3 Bitangent : BITANGENT;
+	float2 UV : UV;
+	float4 Position : SV_Position;
+};
+
+// Depth only, with the same alpha test as GBufferWritePS
+void main(PSIn input)
+{
+	if (SampleMaterial(AlbedoMap, Sampler, AlbedoPages, input.UV).a < 0.5f) discard;
+}
@@ -0,0 +1,51 @@
+// Decoding of CompactVertex, mirrors VertexFormat::Decode in Source/VertexFormat.cpp
+
+#include "Instance.hlsli"
+
+struct CompactVSIn
+{
+	float4 Position : POSITION;
+	float2 Normal : NORMAL;
+	float2 Tangent : TANGENT;
+	float2 UV : UV;
+	float4 TransformX : TRANSFORM_X;
+	float4 TransformY : TRANSFORM_Y;
+	float4 TransformZ : TRANSFORM_Z;
+	float3 QuantOffset : QUANT_OFFSET;
+	float3 QuantScale : QUANT_SCALE;
+};
+
+struct DecodedVertex
+{
+	float3 Position;
+	float3 Normal;
+	float3 Tangent;
+	float3 Bitangent;
+	float2 UV;
+};
+
+float3 OctDecode(float2 encoded)
+{
+	float3 n = float3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.f ? -t : t;
+	return normalize(n);
+}
+
+InstanceTransform GetTransform(CompactVSIn input)
+{
+	InstanceTransform transform = { input.TransformX, input.TransformY, input.TransformZ };
+	return transform;
+}
+
+// Still in object space
+DecodedVertex DecodeVertex(CompactVSIn input)
+{
+	DecodedVertex output;
+	output.Position = input.QuantOffset + input.Position.xyz * input.QuantScale;
+	output.Normal = OctDecode(input.Normal);
+	output.Tangent = OctDecode(input.Tangent);
+	output.Bitangent = cross(output.Normal, output.Tangent) * (input.Position.w > 0.5f ? 1.f : -1.f);
+	output.UV = input.UV;
+	return output;
+}
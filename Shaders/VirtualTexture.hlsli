@@ -0,0 +1,116 @@
+// Sampling of paged textures through their page tables, see Source/PageCache.h for the layout and the encodings.
+
+#define PAGE_SIZE 128
+#define PAGE_BORDER 4
+#define PAGE_SLOT_SIZE 136
+#define SLOTS_PER_SIDE 16
+#define NO_PAGES 0xffffffff
+
+struct PagedTexture
+{
+	uint Pool;
+	uint Offset;
+	uint Width;
+	uint Height;
+	uint Mips;
+};
+
+// Indexed by scene texture
+StructuredBuffer<PagedTexture> PagedTextures : register(t5);
+StructuredBuffer<uint> PageTable : register(t6);
+// One pool per format
+Texture2DArray PoolBC1 : register(t7);
+Texture2DArray PoolBC3 : register(t8);
+Texture2DArray PoolBC4 : register(t9);
+Texture2DArray PoolBC5 : register(t10);
+Texture2DArray PoolBC3Linear : register(t11);
+
+SamplerState PageSampler : register(s3);
+
+cbuffer PageFeedback : register(b4)
+{
+	uint2 FeedbackOffset;
+	uint FeedbackScale;
+	// Which of the material's textures this frame's feedback is for
+	uint FeedbackSlot;
+}
+
+// Scene texture of each of the material's maps, NO_PAGES when the map itself is bound
+cbuffer PagedMaterial : register(b5)
+{
+	uint AlbedoPages;
+	uint SurfacePages;
+}
+
+uint2 GetMipSize(PagedTexture texture, uint mip)
+{
+	return max(uint2(texture.Width, texture.Height) >> mip, 1);
+}
+
+uint2 GetPageCount(PagedTexture texture, uint mip)
+{
+	return (GetMipSize(texture, mip) + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+// The mip regular sampling would pick, clamped to the paged ones
+uint GetPagedMip(PagedTexture texture, float2 uv)
+{
+	float2 size = float2(texture.Width, texture.Height);
+	float2 dx = ddx(uv * size);
+	float2 dy = ddy(uv * size);
+	float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy)));
+	return (uint)clamp(lod, 0.f, float(texture.Mips - 1));
+}
+
+// uv is wrapped already
+uint2 GetPage(PagedTexture texture, float2 uv, uint mip)
+{
+	return min(uint2(uv * GetMipSize(texture, mip)) / PAGE_SIZE, GetPageCount(texture, mip) - 1);
+}
+
+uint GetPageRequest(uint id, float2 uv)
+{
+	PagedTexture texture = PagedTextures[id];
+	uint mip = GetPagedMip(texture, uv);
+	uint2 page = GetPage(texture, frac(uv), mip);
+	return id << 20 | mip << 16 | page.y << 8 | page.x;
+}
+
+float4 SamplePaged(uint id, float2 uv)
+{
+	PagedTexture texture = PagedTextures[id];
+	uint mip = GetPagedMip(texture, uv);
+	uv = frac(uv);
+
+	uint index = texture.Offset;
+	for (uint level = 0; level < mip; level++)
+	{
+		uint2 count = GetPageCount(texture, level);
+		index += count.x * count.y;
+	}
+	uint2 page = GetPage(texture, uv, mip);
+	uint entry = PageTable[index + page.y * GetPageCount(texture, mip).x + page.x];
+
+	// Missing pages point at a coarser one
+	uint resident = entry >> 20;
+	uint slot = entry & 0xfffff;
+	float2 texel = uv * GetMipSize(texture, resident);
+	float2 inPage = texel - floor(texel / PAGE_SIZE) * PAGE_SIZE;
+	float2 origin = float2(slot % SLOTS_PER_SIDE, (slot / SLOTS_PER_SIDE) % SLOTS_PER_SIDE) * PAGE_SLOT_SIZE + PAGE_BORDER;
+	float3 coords = float3((origin + inPage) / (SLOTS_PER_SIDE * PAGE_SLOT_SIZE), slot / (SLOTS_PER_SIDE * SLOTS_PER_SIDE));
+
+	[branch] switch (texture.Pool)
+	{
+	case 0: return PoolBC1.SampleLevel(PageSampler, coords, 0.f);
+	case 1: return PoolBC3.SampleLevel(PageSampler, coords, 0.f);
+	case 2: return PoolBC4.SampleLevel(PageSampler, coords, 0.f);
+	case 3: return PoolBC5.SampleLevel(PageSampler, coords, 0.f);
+	default: return PoolBC3Linear.SampleLevel(PageSampler, coords, 0.f);
+	}
+}
+
+float4 SampleMaterial(Texture2D map, SamplerState mapSampler, uint pages, float2 uv)
+{
+	if (pages == NO_PAGES) return map.Sample(mapSampler, uv);
+	return SamplePaged(pages, uv);
+}
@@ -21,6 +21,7 @@ cbuffer ConstantBuffer : register(b1)
 	float3 CameraPosition;
 	float VoxelHalfExtent;
 	float VoxelGridRes;
+	float3 VoxelCenter;
 }
 
 cbuffer ConstantBuffer : register(b2)
@@ -194,7 +195,7 @@ float4 ConeTrace(float3 P, float3 N, float3 coneDirection, float coneAperture)
 		float mip = log2(diameter / VoxelHalfExtent);
 
 		float3 tc = startPos + coneDirection * dist;
-		tc = (tc /*- CameraPosition*/) / VoxelHalfExtent;
+		tc = (tc - VoxelCenter) / VoxelHalfExtent;
 		tc /= VoxelGridRes;
 		tc = tc * float3(0.5f, -0.5f, 0.5f) + 0.5f;
 
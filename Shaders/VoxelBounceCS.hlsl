@@ -17,7 +17,7 @@ void main(uint3 id : SV_DispatchThreadID)
 		P.y *= -1;
 		P *= VoxelHalfExtent;
 		P *= VoxelGridRes;
-		// P += CameraPosition;
+		P += VoxelCenter;
 		
 		float4 radiance = ConeTraceRadiance(P, plane.xyz);
 		emission += float4(radiance.rgb, 0);
@@ -44,7 +44,7 @@ void main(point GSOut input[1], inout PointStream<GSOut> output)
 		element.Position.y = -element.Position.y;
 		element.Position.xyz *= VoxelGridRes;
 		element.Position.xyz *= VoxelHalfExtent;
-		// element.Position.xyz += CameraPosition;
+		element.Position.xyz += VoxelCenter;
 		element.Position = mul(float4(element.Position.xyz, 1.f), ViewProjection);
 		
 		output.Append(element);
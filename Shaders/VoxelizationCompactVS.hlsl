@@ -0,0 +1,25 @@
+#include "VertexFormat.hlsli"
+
+struct VSOut
+{
+	float3 Position : POSITION;
+	float3 Normal : NORMAL;
+	float3 Tangent : TANGENT;
+	float3 Bitangent : BITANGENT;
+	float2 UV : UV;
+};
+
+VSOut main(CompactVSIn input)
+{
+	DecodedVertex vertex = DecodeVertex(input);
+	InstanceTransform transform = GetTransform(input);
+
+	VSOut output;
+	output.Position = TransformPosition(transform, vertex.Position);
+	output.Normal = TransformNormal(transform, vertex.Normal);
+	output.Tangent = TransformDirection(transform, vertex.Tangent);
+	output.Bitangent = TransformDirection(transform, vertex.Bitangent);
+	output.UV = vertex.UV;
+	
+	return output;
+}
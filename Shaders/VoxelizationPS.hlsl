@@ -1,4 +1,5 @@
 #include "Voxel.hlsli"
+#include "VirtualTexture.hlsli"
 
 RWStructuredBuffer<Voxel> VoxelGrid : register(u0);
 
@@ -18,14 +19,14 @@ struct PSIn
 
 void main(PSIn input)
 {
-	float3 color = AlbedoMap.Sample(Sampler, input.UV).xyz;
+	float3 color = SampleMaterial(AlbedoMap, Sampler, AlbedoPages, input.UV).xyz;
 	
 	float NdotL = dot(input.Normal, LightDirection);
 	float4 output = float4(NdotL > 0.f ? NdotL * LightIntensity * LightColor * color : float3(0.f, 0.f, 0.f), 1.f);
 	
-	float3 diff = (input.WorldPosition /*- CameraPosition*/) / (VoxelGridRes * VoxelHalfExtent);
+	float3 diff = (input.WorldPosition - VoxelCenter) / (VoxelGridRes * VoxelHalfExtent);
 	float3 corner = floor(diff);
-	corner *= VoxelGridRes * VoxelHalfExtent;
+	corner = corner * VoxelGridRes * VoxelHalfExtent + VoxelCenter;
 	float3 uvw = diff * float3(0.5f, -0.5f, 0.5f) + 0.5f;
 	uint3 coords = floor(uvw * VoxelGridRes);
 	
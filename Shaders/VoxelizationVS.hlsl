@@ -1,3 +1,5 @@
+#include "Instance.hlsli"
+
 struct VSIn
 {
 	float3 Position : POSITION;
@@ -5,6 +7,9 @@ struct VSIn
 	float3 Tangent : TANGENT;
 	float3 Bitangent : BITANGENT;
 	float2 UV : UV;
+	float4 TransformX : TRANSFORM_X;
+	float4 TransformY : TRANSFORM_Y;
+	float4 TransformZ : TRANSFORM_Z;
 };
 
 struct VSOut
@@ -18,12 +23,14 @@ struct VSOut
 
 VSOut main(VSIn input)
 {
+	InstanceTransform transform = { input.TransformX, input.TransformY, input.TransformZ };
+
 	VSOut output;
 	
-	output.Position = input.Position;
-	output.Normal = input.Normal;
-	output.Tangent = input.Tangent;
-	output.Bitangent = input.Bitangent;
+	output.Position = TransformPosition(transform, input.Position);
+	output.Normal = TransformNormal(transform, input.Normal);
+	output.Tangent = TransformDirection(transform, input.Tangent);
+	output.Bitangent = TransformDirection(transform, input.Bitangent);
 	output.UV = input.UV;
 	
 	return output;
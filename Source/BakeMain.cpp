@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Import/Bake.h"
+#include "Import/Benchmark.h"
+
+// Entry point of the VoxelBake command line target, see CMakeLists.txt. Nothing here may depend on Windows or D3D.
+// VoxelBake [-compact] [-atlas] [-force] [-verbose] [-benchmark [iterations]] <scene or directory>...
+// -benchmark times the import, BVH, culling and page cache passes over each scene instead of baking it, like Voxel.exe's.
+
+bool IsSceneFile(const std::filesystem::path& path)
+{
+	static const char* extensions[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".ply", ".stl", ".blend" };
+	auto extension = path.extension().string();
+	for (auto& c : extension)
+	{
+		c = char(tolower(c));
+	}
+	for (auto known : extensions)
+	{
+		if (extension == known) return true;
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	Bake::Options options;
+	std::vector<std::string> paths;
+	uint32_t benchmarkIterations = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-compact")) options.Import.CompactVertices = true;
+		else if (!strcmp(argv[i], "-atlas")) options.Import.AtlasTextures = true;
+		else if (!strcmp(argv[i], "-force")) options.Force = true;
+		else if (!strcmp(argv[i], "-verbose")) options.Verbose = true;
+		else if (!strcmp(argv[i], "-benchmark"))
+		{
+			benchmarkIterations = 10;
+			if (i + 1 < argc && atoi(argv[i + 1]) > 0) benchmarkIterations = uint32_t(atoi(argv[++i]));
+		}
+		else if (std::filesystem::is_directory(argv[i]))
+		{
+			// Sorted so runs over the same tree print in the same order
+			std::vector<std::string> found;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[i]))
+			{
+				if (entry.is_regular_file() && IsSceneFile(entry.path())) found.push_back(entry.path().string());
+			}
+			std::sort(found.begin(), found.end());
+			paths.insert(paths.end(), found.begin(), found.end());
+		}
+		else paths.push_back(argv[i]);
+	}
+
+	if (paths.empty())
+	{
+		printf("Usage: %s [-compact] [-atlas] [-force] [-verbose] [-benchmark [iterations]] <scene or directory>...\n", argv[0]);
+		return 2;
+	}
+
+	if (benchmarkIterations)
+	{
+		int failed = 0;
+		for (const auto& path : paths)
+		{
+			try { Benchmark::Run(path, benchmarkIterations, options.Import); }
+			catch (const std::exception& e)
+			{
+				printf("Error: %s\n", e.what());
+				failed = 1;
+			}
+		}
+		return failed;
+	}
+
+	return Bake::Run(paths, options) ? 1 : 0;
+}
@@ -0,0 +1,730 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "Jobs.h"
+#include "SceneData.h"
+
+using namespace DirectX;
+
+namespace
+{
+
+	constexpr uint32_t m_BinCount = 16;
+	// Subtrees bigger than this are built as separate jobs
+	constexpr uint32_t m_ParallelThreshold = 4096;
+	// Past this depth splits are forced to the median, which bounds the traversal stack
+	constexpr uint32_t m_MaxSahDepth = 48;
+	// Relative to one primitive test
+	constexpr float m_TraversalCost = 1.f;
+
+	struct Bounds
+	{
+		XMVECTOR Min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR Max = XMVectorReplicate(-FLT_MAX);
+
+		void Grow(FXMVECTOR point)
+		{
+			Min = XMVectorMin(Min, point);
+			Max = XMVectorMax(Max, point);
+		}
+
+		void Grow(const Bounds& other)
+		{
+			Min = XMVectorMin(Min, other.Min);
+			Max = XMVectorMax(Max, other.Max);
+		}
+
+		float HalfArea() const
+		{
+			XMFLOAT3 extent;
+			XMStoreFloat3(&extent, XMVectorMax(XMVectorSubtract(Max, Min), XMVectorZero()));
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct BinaryNode
+	{
+		Bounds Box;
+		// Children are Left and Left + 1, a leaf has Count > 0
+		uint32_t Left;
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	class Builder
+	{
+	public:
+		Builder(std::span<const Box> primitives, std::vector<uint32_t>& order)
+			: m_Boxes(primitives.size()), m_Centroids(primitives.size()), m_Order(order), m_Nodes(primitives.size() * 2)
+		{
+			for (size_t i = 0; i < primitives.size(); i++)
+			{
+				m_Boxes[i].Min = XMLoadFloat3(&primitives[i].Min);
+				m_Boxes[i].Max = XMLoadFloat3(&primitives[i].Max);
+				XMStoreFloat3(&m_Centroids[i], XMVectorScale(XMVectorAdd(m_Boxes[i].Min, m_Boxes[i].Max), 0.5f));
+			}
+
+			m_NextNode = 1;
+			Build(0, 0, uint32_t(primitives.size()), 0);
+		}
+
+		std::vector<BvhNode> Collapse()
+		{
+			std::vector<BvhNode> nodes;
+			nodes.reserve(m_NextNode / 2 + 1);
+			if (m_Nodes[0].Count)
+			{
+				// Too few primitives for an inner node, one leaf slot in the root
+				nodes.emplace_back();
+				Fill(nodes[0], { 0 });
+				return nodes;
+			}
+			Collapse(0, nodes);
+			return nodes;
+		}
+
+	private:
+		void Build(uint32_t index, uint32_t first, uint32_t count, uint32_t depth)
+		{
+			auto& node = m_Nodes[index];
+			node.First = first;
+			node.Count = count;
+
+			Bounds centroids;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				node.Box.Grow(m_Boxes[m_Order[i]]);
+				centroids.Grow(XMLoadFloat3(&m_Centroids[m_Order[i]]));
+			}
+			if (count == 1) return;
+
+			uint32_t split = FindSplit(node, centroids, depth);
+			if (split == 0) return;
+
+			node.Left = m_NextNode.fetch_add(2);
+			node.Count = 0;
+			uint32_t left = node.Left;
+			auto buildLeft = [=, this] { Build(left, first, split, depth + 1); };
+			auto buildRight = [=, this] { Build(left + 1, first + split, count - split, depth + 1); };
+			if (count > m_ParallelThreshold)
+			{
+				Jobs::ParallelFor(2, [&](uint32_t i) { i ? buildRight() : buildLeft(); });
+			}
+			else
+			{
+				buildLeft();
+				buildRight();
+			}
+		}
+
+		// Partitions the node's primitives and returns how many go left, 0 to make it a leaf
+		uint32_t FindSplit(const BinaryNode& node, const Bounds& centroids, uint32_t depth)
+		{
+			uint32_t first = node.First;
+			uint32_t count = node.Count;
+
+			XMFLOAT3 min, extent;
+			XMStoreFloat3(&min, centroids.Min);
+			XMStoreFloat3(&extent, XMVectorSubtract(centroids.Max, centroids.Min));
+			const float mins[] = { min.x, min.y, min.z };
+			const float extents[] = { extent.x, extent.y, extent.z };
+
+			auto median = [&]
+			{
+				uint32_t axis = uint32_t(std::max_element(extents, extents + 3) - extents);
+				uint32_t half = count / 2;
+				std::nth_element(m_Order.begin() + first, m_Order.begin() + first + half, m_Order.begin() + first + count,
+					[&](uint32_t a, uint32_t b) { return GetAxis(m_Centroids[a], axis) < GetAxis(m_Centroids[b], axis); });
+				return half;
+			};
+			if (depth >= m_MaxSahDepth) return count <= Bvh::MaxLeafSize ? 0 : median();
+
+			float bestCost = FLT_MAX;
+			uint32_t bestAxis = 0;
+			uint32_t bestBin = 0;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				if (extents[axis] <= 0.f) continue;
+
+				Bounds bins[m_BinCount];
+				uint32_t counts[m_BinCount] = {};
+				float scale = m_BinCount / extents[axis];
+				for (uint32_t i = first; i < first + count; i++)
+				{
+					uint32_t bin = GetBin(m_Centroids[m_Order[i]], axis, mins[axis], scale);
+					bins[bin].Grow(m_Boxes[m_Order[i]]);
+					counts[bin]++;
+				}
+
+				// Sweep from the right, then from the left evaluating every plane between bins
+				float rightArea[m_BinCount];
+				uint32_t rightCount[m_BinCount];
+				Bounds right;
+				uint32_t rightTotal = 0;
+				for (uint32_t b = m_BinCount - 1; b > 0; b--)
+				{
+					right.Grow(bins[b]);
+					rightTotal += counts[b];
+					rightArea[b] = right.HalfArea();
+					rightCount[b] = rightTotal;
+				}
+
+				Bounds left;
+				uint32_t leftTotal = 0;
+				for (uint32_t b = 0; b < m_BinCount - 1; b++)
+				{
+					left.Grow(bins[b]);
+					leftTotal += counts[b];
+					if (!leftTotal || !rightCount[b + 1]) continue;
+
+					float cost = left.HalfArea() * leftTotal + rightArea[b + 1] * rightCount[b + 1];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+
+			float leafCost = node.Box.HalfArea() * count;
+			bestCost = node.Box.HalfArea() * m_TraversalCost + bestCost;
+			if (bestCost == FLT_MAX)
+			{
+				// Every centroid is in the same spot
+				return count <= Bvh::MaxLeafSize ? 0 : median();
+			}
+			if (count <= Bvh::MaxLeafSize && leafCost <= bestCost) return 0;
+
+			float scale = m_BinCount / extents[bestAxis];
+			auto middle = std::partition(m_Order.begin() + first, m_Order.begin() + first + count, [&](uint32_t i)
+				{
+					return GetBin(m_Centroids[i], bestAxis, mins[bestAxis], scale) <= bestBin;
+				});
+			return uint32_t(middle - (m_Order.begin() + first));
+		}
+
+		static float GetAxis(const XMFLOAT3& vector, uint32_t axis)
+		{
+			return (&vector.x)[axis];
+		}
+
+		static uint32_t GetBin(const XMFLOAT3& centroid, uint32_t axis, float min, float scale)
+		{
+			return std::min(uint32_t((GetAxis(centroid, axis) - min) * scale), m_BinCount - 1);
+		}
+
+		// Pulls grandchildren up until there are four slots, always opening the largest inner child
+		uint32_t Collapse(uint32_t index, std::vector<BvhNode>& nodes)
+		{
+			std::vector<uint32_t> children = { m_Nodes[index].Left, m_Nodes[index].Left + 1 };
+			while (children.size() < 4)
+			{
+				int32_t best = -1;
+				float bestArea = -1.f;
+				for (size_t i = 0; i < children.size(); i++)
+				{
+					const auto& child = m_Nodes[children[i]];
+					if (!child.Count && child.Box.HalfArea() > bestArea)
+					{
+						best = int32_t(i);
+						bestArea = child.Box.HalfArea();
+					}
+				}
+				if (best < 0) break;
+
+				uint32_t left = m_Nodes[children[best]].Left;
+				children[best] = left;
+				children.push_back(left + 1);
+			}
+
+			uint32_t result = uint32_t(nodes.size());
+			nodes.emplace_back();
+			Fill(nodes[result], children);
+			for (uint32_t i = 0; i < children.size(); i++)
+			{
+				if (!m_Nodes[children[i]].Count)
+				{
+					uint32_t child = Collapse(children[i], nodes);
+					nodes[result].Children[i] = child;
+				}
+			}
+			return result;
+		}
+
+		void Fill(BvhNode& node, const std::vector<uint32_t>& children)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				XMFLOAT3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+				XMFLOAT3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				node.Children[i] = BvhNode::Empty;
+				node.Counts[i] = 0;
+				if (i < children.size())
+				{
+					const auto& child = m_Nodes[children[i]];
+					XMStoreFloat3(&min, child.Box.Min);
+					XMStoreFloat3(&max, child.Box.Max);
+					node.Children[i] = child.Count ? child.First : 0;
+					node.Counts[i] = child.Count;
+				}
+				node.MinX[i] = min.x;
+				node.MinY[i] = min.y;
+				node.MinZ[i] = min.z;
+				node.MaxX[i] = max.x;
+				node.MaxY[i] = max.y;
+				node.MaxZ[i] = max.z;
+			}
+		}
+
+		std::vector<Bounds> m_Boxes;
+		// Unaligned floats, a vector of XMVECTOR would drop its alignment
+		std::vector<XMFLOAT3> m_Centroids;
+		std::vector<uint32_t>& m_Order;
+		std::vector<BinaryNode> m_Nodes;
+		std::atomic<uint32_t> m_NextNode;
+	};
+
+	XMVECTOR LoadLanes(const float (&lanes)[4])
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(lanes));
+	}
+
+	uint32_t GetMask(FXMVECTOR comparison)
+	{
+		XMUINT4 lanes;
+		XMStoreUInt4(&lanes, comparison);
+		return (lanes.x ? 1u : 0u) | (lanes.y ? 2u : 0u) | (lanes.z ? 4u : 0u) | (lanes.w ? 8u : 0u);
+	}
+
+}
+
+Box Box::Transform(const XMFLOAT3X4& transform) const
+{
+	// Arvo: the center moves, the extent grows by the absolute value of the rotation
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&Min), XMLoadFloat3(&Max)), 0.5f);
+	XMVECTOR extent = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&Max), XMLoadFloat3(&Min)), 0.5f);
+	float newCenter[3], newExtent[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		XMVECTOR row = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(transform.m[i]));
+		newCenter[i] = XMVectorGetX(XMVector3Dot(row, center)) + transform.m[i][3];
+		newExtent[i] = XMVectorGetX(XMVector3Dot(XMVectorAbs(row), extent));
+	}
+	return {
+		{ newCenter[0] - newExtent[0], newCenter[1] - newExtent[1], newCenter[2] - newExtent[2] },
+		{ newCenter[0] + newExtent[0], newCenter[1] + newExtent[1], newCenter[2] + newExtent[2] }
+	};
+}
+
+Frustum Frustum::FromMatrix(FXMMATRIX viewProjection)
+{
+	// Columns of the row vector matrix are the clip space rows
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixTranspose(viewProjection));
+	XMVECTOR x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(m.m[0]));
+	XMVECTOR y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(m.m[1]));
+	XMVECTOR z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(m.m[2]));
+	XMVECTOR w = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(m.m[3]));
+
+	const XMVECTOR planes[6] = {
+		XMVectorAdd(w, x), XMVectorSubtract(w, x),
+		XMVectorAdd(w, y), XMVectorSubtract(w, y),
+		z, XMVectorSubtract(w, z)
+	};
+
+	Frustum frustum;
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		float length = XMVectorGetX(XMVector3Length(planes[i]));
+		XMStoreFloat4(&frustum.Planes[i], XMVectorScale(planes[i], length > 0.f ? 1.f / length : 0.f));
+	}
+	return frustum;
+}
+
+Frustum Frustum::FromBox(const Box& box)
+{
+	return { {
+		{ 1.f, 0.f, 0.f, -box.Min.x }, { -1.f, 0.f, 0.f, box.Max.x },
+		{ 0.f, 1.f, 0.f, -box.Min.y }, { 0.f, -1.f, 0.f, box.Max.y },
+		{ 0.f, 0.f, 1.f, -box.Min.z }, { 0.f, 0.f, -1.f, box.Max.z }
+	} };
+}
+
+Bvh::Bvh(std::span<const Box> primitives)
+{
+	if (primitives.empty()) return;
+
+	Primitives.resize(primitives.size());
+	for (uint32_t i = 0; i < Primitives.size(); i++)
+	{
+		Primitives[i] = i;
+	}
+
+	Builder builder(primitives, Primitives);
+	Nodes = builder.Collapse();
+}
+
+Bvh::Bvh(std::span<const BvhNode> nodes, std::span<const uint32_t> primitives)
+	: Nodes(nodes.begin(), nodes.end()), Primitives(primitives.begin(), primitives.end())
+{}
+
+Bvh::RayState Bvh::Prepare(const Ray& ray)
+{
+	// Zero components get a huge inverse instead of inf, which would make 0 * inf NaNs in the slab test
+	auto inverse = [](float d) { return 1.f / (std::abs(d) > 1e-20f ? d : std::copysign(1e-20f, d)); };
+
+	RayState state;
+	state.Origin[0] = XMVectorReplicate(ray.Origin.x);
+	state.Origin[1] = XMVectorReplicate(ray.Origin.y);
+	state.Origin[2] = XMVectorReplicate(ray.Origin.z);
+	state.InverseDirection[0] = XMVectorReplicate(inverse(ray.Direction.x));
+	state.InverseDirection[1] = XMVectorReplicate(inverse(ray.Direction.y));
+	state.InverseDirection[2] = XMVectorReplicate(inverse(ray.Direction.z));
+	return state;
+}
+
+uint32_t Bvh::IntersectNode(const BvhNode& node, const RayState& ray, float tMax, float (&tNear)[4])
+{
+	XMVECTOR x1 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.MinX), ray.Origin[0]), ray.InverseDirection[0]);
+	XMVECTOR x2 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.MaxX), ray.Origin[0]), ray.InverseDirection[0]);
+	XMVECTOR y1 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.MinY), ray.Origin[1]), ray.InverseDirection[1]);
+	XMVECTOR y2 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.MaxY), ray.Origin[1]), ray.InverseDirection[1]);
+	XMVECTOR z1 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.MinZ), ray.Origin[2]), ray.InverseDirection[2]);
+	XMVECTOR z2 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.MaxZ), ray.Origin[2]), ray.InverseDirection[2]);
+
+	XMVECTOR enter = XMVectorMax(XMVectorMax(XMVectorMin(x1, x2), XMVectorMin(y1, y2)), XMVectorMax(XMVectorMin(z1, z2), XMVectorZero()));
+	XMVECTOR exit = XMVectorMin(XMVectorMin(XMVectorMax(x1, x2), XMVectorMax(y1, y2)), XMVectorMin(XMVectorMax(z1, z2), XMVectorReplicate(tMax)));
+
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(tNear), enter);
+	return GetMask(XMVectorLessOrEqual(enter, exit));
+}
+
+uint32_t Bvh::OverlapNode(const BvhNode& node, const Box& box)
+{
+	XMVECTOR overlap = XMVectorAndInt(
+		XMVectorAndInt(XMVectorLessOrEqual(LoadLanes(node.MinX), XMVectorReplicate(box.Max.x)),
+			XMVectorGreaterOrEqual(LoadLanes(node.MaxX), XMVectorReplicate(box.Min.x))),
+		XMVectorAndInt(
+			XMVectorAndInt(XMVectorLessOrEqual(LoadLanes(node.MinY), XMVectorReplicate(box.Max.y)),
+				XMVectorGreaterOrEqual(LoadLanes(node.MaxY), XMVectorReplicate(box.Min.y))),
+			XMVectorAndInt(XMVectorLessOrEqual(LoadLanes(node.MinZ), XMVectorReplicate(box.Max.z)),
+				XMVectorGreaterOrEqual(LoadLanes(node.MaxZ), XMVectorReplicate(box.Min.z)))));
+	return GetMask(overlap);
+}
+
+uint32_t Bvh::CullNode(const BvhNode& node, const Frustum& frustum)
+{
+	XMVECTOR minX = LoadLanes(node.MinX), minY = LoadLanes(node.MinY), minZ = LoadLanes(node.MinZ);
+	XMVECTOR maxX = LoadLanes(node.MaxX), maxY = LoadLanes(node.MaxY), maxZ = LoadLanes(node.MaxZ);
+
+	// Only the corner furthest along each plane's normal has to be tested
+	XMVECTOR inside = XMVectorTrueInt();
+	for (const auto& plane : frustum.Planes)
+	{
+		XMVECTOR distance = XMVectorReplicate(plane.w);
+		distance = XMVectorMultiplyAdd(plane.x >= 0.f ? maxX : minX, XMVectorReplicate(plane.x), distance);
+		distance = XMVectorMultiplyAdd(plane.y >= 0.f ? maxY : minY, XMVectorReplicate(plane.y), distance);
+		distance = XMVectorMultiplyAdd(plane.z >= 0.f ? maxZ : minZ, XMVectorReplicate(plane.z), distance);
+		inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, XMVectorZero()));
+	}
+	return GetMask(inside);
+}
+
+namespace SceneBvh
+{
+
+	static bool IsInstanced(const MaterialData& material)
+	{
+		return material.InstanceCount > 1;
+	}
+
+	// Builds over a subset of the boxes, primitives come out as ids[i] instead of i
+	static Bvh BuildSubset(std::span<const Box> boxes, std::span<const uint32_t> ids)
+	{
+		Bvh bvh(boxes);
+		for (auto& primitive : bvh.Primitives)
+		{
+			primitive = ids[primitive];
+		}
+		return bvh;
+	}
+
+	Box GetMaterialBounds(const SceneView& scene, uint32_t material)
+	{
+		const auto& data = scene.Materials[material];
+		XMVECTOR min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+		for (uint32_t c = data.BaseCluster; c < data.BaseCluster + data.ClusterCount; c++)
+		{
+			min = XMVectorMin(min, XMLoadFloat3(&scene.Clusters[c].Min));
+			max = XMVectorMax(max, XMLoadFloat3(&scene.Clusters[c].Max));
+		}
+		Box box;
+		XMStoreFloat3(&box.Min, min);
+		XMStoreFloat3(&box.Max, max);
+		return box;
+	}
+
+	// Four positions are three float4 loads with lanes xyzx, yzxy, zxyz, so the loop is plain vertical min and max and
+	// the lanes are only folded back into x, y and z once at the end
+	static void ReducePositions(std::span<const XMFLOAT3> positions, XMVECTOR& min, XMVECTOR& max)
+	{
+		XMVECTOR min0 = XMVectorReplicate(FLT_MAX), min1 = min0, min2 = min0;
+		XMVECTOR max0 = XMVectorReplicate(-FLT_MAX), max1 = max0, max2 = max0;
+		const float* p = &positions.data()->x;
+		size_t v = 0;
+		for (; v + 4 <= positions.size(); v += 4, p += 12)
+		{
+			XMVECTOR a = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+			XMVECTOR b = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + 4));
+			XMVECTOR c = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p + 8));
+			min0 = XMVectorMin(min0, a);
+			min1 = XMVectorMin(min1, b);
+			min2 = XMVectorMin(min2, c);
+			max0 = XMVectorMax(max0, a);
+			max1 = XMVectorMax(max1, b);
+			max2 = XMVectorMax(max2, c);
+		}
+
+		auto fold = [](XMVECTOR a, XMVECTOR b, XMVECTOR c, auto op)
+		{
+			return op(op(a, XMVectorPermute<3, 4, 5, 6>(a, b)), op(XMVectorPermute<2, 3, 4, 5>(b, c), XMVectorSwizzle<1, 2, 3, 3>(c)));
+		};
+		min = XMVectorMin(min, fold(min0, min1, min2, [](XMVECTOR a, XMVECTOR b) { return XMVectorMin(a, b); }));
+		max = XMVectorMax(max, fold(max0, max1, max2, [](XMVECTOR a, XMVECTOR b) { return XMVectorMax(a, b); }));
+		for (; v < positions.size(); v++)
+		{
+			XMVECTOR position = XMLoadFloat3(&positions[v]);
+			min = XMVectorMin(min, position);
+			max = XMVectorMax(max, position);
+		}
+	}
+
+	Box GetSceneBounds(const SceneView& scene)
+	{
+		// Materials in parallel, instances transform every vertex since a rotated box is only an upper bound
+		std::vector<Box> boxes(scene.Materials.size());
+		Jobs::ParallelFor(uint32_t(scene.Materials.size()), [&](uint32_t m)
+			{
+				const auto& material = scene.Materials[m];
+				auto positions = scene.Positions.subspan(material.BaseVertex, material.VertexCount);
+				XMVECTOR min = XMVectorReplicate(FLT_MAX);
+				XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+				if (!IsInstanced(material))
+				{
+					if (material.InstanceCount) ReducePositions(positions, min, max);
+				}
+				else
+				{
+					for (uint32_t i = material.BaseInstance; i < material.BaseInstance + material.InstanceCount; i++)
+					{
+						XMMATRIX transform = XMLoadFloat3x4(&scene.Instances[i].Transform);
+						for (const auto& position : positions)
+						{
+							XMVECTOR world = XMVector3Transform(XMLoadFloat3(&position), transform);
+							min = XMVectorMin(min, world);
+							max = XMVectorMax(max, world);
+						}
+					}
+				}
+				XMStoreFloat3(&boxes[m].Min, min);
+				XMStoreFloat3(&boxes[m].Max, max);
+			});
+
+		XMVECTOR min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+		for (const auto& box : boxes)
+		{
+			min = XMVectorMin(min, XMLoadFloat3(&box.Min));
+			max = XMVectorMax(max, XMLoadFloat3(&box.Max));
+		}
+		// Nothing to draw, a point at the origin instead of an inverted box
+		if (XMVector3Greater(min, max))
+		{
+			min = max = XMVectorZero();
+		}
+		Box box;
+		XMStoreFloat3(&box.Min, min);
+		XMStoreFloat3(&box.Max, max);
+		return box;
+	}
+
+	Bvh BuildClusters(const SceneView& scene)
+	{
+		std::vector<Box> boxes;
+		std::vector<uint32_t> ids;
+		for (uint32_t m = 0; m < scene.Materials.size(); m++)
+		{
+			const auto& material = scene.Materials[m];
+			if (IsInstanced(material))
+			{
+				auto bounds = GetMaterialBounds(scene, m);
+				for (uint32_t i = material.BaseInstance; i < material.BaseInstance + material.InstanceCount; i++)
+				{
+					boxes.push_back(bounds.Transform(scene.Instances[i].Transform));
+					ids.push_back(uint32_t(scene.Clusters.size()) + i);
+				}
+				continue;
+			}
+
+			for (uint32_t c = material.BaseCluster; c < material.BaseCluster + material.ClusterCount; c++)
+			{
+				boxes.push_back({ scene.Clusters[c].Min, scene.Clusters[c].Max });
+				ids.push_back(c);
+			}
+		}
+		return BuildSubset(boxes, ids);
+	}
+
+	static uint32_t GetTriangleMaterial(const SceneView& scene, uint32_t triangle)
+	{
+		auto it = std::upper_bound(scene.Materials.begin(), scene.Materials.end(), triangle * 3,
+			[](uint32_t index, const MaterialData& material) { return index < material.BaseIndex; });
+		return uint32_t(it - scene.Materials.begin()) - 1;
+	}
+
+	static uint32_t GetInstanceMaterial(const SceneView& scene, uint32_t instance)
+	{
+		auto it = std::upper_bound(scene.Materials.begin(), scene.Materials.end(), instance,
+			[](uint32_t index, const MaterialData& material) { return index < material.BaseInstance; });
+		return uint32_t(it - scene.Materials.begin()) - 1;
+	}
+
+	TriangleTrees BuildTriangles(const SceneView& scene)
+	{
+		// LOD indices come after the full detail ones and are left out
+		uint32_t triangles = scene.Materials.empty() ? 0 : (scene.Materials.back().BaseIndex + scene.Materials.back().IndexCount) / 3;
+		std::vector<Box> boxes(triangles);
+		Jobs::ParallelFor(uint32_t(scene.Materials.size()), [&](uint32_t m)
+			{
+				const auto& material = scene.Materials[m];
+				for (uint32_t t = material.BaseIndex / 3; t < (material.BaseIndex + material.IndexCount) / 3; t++)
+				{
+					XMVECTOR p0 = XMLoadFloat3(&scene.Positions[material.BaseVertex + scene.Indices[t * 3]]);
+					XMVECTOR p1 = XMLoadFloat3(&scene.Positions[material.BaseVertex + scene.Indices[t * 3 + 1]]);
+					XMVECTOR p2 = XMLoadFloat3(&scene.Positions[material.BaseVertex + scene.Indices[t * 3 + 2]]);
+					XMStoreFloat3(&boxes[t].Min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+					XMStoreFloat3(&boxes[t].Max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+				}
+			});
+
+		TriangleTrees trees;
+		trees.Materials.resize(scene.Materials.size());
+		trees.Inverses.resize(scene.Instances.size());
+		std::vector<Box> worldBoxes, instanceBoxes;
+		std::vector<uint32_t> worldIds, instanceIds;
+		for (uint32_t m = 0; m < scene.Materials.size(); m++)
+		{
+			const auto& material = scene.Materials[m];
+			uint32_t first = material.BaseIndex / 3;
+			uint32_t count = material.IndexCount / 3;
+			if (!IsInstanced(material))
+			{
+				worldBoxes.insert(worldBoxes.end(), boxes.begin() + first, boxes.begin() + first + count);
+				for (uint32_t t = first; t < first + count; t++)
+				{
+					worldIds.push_back(t);
+				}
+				continue;
+			}
+
+			trees.Materials[m] = Bvh(std::span<const Box>(boxes).subspan(first, count));
+			for (auto& primitive : trees.Materials[m].Primitives)
+			{
+				primitive += first;
+			}
+
+			auto bounds = GetMaterialBounds(scene, m);
+			for (uint32_t i = material.BaseInstance; i < material.BaseInstance + material.InstanceCount; i++)
+			{
+				XMMATRIX transform = XMLoadFloat3x4(&scene.Instances[i].Transform);
+				XMStoreFloat3x4(&trees.Inverses[i], XMMatrixInverse(nullptr, transform));
+				instanceBoxes.push_back(bounds.Transform(scene.Instances[i].Transform));
+				instanceIds.push_back(i);
+			}
+		}
+		trees.World = BuildSubset(worldBoxes, worldIds);
+		trees.Instances = BuildSubset(instanceBoxes, instanceIds);
+		return trees;
+	}
+
+	std::optional<RayHit> IntersectTriangle(const SceneView& scene, uint32_t triangle, const Ray& ray)
+	{
+		// Moller-Trumbore
+		XMVECTOR origin = XMLoadFloat3(&ray.Origin);
+		XMVECTOR direction = XMLoadFloat3(&ray.Direction);
+		int32_t baseVertex = scene.Materials[GetTriangleMaterial(scene, triangle)].BaseVertex;
+		XMVECTOR p0 = XMLoadFloat3(&scene.Positions[baseVertex + scene.Indices[triangle * 3]]);
+		XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&scene.Positions[baseVertex + scene.Indices[triangle * 3 + 1]]), p0);
+		XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&scene.Positions[baseVertex + scene.Indices[triangle * 3 + 2]]), p0);
+
+		XMVECTOR p = XMVector3Cross(direction, e2);
+		float determinant = XMVectorGetX(XMVector3Dot(e1, p));
+		if (std::abs(determinant) < 1e-12f) return std::nullopt;
+
+		float inverse = 1.f / determinant;
+		XMVECTOR s = XMVectorSubtract(origin, p0);
+		float u = XMVectorGetX(XMVector3Dot(s, p)) * inverse;
+		if (u < 0.f || u > 1.f) return std::nullopt;
+
+		XMVECTOR q = XMVector3Cross(s, e1);
+		float v = XMVectorGetX(XMVector3Dot(direction, q)) * inverse;
+		if (v < 0.f || u + v > 1.f) return std::nullopt;
+
+		float t = XMVectorGetX(XMVector3Dot(e2, q)) * inverse;
+		if (t < 0.f || t > ray.TMax) return std::nullopt;
+
+		return RayHit{ t, triangle, u, v };
+	}
+
+	Ray ToObjectSpace(const TriangleTrees& trees, uint32_t instance, const Ray& ray)
+	{
+		// The direction is not normalized, so t keeps measuring world space distance
+		XMMATRIX inverse = XMLoadFloat3x4(&trees.Inverses[instance]);
+		Ray local;
+		XMStoreFloat3(&local.Origin, XMVector3Transform(XMLoadFloat3(&ray.Origin), inverse));
+		XMStoreFloat3(&local.Direction, XMVector3TransformNormal(XMLoadFloat3(&ray.Direction), inverse));
+		local.TMax = ray.TMax;
+		return local;
+	}
+
+	std::optional<RayHit> RayCast(const TriangleTrees& trees, const SceneView& scene, const Ray& ray)
+	{
+		std::optional<RayHit> hit;
+		auto test = [&](const Ray& tested, uint32_t triangle, float& tMax, uint32_t instance)
+		{
+			Ray clipped = tested;
+			clipped.TMax = tMax;
+			if (auto triangleHit = IntersectTriangle(scene, triangle, clipped))
+			{
+				hit = triangleHit;
+				hit->Instance = instance;
+				tMax = hit->Distance;
+			}
+		};
+
+		trees.World.Intersect(ray, [&](uint32_t triangle, float& tMax)
+			{
+				test(ray, triangle, tMax, scene.Materials[GetTriangleMaterial(scene, triangle)].BaseInstance);
+			});
+
+		Ray clipped = ray;
+		if (hit) clipped.TMax = hit->Distance;
+		trees.Instances.Intersect(clipped, [&](uint32_t instance, float& tMax)
+			{
+				Ray local = ToObjectSpace(trees, instance, ray);
+				local.TMax = tMax;
+				trees.Materials[GetInstanceMaterial(scene, instance)].Intersect(local, [&](uint32_t triangle, float& localMax)
+					{
+						test(local, triangle, localMax, instance);
+					});
+				if (hit) tMax = (std::min)(tMax, hit->Distance);
+			});
+		return hit;
+	}
+
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <DirectXMath.h>
+
+struct ClusterData;
+struct SceneView;
+
+struct Box
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+
+	// Smallest box around the transformed corners, transform as in InstanceData
+	Box Transform(const DirectX::XMFLOAT3X4& transform) const;
+};
+
+struct Ray
+{
+	DirectX::XMFLOAT3 Origin;
+	DirectX::XMFLOAT3 Direction;
+	float TMax = FLT_MAX;
+};
+
+// Planes point inwards: a point p is inside if dot(Plane.xyz, p) + Plane.w >= 0 for all of them.
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];
+
+	// D3D clip space, row vectors: left, right, bottom, top, near, far.
+	static Frustum FromMatrix(DirectX::FXMMATRIX viewProjection);
+	static Frustum FromBox(const Box& box);
+};
+
+// Four children in SoA so one node is tested with a single pass of vector instructions.
+// An empty slot has Children == Empty, a leaf slot has Counts > 0 and Children as its first primitive.
+struct BvhNode
+{
+	static constexpr uint32_t Empty = ~0u;
+
+	float MinX[4];
+	float MinY[4];
+	float MinZ[4];
+	float MaxX[4];
+	float MaxY[4];
+	float MaxZ[4];
+	uint32_t Children[4];
+	uint32_t Counts[4];
+};
+
+// 4-wide BVH over arbitrary boxes, built with binned SAH. Queries hand primitive indices (into the span
+// the tree was built from) to a callback.
+class Bvh
+{
+public:
+	static constexpr uint32_t MaxLeafSize = 4;
+
+	Bvh() = default;
+	// Splits large subtrees across the job pool.
+	Bvh(std::span<const Box> primitives);
+	// Trees loaded from the cache
+	Bvh(std::span<const BvhNode> nodes, std::span<const uint32_t> primitives);
+
+	bool Empty() const { return Nodes.empty(); }
+
+	// func(primitive, tMax) tests the primitive, lowering tMax on a hit so farther nodes are skipped.
+	template<typename F>
+	void Intersect(const Ray& ray, F&& func) const;
+	// func(primitive) for every primitive whose box overlaps
+	template<typename F>
+	void Query(const Box& box, F&& func) const;
+	// func(primitive) for every primitive whose box is not fully outside one of the planes
+	template<typename F>
+	void Query(const Frustum& frustum, F&& func) const;
+
+	// Primitives in leaf order, leaves index into this
+	std::vector<BvhNode> Nodes;
+	std::vector<uint32_t> Primitives;
+
+private:
+	// Depth is bounded by the build, which falls back to median splits that halve the range
+	static constexpr uint32_t m_StackSize = 256;
+
+	struct RayState
+	{
+		DirectX::XMVECTOR Origin[3];
+		DirectX::XMVECTOR InverseDirection[3];
+	};
+
+	static RayState Prepare(const Ray& ray);
+	// Lane masks, bit i set if child i passes
+	static uint32_t IntersectNode(const BvhNode& node, const RayState& ray, float tMax, float (&tNear)[4]);
+	static uint32_t OverlapNode(const BvhNode& node, const Box& box);
+	static uint32_t CullNode(const BvhNode& node, const Frustum& frustum);
+
+	template<typename Test, typename F>
+	void Traverse(Test&& test, F&& func) const;
+};
+
+template<typename Test, typename F>
+void Bvh::Traverse(Test&& test, F&& func) const
+{
+	if (Nodes.empty()) return;
+
+	uint32_t stack[m_StackSize];
+	uint32_t size = 0;
+	stack[size++] = 0;
+	while (size)
+	{
+		const auto& node = Nodes[stack[--size]];
+		uint32_t mask = test(node);
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (!(mask & (1u << i)) || node.Children[i] == BvhNode::Empty) continue;
+
+			if (node.Counts[i])
+			{
+				for (uint32_t p = node.Children[i]; p < node.Children[i] + node.Counts[i]; p++)
+				{
+					func(Primitives[p]);
+				}
+			}
+			else
+			{
+				stack[size++] = node.Children[i];
+			}
+		}
+	}
+}
+
+template<typename F>
+void Bvh::Intersect(const Ray& ray, F&& func) const
+{
+	if (Nodes.empty()) return;
+
+	auto state = Prepare(ray);
+	float tMax = ray.TMax;
+
+	// Nearest child first, so hits shrink tMax early
+	struct Entry
+	{
+		uint32_t Node;
+		float TNear;
+	};
+	Entry stack[m_StackSize];
+	uint32_t size = 0;
+	stack[size++] = { 0, 0.f };
+	while (size)
+	{
+		auto entry = stack[--size];
+		if (entry.TNear > tMax) continue;
+
+		const auto& node = Nodes[entry.Node];
+		float tNear[4];
+		uint32_t mask = IntersectNode(node, state, tMax, tNear);
+
+		Entry children[4];
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (!(mask & (1u << i)) || node.Children[i] == BvhNode::Empty) continue;
+
+			if (node.Counts[i])
+			{
+				for (uint32_t p = node.Children[i]; p < node.Children[i] + node.Counts[i]; p++)
+				{
+					func(Primitives[p], tMax);
+				}
+			}
+			else
+			{
+				// Insertion sort, farthest ends up first so the nearest is popped next
+				uint32_t j = count++;
+				for (; j > 0 && children[j - 1].TNear < tNear[i]; j--)
+				{
+					children[j] = children[j - 1];
+				}
+				children[j] = { node.Children[i], tNear[i] };
+			}
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			stack[size++] = children[i];
+		}
+	}
+}
+
+template<typename F>
+void Bvh::Query(const Box& box, F&& func) const
+{
+	Traverse([&](const BvhNode& node) { return OverlapNode(node, box); }, func);
+}
+
+template<typename F>
+void Bvh::Query(const Frustum& frustum, F&& func) const
+{
+	Traverse([&](const BvhNode& node) { return CullNode(node, frustum); }, func);
+}
+
+// Scene level trees: clusters for culling, triangles for ray casts.
+// Instanced materials (InstanceCount > 1) are in object space, everything else is in world space.
+namespace SceneBvh
+{
+
+	// Object space bounds of a material's clusters
+	Box GetMaterialBounds(const SceneView& scene, uint32_t material);
+	// Exact world space bounds of every vertex of every instance, from Positions. A point at the origin when empty.
+	Box GetSceneBounds(const SceneView& scene);
+
+	// Primitives below Clusters.size() are clusters of materials drawn once, the rest are
+	// Clusters.size() + instance for the instances of instanced materials.
+	Bvh BuildClusters(const SceneView& scene);
+
+	// Two levels, primitives of the triangle trees are triangle numbers, the triangle's indices start at Indices[primitive * 3]
+	struct TriangleTrees
+	{
+		// Triangles of materials drawn once
+		Bvh World;
+		// Primitives are instances of instanced materials
+		Bvh Instances;
+		// Per material, only built for instanced materials
+		std::vector<Bvh> Materials;
+		// World to object space, per instance
+		std::vector<DirectX::XMFLOAT3X4> Inverses;
+	};
+
+	TriangleTrees BuildTriangles(const SceneView& scene);
+
+	struct RayHit
+	{
+		float Distance;
+		uint32_t Triangle;
+		float U;
+		float V;
+		// The material's only instance for materials drawn once
+		uint32_t Instance = 0;
+	};
+
+	// Both windings, misses past ray.TMax. ray is in the triangle's object space.
+	std::optional<RayHit> IntersectTriangle(const SceneView& scene, uint32_t triangle, const Ray& ray);
+	// Closest hit, trees are from BuildTriangles over the same scene
+	std::optional<RayHit> RayCast(const TriangleTrees& trees, const SceneView& scene, const Ray& ray);
+	// Ray into the object space of instance, distances along it stay the same
+	Ray ToObjectSpace(const TriangleTrees& trees, uint32_t instance, const Ray& ray);
+
+}
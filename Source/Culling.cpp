@@ -0,0 +1,237 @@
+#include "Culling.h"
+
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace Culling
+{
+
+	static void SetBox(BoundsSoA& bounds, uint32_t i, const Box& box)
+	{
+		bounds.CenterX[i] = (box.Min.x + box.Max.x) * 0.5f;
+		bounds.CenterY[i] = (box.Min.y + box.Max.y) * 0.5f;
+		bounds.CenterZ[i] = (box.Min.z + box.Max.z) * 0.5f;
+		bounds.ExtentX[i] = (box.Max.x - box.Min.x) * 0.5f;
+		bounds.ExtentY[i] = (box.Max.y - box.Min.y) * 0.5f;
+		bounds.ExtentZ[i] = (box.Max.z - box.Min.z) * 0.5f;
+	}
+
+	static void Resize(BoundsSoA& bounds, size_t count)
+	{
+		bounds.Count = uint32_t(count);
+		for (auto* lanes : { &bounds.CenterX, &bounds.CenterY, &bounds.CenterZ, &bounds.ExtentX, &bounds.ExtentY, &bounds.ExtentZ })
+		{
+			lanes->resize(count + 3, 0.f);
+		}
+	}
+
+	CullingData Prepare(const SceneView& scene)
+	{
+		CullingData data;
+		data.ClusterRanges.assign(scene.Clusters.begin(), scene.Clusters.end());
+		data.Materials.assign(scene.Materials.begin(), scene.Materials.end());
+
+		Resize(data.Clusters, scene.Clusters.size());
+		for (uint32_t i = 0; i < scene.Clusters.size(); i++)
+		{
+			SetBox(data.Clusters, i, { scene.Clusters[i].Min, scene.Clusters[i].Max });
+		}
+
+		// Only read for instanced materials, the others' single instance is the identity
+		Resize(data.Instances, scene.Instances.size());
+		for (uint32_t m = 0; m < scene.Materials.size(); m++)
+		{
+			const auto& material = scene.Materials[m];
+			if (material.InstanceCount < 2) continue;
+
+			auto bounds = SceneBvh::GetMaterialBounds(scene, m);
+			for (uint32_t i = material.BaseInstance; i < material.BaseInstance + material.InstanceCount; i++)
+			{
+				SetBox(data.Instances, i, bounds.Transform(scene.Instances[i].Transform));
+			}
+		}
+		return data;
+	}
+
+	// A box is outside a plane if its center is further out than the extent projected onto the normal
+	struct Planes
+	{
+		XMVECTOR Lanes[6][7];
+
+		Planes(const Frustum& volume)
+		{
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				const auto& plane = volume.Planes[p];
+				Lanes[p][0] = XMVectorReplicate(plane.x);
+				Lanes[p][1] = XMVectorReplicate(plane.y);
+				Lanes[p][2] = XMVectorReplicate(plane.z);
+				Lanes[p][3] = XMVectorReplicate(plane.w);
+				Lanes[p][4] = XMVectorReplicate(std::abs(plane.x));
+				Lanes[p][5] = XMVectorReplicate(std::abs(plane.y));
+				Lanes[p][6] = XMVectorReplicate(std::abs(plane.z));
+			}
+		}
+	};
+
+	// func(i) in order for every box in [begin, end) inside the planes
+	template<typename F>
+	static void CullRange(const BoundsSoA& bounds, uint32_t begin, uint32_t end, const Planes& planes, F&& func)
+	{
+		auto load = [](const std::vector<float>& lanes, uint32_t i)
+		{
+			return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(lanes.data() + i));
+		};
+
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			XMVECTOR centerX = load(bounds.CenterX, i), centerY = load(bounds.CenterY, i), centerZ = load(bounds.CenterZ, i);
+			XMVECTOR extentX = load(bounds.ExtentX, i), extentY = load(bounds.ExtentY, i), extentZ = load(bounds.ExtentZ, i);
+
+			XMVECTOR inside = XMVectorTrueInt();
+			for (const auto& plane : planes.Lanes)
+			{
+				XMVECTOR distance = XMVectorMultiplyAdd(centerX, plane[0], plane[3]);
+				distance = XMVectorMultiplyAdd(centerY, plane[1], distance);
+				distance = XMVectorMultiplyAdd(centerZ, plane[2], distance);
+				distance = XMVectorMultiplyAdd(extentX, plane[4], distance);
+				distance = XMVectorMultiplyAdd(extentY, plane[5], distance);
+				distance = XMVectorMultiplyAdd(extentZ, plane[6], distance);
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, XMVectorZero()));
+			}
+
+			XMUINT4 lanes;
+			XMStoreUInt4(&lanes, inside);
+			const uint32_t masks[] = { lanes.x, lanes.y, lanes.z, lanes.w };
+			for (uint32_t lane = 0; lane < 4 && i + lane < end; lane++)
+			{
+				if (masks[lane]) func(i + lane);
+			}
+		}
+	}
+
+	void Cull(const CullingData& data, const Frustum& volume, DrawList& list)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		list.Draws.clear();
+		list.MaskedDraws.clear();
+		list.Visible = 0;
+		list.Triangles = 0;
+		list.Simplified = 0;
+
+		Planes planes(volume);
+		uint32_t total = 0;
+		for (uint32_t m = 0; m < data.Materials.size(); m++)
+		{
+			const auto& material = data.Materials[m];
+			auto& draws = material.Masked ? list.MaskedDraws : list.Draws;
+			total += material.ClusterCount * material.InstanceCount;
+
+			// Whole instances, runs of visible ones become one instanced draw
+			if (material.InstanceCount > 1)
+			{
+				CullRange(data.Instances, material.BaseInstance, material.BaseInstance + material.InstanceCount, planes, [&](uint32_t i)
+					{
+						list.Visible += material.ClusterCount;
+						list.Triangles += material.IndexCount / 3;
+						if (draws.size())
+						{
+							auto& last = draws.back();
+							if (last.Material == m && last.BaseInstance + last.InstanceCount == i)
+							{
+								last.InstanceCount++;
+								return;
+							}
+						}
+						draws.push_back({ material.BaseIndex, material.IndexCount, m, i, 1 });
+					});
+				continue;
+			}
+
+			CullRange(data.Clusters, material.BaseCluster, material.BaseCluster + material.ClusterCount, planes, [&](uint32_t i)
+				{
+					const auto& cluster = data.ClusterRanges[i];
+					list.Visible++;
+					list.Triangles += cluster.IndexCount / 3;
+					if (draws.size())
+					{
+						auto& last = draws.back();
+						if (last.Material == m && last.BaseIndex + last.IndexCount == cluster.BaseIndex)
+						{
+							last.IndexCount += cluster.IndexCount;
+							return;
+						}
+					}
+					draws.push_back({ cluster.BaseIndex, cluster.IndexCount, m, material.BaseInstance, 1 });
+				});
+		}
+
+		list.Culled = total - list.Visible;
+		list.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void SelectLods(DrawList& list, std::vector<DrawRange>& draws, std::span<const LodData> lods, float maxError)
+	{
+		// Both are sorted by material, so one walk over each is enough and the list is rewritten in place
+		size_t write = 0;
+		size_t lod = 0;
+		for (size_t read = 0; read < draws.size();)
+		{
+			uint32_t material = draws[read].Material;
+			size_t end = read;
+			while (end < draws.size() && draws[end].Material == material) end++;
+
+			// Draws sharing their instances collapse into one LOD draw, so a material drawn once becomes a single
+			// draw and an instanced one keeps one draw per run of instances
+			uint64_t visible = 0;
+			uint64_t instances = 0;
+			for (size_t i = read; i < end; i++)
+			{
+				visible += uint64_t(draws[i].IndexCount) * draws[i].InstanceCount;
+				if (i == read || draws[i].BaseInstance != draws[i - 1].BaseInstance) instances += draws[i].InstanceCount;
+			}
+
+			// A mostly culled material can be cheaper at full detail than whole at a LOD
+			while (lod < lods.size() && lods[lod].Material < material) lod++;
+			const LodData* selected = nullptr;
+			for (; lod < lods.size() && lods[lod].Material == material; lod++)
+			{
+				if (lods[lod].Error <= maxError && lods[lod].IndexCount * instances < visible) selected = &lods[lod];
+			}
+
+			if (selected)
+			{
+				list.Triangles -= uint32_t(visible / 3);
+				list.Triangles += uint32_t(selected->IndexCount * instances / 3);
+				list.Simplified++;
+				// Written in place, so the run start is kept from before the write
+				uint32_t previous = ~0u;
+				for (size_t i = read; i < end; i++)
+				{
+					auto draw = draws[i];
+					if (draw.BaseInstance == previous) continue;
+					previous = draw.BaseInstance;
+					draws[write++] = { selected->BaseIndex, selected->IndexCount, material, draw.BaseInstance, draw.InstanceCount };
+				}
+			}
+			else
+			{
+				for (size_t i = read; i < end; i++)
+				{
+					draws[write++] = draws[i];
+				}
+			}
+			read = end;
+		}
+		draws.resize(write);
+	}
+
+	void SelectLods(DrawList& list, std::span<const LodData> lods, float maxError)
+	{
+		SelectLods(list, list.Draws, lods, maxError);
+		SelectLods(list, list.MaskedDraws, lods, maxError);
+	}
+
+}
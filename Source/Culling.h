@@ -0,0 +1,70 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "Bvh.h"
+#include "SceneData.h"
+
+// Boxes as structure of arrays, padded so four lanes can be loaded starting at any box.
+struct BoundsSoA
+{
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> ExtentX;
+	std::vector<float> ExtentY;
+	std::vector<float> ExtentZ;
+	uint32_t Count = 0;
+};
+
+// Everything culling needs from a scene. Materials drawn once are culled per cluster, instanced ones
+// (InstanceCount > 1) per instance, with the instance's world bounds.
+struct CullingData
+{
+	BoundsSoA Clusters;
+	BoundsSoA Instances;
+	std::vector<ClusterData> ClusterRanges;
+	std::vector<MaterialData> Materials;
+};
+
+// Consecutive visible clusters of one material merged into a single index range,
+// drawn for consecutive visible instances.
+struct DrawRange
+{
+	uint32_t BaseIndex;
+	uint32_t IndexCount;
+	uint32_t Material;
+	uint32_t BaseInstance;
+	uint32_t InstanceCount;
+};
+
+// One pass' draws, in material order. Cluster counts include every instance.
+struct DrawList
+{
+	std::vector<DrawRange> Draws;
+	// Materials with MaterialData::Masked, drawn after the others with the alpha test
+	std::vector<DrawRange> MaskedDraws;
+	uint32_t Visible = 0;
+	uint32_t Culled = 0;
+	uint32_t Triangles = 0;
+	// Materials drawn with one of their LODs
+	uint32_t Simplified = 0;
+	double Milliseconds = 0.0;
+};
+
+// Per pass CPU culling of clusters and instances against a convex volume, 4 boxes per test.
+namespace Culling
+{
+
+	CullingData Prepare(const SceneView& scene);
+
+	// Clears and refills list with the clusters and instances that are not fully outside one of the volume's planes
+	void Cull(const CullingData& data, const Frustum& volume, DrawList& list);
+
+	// Every material with a visible cluster and a LOD within maxError is drawn whole at its coarsest such LOD instead,
+	// as long as that is fewer triangles than its visible clusters. LODs are not clustered, so they can't be culled.
+	// Instanced materials keep their visible instances and swap the index range.
+	void SelectLods(DrawList& list, std::span<const LodData> lods, float maxError);
+
+}
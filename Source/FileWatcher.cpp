@@ -0,0 +1,170 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+std::string GetCanonicalPath(const std::filesystem::path& path)
+{
+	std::error_code error;
+	auto canonical = std::filesystem::weakly_canonical(path, error);
+	auto string = (error ? path : canonical).u8string();
+	return std::string(string.begin(), string.end());
+}
+
+#ifdef _WIN32
+
+struct FileWatcher::State
+{
+	std::filesystem::path Root;
+	HANDLE Directory = INVALID_HANDLE_VALUE;
+	OVERLAPPED Overlapped = {};
+	alignas(DWORD) uint8_t Buffer[64 * 1024];
+
+	// Overlapped, the result is picked up by Poll
+	void Read()
+	{
+		ReadDirectoryChangesW(Directory, Buffer, sizeof(Buffer), TRUE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE, nullptr, &Overlapped, nullptr);
+	}
+
+	~State()
+	{
+		if (Directory != INVALID_HANDLE_VALUE)
+		{
+			CancelIo(Directory);
+			CloseHandle(Directory);
+		}
+		if (Overlapped.hEvent) CloseHandle(Overlapped.hEvent);
+	}
+};
+
+FileWatcher::FileWatcher(const std::string& directory)
+	: m_State(std::make_unique<State>())
+{
+	m_State->Root = std::filesystem::u8path(directory);
+	m_State->Directory = CreateFileW(m_State->Root.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (m_State->Directory == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to watch " + directory);
+	}
+	m_State->Overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	m_State->Read();
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+	std::vector<std::string> paths;
+	if (!m_State) return paths;
+
+	DWORD size;
+	if (!GetOverlappedResult(m_State->Directory, &m_State->Overlapped, &size, FALSE)) return paths;
+
+	// An empty result means the buffer overflowed and the changes are lost
+	for (DWORD offset = 0; size;)
+	{
+		auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(m_State->Buffer + offset);
+		if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+		{
+			paths.push_back(GetCanonicalPath(m_State->Root / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))));
+		}
+		if (!info->NextEntryOffset) break;
+		offset += info->NextEntryOffset;
+	}
+
+	ResetEvent(m_State->Overlapped.hEvent);
+	m_State->Read();
+
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+	return paths;
+}
+
+#else
+
+struct FileWatcher::State
+{
+	int Descriptor = -1;
+	// inotify watches directories one by one, new subdirectories are added as they show up
+	std::unordered_map<int, std::filesystem::path> Directories;
+
+	void Add(const std::filesystem::path& directory)
+	{
+		int watch = inotify_add_watch(Descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (watch >= 0) Directories[watch] = directory;
+	}
+
+	~State()
+	{
+		if (Descriptor >= 0) close(Descriptor);
+	}
+};
+
+FileWatcher::FileWatcher(const std::string& directory)
+	: m_State(std::make_unique<State>())
+{
+	m_State->Descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_State->Descriptor < 0)
+	{
+		throw std::runtime_error("Failed to watch " + directory);
+	}
+
+	auto root = std::filesystem::u8path(directory);
+	m_State->Add(root);
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+	{
+		if (it->is_directory(error)) m_State->Add(it->path());
+	}
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+	std::vector<std::string> paths;
+	if (!m_State) return paths;
+
+	alignas(inotify_event) char buffer[16 * 1024];
+	ssize_t size;
+	while ((size = read(m_State->Descriptor, buffer, sizeof(buffer))) > 0)
+	{
+		for (ssize_t offset = 0; offset < size;)
+		{
+			auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			auto directory = m_State->Directories.find(event->wd);
+			if (!event->len || directory == m_State->Directories.end()) continue;
+
+			auto path = directory->second / event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				m_State->Add(path);
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				// Plain creation is followed by a close once the file is written
+				paths.push_back(GetCanonicalPath(path));
+			}
+		}
+	}
+
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+	return paths;
+}
+
+#endif
+
+FileWatcher::FileWatcher() = default;
+FileWatcher::FileWatcher(FileWatcher&& other) = default;
+FileWatcher& FileWatcher::operator=(FileWatcher&& other) = default;
+FileWatcher::~FileWatcher() = default;
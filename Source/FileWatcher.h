@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reports files written under a directory, subdirectories included.
+// ReadDirectoryChangesW on Windows, inotify elsewhere.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	FileWatcher(const std::string& directory);
+	FileWatcher(FileWatcher&& other);
+	FileWatcher& operator=(FileWatcher&& other);
+
+	~FileWatcher();
+
+	// Canonical paths of the files changed since the last call, each once. Never blocks.
+	std::vector<std::string> Poll();
+
+private:
+	struct State;
+	std::unique_ptr<State> m_State;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace Hash
+{
+
+	// 64-bit content hash, word at a time. Not cryptographic, only used to detect changed files.
+	inline uint64_t Bytes(const void* data, size_t size, uint64_t seed = 0x9e3779b97f4a7c15ull)
+	{
+		constexpr uint64_t prime = 0x100000001b3ull;
+		auto bytes = static_cast<const uint8_t*>(data);
+
+		uint64_t hash = seed ^ (size * prime);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(word));
+			word *= 0xff51afd7ed558ccdull;
+			word ^= word >> 32;
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * prime;
+		}
+
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+}
@@ -0,0 +1,267 @@
+#include "HotReload.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#include "FileWatcher.h"
+#include "Hash.h"
+#include "Import/Importer.h"
+#include "Import/SceneCache.h"
+#include "Import/Textures.h"
+#include "MappedFile.h"
+
+namespace HotReload
+{
+
+	using Clock = std::chrono::steady_clock;
+
+	ImportStats Stats;
+	std::string Error;
+
+	// Editors often save in several writes, a file is reloaded once it has been quiet this long
+	constexpr auto m_Debounce = std::chrono::milliseconds(250);
+
+	struct ReloadedTexture
+	{
+		uint32_t Source;
+		TextureData Texture;
+		uint64_t Hash;
+		bool Masked;
+	};
+
+	struct Result
+	{
+		std::vector<ReloadedTexture> Textures;
+		std::optional<SceneData> Geometry;
+		ImportStats Stats;
+		std::string Error;
+	};
+
+	std::string m_Path;
+	ImportOptions m_Options;
+	FileWatcher m_Watcher;
+	std::unordered_map<std::string, Clock::time_point> m_Pending;
+	std::thread m_Thread;
+	std::unique_ptr<LoadProgress> m_Progress;
+	std::atomic<bool> m_Finished = false;
+	Result m_Result;
+
+	void AddStages(ImportStats& stats, const ImportStats& from)
+	{
+		stats.Stages.insert(stats.Stages.end(), from.Stages.begin(), from.Stages.end());
+	}
+
+	// Runs on the reload thread, the scene is only read again by Apply
+	void Reload(Result& result, const std::vector<std::string>& paths, const std::vector<TextureSource>& sources,
+		const std::vector<SourceDependency>& dependencies, const std::string& path, const ImportOptions& options, LoadProgress* progress)
+	{
+		auto changed = [&](const std::string& file) { return std::find(paths.begin(), paths.end(), file) != paths.end(); };
+
+		// Albedo textures are decoded on their own. Specular and bump maps are packed together, so a new one
+		// takes an import like the scene itself, as does any file the loader reads.
+		bool reimport = changed(path);
+		for (const auto& dependency : dependencies)
+		{
+			if (!changed(dependency.Path)) continue;
+
+			MappedFile file(dependency.Path);
+			if (Hash::Bytes(file.Data, file.Size) != dependency.Hash) reimport = true;
+		}
+		std::vector<uint32_t> reloads;
+		for (uint32_t s = 0; s < sources.size(); s++)
+		{
+			const auto& source = sources[s];
+			if (!changed(source.Path)) continue;
+
+			// Saved without changes, or touched by a tool
+			{
+				MappedFile file(source.Path);
+				if ((Hash::Bytes(file.Data, file.Size) ^ uint64_t(source.Usage) << 56) == source.Hash) continue;
+			}
+
+			// Atlases are packed at import as well
+			if (source.Usage == TextureUsage::Albedo && !options.AtlasTextures) reloads.push_back(s);
+			else reimport = true;
+		}
+
+		// The outdated cache provides every texture that didn't change and is closed before the new one replaces it.
+		// Apply picks the changed textures out of the import.
+		if (reimport)
+		{
+			{
+				auto previous = SceneCache::Open(path, options, false);
+				result.Geometry = Importer::Import(path, options, progress, previous ? &previous->View : nullptr);
+			}
+			{
+				ScopedStage stage(result.Geometry->Stats, "Cache write");
+				SceneCache::Write(path, result.Geometry->View(), options);
+			}
+			AddStages(result.Stats, result.Geometry->Stats);
+			return;
+		}
+
+		for (uint32_t s : reloads)
+		{
+			const auto& source = sources[s];
+			ImportStats stats;
+			stats.Progress = progress;
+			auto loaded = Textures::Load({ { source.Path, {}, source.Usage } }, {}, stats);
+			result.Textures.push_back({ s, std::move(loaded.Textures[0]), loaded.Sources[0].Hash, loaded.Masked[0] });
+			AddStages(result.Stats, stats);
+		}
+	}
+
+	bool Apply(Scene& scene, Result& result)
+	{
+		Stats = std::move(result.Stats);
+		Error = std::move(result.Error);
+		ScopedStage stage(Stats, "Patch");
+
+		uint32_t patched = 0;
+		uint32_t replacements = uint32_t(result.Textures.size());
+		if (result.Geometry)
+		{
+			auto view = result.Geometry->View();
+			if (!scene.Patch(view, patched)) return true;
+			scene.Dependencies = view.Dependencies;
+
+			// Patch checked that the sources line up, a changed hash is a changed file or color
+			std::vector<bool> replaced(view.Textures.size(), false);
+			for (uint32_t s = 0; s < view.TextureSources.size(); s++)
+			{
+				auto& source = scene.TextureSources[s];
+				if (source.Hash == view.TextureSources[s].Hash) continue;
+				if (!replaced[source.Texture])
+				{
+					scene.ReplaceTexture(source.Texture, view.Textures[source.Texture]);
+					replaced[source.Texture] = true;
+					replacements++;
+				}
+				source.Hash = view.TextureSources[s].Hash;
+			}
+		}
+
+		for (const auto& reloaded : result.Textures)
+		{
+			// Files with identical contents share one texture, only a full load can split them again
+			auto& source = scene.TextureSources[reloaded.Source];
+			for (uint32_t s = 0; s < scene.TextureSources.size(); s++)
+			{
+				if (s != reloaded.Source && scene.TextureSources[s].Texture == source.Texture) return true;
+			}
+			// Gaining or losing the alpha test moves batches between draw lists, culling data is rebuilt by a full load
+			for (const auto& material : scene.CullingBounds.Materials)
+			{
+				if (material.Albedo == source.Texture && bool(material.Masked) != reloaded.Masked) return true;
+			}
+
+			const auto& texture = reloaded.Texture;
+			scene.ReplaceTexture(source.Texture, { texture.Width, texture.Height, texture.MipLevels, texture.Format, texture.Pixels });
+			source.Hash = reloaded.Hash;
+		}
+
+		Stats.Add("Textures reloaded", double(replacements));
+		Stats.Add("Batches patched", double(patched));
+		Stats.Add("Batches", double(scene.Materials.size()));
+		return false;
+	}
+
+	void Watch(const std::string& path, const ImportOptions& options)
+	{
+		Shutdown();
+		Stats = {};
+		Error.clear();
+
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(std::filesystem::u8path(path), error).u8string();
+		m_Path = error ? path : std::string(canonical.begin(), canonical.end());
+		m_Options = options;
+		try
+		{
+			auto directory = std::filesystem::u8path(m_Path).parent_path().u8string();
+			m_Watcher = FileWatcher(std::string(directory.begin(), directory.end()));
+		}
+		catch (const std::exception& e)
+		{
+			Error = e.what();
+		}
+	}
+
+	bool Update(Scene& scene)
+	{
+		auto now = Clock::now();
+		for (auto& path : m_Watcher.Poll())
+		{
+			m_Pending[std::move(path)] = now;
+		}
+
+		// m_Result is only touched by the main thread again after m_Finished is seen
+		if (m_Thread.joinable())
+		{
+			if (!m_Finished) return false;
+
+			m_Thread.join();
+			m_Progress.reset();
+			bool reload = Apply(scene, m_Result);
+			m_Result = {};
+			return reload;
+		}
+
+		// Everything else in the directory, the cache included, is dropped
+		std::vector<std::string> paths;
+		for (auto it = m_Pending.begin(); it != m_Pending.end();)
+		{
+			if (now - it->second < m_Debounce)
+			{
+				it++;
+				continue;
+			}
+
+			const auto& path = it->first;
+			if (path == m_Path || std::any_of(scene.TextureSources.begin(), scene.TextureSources.end(),
+				[&](const TextureSource& source) { return source.Path == path; }) ||
+				std::any_of(scene.Dependencies.begin(), scene.Dependencies.end(),
+				[&](const SourceDependency& dependency) { return dependency.Path == path; }))
+			{
+				paths.push_back(path);
+			}
+			it = m_Pending.erase(it);
+		}
+		if (paths.empty()) return false;
+
+		m_Progress = std::make_unique<LoadProgress>();
+		m_Finished = false;
+		m_Thread = std::thread([paths = std::move(paths), sources = scene.TextureSources, dependencies = scene.Dependencies, path = m_Path,
+			options = m_Options, progress = m_Progress.get()]
+			{
+				try { Reload(m_Result, paths, sources, dependencies, path, options, progress); }
+				catch (const LoadCancelled&) { m_Result = {}; }
+				catch (const std::exception& e)
+				{
+					m_Result = {};
+					m_Result.Error = e.what();
+				}
+				m_Finished = true;
+			});
+		return false;
+	}
+
+	void Shutdown()
+	{
+		m_Watcher = {};
+		m_Pending.clear();
+		if (!m_Thread.joinable()) return;
+
+		m_Progress->Cancel();
+		m_Thread.join();
+		m_Progress.reset();
+		m_Result = {};
+	}
+
+}
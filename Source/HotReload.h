@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "Scene.h"
+
+// Watches the current scene's directory and patches the scene in place when its files change. Changed textures
+// are decoded again on their own. A changed scene file, or a buffer or material library it reads, is imported again
+// in the background and only the batches whose hash changed are uploaded. Unchanged files are never read past their hash.
+namespace HotReload
+{
+
+	// Watches the scene loaded from path, replacing the previous watch.
+	void Watch(const std::string& path, const ImportOptions& options);
+
+	// Once per frame, before anything is recorded. Applies a finished reload to scene and returns true when it
+	// can't be patched, the scene has to be loaded again as a whole then.
+	bool Update(Scene& scene);
+
+	// Cancels and waits for a running reload.
+	void Shutdown();
+
+	// Of the last reload
+	extern ImportStats Stats;
+	extern std::string Error;
+
+}
@@ -0,0 +1,350 @@
+#include "Atlas.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <unordered_map>
+
+#include "BlockCompression.h"
+#include "Jobs.h"
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+#include "ImGui/imstb_rectpack.h"
+
+using namespace DirectX;
+
+namespace Atlas
+{
+
+	// Mips kept in atlases. Rectangles are placed and sized in units of one block of the smallest of them,
+	// so every kept level starts and ends on block boundaries.
+	constexpr uint32_t m_MipLevels = 4;
+	constexpr uint32_t m_Unit = 4 << (m_MipLevels - 1);
+	// Wrapped texels on every side of a rectangle, one block at the smallest mip
+	constexpr uint32_t m_Gutter = m_Unit;
+	// Larger textures keep their full mip chain, and are paged when virtual textures are on
+	constexpr uint32_t m_MaxTextureSize = 512;
+	constexpr uint32_t m_MaxSize = 4096;
+
+	struct Cell
+	{
+		uint32_t Albedo;
+		uint32_t Surface;
+		// Of the textures, one unit for two solid colors
+		uint32_t Width;
+		uint32_t Height;
+		bool Masked;
+		uint32_t Page;
+		// Texels, inside the gutter
+		uint32_t X;
+		uint32_t Y;
+	};
+
+	struct Page
+	{
+		uint32_t Size;
+		bool Masked;
+	};
+
+	bool IsSolid(const TextureData& texture)
+	{
+		return texture.Width == 1 && texture.Height == 1 && !IsBlockCompressed(texture.Format);
+	}
+
+	bool IsPackable(const TextureData& texture, TextureFormat format)
+	{
+		return texture.Format == format && texture.Width % m_Unit == 0 && texture.Height % m_Unit == 0 &&
+			(std::max)(texture.Width, texture.Height) <= m_MaxTextureSize && texture.MipLevels >= m_MipLevels;
+	}
+
+	// The kept levels of from, or one block of its solid color, into the rectangle at x, y with its gutter around it
+	void Copy(const TextureData& from, TextureData& atlas, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	{
+		uint32_t blockSize = GetElementSize(atlas.Format);
+		TextureData solid;
+		if (IsSolid(from))
+		{
+			TextureData block{ 4, 4, 1, from.Format };
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				block.Pixels.insert(block.Pixels.end(), from.Pixels.begin(), from.Pixels.begin() + 4);
+			}
+			solid = BlockCompression::Compress(block, atlas.Format);
+		}
+
+		size_t fromOffset = 0;
+		size_t atlasOffset = 0;
+		for (uint32_t level = 0; level < m_MipLevels; level++)
+		{
+			int32_t blocksX = int32_t(width >> level) / 4;
+			int32_t blocksY = int32_t(height >> level) / 4;
+			int32_t gutter = int32_t(m_Gutter >> level) / 4;
+			uint32_t originX = (x >> level) / 4;
+			uint32_t originY = (y >> level) / 4;
+			uint32_t fromPitch = GetRowPitch(from.Format, from.Width >> level);
+			uint32_t atlasPitch = GetRowPitch(atlas.Format, atlas.Width >> level);
+			for (int32_t by = -gutter; by < blocksY + gutter; by++)
+			{
+				uint8_t* row = atlas.Pixels.data() + atlasOffset + size_t(originY + by) * atlasPitch;
+				for (int32_t bx = -gutter; bx < blocksX + gutter; bx++)
+				{
+					const uint8_t* block = solid.Pixels.size() ? solid.Pixels.data() : from.Pixels.data() + fromOffset +
+						size_t((by + blocksY) % blocksY) * fromPitch + size_t((bx + blocksX) % blocksX) * blockSize;
+					memcpy(row + size_t(originX + bx) * blockSize, block, blockSize);
+				}
+			}
+			if (solid.Pixels.empty()) fromOffset += GetMipSize(from.Format, from.Width >> level, from.Height >> level);
+			atlasOffset += GetMipSize(atlas.Format, atlas.Width >> level, atlas.Height >> level);
+		}
+	}
+
+	void Pack(SourceScene& scene, std::vector<uint32_t>& albedos, std::vector<uint32_t>& surfaces, Textures::LoadResult& textures,
+		ImportStats& stats)
+	{
+		ScopedStage stage(stats, "Texture atlas");
+		auto& meshes = scene.Meshes;
+		uint32_t meshCount = uint32_t(meshes.size());
+		uint32_t materialCount = uint32_t(albedos.size());
+
+		// UV bounds of every material, as min xy and max zw
+		std::vector<XMFLOAT4> meshBounds(meshCount);
+		Jobs::ParallelFor(meshCount, [&](uint32_t i)
+			{
+				XMVECTOR low = XMVectorReplicate(FLT_MAX);
+				XMVECTOR high = XMVectorReplicate(-FLT_MAX);
+				for (const auto& vertex : meshes[i].Vertices)
+				{
+					XMVECTOR uv = XMLoadFloat2(&vertex.UV);
+					low = XMVectorMin(low, uv);
+					high = XMVectorMax(high, uv);
+				}
+				meshBounds[i] = { XMVectorGetX(low), XMVectorGetY(low), XMVectorGetX(high), XMVectorGetY(high) };
+			});
+		std::vector<XMFLOAT4> bounds(materialCount, { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX });
+		for (uint32_t i = 0; i < meshCount; i++)
+		{
+			auto& to = bounds[meshes[i].Material];
+			to = { (std::min)(to.x, meshBounds[i].x), (std::min)(to.y, meshBounds[i].y),
+				(std::max)(to.z, meshBounds[i].z), (std::max)(to.w, meshBounds[i].w) };
+		}
+
+		// One cell per distinct pair of textures. Albedo and surface share UVs, so their sizes have to match
+		// unless one is a solid color, which fills any rectangle.
+		std::vector<Cell> cells;
+		std::vector<uint32_t> materialCells(materialCount, ~0u);
+		uint32_t tiling = 0;
+		{
+			std::unordered_map<uint64_t, uint32_t> registry;
+			for (uint32_t m = 0; m < materialCount; m++)
+			{
+				if (albedos[m] == ~0u) continue;
+				const auto& albedo = textures.Textures[albedos[m]];
+				const auto& surface = textures.Textures[surfaces[m]];
+				bool masked = textures.Masked[albedos[m]];
+				bool albedoSolid = IsSolid(albedo);
+				bool surfaceSolid = IsSolid(surface);
+				if (!albedoSolid && !IsPackable(albedo, masked ? TextureFormat::BC3_SRGB : TextureFormat::BC1_SRGB)) continue;
+				if (!surfaceSolid && !IsPackable(surface, TextureFormat::BC3)) continue;
+				if (!albedoSolid && !surfaceSolid && (albedo.Width != surface.Width || albedo.Height != surface.Height)) continue;
+
+				const auto& sized = albedoSolid ? surface : albedo;
+				uint32_t width = albedoSolid && surfaceSolid ? m_Unit : sized.Width;
+				uint32_t height = albedoSolid && surfaceSolid ? m_Unit : sized.Height;
+				// Half the gutter, the rest is what bilinear filtering of the smallest mip reaches past the edge
+				float marginX = m_Gutter * 0.5f / width;
+				float marginY = m_Gutter * 0.5f / height;
+				const auto& uv = bounds[m];
+				if (!(albedoSolid && surfaceSolid) && (uv.x < -marginX || uv.y < -marginY || uv.z > 1.f + marginX || uv.w > 1.f + marginY))
+				{
+					tiling++;
+					continue;
+				}
+
+				auto [it, inserted] = registry.try_emplace(uint64_t(albedos[m]) << 32 | surfaces[m], uint32_t(cells.size()));
+				if (inserted) cells.push_back({ albedos[m], surfaces[m], width, height, masked });
+				materialCells[m] = it->second;
+			}
+		}
+		stats.Add("Materials with tiling UVs", tiling);
+		if (cells.empty()) return;
+
+		// Opaque and masked albedo are compressed differently, so they fill separate atlases.
+		// Each atlas is the smallest power of two its cells fit into, or the largest size with the rest moving on.
+		std::vector<Page> pages;
+		uint64_t usedArea = 0;
+		uint64_t atlasArea = 0;
+		for (bool masked : { false, true })
+		{
+			std::vector<uint32_t> pending;
+			for (uint32_t c = 0; c < cells.size(); c++)
+			{
+				if (cells[c].Masked == masked) pending.push_back(c);
+			}
+
+			while (pending.size())
+			{
+				uint64_t area = 0;
+				uint32_t largest = 0;
+				for (uint32_t c : pending)
+				{
+					uint32_t width = (cells[c].Width + 2 * m_Gutter) / m_Unit;
+					uint32_t height = (cells[c].Height + 2 * m_Gutter) / m_Unit;
+					area += uint64_t(width) * height;
+					largest = (std::max)(largest, (std::max)(width, height));
+				}
+				uint32_t size = 1;
+				while (uint64_t(size) * size < area || size < largest) size *= 2;
+				size = (std::min)(size, m_MaxSize / m_Unit);
+
+				std::vector<stbrp_rect> rects;
+				while (true)
+				{
+					rects.clear();
+					for (uint32_t c : pending)
+					{
+						stbrp_rect rect{};
+						rect.id = int(c);
+						rect.w = stbrp_coord((cells[c].Width + 2 * m_Gutter) / m_Unit);
+						rect.h = stbrp_coord((cells[c].Height + 2 * m_Gutter) / m_Unit);
+						rects.push_back(rect);
+					}
+					stbrp_context context;
+					std::vector<stbrp_node> nodes(size);
+					stbrp_init_target(&context, int(size), int(size), nodes.data(), int(size));
+					if (stbrp_pack_rects(&context, rects.data(), int(rects.size())) || size == m_MaxSize / m_Unit) break;
+					size *= 2;
+				}
+
+				pending.clear();
+				for (const auto& rect : rects)
+				{
+					auto& cell = cells[rect.id];
+					if (!rect.was_packed)
+					{
+						pending.push_back(uint32_t(rect.id));
+						continue;
+					}
+					cell.Page = uint32_t(pages.size());
+					cell.X = rect.x * m_Unit + m_Gutter;
+					cell.Y = rect.y * m_Unit + m_Gutter;
+					usedArea += uint64_t(cell.Width) * cell.Height;
+				}
+				pages.push_back({ size * m_Unit, masked });
+				atlasArea += uint64_t(size * m_Unit) * (size * m_Unit);
+			}
+		}
+
+		// Every page is an albedo atlas followed by its surface atlas
+		uint32_t basePage = uint32_t(textures.Textures.size());
+		for (const auto& page : pages)
+		{
+			for (auto format : { page.Masked ? TextureFormat::BC3_SRGB : TextureFormat::BC1_SRGB, TextureFormat::BC3 })
+			{
+				size_t bytes = 0;
+				for (uint32_t level = 0; level < m_MipLevels; level++)
+				{
+					bytes += GetMipSize(format, page.Size >> level, page.Size >> level);
+				}
+				textures.Textures.push_back({ page.Size, page.Size, m_MipLevels, format, std::vector<uint8_t>(bytes, 0) });
+				textures.Masked.push_back(page.Masked && format == TextureFormat::BC3_SRGB);
+			}
+		}
+		Jobs::ParallelFor(uint32_t(cells.size()), [&](uint32_t c)
+			{
+				const auto& cell = cells[c];
+				Copy(textures.Textures[cell.Albedo], textures.Textures[basePage + cell.Page * 2], cell.X, cell.Y, cell.Width, cell.Height);
+				Copy(textures.Textures[cell.Surface], textures.Textures[basePage + cell.Page * 2 + 1], cell.X, cell.Y, cell.Width, cell.Height);
+			});
+
+		// Two solid colors look the same from anywhere in their cell, its center is the farthest from the neighbours
+		Jobs::ParallelFor(meshCount, [&](uint32_t i)
+			{
+				uint32_t c = materialCells[meshes[i].Material];
+				if (c == ~0u) return;
+				const auto& cell = cells[c];
+				float size = float(pages[cell.Page].Size);
+				bool solid = IsSolid(textures.Textures[cell.Albedo]) && IsSolid(textures.Textures[cell.Surface]);
+				XMVECTOR scale = solid ? XMVectorZero() : XMVectorSet(cell.Width / size, cell.Height / size, 0.f, 0.f);
+				XMVECTOR offset = XMVectorSet((cell.X + (solid ? cell.Width * 0.5f : 0.f)) / size, (cell.Y + (solid ? cell.Height * 0.5f : 0.f)) / size, 0.f, 0.f);
+				for (auto& vertex : meshes[i].Vertices)
+				{
+					XMStoreFloat2(&vertex.UV, XMVectorMultiplyAdd(XMLoadFloat2(&vertex.UV), scale, offset));
+				}
+			});
+
+		// Where each packed texture went, for its sources
+		std::vector<uint32_t> moved(basePage, ~0u);
+		uint64_t droppedMips = 0;
+		for (const auto& cell : cells)
+		{
+			for (uint32_t t : { cell.Albedo, cell.Surface })
+			{
+				if (moved[t] != ~0u) continue;
+				moved[t] = basePage + cell.Page * 2 + (t == cell.Surface);
+				if (!IsSolid(textures.Textures[t])) droppedMips += textures.Textures[t].MipLevels - m_MipLevels;
+			}
+		}
+
+		// Materials sampling the same textures are one batch now
+		std::vector<uint32_t> merged(materialCount, ~0u);
+		uint32_t batches = 0;
+		uint32_t materials = 0;
+		{
+			std::unordered_map<uint64_t, uint32_t> registry;
+			for (uint32_t m = 0; m < materialCount; m++)
+			{
+				if (albedos[m] == ~0u) continue;
+				if (materialCells[m] != ~0u)
+				{
+					albedos[m] = basePage + cells[materialCells[m]].Page * 2;
+					surfaces[m] = albedos[m] + 1;
+				}
+				auto [it, inserted] = registry.try_emplace(uint64_t(albedos[m]) << 32 | surfaces[m], m);
+				merged[m] = it->second;
+				batches += inserted;
+				materials++;
+			}
+		}
+		for (auto& mesh : meshes)
+		{
+			mesh.Material = merged[mesh.Material];
+		}
+
+		// Drop the textures only atlases hold now
+		std::vector<bool> referenced(textures.Textures.size(), false);
+		for (uint32_t m = 0; m < materialCount; m++)
+		{
+			if (albedos[m] != ~0u) referenced[albedos[m]] = referenced[surfaces[m]] = true;
+		}
+		std::vector<uint32_t> remap(textures.Textures.size(), ~0u);
+		std::vector<TextureData> kept;
+		std::vector<bool> masked;
+		for (uint32_t t = 0; t < textures.Textures.size(); t++)
+		{
+			if (!referenced[t]) continue;
+			remap[t] = uint32_t(kept.size());
+			kept.push_back(std::move(textures.Textures[t]));
+			masked.push_back(textures.Masked[t]);
+		}
+		textures.Textures = std::move(kept);
+		textures.Masked = std::move(masked);
+		for (auto& source : textures.Sources)
+		{
+			source.Texture = remap[referenced[source.Texture] ? source.Texture : moved[source.Texture]];
+		}
+		for (uint32_t m = 0; m < materialCount; m++)
+		{
+			if (albedos[m] == ~0u) continue;
+			albedos[m] = remap[albedos[m]];
+			surfaces[m] = remap[surfaces[m]];
+		}
+
+		stats.Add("Atlases", double(pages.size() * 2));
+		stats.Add("Atlased textures", double(std::count_if(moved.begin(), moved.end(), [](uint32_t t) { return t != ~0u; })));
+		stats.Add("Atlas padding (%)", 100.0 * double(atlasArea - usedArea) / double(atlasArea));
+		stats.Add("Atlas mip levels dropped", double(droppedMips));
+		stats.Add("Materials merged", double(materials - batches));
+	}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "SourceScene.h"
+#include "Textures.h"
+
+// Small material textures packed into a few large ones, so materials that only differed by their textures become one
+// batch and draw. Each material's albedo and surface texture take the same rectangle of an albedo and a surface atlas
+// and its UVs are moved into that rectangle, the shaders don't know about atlases.
+// Rectangles are surrounded by a gutter of wrapped texels so filtering at their edges samples what it did before,
+// atlases keep only the mips the gutter covers. Materials whose UVs leave 0..1 tile their textures and stay as they are.
+namespace Atlas
+{
+
+	// albedos and surfaces index textures.Textures per material, ~0u for materials without meshes. Both are updated
+	// for atlased materials, and meshes of materials that end up with the same textures move to the first of them.
+	// Textures no material samples anymore are removed, their sources point at the atlases that took them.
+	void Pack(SourceScene& scene, std::vector<uint32_t>& albedos, std::vector<uint32_t>& surfaces, Textures::LoadResult& textures,
+		ImportStats& stats);
+
+}
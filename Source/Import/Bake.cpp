@@ -0,0 +1,160 @@
+#include "Bake.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+#include "Importer.h"
+#include "Jobs.h"
+#include "Memory.h"
+#include "SceneCache.h"
+
+namespace Bake
+{
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Result
+	{
+		enum class Status
+		{
+			Baked,
+			UpToDate,
+			Failed
+		} Status = Status::Failed;
+		std::string Error;
+		ImportStats Stats;
+		double Milliseconds = 0.0;
+		uint64_t SourceBytes = 0;
+		uint64_t CacheBytes = 0;
+	};
+
+	double GetMilliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	uint64_t GetFileSize(const std::string& path)
+	{
+		std::error_code error;
+		auto size = std::filesystem::file_size(std::filesystem::u8path(path), error);
+		return error ? 0 : uint64_t(size);
+	}
+
+	Result BakeOne(const std::string& sourcePath, const Options& options)
+	{
+		Result result;
+		auto start = Clock::now();
+		try
+		{
+			result.SourceBytes = GetFileSize(sourcePath);
+			if (!options.Force && SceneCache::Open(sourcePath, options.Import))
+			{
+				result.Status = Result::Status::UpToDate;
+			}
+			else
+			{
+				// -force decodes every texture again, otherwise the outdated cache's unchanged ones are kept
+				SceneData data;
+				{
+					auto previous = options.Force ? std::nullopt : SceneCache::Open(sourcePath, options.Import, false);
+					data = Importer::Import(sourcePath, options.Import, nullptr, previous ? &previous->View : nullptr);
+				}
+				{
+					ScopedStage stage(data.Stats, "Cache write");
+					SceneCache::Write(sourcePath, data.View(), options.Import);
+				}
+				result.Stats = std::move(data.Stats);
+				result.Status = Result::Status::Baked;
+			}
+			result.CacheBytes = GetFileSize(SceneCache::GetPath(sourcePath));
+		}
+		catch (const std::exception& e)
+		{
+			result.Status = Result::Status::Failed;
+			result.Error = e.what();
+		}
+		result.Milliseconds = GetMilliseconds(start);
+		return result;
+	}
+
+	uint32_t Run(const std::vector<std::string>& sourcePaths, const Options& options)
+	{
+		constexpr double mib = 1024.0 * 1024.0;
+
+		// Nested jobs: every file is a job, and each import spreads its own stages over the same pool
+		auto start = Clock::now();
+		std::vector<Result> results(sourcePaths.size());
+		std::atomic<uint32_t> done = 0;
+		Jobs::ParallelFor(uint32_t(sourcePaths.size()), [&](uint32_t i)
+			{
+				results[i] = BakeOne(sourcePaths[i], options);
+				fprintf(stderr, "[%u/%zu] %s\n", ++done, sourcePaths.size(), sourcePaths[i].c_str());
+			});
+		double totalTime = GetMilliseconds(start);
+
+		uint32_t failed = 0;
+		uint32_t baked = 0;
+		uint64_t sourceBytes = 0;
+		uint64_t cacheBytes = 0;
+		for (size_t i = 0; i < sourcePaths.size(); i++)
+		{
+			const auto& result = results[i];
+			sourceBytes += result.SourceBytes;
+			cacheBytes += result.CacheBytes;
+			switch (result.Status)
+			{
+			case Result::Status::Failed:
+				failed++;
+				printf("%s: failed, %s\n", sourcePaths[i].c_str(), result.Error.c_str());
+				continue;
+			case Result::Status::UpToDate:
+				printf("%s: up to date (%.1f MiB)\n", sourcePaths[i].c_str(), result.CacheBytes / mib);
+				continue;
+			default:
+				baked++;
+				printf("%s: baked in %.2f ms, %.1f MiB -> %.1f MiB\n", sourcePaths[i].c_str(), result.Milliseconds,
+					result.SourceBytes / mib, result.CacheBytes / mib);
+				break;
+			}
+
+			if (!options.Verbose) continue;
+
+			// Stages overlap with other files' imports, so they are wall time under contention
+			for (const auto& stage : result.Stats.Stages)
+			{
+				printf("    %-16s %10.2f ms\n", stage.Name.c_str(), stage.Milliseconds);
+			}
+			for (const auto& counter : result.Stats.Counters)
+			{
+				printf("    %-32s %10.2f\n", counter.Name.c_str(), counter.Value);
+			}
+		}
+
+		// Summed over every baked file, in the order the importer runs them
+		std::vector<ImportStage> stages;
+		for (const auto& result : results)
+		{
+			for (const auto& stage : result.Stats.Stages)
+			{
+				auto it = std::find_if(stages.begin(), stages.end(), [&](const ImportStage& total) { return total.Name == stage.Name; });
+				if (it == stages.end()) stages.push_back(stage);
+				else it->Milliseconds += stage.Milliseconds;
+			}
+		}
+		if (stages.size()) printf("Stage totals:\n");
+		for (const auto& stage : stages)
+		{
+			printf("    %-16s %10.2f ms\n", stage.Name.c_str(), stage.Milliseconds);
+		}
+
+		printf("Baked %u, up to date %zu, failed %u of %zu files in %.2f ms on %u threads\n", baked,
+			sourcePaths.size() - baked - failed, failed, sourcePaths.size(), totalTime, Jobs::ThreadCount());
+		printf("  Sources %.1f MiB, caches %.1f MiB, peak RSS %.1f MiB\n", sourceBytes / mib, cacheBytes / mib,
+			double(Memory::GetPeakResidentBytes()) / mib);
+		return failed;
+	}
+
+}
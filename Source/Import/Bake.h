@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SceneData.h"
+
+// Offline conversion of source assets into .vxscene caches, without a window or device.
+namespace Bake
+{
+
+	struct Options
+	{
+		ImportOptions Import;
+		// Rebake even if the cache next to the source is still valid
+		bool Force = false;
+		// Print every stage and counter of each import, not just the summary line
+		bool Verbose = false;
+	};
+
+	// Imports all sources in parallel, each on top of the shared job pool, and prints per-file stages
+	// and a summary to stdout. Returns the number of sources that failed.
+	uint32_t Run(const std::vector<std::string>& sourcePaths, const Options& options = {});
+
+}
@@ -0,0 +1,507 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+#include "Culling.h"
+#include "GltfLoader.h"
+#include "Importer.h"
+#include "Jobs.h"
+#include "Memory.h"
+#include "NormalMaps.h"
+#include "ObjLoader.h"
+#include "PageCache.h"
+#include "SceneCache.h"
+
+namespace Benchmark
+{
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	double GetMilliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Bounds of every position, the cheapest pass that still has to pull in the whole stream
+	template<typename V, typename F>
+	double StreamPositions(std::span<const V> vertices, uint32_t iterations, F&& getPosition)
+	{
+		double minTime = 1e30;
+		float checksum = 0.f;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			DirectX::XMFLOAT3 min = { 1e30f, 1e30f, 1e30f };
+			DirectX::XMFLOAT3 max = { -1e30f, -1e30f, -1e30f };
+			for (const auto& vertex : vertices)
+			{
+				auto position = getPosition(vertex);
+				min = { (std::min)(min.x, position.x), (std::min)(min.y, position.y), (std::min)(min.z, position.z) };
+				max = { (std::max)(max.x, position.x), (std::max)(max.y, position.y), (std::max)(max.z, position.z) };
+			}
+			minTime = (std::min)(minTime, GetMilliseconds(start));
+			checksum += max.x - min.x + max.y - min.y + max.z - min.z;
+		}
+		if (checksum < 0.f) printf("  Invalid bounds\n");
+		return minTime;
+	}
+
+	void PrintThroughput(const char* name, size_t count, size_t stride, double milliseconds)
+	{
+		double bytes = double(count) * double(stride);
+		printf("  %-12s %4zu B/vertex %10.2f ms %8.2f GB/s %10.1f Mvertices/s\n", name, stride, milliseconds,
+			bytes / (milliseconds * 1e6), double(count) / (milliseconds * 1e3));
+	}
+
+	void BenchmarkBvh(const SceneData& data, uint32_t iterations)
+	{
+		auto view = data.View();
+		if (view.Indices.empty()) return;
+
+		double triangleTime = 1e30;
+		double clusterTime = 1e30;
+		SceneBvh::TriangleTrees triangles;
+		Bvh clusters;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			triangles = SceneBvh::BuildTriangles(view);
+			triangleTime = (std::min)(triangleTime, GetMilliseconds(start));
+			start = Clock::now();
+			clusters = SceneBvh::BuildClusters(view);
+			clusterTime = (std::min)(clusterTime, GetMilliseconds(start));
+		}
+
+		printf("  BVH (best of %u):\n", iterations);
+		size_t instancedTriangles = 0;
+		size_t instancedNodes = 0;
+		for (const auto& tree : triangles.Materials)
+		{
+			instancedTriangles += tree.Primitives.size();
+			instancedNodes += tree.Nodes.size();
+		}
+		printf("    %-12s %10zu primitives %8zu nodes %10.2f ms\n", "Triangles", triangles.World.Primitives.size() + instancedTriangles,
+			triangles.World.Nodes.size() + instancedNodes, triangleTime);
+		printf("    %-12s %10zu primitives %8zu nodes\n", "Instances", triangles.Instances.Primitives.size(), triangles.Instances.Nodes.size());
+		printf("    %-12s %10zu primitives %8zu nodes %10.2f ms\n", "Clusters", clusters.Primitives.size(), clusters.Nodes.size(), clusterTime);
+
+		const auto& bounds = view.Bounds;
+		const auto& min = bounds.Min;
+		const auto& max = bounds.Max;
+
+		// Rays from random points inside the bounds in random directions, fixed seed so runs compare
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		std::normal_distribution<float> normal;
+		std::vector<Ray> rays(1 << 16);
+		for (auto& ray : rays)
+		{
+			ray.Origin = { min.x + unit(random) * (max.x - min.x), min.y + unit(random) * (max.y - min.y), min.z + unit(random) * (max.z - min.z) };
+			DirectX::XMStoreFloat3(&ray.Direction, DirectX::XMVector3Normalize(DirectX::XMVectorSet(normal(random), normal(random), normal(random), 0.f)));
+		}
+
+		// The trees have to agree with testing every triangle of every instance
+		uint32_t mismatches = 0;
+		const uint32_t checked = (std::min)(uint32_t(rays.size()), 64u);
+		for (uint32_t i = 0; i < checked; i++)
+		{
+			auto hit = SceneBvh::RayCast(triangles, view, rays[i]);
+			float closest = FLT_MAX;
+			for (const auto& material : view.Materials)
+			{
+				for (uint32_t instance = material.BaseInstance; instance < material.BaseInstance + material.InstanceCount; instance++)
+				{
+					auto ray = material.InstanceCount > 1 ? SceneBvh::ToObjectSpace(triangles, instance, rays[i]) : rays[i];
+					for (uint32_t t = material.BaseIndex / 3; t < (material.BaseIndex + material.IndexCount) / 3; t++)
+					{
+						if (auto reference = SceneBvh::IntersectTriangle(view, t, ray)) closest = (std::min)(closest, reference->Distance);
+					}
+				}
+			}
+			if ((hit ? hit->Distance : FLT_MAX) != closest) mismatches++;
+		}
+
+		double rayTime = 1e30;
+		uint32_t hits = 0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			std::atomic<uint32_t> count = 0;
+			auto start = Clock::now();
+			Jobs::ParallelFor(uint32_t(rays.size() / 256), [&](uint32_t batch)
+				{
+					uint32_t batchHits = 0;
+					for (uint32_t r = batch * 256; r < batch * 256 + 256; r++)
+					{
+						if (SceneBvh::RayCast(triangles, view, rays[r])) batchHits++;
+					}
+					count += batchHits;
+				});
+			rayTime = (std::min)(rayTime, GetMilliseconds(start));
+			hits = count;
+		}
+		printf("    Rays: %zu, %u hit, %10.2f ms, %.2f Mrays/s on %u threads, %u/%u mismatches against brute force\n",
+			rays.size(), hits, rayTime, double(rays.size()) / (rayTime * 1e3), Jobs::ThreadCount(), mismatches, checked);
+
+		// A 90 degree frustum from the center looking down +z, and a box around the center an eighth of the scene's size
+		DirectX::XMFLOAT3 center = { (min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f };
+		float size = (std::max)({ max.x - min.x, max.y - min.y, max.z - min.z });
+		auto viewMatrix = DirectX::XMMatrixLookToLH(DirectX::XMLoadFloat3(&center), DirectX::XMVectorSet(0.f, 0.f, 1.f, 0.f),
+			DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f));
+		auto frustum = Frustum::FromMatrix(viewMatrix * DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1.f, 0.01f, size));
+		Box box = { { center.x - size / 16.f, center.y - size / 16.f, center.z - size / 16.f },
+			{ center.x + size / 16.f, center.y + size / 16.f, center.z + size / 16.f } };
+
+		double frustumTime = 1e30;
+		double boxTime = 1e30;
+		uint32_t frustumCount = 0;
+		uint32_t boxCount = 0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			frustumCount = 0;
+			clusters.Query(frustum, [&](uint32_t) { frustumCount++; });
+			frustumTime = (std::min)(frustumTime, GetMilliseconds(start));
+
+			start = Clock::now();
+			boxCount = 0;
+			clusters.Query(box, [&](uint32_t) { boxCount++; });
+			boxTime = (std::min)(boxTime, GetMilliseconds(start));
+		}
+		printf("    Frustum query: %u/%zu clusters and instances %10.3f ms\n", frustumCount, clusters.Primitives.size(), frustumTime);
+		printf("    Box query:     %u/%zu clusters and instances %10.3f ms\n", boxCount, clusters.Primitives.size(), boxTime);
+	}
+
+	// The renderer's three passes, with volumes scaled to the scene bounds
+	void BenchmarkCulling(const SceneData& data, uint32_t iterations)
+	{
+		using namespace DirectX;
+
+		if (data.Clusters.empty()) return;
+
+		auto view = data.View();
+		const auto& bounds = view.Bounds;
+		XMVECTOR min = XMLoadFloat3(&bounds.Min);
+		XMVECTOR max = XMLoadFloat3(&bounds.Max);
+		XMVECTOR center = XMVectorScale(XMVectorAdd(min, max), 0.5f);
+		float size = XMVectorGetX(XMVector3Length(XMVectorSubtract(max, min)));
+
+		auto camera = XMMatrixLookToLH(center, XMVectorSet(0.f, 0.f, 1.f, 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f)) *
+			XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.f / 9.f, size, size * 1e-4f);
+		auto direction = XMVector3Normalize(XMVectorSet(0.3f, 1.f, 0.2f, 0.f));
+		auto light = XMMatrixLookToLH(XMVectorAdd(center, XMVectorScale(direction, size)), XMVectorNegate(direction),
+			XMVector3Cross(XMVectorSet(1.f, 0.f, 0.f, 0.f), direction)) * XMMatrixOrthographicLH(size * 0.5f, size * 0.5f, size * 2.f, 0.1f);
+		Box voxels;
+		XMStoreFloat3(&voxels.Min, XMVectorSubtract(center, XMVectorReplicate(size * 0.125f)));
+		XMStoreFloat3(&voxels.Max, XMVectorAdd(center, XMVectorReplicate(size * 0.125f)));
+
+		const char* names[] = { "Shadow", "Voxel", "Camera" };
+		const Frustum volumes[] = { Frustum::FromMatrix(light), Frustum::FromBox(voxels), Frustum::FromMatrix(camera) };
+
+		auto start = Clock::now();
+		auto culling = Culling::Prepare(view);
+		double prepareTime = GetMilliseconds(start);
+		uint32_t total = 0;
+		for (const auto& material : data.Materials)
+		{
+			total += material.ClusterCount * material.InstanceCount;
+		}
+		printf("  Culling %u clusters, %zu unique (best of %u, prepare %.3f ms):\n", total, data.Clusters.size(), iterations, prepareTime);
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			DrawList list;
+			double time = 1e30;
+			for (uint32_t j = 0; j < iterations; j++)
+			{
+				Culling::Cull(culling, volumes[i], list);
+				time = (std::min)(time, list.Milliseconds);
+			}
+			printf("    %-8s %8u visible %8u culled %6zu draws %6zu masked %10u triangles %8.3f ms %8.1f Mclusters/s\n", names[i],
+				list.Visible, list.Culled, list.Draws.size(), list.MaskedDraws.size(), list.Triangles, time, total / (time * 1e3));
+
+			// Same thresholds as the renderer: a shadow map texel, half a voxel
+			if (i < 2)
+			{
+				float maxError = i == 0 ? size * 0.5f / 4096.f : size * 0.25f / 128.f * 0.5f;
+				Culling::SelectLods(list, data.Lods, maxError);
+				printf("    %-8s %8u LODs (error <= %.4f) %6zu draws %6zu masked %10u triangles\n", "", list.Simplified, maxError,
+					list.Draws.size(), list.MaskedDraws.size(), list.Triangles);
+			}
+		}
+	}
+
+	// Feedback streams the renderer would produce, without a GPU: a few popular textures and a long tail, each seen
+	// through a window of pages that drifts over it, at a mip that changes with the distance to the camera.
+	void BenchmarkPages(const SceneData& data)
+	{
+		std::vector<Pages::Layout> layouts;
+		for (const auto& texture : data.Textures)
+		{
+			if (Pages::IsPageable(texture.Width, texture.Height, texture.MipLevels, texture.Format))
+			{
+				layouts.push_back(Pages::Layout::Create(texture.Width, texture.Height));
+			}
+		}
+		const char* source = "scene";
+		if (layouts.empty())
+		{
+			layouts.assign(64, Pages::Layout::Create(4096, 4096));
+			source = "synthetic 4096x4096";
+		}
+		uint32_t pageCount = 0;
+		for (const auto& layout : layouts)
+		{
+			pageCount += layout.PageCount;
+		}
+
+		constexpr uint32_t frames = 600;
+		constexpr uint32_t visible = 24;
+		// A 1080p frame at the renderer's feedback scale
+		constexpr uint32_t samples = 240 * 135;
+		uint32_t textureCount = uint32_t(layouts.size());
+		printf("  Virtual texturing, %u %s textures, %u pages, %u frames of %u samples:\n", textureCount, source, pageCount, frames, samples);
+
+		for (uint32_t percent : { 10u, 25u, 50u, 100u })
+		{
+			Pages::PageCache cache(layouts, (std::max)(pageCount * percent / 100, textureCount + 1));
+			uint32_t state = 12345;
+			auto next = [&] { return state = state * 1664525u + 1013904223u; };
+			auto uniform = [&] { return float(next() >> 8) / float(1 << 24); };
+
+			uint64_t requested = 0, hits = 0, uploads = 0, evictions = 0, deferred = 0, dropped = 0, exact = 0, sampled = 0;
+			uint32_t maxUploads = 0;
+			double time = 0.0;
+			std::vector<uint32_t> requests;
+			for (uint32_t frame = 0; frame < frames; frame++)
+			{
+				requests.clear();
+				for (uint32_t v = 0; v < visible; v++)
+				{
+					// Zipf-like: low indices show up most
+					uint32_t texture = (std::min)(uint32_t(textureCount * uniform() * uniform() * uniform()), textureCount - 1);
+					const auto& layout = layouts[texture];
+					float phase = frame * 0.002f + texture * 0.37f;
+					uint32_t mip = (std::min)(uint32_t((0.5f + 0.5f * sinf(phase * 3.f + v)) * layout.Mips), layout.Mips - 1);
+					float centerX = (phase - floorf(phase)) * layout.PagesX[mip];
+					float centerY = (0.5f + 0.5f * cosf(phase * 2.f)) * layout.PagesY[mip];
+					for (uint32_t i = 0; i < samples / visible; i++)
+					{
+						uint32_t x = uint32_t(centerX + (uniform() - 0.5f) * 4.f + layout.PagesX[mip]) % layout.PagesX[mip];
+						uint32_t y = (std::min)(uint32_t((std::max)(centerY + (uniform() - 0.5f) * 4.f, 0.f)), layout.PagesY[mip] - 1);
+						requests.push_back(Pages::EncodeRequest(texture, mip, x, y));
+					}
+				}
+
+				auto start = Clock::now();
+				cache.Update(requests, 64);
+				time += GetMilliseconds(start);
+
+				const auto& stats = cache.Stats;
+				requested += stats.Requested;
+				hits += stats.Hits;
+				uploads += stats.Uploads;
+				evictions += stats.Evictions;
+				deferred += stats.Deferred;
+				dropped += stats.Dropped;
+				maxUploads = (std::max)(maxUploads, stats.Uploads);
+
+				// What this frame's samples resolve to, the page itself or a coarser fallback
+				const auto& indirection = cache.GetIndirection();
+				for (uint32_t i = 0; i < requests.size(); i += 64)
+				{
+					uint32_t request = requests[i];
+					uint32_t texture = request >> 20, mip = (request >> 16) & 0xf, y = (request >> 8) & 0xff, x = request & 0xff;
+					const auto& layout = cache.GetLayout(texture);
+					uint32_t entry = indirection[cache.GetOffset(texture) + layout.Offsets[mip] + y * layout.PagesX[mip] + x];
+					exact += (entry >> 20) == mip;
+					sampled++;
+				}
+			}
+			printf("    %3u%% budget %7u slots: %5.1f%% hits, %5.1f%% exact samples, %6.1f avg %4u max uploads/frame, %8llu evictions, "
+				"%8llu deferred, %8llu dropped, %7.3f ms/update\n", percent, cache.GetSlotCount(), 100.0 * hits / (std::max)(requested, uint64_t(1)),
+				100.0 * exact / (std::max)(sampled, uint64_t(1)), double(uploads) / frames, maxUploads, (unsigned long long)evictions,
+				(unsigned long long)deferred, (unsigned long long)dropped, time / frames);
+		}
+	}
+
+	// The native OBJ and glTF readers against assimp on the same file, up to the SourceScene both hand to the importer.
+	// The peak is the process' high water mark, so the native loader runs first to be measured on its own.
+	void BenchmarkLoaders(const std::string& sourcePath, uint32_t iterations)
+	{
+		bool obj = ObjLoader::IsObj(sourcePath);
+		if (!obj && !GltfLoader::IsGltf(sourcePath)) return;
+
+		printf("  %s loading (best of %u):\n", obj ? "OBJ" : "glTF", iterations);
+		size_t fileSize = std::filesystem::file_size(sourcePath);
+		for (bool assimp : { false, true })
+		{
+			double minTime = 1e30;
+			uint64_t peakBefore = Memory::GetPeakResidentBytes();
+			SourceScene scene;
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				scene = {};
+				ImportStats stats;
+				auto start = Clock::now();
+				scene = Importer::Load(sourcePath, stats, assimp);
+				minTime = (std::min)(minTime, GetMilliseconds(start));
+			}
+			uint64_t peakGrowth = Memory::GetPeakResidentBytes() - peakBefore;
+
+			size_t vertexCount = 0;
+			size_t triangleCount = 0;
+			for (const auto& mesh : scene.Meshes)
+			{
+				vertexCount += mesh.Vertices.size();
+				triangleCount += mesh.Indices.size() / 3;
+			}
+			printf("    %-8s %10.2f ms %8.1f MiB/s %8.1f MiB peak growth %6zu meshes %10zu vertices %10zu triangles\n",
+				assimp ? "Assimp" : "Native", minTime, fileSize / (1024.0 * 1024.0) / (minTime * 1e-3), peakGrowth / (1024.0 * 1024.0),
+				scene.Meshes.size(), vertexCount, triangleCount);
+		}
+	}
+
+	// The imported normal maps against the normal GBufferWritePS derived from the same height map, on a smooth synthetic
+	// surface where the Sobel filter and the shader's one texel differences should agree
+	void BenchmarkNormalMaps(uint32_t iterations)
+	{
+		constexpr uint32_t size = 1024;
+		TextureData height{ size, size, 1, TextureFormat::RGBA8, std::vector<uint8_t>(size_t(size) * size * 4, 255) };
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				float value = 0.5f + 0.45f * std::sin(x * 6.2831853f / 128.f) * std::cos(y * 6.2831853f / 256.f);
+				height.Pixels[(size_t(y) * size + x) * 4] = uint8_t(value * 255.f + 0.5f);
+			}
+		}
+
+		double minTime = 1e30;
+		TextureData normals;
+		for (uint32_t i = 0; i < (std::max)(iterations, 1u); i++)
+		{
+			normals = height;
+			auto start = Clock::now();
+			NormalMaps::FromHeight(normals);
+			minTime = (std::min)(minTime, GetMilliseconds(start));
+		}
+
+		double maxError = 0.0;
+		double errorSum = 0.0;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				auto expected = NormalMaps::GetShaderNormal(height, x, y);
+				auto actual = NormalMaps::Decode(&normals.Pixels[(size_t(y) * size + x) * 4]);
+				float cosine = std::clamp(expected.x * actual.x + expected.y * actual.y + expected.z * actual.z, -1.f, 1.f);
+				double error = std::acos(cosine) * 57.29578;
+				maxError = (std::max)(maxError, error);
+				errorSum += error;
+			}
+		}
+		printf("  Normal maps: %ux%u in %.2f ms (%.1f Mtexels/s), %.2f deg avg %.2f deg max from the shader's normals\n", size, size,
+			minTime, double(size) * size / (minTime * 1e3), errorSum / (double(size) * size), maxError);
+	}
+
+	void Run(const std::string& sourcePath, uint32_t iterations, const ImportOptions& options)
+	{
+		auto start = Clock::now();
+		SceneData data = Importer::Import(sourcePath, options);
+		double importTime = GetMilliseconds(start);
+
+		start = Clock::now();
+		SceneCache::Write(sourcePath, data.View(), options);
+		double writeTime = GetMilliseconds(start);
+
+		double minTime = 1e30;
+		double totalTime = 0.0;
+		uint64_t bytes = 0;
+		uint64_t checksum = 0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			start = Clock::now();
+			auto file = SceneCache::Open(sourcePath, options);
+			if (!file)
+			{
+				printf("Cache for %s could not be opened\n", sourcePath.c_str());
+				return;
+			}
+
+			// Touch every page so the numbers include the actual file reads, not just the mapping
+			for (size_t offset = 0; offset < file->Mapping.Size; offset += 4096)
+			{
+				checksum += file->Mapping.Data[offset];
+			}
+			bytes = file->Mapping.Size;
+
+			double time = GetMilliseconds(start);
+			minTime = (std::min)(minTime, time);
+			totalTime += time;
+		}
+
+		printf("Scene: %s\n", sourcePath.c_str());
+		printf("  Vertices: %zu, Indices: %zu, Materials: %zu, Instances: %zu, Textures: %zu\n",
+			data.Vertices.size(), data.Indices.size(), data.Materials.size(), data.Instances.size(), data.Textures.size());
+		printf("  Import:      %10.2f ms on %u threads\n", importTime, Jobs::ThreadCount());
+		for (const auto& stage : data.Stats.Stages)
+		{
+			printf("    %-16s %10.2f ms\n", stage.Name.c_str(), stage.Milliseconds);
+		}
+		for (const auto& counter : data.Stats.Counters)
+		{
+			printf("    %-32s %10.2f\n", counter.Name.c_str(), counter.Value);
+		}
+		printf("  Cache write: %10.2f ms (%.1f MiB)\n", writeTime, bytes / (1024.0 * 1024.0));
+		printf("  Cache load:  %10.2f ms min, %.2f ms avg over %u runs (checksum %llu)\n",
+			minTime, totalTime / (std::max)(iterations, 1u), iterations, (unsigned long long)checksum);
+
+		printf("  Vertex stream (best of %u):\n", iterations);
+		double fullTime = StreamPositions(std::span<const Vertex>(data.Vertices), iterations,
+			[](const Vertex& vertex) { return vertex.Position; });
+		PrintThroughput("Full", data.Vertices.size(), sizeof(Vertex), fullTime);
+		double positionTime = StreamPositions(std::span<const DirectX::XMFLOAT3>(data.Positions), iterations,
+			[](const DirectX::XMFLOAT3& position) { return position; });
+		PrintThroughput("Positions", data.Positions.size(), sizeof(DirectX::XMFLOAT3), positionTime);
+		printf("  Position stream: %.2fx less data, %.2fx faster\n",
+			double(sizeof(Vertex)) / sizeof(DirectX::XMFLOAT3), fullTime / (std::max)(positionTime, 1e-9));
+
+		if (data.CompactVertices.size())
+		{
+			// Dequantized with each material's own range, as the vertex shader does
+			double compactTime = 0.0;
+			for (size_t m = 0; m < data.Materials.size(); m++)
+			{
+				if (SharesVertices(data.Materials, m)) continue;
+
+				const auto& material = data.Materials[m];
+				const auto& quantization = data.Quantization[m];
+				std::span<const CompactVertex> vertices(data.CompactVertices.data() + material.BaseVertex, material.VertexCount);
+				compactTime += StreamPositions(vertices, iterations, [&](const CompactVertex& vertex)
+				{
+					return DirectX::XMFLOAT3{
+						quantization.Offset.x + vertex.Position[0] / 65535.f * quantization.Scale.x,
+						quantization.Offset.y + vertex.Position[1] / 65535.f * quantization.Scale.y,
+						quantization.Offset.z + vertex.Position[2] / 65535.f * quantization.Scale.z
+					};
+				});
+			}
+			PrintThroughput("Compact", data.CompactVertices.size(), sizeof(CompactVertex), compactTime);
+			printf("  Bandwidth reduction: %.2fx, %.2fx faster\n",
+				double(sizeof(Vertex)) / sizeof(CompactVertex), fullTime / (std::max)(compactTime, 1e-9));
+		}
+
+		BenchmarkBvh(data, iterations);
+		BenchmarkCulling(data, iterations);
+		BenchmarkPages(data);
+		BenchmarkLoaders(sourcePath, iterations);
+		BenchmarkNormalMaps(iterations);
+	}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+#include "SceneData.h"
+
+// Headless timings for the import pipeline and the baked cache, printed to stdout.
+namespace Benchmark
+{
+
+	// Imports once, then times repeated cache loads and a CPU pass over the vertex streams.
+	void Run(const std::string& sourcePath, uint32_t iterations, const ImportOptions& options = {});
+
+}
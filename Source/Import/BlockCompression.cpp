@@ -0,0 +1,229 @@
+#include "BlockCompression.h"
+
+#include <cmath>
+#include <cstring>
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+namespace BlockCompression
+{
+
+	void EncodeBlock(TextureFormat format, const uint8_t (&rgba)[64], uint8_t* out)
+	{
+		uint8_t channels[32];
+		switch (format)
+		{
+		case TextureFormat::BC1_SRGB:
+			stb_compress_dxt_block(out, rgba, 0, STB_DXT_HIGHQUAL);
+			break;
+		case TextureFormat::BC3_SRGB:
+		case TextureFormat::BC3:
+			stb_compress_dxt_block(out, rgba, 1, STB_DXT_HIGHQUAL);
+			break;
+		case TextureFormat::BC4:
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				channels[i] = rgba[i * 4];
+			}
+			stb_compress_bc4_block(out, channels);
+			break;
+		case TextureFormat::BC5:
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				channels[i * 2] = rgba[i * 4];
+				channels[i * 2 + 1] = rgba[i * 4 + 1];
+			}
+			stb_compress_bc5_block(out, channels);
+			break;
+		default:
+			break;
+		}
+	}
+
+	TextureData Compress(const TextureData& source, TextureFormat format)
+	{
+		TextureData result{ source.Width, source.Height, source.MipLevels, format };
+
+		size_t total = 0;
+		for (uint32_t level = 0, w = source.Width, h = source.Height; level < source.MipLevels; level++)
+		{
+			total += GetMipSize(format, w, h);
+			w = std::max(w / 2, 1u);
+			h = std::max(h / 2, 1u);
+		}
+		result.Pixels.resize(total);
+
+		const uint8_t* src = source.Pixels.data();
+		uint8_t* dst = result.Pixels.data();
+		uint32_t width = source.Width;
+		uint32_t height = source.Height;
+		uint32_t blockSize = GetElementSize(format);
+		for (uint32_t level = 0; level < source.MipLevels; level++)
+		{
+			// The last mips are smaller than a block, the edge texels are repeated to fill it
+			for (uint32_t by = 0; by < height; by += 4)
+			{
+				for (uint32_t bx = 0; bx < width; bx += 4)
+				{
+					uint8_t block[64];
+					for (uint32_t y = 0; y < 4; y++)
+					{
+						uint32_t sy = std::min(by + y, height - 1);
+						for (uint32_t x = 0; x < 4; x++)
+						{
+							uint32_t sx = std::min(bx + x, width - 1);
+							memcpy(block + (y * 4 + x) * 4, src + (size_t(sy) * width + sx) * 4, 4);
+						}
+					}
+
+					EncodeBlock(format, block, dst);
+					dst += blockSize;
+				}
+			}
+
+			src += GetMipSize(source.Format, width, height);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+
+		return result;
+	}
+
+	void DecodeColor(const uint8_t* block, uint8_t (&out)[16][4], bool alpha)
+	{
+		uint16_t c[2];
+		memcpy(c, block, 4);
+
+		uint8_t palette[4][4];
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			palette[i][0] = uint8_t(((c[i] >> 11) & 31) * 255 / 31);
+			palette[i][1] = uint8_t(((c[i] >> 5) & 63) * 255 / 63);
+			palette[i][2] = uint8_t((c[i] & 31) * 255 / 31);
+			palette[i][3] = 255;
+		}
+		for (uint32_t ch = 0; ch < 3; ch++)
+		{
+			if (c[0] > c[1] || alpha)
+			{
+				palette[2][ch] = uint8_t((2 * palette[0][ch] + palette[1][ch]) / 3);
+				palette[3][ch] = uint8_t((palette[0][ch] + 2 * palette[1][ch]) / 3);
+			}
+			else
+			{
+				palette[2][ch] = uint8_t((palette[0][ch] + palette[1][ch]) / 2);
+				palette[3][ch] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = c[0] > c[1] || alpha ? 255 : 0;
+
+		uint32_t indices;
+		memcpy(&indices, block + 4, 4);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			memcpy(out[i], palette[(indices >> (i * 2)) & 3], 4);
+		}
+	}
+
+	void DecodeChannel(const uint8_t* block, uint8_t (&out)[16][4], uint32_t channel)
+	{
+		uint8_t palette[8] = { block[0], block[1] };
+		if (palette[0] > palette[1])
+		{
+			for (uint32_t i = 1; i < 7; i++)
+			{
+				palette[i + 1] = uint8_t(((7 - i) * palette[0] + i * palette[1]) / 7);
+			}
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; i++)
+			{
+				palette[i + 1] = uint8_t(((5 - i) * palette[0] + i * palette[1]) / 5);
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t indices = 0;
+		memcpy(&indices, block + 2, 6);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			out[i][channel] = palette[(indices >> (i * 3)) & 7];
+		}
+	}
+
+	std::vector<uint8_t> Decode(const TextureData& texture)
+	{
+		std::vector<uint8_t> pixels(size_t(texture.Width) * texture.Height * 4);
+		if (!IsBlockCompressed(texture.Format))
+		{
+			memcpy(pixels.data(), texture.Pixels.data(), pixels.size());
+			return pixels;
+		}
+
+		const uint8_t* block = texture.Pixels.data();
+		uint32_t blockSize = GetElementSize(texture.Format);
+		for (uint32_t by = 0; by < texture.Height; by += 4)
+		{
+			for (uint32_t bx = 0; bx < texture.Width; bx += 4)
+			{
+				uint8_t decoded[16][4] = {};
+				switch (texture.Format)
+				{
+				case TextureFormat::BC1_SRGB:
+					DecodeColor(block, decoded, false);
+					break;
+				case TextureFormat::BC3_SRGB:
+				case TextureFormat::BC3:
+					DecodeColor(block + 8, decoded, true);
+					DecodeChannel(block, decoded, 3);
+					break;
+				case TextureFormat::BC4:
+					DecodeChannel(block, decoded, 0);
+					break;
+				case TextureFormat::BC5:
+					DecodeChannel(block, decoded, 0);
+					DecodeChannel(block + 8, decoded, 1);
+					break;
+				default:
+					break;
+				}
+
+				for (uint32_t y = 0; y < 4 && by + y < texture.Height; y++)
+				{
+					for (uint32_t x = 0; x < 4 && bx + x < texture.Width; x++)
+					{
+						memcpy(&pixels[((size_t(by) + y) * texture.Width + bx + x) * 4], decoded[y * 4 + x], 4);
+					}
+				}
+				block += blockSize;
+			}
+		}
+
+		return pixels;
+	}
+
+	double PSNR(const uint8_t* first, const uint8_t* second, size_t pixelCount, uint32_t channelMask)
+	{
+		double error = 0.0;
+		size_t samples = 0;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			for (uint32_t ch = 0; ch < 4; ch++)
+			{
+				if (!(channelMask & (1u << ch))) continue;
+
+				double diff = double(first[i * 4 + ch]) - double(second[i * 4 + ch]);
+				error += diff * diff;
+				samples++;
+			}
+		}
+
+		if (!samples || error == 0.0) return 99.0;
+		return 10.0 * std::log10(255.0 * 255.0 / (error / double(samples)));
+	}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "SceneData.h"
+
+// CPU block compression of imported textures, built on stb_dxt.
+namespace BlockCompression
+{
+
+	// Compresses every mip of an RGBA8 texture. BC4 takes the red channel and BC5 red and green.
+	// Level 0 must be a multiple of 4 in both dimensions, as D3D requires for block compressed textures.
+	TextureData Compress(const TextureData& source, TextureFormat format);
+
+	// Decodes level 0 back to RGBA8, for checking the encoder against its source.
+	std::vector<uint8_t> Decode(const TextureData& texture);
+
+	// Peak signal to noise ratio in dB over the channels set in channelMask (bit 0 = red).
+	double PSNR(const uint8_t* first, const uint8_t* second, size_t pixelCount, uint32_t channelMask);
+
+}
@@ -0,0 +1,185 @@
+#include "Clusters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+namespace Clusters
+{
+
+	using namespace DirectX;
+
+	XMVECTOR GetCentroid(std::span<const uint32_t> indices, std::span<const Vertex> vertices, uint32_t triangle)
+	{
+		XMVECTOR sum = XMVectorAdd(XMLoadFloat3(&vertices[indices[triangle * 3]].Position),
+			XMVectorAdd(XMLoadFloat3(&vertices[indices[triangle * 3 + 1]].Position), XMLoadFloat3(&vertices[indices[triangle * 3 + 2]].Position)));
+		return XMVectorScale(sum, 1.f / 3.f);
+	}
+
+	void Build(std::span<uint32_t> indices, std::span<const Vertex> vertices, uint32_t material, std::vector<ClusterData>& clusters)
+	{
+		uint32_t triangleCount = uint32_t(indices.size() / 3);
+		auto adjacency = MeshOptimizer::BuildAdjacency(indices, uint32_t(vertices.size()));
+
+		std::vector<bool> assigned(triangleCount, false);
+		// Cluster number + 1 of the last cluster that used the vertex
+		std::vector<uint32_t> vertexCluster(vertices.size(), 0);
+		std::vector<uint32_t> clusterVertices;
+		std::vector<uint32_t> clusterTriangles;
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		uint32_t clusterID = 0;
+		uint32_t cursor = 0;
+		while (true)
+		{
+			while (cursor < triangleCount && assigned[cursor]) cursor++;
+			if (cursor == triangleCount) break;
+
+			clusterID++;
+			clusterVertices.clear();
+			clusterTriangles.clear();
+			XMVECTOR centroidSum = XMVectorZero();
+
+			auto add = [&](uint32_t triangle)
+			{
+				assigned[triangle] = true;
+				clusterTriangles.push_back(triangle);
+				centroidSum = XMVectorAdd(centroidSum, GetCentroid(indices, vertices, triangle));
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					if (vertexCluster[vertex] != clusterID)
+					{
+						vertexCluster[vertex] = clusterID;
+						clusterVertices.push_back(vertex);
+					}
+				}
+			};
+			add(cursor);
+
+			// Grow through shared vertices: fewest new vertices first, then closest to the cluster's centroid
+			while (clusterTriangles.size() < MaxTriangles)
+			{
+				XMVECTOR centroid = XMVectorScale(centroidSum, 1.f / float(clusterTriangles.size()));
+				uint32_t best = ~0u;
+				uint32_t bestNew = 4;
+				float bestDistance = 0.f;
+				for (uint32_t vertex : clusterVertices)
+				{
+					for (uint32_t a = adjacency.Offsets[vertex]; a < adjacency.Offsets[vertex + 1]; a++)
+					{
+						uint32_t triangle = adjacency.Triangles[a];
+						if (assigned[triangle]) continue;
+
+						uint32_t newVertices = 0;
+						for (uint32_t corner = 0; corner < 3; corner++)
+						{
+							newVertices += vertexCluster[indices[triangle * 3 + corner]] != clusterID;
+						}
+						if (clusterVertices.size() + newVertices > MaxVertices || newVertices > bestNew) continue;
+
+						float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(GetCentroid(indices, vertices, triangle), centroid)));
+						if (newVertices < bestNew || distance < bestDistance)
+						{
+							best = triangle;
+							bestNew = newVertices;
+							bestDistance = distance;
+						}
+					}
+				}
+				if (best == ~0u) break;
+				add(best);
+			}
+
+			std::sort(clusterTriangles.begin(), clusterTriangles.end());
+			ClusterData cluster{
+				.BaseIndex = uint32_t(result.size()),
+				.IndexCount = uint32_t(clusterTriangles.size() * 3),
+				.Material = material,
+				.VertexCount = uint32_t(clusterVertices.size())
+			};
+			for (uint32_t triangle : clusterTriangles)
+			{
+				result.insert(result.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
+			}
+			ComputeBounds(cluster, std::span<const uint32_t>(result).subspan(cluster.BaseIndex, cluster.IndexCount), vertices);
+			clusters.push_back(cluster);
+		}
+
+		std::copy(result.begin(), result.end(), indices.begin());
+	}
+
+	void ComputeBounds(ClusterData& cluster, std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+	{
+		XMVECTOR min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+		XMVECTOR normalSum = XMVectorZero();
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+			min = XMVectorMin(min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+			max = XMVectorMax(max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+			// Clockwise front faces in our left handed space, so this points out of the front
+			normalSum = XMVectorAdd(normalSum, XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0))));
+		}
+		XMStoreFloat3(&cluster.Min, min);
+		XMStoreFloat3(&cluster.Max, max);
+
+		XMVECTOR center = XMVectorScale(XMVectorAdd(min, max), 0.5f);
+		float radiusSq = 0.f;
+		for (uint32_t index : indices)
+		{
+			radiusSq = (std::max)(radiusSq, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&vertices[index].Position), center))));
+		}
+		XMStoreFloat3(&cluster.Center, center);
+		cluster.Radius = std::sqrt(radiusSq);
+
+		// The cone has to contain every triangle normal, its cutoff is the sine of its half angle
+		cluster.ConeAxis = { 0.f, 0.f, 0.f };
+		cluster.ConeCutoff = 1.f;
+		if (XMVectorGetX(XMVector3LengthSq(normalSum)) == 0.f) return;
+
+		XMVECTOR axis = XMVector3Normalize(normalSum);
+		float minDot = 1.f;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.f) continue;
+			minDot = (std::min)(minDot, XMVectorGetX(XMVector3Dot(XMVector3Normalize(normal), axis)));
+		}
+
+		XMStoreFloat3(&cluster.ConeAxis, axis);
+		if (minDot > 0.f)
+		{
+			cluster.ConeCutoff = std::sqrt(1.f - minDot * minDot);
+		}
+	}
+
+	void AddStats(std::span<const ClusterData> clusters, ImportStats& stats)
+	{
+		if (clusters.empty()) return;
+
+		uint64_t triangles = 0;
+		uint64_t vertices = 0;
+		uint32_t cones = 0;
+		for (const auto& cluster : clusters)
+		{
+			triangles += cluster.IndexCount / 3;
+			vertices += cluster.VertexCount;
+			cones += cluster.ConeCutoff < 1.f;
+		}
+		stats.Add("Clusters", double(clusters.size()));
+		stats.Add("Triangles per cluster", double(triangles) / clusters.size());
+		stats.Add("Vertices per cluster", double(vertices) / clusters.size());
+		stats.Add("Clusters with normal cone (%)", 100.0 * cones / clusters.size());
+	}
+
+}
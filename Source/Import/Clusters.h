@@ -0,0 +1,24 @@
+#pragma once
+
+#include <span>
+
+#include "SceneData.h"
+
+// Splits material index ranges into spatially compact clusters with their culling bounds.
+namespace Clusters
+{
+
+	// Same limits as common mesh shader meshlets, so the clusters carry over if the renderer moves to them
+	constexpr uint32_t MaxVertices = 64;
+	constexpr uint32_t MaxTriangles = 124;
+
+	// Regroups the triangles of one material (indices relative to vertices) so that every cluster is contiguous,
+	// keeping the existing relative order inside each cluster. Appends the clusters with BaseIndex relative to indices.
+	void Build(std::span<uint32_t> indices, std::span<const Vertex> vertices, uint32_t material, std::vector<ClusterData>& clusters);
+
+	void ComputeBounds(ClusterData& cluster, std::span<const uint32_t> indices, std::span<const Vertex> vertices);
+
+	// Triangles, vertices per cluster and how many have a usable normal cone
+	void AddStats(std::span<const ClusterData> clusters, ImportStats& stats);
+
+}
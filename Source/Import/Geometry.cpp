@@ -0,0 +1,358 @@
+#include "Geometry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "Hash.h"
+
+using namespace DirectX;
+
+namespace Geometry
+{
+
+	constexpr uint32_t m_None = ~0u;
+
+	// first[i] is the lowest index equal to i, found through an open addressing table at most half full
+	template<typename H, typename E>
+	void FindFirst(uint32_t count, std::vector<uint32_t>& first, H&& hash, E&& equal)
+	{
+		uint32_t mask = std::bit_ceil((std::max)(count * 2, 2u)) - 1;
+		std::vector<uint32_t> table(size_t(mask) + 1, m_None);
+		first.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t slot = uint32_t(hash(i)) & mask;
+			while (table[slot] != m_None && !equal(table[slot], i))
+			{
+				slot = (slot + 1) & mask;
+			}
+			if (table[slot] == m_None) table[slot] = i;
+			first[i] = table[slot];
+		}
+	}
+
+	void Weld(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> first;
+		FindFirst(uint32_t(vertices.size()), first,
+			[&](uint32_t i) { return Hash::Bytes(&vertices[i], sizeof(Vertex)); },
+			[&](uint32_t a, uint32_t b) { return !memcmp(&vertices[a], &vertices[b], sizeof(Vertex)); });
+
+		std::vector<uint32_t> remap(vertices.size(), m_None);
+		std::vector<Vertex> welded;
+		welded.reserve(vertices.size());
+		size_t count = 0;
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			uint32_t corners[] = { first[indices[t]], first[indices[t + 1]], first[indices[t + 2]] };
+			if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) continue;
+
+			for (uint32_t corner : corners)
+			{
+				if (remap[corner] == m_None)
+				{
+					remap[corner] = uint32_t(welded.size());
+					welded.push_back(vertices[corner]);
+				}
+				indices[count++] = remap[corner];
+			}
+		}
+		indices.resize(count);
+		vertices = std::move(welded);
+	}
+
+	void GenerateNormals(std::span<Vertex> vertices, std::span<const uint32_t> indices)
+	{
+		std::vector<uint32_t> group;
+		FindFirst(uint32_t(vertices.size()), group,
+			[&](uint32_t i) { return Hash::Bytes(&vertices[i].Position, sizeof(XMFLOAT3)); },
+			[&](uint32_t a, uint32_t b) { return !memcmp(&vertices[a].Position, &vertices[b].Position, sizeof(XMFLOAT3)); });
+
+		std::vector<XMFLOAT3> sums(vertices.size(), { 0.f, 0.f, 0.f });
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t + 2]].Position);
+			XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+			for (size_t k = 0; k < 3; k++)
+			{
+				auto& sum = sums[group[indices[t + k]]];
+				XMStoreFloat3(&sum, XMVectorAdd(XMLoadFloat3(&sum), normal));
+			}
+		}
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			XMStoreFloat3(&vertices[v].Normal, XMVector3Normalize(XMLoadFloat3(&sums[group[v]])));
+		}
+	}
+
+	// Any unit vector perpendicular to normal, for vertices without a usable UV direction
+	XMVECTOR GetPerpendicular(XMVECTOR normal)
+	{
+		XMVECTOR axis = fabsf(XMVectorGetX(normal)) < 0.9f ? XMVectorSet(1.f, 0.f, 0.f, 0.f) : XMVectorSet(0.f, 1.f, 0.f, 0.f);
+		return XMVector3Normalize(XMVector3Cross(normal, axis));
+	}
+
+	// Unit length unless every component is within FLT_MIN of zero, the vector is then left as is like in MikkTSpace
+	XMVECTOR NormalizeNonZero(XMVECTOR vector)
+	{
+		return XMVector3LessOrEqual(XMVectorAbs(vector), XMVectorReplicate(FLT_MIN)) ? vector : XMVector3Normalize(vector);
+	}
+
+	XMVECTOR Project(XMVECTOR vector, XMVECTOR normal)
+	{
+		return XMVectorSubtract(vector, XMVectorMultiply(normal, XMVector3Dot(normal, vector)));
+	}
+
+	void GenerateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		// Unit tangent of every triangle and its UV handedness, 0 when its UVs are degenerate
+		size_t triangleCount = indices.size() / 3;
+		std::vector<XMFLOAT3> tangents(triangleCount, { 0.f, 0.f, 0.f });
+		std::vector<int8_t> handedness(triangleCount, 0);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const auto& v0 = vertices[indices[t * 3]];
+			const auto& v1 = vertices[indices[t * 3 + 1]];
+			const auto& v2 = vertices[indices[t * 3 + 2]];
+			float du1 = v1.UV.x - v0.UV.x, dv1 = v1.UV.y - v0.UV.y;
+			float du2 = v2.UV.x - v0.UV.x, dv2 = v2.UV.y - v0.UV.y;
+			float det = du1 * dv2 - du2 * dv1;
+			if (!std::isnormal(det)) continue;
+
+			XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&v1.Position), XMLoadFloat3(&v0.Position));
+			XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&v2.Position), XMLoadFloat3(&v0.Position));
+			handedness[t] = det < 0.f ? -1 : 1;
+			XMVECTOR tangent = XMVectorSubtract(XMVectorScale(e1, dv2), XMVectorScale(e2, dv1));
+			XMStoreFloat3(&tangents[t], XMVectorScale(NormalizeNonZero(tangent), handedness[t]));
+		}
+
+		// The triangle across the edge from every corner to the next. Like MikkTSpace, only an edge in the other direction
+		// matches, so neighbours are consistently wound and share both vertices, which the weld made equal in every attribute.
+		auto next = [](size_t corner) { return corner - corner % 3 + (corner % 3 + 1) % 3; };
+		std::vector<std::pair<uint64_t, uint32_t>> edges(triangleCount * 3);
+		for (size_t c = 0; c < edges.size(); c++)
+		{
+			edges[c] = { uint64_t(indices[c]) << 32 | indices[next(c)], uint32_t(c) };
+		}
+		std::sort(edges.begin(), edges.end());
+		std::vector<uint32_t> neighbours(edges.size(), m_None);
+		for (auto [edge, corner] : edges)
+		{
+			if (neighbours[corner] != m_None) continue;
+			uint64_t reverse = edge << 32 | edge >> 32;
+			for (auto match = std::lower_bound(edges.begin(), edges.end(), std::pair(reverse, 0u)); match != edges.end() && match->first == reverse; match++)
+			{
+				if (neighbours[match->second] != m_None || match->second / 3 == corner / 3) continue;
+				neighbours[corner] = match->second / 3;
+				neighbours[match->second] = corner / 3;
+				break;
+			}
+		}
+
+		// Around each vertex, the corners reached through those neighbours without changing handedness share a tangent.
+		// Triangles with degenerate UVs don't start a group, they take the handedness of the first one that reaches them.
+		struct Group
+		{
+			uint32_t Vertex;
+			int8_t Sign;
+		};
+		std::vector<Group> groups;
+		std::vector<uint32_t> cornerGroups(edges.size(), m_None);
+		std::vector<bool> valid(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			valid[t] = handedness[t] != 0;
+		}
+		std::vector<uint32_t> stack;
+		for (size_t c = 0; c < cornerGroups.size(); c++)
+		{
+			if (!valid[c / 3] || cornerGroups[c] != m_None) continue;
+
+			uint32_t group = uint32_t(groups.size());
+			uint32_t vertex = indices[c];
+			groups.push_back({ vertex, handedness[c / 3] });
+			stack.push_back(uint32_t(c / 3));
+			while (stack.size())
+			{
+				uint32_t t = stack.back();
+				stack.pop_back();
+				uint32_t corner = t * 3 + (indices[t * 3] == vertex ? 0 : indices[t * 3 + 1] == vertex ? 1 : 2);
+				if (cornerGroups[corner] != m_None) continue;
+				if (!valid[t] && cornerGroups[t * 3] == m_None && cornerGroups[t * 3 + 1] == m_None && cornerGroups[t * 3 + 2] == m_None)
+				{
+					handedness[t] = groups[group].Sign;
+				}
+				if (handedness[t] != groups[group].Sign) continue;
+
+				cornerGroups[corner] = group;
+				// The edges leaving and entering the corner, in the order MikkTSpace recurses into them
+				uint32_t previous = uint32_t(corner % 3 ? corner - 1 : corner + 2);
+				if (neighbours[previous] != m_None) stack.push_back(neighbours[previous]);
+				if (neighbours[corner] != m_None) stack.push_back(neighbours[corner]);
+			}
+		}
+
+		// Each valid corner's triangle tangent projected onto the vertex normal's plane, weighted by the corner's angle
+		// in that plane
+		std::vector<XMFLOAT3> sums(groups.size(), { 0.f, 0.f, 0.f });
+		for (size_t c = 0; c < cornerGroups.size(); c++)
+		{
+			uint32_t group = cornerGroups[c];
+			if (group == m_None || !valid[c / 3]) continue;
+
+			const auto& vertex = vertices[indices[c]];
+			XMVECTOR normal = XMLoadFloat3(&vertex.Normal);
+			XMVECTOR position = XMLoadFloat3(&vertex.Position);
+			XMVECTOR tangent = NormalizeNonZero(Project(XMLoadFloat3(&tangents[c / 3]), normal));
+			XMVECTOR edge1 = NormalizeNonZero(Project(XMVectorSubtract(XMLoadFloat3(&vertices[indices[next(c)]].Position), position), normal));
+			XMVECTOR edge2 = NormalizeNonZero(Project(XMVectorSubtract(XMLoadFloat3(&vertices[indices[next(next(c))]].Position), position), normal));
+			float angle = acosf(std::clamp(XMVectorGetX(XMVector3Dot(edge1, edge2)), -1.f, 1.f));
+			XMStoreFloat3(&sums[group], XMVectorAdd(XMLoadFloat3(&sums[group]), XMVectorScale(tangent, angle)));
+		}
+
+		// A vertex keeps its first group's frame, other groups with a different one get a copy of it
+		auto setFrame = [&](Vertex& vertex, XMVECTOR tangent, int8_t sign)
+		{
+			XMVECTOR normal = XMLoadFloat3(&vertex.Normal);
+			XMStoreFloat3(&vertex.Tangent, tangent);
+			XMStoreFloat3(&vertex.Bitangent, XMVectorScale(XMVector3Cross(normal, tangent), sign < 0 ? -1.f : 1.f));
+		};
+		uint32_t vertexCount = uint32_t(vertices.size());
+		std::vector<uint32_t> firstGroups(vertexCount, m_None);
+		std::vector<uint32_t> nextGroups(groups.size(), m_None);
+		std::vector<uint32_t> groupVertices(groups.size());
+		for (uint32_t g = 0; g < groups.size(); g++)
+		{
+			uint32_t v = groups[g].Vertex;
+			XMVECTOR normal = XMLoadFloat3(&vertices[v].Normal);
+			XMVECTOR tangent = NormalizeNonZero(XMLoadFloat3(&sums[g]));
+			if (XMVectorGetX(XMVector3LengthSq(tangent)) < 0.5f) tangent = GetPerpendicular(normal);
+			Vertex frame = vertices[v];
+			setFrame(frame, tangent, groups[g].Sign);
+
+			uint32_t* link = &firstGroups[v];
+			groupVertices[g] = m_None;
+			for (; *link != m_None; link = &nextGroups[*link])
+			{
+				if (!memcmp(&vertices[groupVertices[*link]], &frame, sizeof(Vertex))) groupVertices[g] = groupVertices[*link];
+			}
+			*link = g;
+			if (groupVertices[g] != m_None) continue;
+
+			groupVertices[g] = firstGroups[v] == g ? v : uint32_t(vertices.size());
+			if (groupVertices[g] == v) vertices[v] = frame;
+			else vertices.push_back(frame);
+		}
+		for (size_t c = 0; c < cornerGroups.size(); c++)
+		{
+			if (cornerGroups[c] != m_None) indices[c] = groupVertices[cornerGroups[c]];
+		}
+
+		// Only used by triangles with degenerate UVs that no group reached
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			if (firstGroups[v] == m_None) setFrame(vertices[v], GetPerpendicular(XMLoadFloat3(&vertices[v].Normal)), 1);
+		}
+	}
+
+	void Triangulate(std::span<const Vertex> vertices, std::span<const uint32_t> polygon, std::vector<uint32_t>& indices)
+	{
+		uint32_t count = uint32_t(polygon.size());
+		if (count < 3) return;
+		if (count == 3)
+		{
+			indices.insert(indices.end(), polygon.begin(), polygon.end());
+			return;
+		}
+
+		// Twice the area along the normal, counterclockwise around it, which is sound for polygons that aren't planar
+		auto position = [&](uint32_t i) { return XMLoadFloat3(&vertices[polygon[i]].Position); };
+		XMVECTOR origin = position(0);
+		XMVECTOR normal = XMVectorZero();
+		for (uint32_t i = 1; i + 1 < count; i++)
+		{
+			normal = XMVectorAdd(normal, XMVector3Cross(XMVectorSubtract(position(i), origin), XMVectorSubtract(position(i + 1), origin)));
+		}
+		auto fan = [&](uint32_t first)
+		{
+			for (uint32_t k = 2; k < count; k++)
+			{
+				indices.insert(indices.end(), { polygon[first], polygon[(first + k - 1) % count], polygon[(first + k) % count] });
+			}
+		};
+		if (XMVector3Equal(normal, XMVectorZero()))
+		{
+			fan(0);
+			return;
+		}
+
+		// Quads, most polygons that aren't triangles, have at most one reflex corner and are split through it
+		if (count == 4)
+		{
+			uint32_t reflex = 0;
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				XMVECTOR corner = position(i);
+				XMVECTOR turn = XMVector3Cross(XMVectorSubtract(corner, position((i + 3) % 4)), XMVectorSubtract(position((i + 1) % 4), corner));
+				if (XMVectorGetX(XMVector3Dot(turn, normal)) < 0.f) reflex = i;
+			}
+			fan(reflex);
+			return;
+		}
+
+		// Ear clipping in the plane of the normal's largest axis, turned so the polygon is counterclockwise in it
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal);
+		uint32_t axis = fabsf(n.x) > fabsf(n.y) ? (fabsf(n.x) > fabsf(n.z) ? 0 : 2) : (fabsf(n.y) > fabsf(n.z) ? 1 : 2);
+		uint32_t u = (axis + 1) % 3, v = (axis + 2) % 3;
+		if ((&n.x)[axis] < 0.f) std::swap(u, v);
+		std::vector<XMFLOAT2> points(count);
+		std::vector<uint32_t> previous(count), following(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const XMFLOAT3& p = vertices[polygon[i]].Position;
+			points[i] = { (&p.x)[u], (&p.x)[v] };
+			previous[i] = (i + count - 1) % count;
+			following[i] = (i + 1) % count;
+		}
+		auto area = [&](uint32_t a, uint32_t b, const XMFLOAT2& p)
+		{
+			return (points[b].x - points[a].x) * (p.y - points[a].y) - (points[b].y - points[a].y) * (p.x - points[a].x);
+		};
+		auto same = [&](uint32_t a, uint32_t b) { return points[a].x == points[b].x && points[a].y == points[b].y; };
+
+		// A convex corner is an ear when no other corner is inside or on its triangle, except copies of its own corners.
+		// When there is none, the polygon intersects itself and the corner is clipped anyway.
+		uint32_t current = 0;
+		for (uint32_t remaining = count, attempts = 0; remaining > 3;)
+		{
+			uint32_t a = previous[current], c = following[current];
+			bool ear = area(a, current, points[c]) > 0.f;
+			for (uint32_t p = following[c]; ear && p != a; p = following[p])
+			{
+				if (same(p, a) || same(p, current) || same(p, c)) continue;
+				ear = area(a, current, points[p]) < 0.f || area(current, c, points[p]) < 0.f || area(c, a, points[p]) < 0.f;
+			}
+			if (!ear && ++attempts < remaining)
+			{
+				current = c;
+				continue;
+			}
+
+			indices.insert(indices.end(), { polygon[a], polygon[current], polygon[c] });
+			following[a] = c;
+			previous[c] = a;
+			current = c;
+			remaining--;
+			attempts = 0;
+		}
+		indices.insert(indices.end(), { polygon[previous[current]], polygon[current], polygon[following[current]] });
+	}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "SceneData.h"
+
+// Per-mesh vertex processing done after assimp hands over the raw meshes, in place of its welding, normal and tangent
+// steps. Every function works on one mesh, the importer runs them over all meshes in parallel.
+namespace Geometry
+{
+
+	// Merges vertices that are identical in every attribute, in first use order, and drops unreferenced vertices and
+	// triangles that collapse. indices is a triangle list into vertices.
+	void Weld(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Smooth normals: the average of the unit face normals of every triangle touching a vertex's position.
+	// Triangles are clockwise, as they are after assimp's left handed conversion.
+	void GenerateNormals(std::span<Vertex> vertices, std::span<const uint32_t> indices);
+
+	// MikkTSpace tangent frames from the UVs, the ones normal map bakers expect. Around each vertex, the triangles connected
+	// through shared edges with the same UV handedness form a group, seams and flips of handedness start new ones. A group's
+	// tangent is the sum of its triangles' tangents, each projected onto the vertex normal's plane, normalized and weighted
+	// by the corner's angle in that plane. The bitangent is the normal cross the tangent with the group's handedness.
+	// Vertices in several groups with different frames are split.
+	void GenerateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Appends the triangles of one polygon, indices into vertices, with the polygon's winding. Concave polygons are ear
+	// clipped so no triangle covers what is outside of them.
+	void Triangulate(std::span<const Vertex> vertices, std::span<const uint32_t> polygon, std::vector<uint32_t>& indices);
+
+}
@@ -0,0 +1,814 @@
+#include "GltfLoader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+
+#include "Hash.h"
+#include "Jobs.h"
+
+using namespace DirectX;
+
+namespace GltfLoader
+{
+
+	// Just enough JSON for glTF. Objects keep their keys in Keys, parallel to Items.
+	struct Json
+	{
+		enum class Type : uint8_t
+		{
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type Kind = Type::Null;
+		double Number = 0.0;
+		std::string String;
+		std::vector<Json> Items;
+		std::vector<std::string> Keys;
+
+		const Json* Find(std::string_view key) const
+		{
+			for (size_t i = 0; i < Keys.size(); i++)
+			{
+				if (Keys[i] == key) return &Items[i];
+			}
+			return nullptr;
+		}
+
+		double GetNumber(std::string_view key, double fallback) const
+		{
+			auto value = Find(key);
+			return value && value->Kind == Type::Number ? value->Number : fallback;
+		}
+
+		// -1 when missing
+		int32_t GetIndex(std::string_view key) const
+		{
+			auto value = Find(key);
+			return value && value->Kind == Type::Number && value->Number >= 0.0 && value->Number < 2147483648.0 ? int32_t(value->Number) : -1;
+		}
+
+		// Empty for anything but an array
+		const std::vector<Json>& GetArray(std::string_view key) const
+		{
+			static const std::vector<Json> empty;
+			auto value = Find(key);
+			return value && value->Kind == Type::Array ? value->Items : empty;
+		}
+	};
+
+	// Element i of an array, a null value when out of range
+	const Json& GetElement(const std::vector<Json>& array, int32_t i)
+	{
+		static const Json null;
+		return i >= 0 && size_t(i) < array.size() ? array[i] : null;
+	}
+
+	[[noreturn]] void Fail(const char* message)
+	{
+		throw std::runtime_error(std::string("Invalid glTF file: ") + message);
+	}
+
+	const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+		return p;
+	}
+
+	void AppendUtf8(std::string& string, uint32_t code)
+	{
+		if (code < 0x80) string += char(code);
+		else if (code < 0x800) string += { char(0xc0 | code >> 6), char(0x80 | (code & 0x3f)) };
+		else if (code < 0x10000) string += { char(0xe0 | code >> 12), char(0x80 | (code >> 6 & 0x3f)), char(0x80 | (code & 0x3f)) };
+		else string += { char(0xf0 | code >> 18), char(0x80 | (code >> 12 & 0x3f)), char(0x80 | (code >> 6 & 0x3f)), char(0x80 | (code & 0x3f)) };
+	}
+
+	uint32_t ParseHex(const char*& p, const char* end)
+	{
+		if (end - p < 4) Fail("truncated escape");
+		uint32_t code = 0;
+		auto result = std::from_chars(p, p + 4, code, 16);
+		if (result.ptr != p + 4) Fail("bad escape");
+		p += 4;
+		return code;
+	}
+
+	std::string ParseString(const char*& p, const char* end)
+	{
+		std::string string;
+		for (p++; p < end && *p != '"'; p++)
+		{
+			if (*p != '\\')
+			{
+				string += *p;
+				continue;
+			}
+
+			if (++p == end) break;
+			switch (*p)
+			{
+			case 'b': string += '\b'; break;
+			case 'f': string += '\f'; break;
+			case 'n': string += '\n'; break;
+			case 'r': string += '\r'; break;
+			case 't': string += '\t'; break;
+			case 'u':
+			{
+				p++;
+				uint32_t code = ParseHex(p, end);
+				if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+				{
+					p += 2;
+					code = 0x10000 + ((code - 0xd800) << 10) + (ParseHex(p, end) - 0xdc00);
+				}
+				AppendUtf8(string, code);
+				p--;
+				break;
+			}
+			default: string += *p; break;
+			}
+		}
+		if (p == end) Fail("unterminated string");
+		p++;
+		return string;
+	}
+
+	Json ParseValue(const char*& p, const char* end, uint32_t depth)
+	{
+		if (depth > 256) Fail("nested too deeply");
+
+		Json value;
+		p = SkipSpaces(p, end);
+		if (p == end) Fail("unexpected end");
+		if (*p == '{' || *p == '[')
+		{
+			bool object = *p == '{';
+			char close = object ? '}' : ']';
+			value.Kind = object ? Json::Type::Object : Json::Type::Array;
+			p = SkipSpaces(p + 1, end);
+			if (p < end && *p == close)
+			{
+				p++;
+				return value;
+			}
+
+			while (true)
+			{
+				if (object)
+				{
+					p = SkipSpaces(p, end);
+					if (p == end || *p != '"') Fail("expected a key");
+					value.Keys.push_back(ParseString(p, end));
+					p = SkipSpaces(p, end);
+					if (p == end || *p != ':') Fail("expected ':'");
+					p++;
+				}
+				value.Items.push_back(ParseValue(p, end, depth + 1));
+				p = SkipSpaces(p, end);
+				if (p < end && *p == ',')
+				{
+					p++;
+					continue;
+				}
+				if (p == end || *p != close) Fail("expected ',' or the end of a list");
+				p++;
+				return value;
+			}
+		}
+		if (*p == '"')
+		{
+			value.Kind = Json::Type::String;
+			value.String = ParseString(p, end);
+		}
+		else if (end - p >= 4 && !memcmp(p, "true", 4))
+		{
+			value.Kind = Json::Type::Bool;
+			value.Number = 1.0;
+			p += 4;
+		}
+		else if (end - p >= 5 && !memcmp(p, "false", 5))
+		{
+			value.Kind = Json::Type::Bool;
+			p += 5;
+		}
+		else if (end - p >= 4 && !memcmp(p, "null", 4))
+		{
+			p += 4;
+		}
+		else
+		{
+			// Locale independent, unlike strtod
+			auto result = std::from_chars(p, end, value.Number);
+			if (result.ec != std::errc() && result.ec != std::errc::result_out_of_range) Fail("unexpected character");
+			value.Kind = Json::Type::Number;
+			p = result.ptr;
+		}
+		return value;
+	}
+
+	std::vector<uint8_t> DecodeBase64(std::string_view text)
+	{
+		std::vector<uint8_t> bytes;
+		bytes.reserve(text.size() / 4 * 3);
+		uint32_t bits = 0;
+		uint32_t count = 0;
+		for (char c : text)
+		{
+			uint32_t value;
+			if (c >= 'A' && c <= 'Z') value = uint32_t(c - 'A');
+			else if (c >= 'a' && c <= 'z') value = uint32_t(c - 'a' + 26);
+			else if (c >= '0' && c <= '9') value = uint32_t(c - '0' + 52);
+			else if (c == '+' || c == '-') value = 62;
+			else if (c == '/' || c == '_') value = 63;
+			else break;
+
+			bits = bits << 6 | value;
+			if (++count == 4)
+			{
+				bytes.insert(bytes.end(), { uint8_t(bits >> 16), uint8_t(bits >> 8), uint8_t(bits) });
+				bits = count = 0;
+			}
+		}
+		if (count == 3) bytes.insert(bytes.end(), { uint8_t(bits >> 10), uint8_t(bits >> 2) });
+		else if (count == 2) bytes.push_back(uint8_t(bits >> 4));
+		return bytes;
+	}
+
+	bool IsDataUri(const std::string& uri)
+	{
+		return uri.starts_with("data:");
+	}
+
+	std::vector<uint8_t> DecodeDataUri(const std::string& uri)
+	{
+		size_t comma = uri.find(',');
+		if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) Fail("only base64 data URIs are supported");
+		return DecodeBase64(std::string_view(uri).substr(comma + 1));
+	}
+
+	// Relative URIs are percent encoded
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string path;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			uint32_t code;
+			if (uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, code, 16).ptr == uri.data() + i + 3)
+			{
+				path += char(code);
+				i += 2;
+			}
+			else path += uri[i];
+		}
+		return path;
+	}
+
+	struct BufferView
+	{
+		std::span<const uint8_t> Bytes;
+		uint32_t Stride = 0;
+	};
+
+	// Elements of Count vectors, Stride bytes apart. Data is null for accessors without a buffer view, which are all zero.
+	struct Accessor
+	{
+		const uint8_t* Data = nullptr;
+		uint32_t Count = 0;
+		uint32_t Stride = 0;
+		uint32_t ComponentType = 0;
+		uint32_t Components = 0;
+		bool Normalized = false;
+	};
+
+	constexpr uint32_t m_Byte = 5120;
+	constexpr uint32_t m_UnsignedByte = 5121;
+	constexpr uint32_t m_Short = 5122;
+	constexpr uint32_t m_UnsignedShort = 5123;
+	constexpr uint32_t m_UnsignedInt = 5125;
+	constexpr uint32_t m_Float = 5126;
+
+	uint32_t GetComponentSize(uint32_t type)
+	{
+		switch (type)
+		{
+		case m_Byte: case m_UnsignedByte: return 1;
+		case m_Short: case m_UnsignedShort: return 2;
+		case m_UnsignedInt: case m_Float: return 4;
+		default: Fail("unknown accessor component type");
+		}
+	}
+
+	Accessor GetAccessor(const Json& root, const std::vector<BufferView>& views, int32_t index)
+	{
+		const auto& json = GetElement(root.GetArray("accessors"), index);
+		if (json.Kind != Json::Type::Object) Fail("missing accessor");
+		if (json.Find("sparse")) Fail("sparse accessors are not supported");
+
+		static const std::pair<std::string_view, uint32_t> types[] = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 } };
+		auto type = json.Find("type");
+		auto it = std::find_if(std::begin(types), std::end(types), [&](const auto& entry) { return type && type->String == entry.first; });
+		if (it == std::end(types)) Fail("unsupported accessor type");
+
+		Accessor accessor;
+		accessor.Count = uint32_t(json.GetNumber("count", 0.0));
+		accessor.ComponentType = uint32_t(json.GetNumber("componentType", 0.0));
+		accessor.Components = it->second;
+		auto normalized = json.Find("normalized");
+		accessor.Normalized = normalized && normalized->Number != 0.0;
+		uint32_t size = GetComponentSize(accessor.ComponentType) * accessor.Components;
+
+		int32_t view = json.GetIndex("bufferView");
+		if (view < 0) return accessor;
+		if (size_t(view) >= views.size()) Fail("missing buffer view");
+
+		const auto& bytes = views[view].Bytes;
+		accessor.Stride = views[view].Stride ? views[view].Stride : size;
+		uint64_t offset = uint64_t(json.GetNumber("byteOffset", 0.0));
+		if (accessor.Count && offset + uint64_t(accessor.Stride) * (accessor.Count - 1) + size > bytes.size())
+		{
+			Fail("accessor is larger than its buffer view");
+		}
+		accessor.Data = bytes.data() + offset;
+		return accessor;
+	}
+
+	float ReadComponent(const uint8_t* p, uint32_t type, bool normalized)
+	{
+		switch (type)
+		{
+		case m_Byte:
+		{
+			int8_t value = int8_t(*p);
+			return normalized ? (std::max)(value / 127.f, -1.f) : float(value);
+		}
+		case m_UnsignedByte:
+			return normalized ? *p / 255.f : float(*p);
+		case m_Short:
+		{
+			int16_t value;
+			memcpy(&value, p, 2);
+			return normalized ? (std::max)(value / 32767.f, -1.f) : float(value);
+		}
+		case m_UnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, p, 2);
+			return normalized ? value / 65535.f : float(value);
+		}
+		case m_UnsignedInt:
+		{
+			uint32_t value;
+			memcpy(&value, p, 4);
+			return float(value);
+		}
+		default:
+		{
+			float value;
+			memcpy(&value, p, 4);
+			return value;
+		}
+		}
+	}
+
+	// Calls write(i, vector) for every element. Float data is loaded from the mapping as it is, with any stride,
+	// quantized data (KHR_mesh_quantization) is converted a component at a time. Returns whether it was loaded directly.
+	template<typename F>
+	bool ReadVectors(const Accessor& accessor, F&& write)
+	{
+		if (!accessor.Data)
+		{
+			for (uint32_t i = 0; i < accessor.Count; i++) write(i, XMVectorZero());
+			return false;
+		}
+
+		const uint8_t* data = accessor.Data;
+		if (accessor.ComponentType == m_Float && accessor.Components >= 2)
+		{
+			if (accessor.Components == 2)
+			{
+				for (uint32_t i = 0; i < accessor.Count; i++) write(i, XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(data + size_t(i) * accessor.Stride)));
+			}
+			else
+			{
+				for (uint32_t i = 0; i < accessor.Count; i++) write(i, XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(data + size_t(i) * accessor.Stride)));
+			}
+			return true;
+		}
+
+		uint32_t componentSize = GetComponentSize(accessor.ComponentType);
+		uint32_t components = (std::min)(accessor.Components, 4u);
+		for (uint32_t i = 0; i < accessor.Count; i++)
+		{
+			float values[4] = {};
+			for (uint32_t c = 0; c < components; c++)
+			{
+				values[c] = ReadComponent(data + size_t(i) * accessor.Stride + c * componentSize, accessor.ComponentType, accessor.Normalized);
+			}
+			write(i, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(values)));
+		}
+		return false;
+	}
+
+	// Triangles of one primitive as a clockwise list, empty for points and lines. Tightly packed 32 bit indices are
+	// copied as a block.
+	std::vector<uint32_t> ReadTriangles(const Json& root, const std::vector<BufferView>& views, const Json& primitive, uint32_t vertexCount,
+		bool& direct)
+	{
+		std::vector<uint32_t> raw;
+		int32_t indices = primitive.GetIndex("indices");
+		if (indices >= 0)
+		{
+			auto accessor = GetAccessor(root, views, indices);
+			if (accessor.Components != 1 || accessor.ComponentType == m_Float || accessor.ComponentType == m_Byte ||
+				accessor.ComponentType == m_Short)
+			{
+				Fail("indices must be unsigned scalars");
+			}
+
+			raw.resize(accessor.Count);
+			uint32_t componentSize = GetComponentSize(accessor.ComponentType);
+			direct = accessor.Data && accessor.ComponentType == m_UnsignedInt && accessor.Stride == 4;
+			if (direct) memcpy(raw.data(), accessor.Data, raw.size() * 4);
+			else if (accessor.Data)
+			{
+				for (uint32_t i = 0; i < accessor.Count; i++)
+				{
+					const uint8_t* p = accessor.Data + size_t(i) * accessor.Stride;
+					if (componentSize == 1) raw[i] = *p;
+					else if (componentSize == 2)
+					{
+						uint16_t index;
+						memcpy(&index, p, 2);
+						raw[i] = index;
+					}
+					else memcpy(&raw[i], p, 4);
+				}
+			}
+
+			for (uint32_t index : raw)
+			{
+				if (index >= vertexCount) Fail("index out of range");
+			}
+		}
+		else
+		{
+			raw.resize(vertexCount);
+			for (uint32_t i = 0; i < vertexCount; i++) raw[i] = i;
+		}
+
+		// The handedness change turns counter clockwise into clockwise by swapping the last two corners
+		std::vector<uint32_t> triangles;
+		uint32_t mode = uint32_t(primitive.GetNumber("mode", 4.0));
+		if (mode == 4)
+		{
+			triangles = std::move(raw);
+			triangles.resize(triangles.size() / 3 * 3);
+			for (size_t t = 0; t < triangles.size(); t += 3) std::swap(triangles[t + 1], triangles[t + 2]);
+		}
+		else if (mode == 5)
+		{
+			for (size_t i = 0; i + 2 < raw.size(); i++)
+			{
+				triangles.insert(triangles.end(), { raw[i], raw[i + 2 - i % 2], raw[i + 1 + i % 2] });
+			}
+		}
+		else if (mode == 6)
+		{
+			for (size_t i = 1; i + 1 < raw.size(); i++)
+			{
+				triangles.insert(triangles.end(), { raw[0], raw[i + 1], raw[i] });
+			}
+		}
+		return triangles;
+	}
+
+	// Local transform as a DirectXMath row vector matrix, still right handed
+	XMMATRIX GetLocalTransform(const Json& node)
+	{
+		const auto& matrix = node.GetArray("matrix");
+		if (matrix.size() == 16)
+		{
+			// Column major column vector is the same memory as row major row vector
+			XMFLOAT4X4 values;
+			for (size_t i = 0; i < 16; i++) values.m[i / 4][i % 4] = float(matrix[i].Number);
+			return XMLoadFloat4x4(&values);
+		}
+
+		auto getVector = [&](std::string_view key, XMVECTOR fallback)
+		{
+			const auto& values = node.GetArray(key);
+			float v[4];
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(v), fallback);
+			for (size_t i = 0; i < (std::min)(values.size(), size_t(4)); i++) v[i] = float(values[i].Number);
+			return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(v));
+		};
+		XMVECTOR scale = getVector("scale", XMVectorSplatOne());
+		XMVECTOR rotation = getVector("rotation", XMQuaternionIdentity());
+		XMVECTOR translation = getVector("translation", XMVectorZero());
+		return XMMatrixScalingFromVector(scale) * XMMatrixRotationQuaternion(rotation) * XMMatrixTranslationFromVector(translation);
+	}
+
+	bool IsGltf(const std::string& path)
+	{
+		auto extension = std::filesystem::u8path(path).extension().u8string();
+		std::string lower;
+		for (auto c : extension) lower += char(c | 0x20);
+		return lower == ".gltf" || lower == ".glb";
+	}
+
+	SourceScene Load(const std::string& path, ImportStats& stats)
+	{
+		SourceScene scene;
+		MappedFile file(path);
+		auto filePath = std::filesystem::u8path(path);
+		auto directory = filePath.parent_path();
+		auto fileName = filePath.filename().u8string();
+		std::string name(fileName.begin(), fileName.end());
+
+		Json root;
+		std::vector<BufferView> views;
+		{
+			ScopedStage stage(stats, "glTF parse");
+
+			// A .glb is a JSON chunk and an optional binary chunk that is the first buffer
+			std::string_view text(reinterpret_cast<const char*>(file.Data), file.Size);
+			std::span<const uint8_t> binary;
+			uint32_t header[3] = {};
+			if (file.Size >= 12) memcpy(header, file.Data, 12);
+			if (header[0] == 0x46546c67)
+			{
+				if (header[1] != 2) Fail("only version 2 is supported");
+				text = {};
+				size_t end = (std::min)(size_t(header[2]), file.Size);
+				for (size_t offset = 12; offset + 8 <= end;)
+				{
+					uint32_t chunk[2];
+					memcpy(chunk, file.Data + offset, 8);
+					offset += 8;
+					if (chunk[0] > end - offset) Fail("truncated chunk");
+					if (chunk[1] == 0x4e4f534a && text.empty()) text = { reinterpret_cast<const char*>(file.Data + offset), chunk[0] };
+					else if (chunk[1] == 0x004e4942 && binary.empty()) binary = { file.Data + offset, chunk[0] };
+					offset += (size_t(chunk[0]) + 3) & ~size_t(3);
+				}
+			}
+
+			const char* p = text.data();
+			root = ParseValue(p, text.data() + text.size(), 0);
+			if (root.Kind != Json::Type::Object) Fail("the root isn't an object");
+
+			// Moving the mappings and decoded buffers into the scene keeps what the spans point to
+			const auto& bufferList = root.GetArray("buffers");
+			std::vector<std::span<const uint8_t>> buffers(bufferList.size());
+			for (size_t b = 0; b < bufferList.size(); b++)
+			{
+				auto uri = bufferList[b].Find("uri");
+				if (!uri) buffers[b] = binary;
+				else if (IsDataUri(uri->String)) buffers[b] = scene.Buffers.emplace_back(DecodeDataUri(uri->String));
+				else
+				{
+					auto bufferPath = (directory / std::filesystem::u8path(DecodeUri(uri->String))).u8string();
+					const auto& mapped = scene.Files.emplace_back(std::string(bufferPath.begin(), bufferPath.end()));
+					buffers[b] = { mapped.Data, mapped.Size };
+					scene.Dependencies.push_back({ std::string(bufferPath.begin(), bufferPath.end()), Hash::Bytes(mapped.Data, mapped.Size) });
+				}
+
+				uint64_t length = uint64_t(bufferList[b].GetNumber("byteLength", 0.0));
+				if (length > buffers[b].size()) Fail("buffer is shorter than its byteLength");
+				buffers[b] = buffers[b].first(size_t(length));
+			}
+
+			for (const auto& view : root.GetArray("bufferViews"))
+			{
+				int32_t buffer = view.GetIndex("buffer");
+				if (buffer < 0 || size_t(buffer) >= buffers.size()) Fail("missing buffer");
+				uint64_t offset = uint64_t(view.GetNumber("byteOffset", 0.0));
+				uint64_t length = uint64_t(view.GetNumber("byteLength", 0.0));
+				if (offset + length > buffers[buffer].size()) Fail("buffer view is larger than its buffer");
+				views.push_back({ buffers[buffer].subspan(size_t(offset), size_t(length)), uint32_t(view.GetNumber("byteStride", 0.0)) });
+			}
+		}
+
+		// Images in a buffer view or a data URI are decoded by the texture stage from where they are, under a name
+		// of their own so the stage can tell them apart
+		const auto& images = root.GetArray("images");
+		std::vector<SourceImage> sourceImages(images.size());
+		uint32_t embeddedImages = 0;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			auto& image = sourceImages[i];
+			auto uri = images[i].Find("uri");
+			int32_t view = images[i].GetIndex("bufferView");
+			if (uri && !IsDataUri(uri->String))
+			{
+				image.Path = DecodeUri(uri->String);
+				continue;
+			}
+
+			if (uri) image.Bytes = scene.Buffers.emplace_back(DecodeDataUri(uri->String));
+			else if (view >= 0 && size_t(view) < views.size()) image.Bytes = views[view].Bytes;
+			else continue;
+			image.Path = name + "#" + std::to_string(i);
+			embeddedImages++;
+		}
+
+		auto getImage = [&](const Json* textureInfo)
+		{
+			if (!textureInfo) return SourceImage();
+			const auto& texture = GetElement(root.GetArray("textures"), textureInfo->GetIndex("index"));
+			int32_t source = texture.GetIndex("source");
+			return source >= 0 && size_t(source) < sourceImages.size() ? sourceImages[source] : SourceImage();
+		};
+		auto getColor = [](const Json* factor, XMFLOAT3 fallback)
+		{
+			if (!factor || factor->Items.size() < 3) return fallback;
+			return XMFLOAT3{ float(factor->Items[0].Number), float(factor->Items[1].Number), float(factor->Items[2].Number) };
+		};
+
+		// Base color as assimp maps it, the specular color only comes from the specular glossiness extension
+		for (const auto& from : root.GetArray("materials"))
+		{
+			auto& material = scene.Materials.emplace_back();
+			const Json* pbr = from.Find("pbrMetallicRoughness");
+			const Json* extensions = from.Find("extensions");
+			const Json* glossiness = extensions ? extensions->Find("KHR_materials_pbrSpecularGlossiness") : nullptr;
+			if (glossiness)
+			{
+				material.Albedo = getImage(glossiness->Find("diffuseTexture"));
+				material.Diffuse = getColor(glossiness->Find("diffuseFactor"), { 1.f, 1.f, 1.f });
+				material.SpecularColor = getColor(glossiness->Find("specularFactor"), { 1.f, 1.f, 1.f });
+			}
+			else
+			{
+				material.Albedo = getImage(pbr ? pbr->Find("baseColorTexture") : nullptr);
+				material.Diffuse = getColor(pbr ? pbr->Find("baseColorFactor") : nullptr, { 1.f, 1.f, 1.f });
+			}
+		}
+
+		// Every triangle primitive becomes a mesh, primitives without a material get a default one
+		struct Primitive
+		{
+			const Json* Source;
+			uint32_t Material;
+		};
+		const auto& meshList = root.GetArray("meshes");
+		std::vector<Primitive> primitives;
+		std::vector<uint32_t> firstPrimitive;
+		uint32_t defaultMaterial = ~0u;
+		for (const auto& mesh : meshList)
+		{
+			firstPrimitive.push_back(uint32_t(primitives.size()));
+			for (const auto& primitive : mesh.GetArray("primitives"))
+			{
+				int32_t material = primitive.GetIndex("material");
+				if (material < 0 || size_t(material) >= root.GetArray("materials").size())
+				{
+					if (defaultMaterial == ~0u)
+					{
+						defaultMaterial = uint32_t(scene.Materials.size());
+						scene.Materials.emplace_back().Diffuse = { 0.6f, 0.6f, 0.6f };
+					}
+					material = int32_t(defaultMaterial);
+				}
+				primitives.push_back({ &primitive, uint32_t(material) });
+			}
+		}
+		firstPrimitive.push_back(uint32_t(primitives.size()));
+
+		std::vector<SourceMesh> meshes(primitives.size());
+		{
+			ScopedStage stage(stats, "Scene graph");
+			const auto& nodes = root.GetArray("nodes");
+			std::vector<int32_t> roots;
+			const auto& sceneList = root.GetArray("scenes");
+			if (sceneList.size())
+			{
+				int32_t index = (std::max)(root.GetIndex("scene"), 0);
+				for (const auto& node : GetElement(sceneList, index).GetArray("nodes")) roots.push_back(int32_t(node.Number));
+			}
+			else
+			{
+				std::vector<bool> isChild(nodes.size(), false);
+				for (const auto& node : nodes)
+				{
+					for (const auto& child : node.GetArray("children"))
+					{
+						if (child.Number >= 0.0 && child.Number < double(nodes.size())) isChild[size_t(child.Number)] = true;
+					}
+				}
+				for (size_t i = 0; i < nodes.size(); i++)
+				{
+					if (!isChild[i]) roots.push_back(int32_t(i));
+				}
+			}
+
+			// Conjugating with a z flip moves a right handed transform into left handed space, like assimp does
+			XMMATRIX flip = XMMatrixScaling(1.f, 1.f, -1.f);
+			struct Node
+			{
+				int32_t Index;
+				XMFLOAT4X4 Parent;
+			};
+			std::vector<Node> stack;
+			XMFLOAT4X4 identity;
+			XMStoreFloat4x4(&identity, XMMatrixIdentity());
+			for (int32_t node : roots) stack.push_back({ node, identity });
+			std::vector<bool> visited(nodes.size(), false);
+			while (stack.size())
+			{
+				auto node = stack.back();
+				stack.pop_back();
+				if (node.Index < 0 || size_t(node.Index) >= nodes.size() || visited[node.Index]) continue;
+				visited[node.Index] = true;
+
+				const auto& json = nodes[node.Index];
+				XMMATRIX world = GetLocalTransform(json) * XMLoadFloat4x4(&node.Parent);
+				XMFLOAT4X4 stored;
+				XMStoreFloat4x4(&stored, world);
+
+				int32_t mesh = json.GetIndex("mesh");
+				if (mesh >= 0 && size_t(mesh) < meshList.size())
+				{
+					XMFLOAT4X4 placement;
+					XMStoreFloat4x4(&placement, flip * world * flip);
+					for (uint32_t p = firstPrimitive[mesh]; p < firstPrimitive[mesh + 1]; p++) meshes[p].Placements.push_back(placement);
+				}
+				for (const auto& child : json.GetArray("children")) stack.push_back({ int32_t(child.Number), stored });
+			}
+
+			for (auto& mesh : meshes)
+			{
+				if (mesh.Placements.empty()) mesh.Placements.push_back(identity);
+			}
+		}
+
+		std::vector<uint8_t> directAccessors(primitives.size(), 0);
+		std::vector<uint8_t> accessorCounts(primitives.size(), 0);
+		{
+			ScopedStage stage(stats, "glTF meshes", uint32_t(primitives.size()));
+			Jobs::ParallelFor(uint32_t(primitives.size()), [&](uint32_t i)
+				{
+					stats.Step();
+					const auto& primitive = *primitives[i].Source;
+					auto& mesh = meshes[i];
+					mesh.Material = primitives[i].Material;
+
+					const Json* attributes = primitive.Find("attributes");
+					int32_t positions = attributes ? attributes->GetIndex("POSITION") : -1;
+					if (positions < 0) return;
+					int32_t normals = attributes->GetIndex("NORMAL");
+					int32_t uvs = attributes->GetIndex("TEXCOORD_0");
+
+					auto position = GetAccessor(root, views, positions);
+					mesh.Vertices.resize(position.Count);
+					XMVECTOR flipZ = XMVectorSet(1.f, 1.f, -1.f, 1.f);
+					auto read = [&](int32_t index, auto&& write)
+					{
+						auto accessor = GetAccessor(root, views, index);
+						if (accessor.Count != position.Count) Fail("attributes of different lengths");
+						directAccessors[i] += ReadVectors(accessor, write);
+						accessorCounts[i]++;
+					};
+					read(positions, [&](uint32_t v, XMVECTOR value) { XMStoreFloat3(&mesh.Vertices[v].Position, XMVectorMultiply(value, flipZ)); });
+					if (normals >= 0)
+					{
+						read(normals, [&](uint32_t v, XMVECTOR value) { XMStoreFloat3(&mesh.Vertices[v].Normal, XMVectorMultiply(value, flipZ)); });
+						mesh.HasNormals = true;
+					}
+					if (uvs >= 0)
+					{
+						read(uvs, [&](uint32_t v, XMVECTOR value) { XMStoreFloat2(&mesh.Vertices[v].UV, value); });
+						mesh.HasUVs = true;
+					}
+
+					bool direct = false;
+					mesh.Indices = ReadTriangles(root, views, primitive, position.Count, direct);
+					directAccessors[i] += direct;
+					accessorCounts[i] += primitive.GetIndex("indices") >= 0;
+				});
+		}
+
+		// Points and lines aren't drawn
+		uint32_t direct = 0;
+		uint32_t accessors = 0;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			direct += directAccessors[i];
+			accessors += accessorCounts[i];
+			if (meshes[i].Indices.size()) scene.Meshes.push_back(std::move(meshes[i]));
+		}
+		stats.Add("glTF accessors read in place", double(direct));
+		stats.Add("glTF accessors converted", double(accessors - direct));
+		stats.Add("glTF embedded images", double(embeddedImages));
+		scene.Files.push_back(std::move(file));
+		return scene;
+	}
+
+}
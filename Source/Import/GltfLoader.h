@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "SourceScene.h"
+
+// glTF 2.0, both .gltf with its buffers and single file .glb, without assimp. Files are mapped and accessors are read
+// straight out of the mapping into the meshes, embedded images are handed to the texture stage without a copy.
+// The result matches assimp's reader with the importer's left handed conversion.
+namespace GltfLoader
+{
+
+	bool IsGltf(const std::string& path);
+
+	// One mesh per triangle primitive, placed at every node of the default scene that uses it.
+	// Throws std::runtime_error for malformed files and accessors that point outside their buffers.
+	SourceScene Load(const std::string& path, ImportStats& stats);
+
+}
@@ -0,0 +1,501 @@
+#include "Importer.h"
+
+#undef max
+#undef min
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include "Atlas.h"
+#include "Geometry.h"
+#include "GltfLoader.h"
+#include "Hash.h"
+#include "Jobs.h"
+#include "Memory.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "Simplifier.h"
+#include "Textures.h"
+#include "VertexFormat.h"
+
+using namespace DirectX;
+
+namespace Importer
+{
+
+	SourceScene LoadAssimp(const std::string& path, ImportStats& stats)
+	{
+		Assimp::Importer importer;
+		{
+			ScopedStage stage(stats, "Assimp");
+			// Raw meshes, welding, normals and tangents are done by the importer on every mesh at once
+			importer.ReadFile(path, aiProcess_ConvertToLeftHanded | aiProcess_TransformUVCoords | aiProcess_GenUVCoords);
+		}
+
+		auto scene = importer.GetScene();
+		if (!scene)
+		{
+			throw std::runtime_error("Invalid scene file");
+		}
+
+		SourceScene source;
+		source.Meshes.resize(scene->mNumMeshes);
+
+		// Every place each mesh is referenced from in the node tree, in world space
+		{
+			ScopedStage stage(stats, "Scene graph");
+			struct Node
+			{
+				const aiNode* Source;
+				XMFLOAT4X4 Parent;
+			};
+			std::vector<Node> stack;
+			XMFLOAT4X4 identity;
+			XMStoreFloat4x4(&identity, XMMatrixIdentity());
+			if (scene->mRootNode) stack.push_back({ scene->mRootNode, identity });
+			while (stack.size())
+			{
+				auto node = stack.back();
+				stack.pop_back();
+
+				// Assimp's matrices are column vector, transposed into DirectXMath's row vector convention
+				const auto& m = node.Source->mTransformation;
+				XMMATRIX local = XMMatrixSet(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+				XMFLOAT4X4 world;
+				XMStoreFloat4x4(&world, local * XMLoadFloat4x4(&node.Parent));
+
+				for (uint32_t i = 0; i < node.Source->mNumMeshes; i++)
+				{
+					source.Meshes[node.Source->mMeshes[i]].Placements.push_back(world);
+				}
+				for (uint32_t i = 0; i < node.Source->mNumChildren; i++)
+				{
+					stack.push_back({ node.Source->mChildren[i], world });
+				}
+			}
+
+			// Meshes no node uses still get drawn where they are
+			for (auto& mesh : source.Meshes)
+			{
+				if (mesh.Placements.empty()) mesh.Placements.push_back(identity);
+			}
+		}
+
+		// Polygons are triangulated, points and lines are dropped
+		{
+			ScopedStage stage(stats, "Assimp meshes", scene->mNumMeshes);
+			Jobs::ParallelFor(scene->mNumMeshes, [&](uint32_t i)
+				{
+					stats.Step();
+					const aiMesh* from = scene->mMeshes[i];
+					auto& mesh = source.Meshes[i];
+					mesh.Material = from->mMaterialIndex;
+					mesh.HasNormals = from->HasNormals();
+					mesh.HasUVs = from->HasTextureCoords(0);
+
+					mesh.Vertices.resize(from->mNumVertices);
+					for (uint32_t j = 0; j < from->mNumVertices; j++)
+					{
+						auto& vertex = mesh.Vertices[j];
+						vertex.Position = { from->mVertices[j].x, from->mVertices[j].y, from->mVertices[j].z };
+						vertex.Normal = mesh.HasNormals ? XMFLOAT3{ from->mNormals[j].x, from->mNormals[j].y, from->mNormals[j].z } : XMFLOAT3{};
+						if (mesh.HasUVs)
+						{
+							vertex.UV = { from->mTextureCoords[0][j].x, from->mTextureCoords[0][j].y };
+						}
+					}
+					for (uint32_t j = 0; j < from->mNumFaces; j++)
+					{
+						const aiFace& face = from->mFaces[j];
+						Geometry::Triangulate(mesh.Vertices, std::span<const uint32_t>(face.mIndices, face.mNumIndices), mesh.Indices);
+					}
+				});
+		}
+
+		for (uint32_t m = 0; m < scene->mNumMaterials; m++)
+		{
+			aiMaterial* from = scene->mMaterials[m];
+			auto getTexture = [&](aiTextureType type)
+			{
+				aiString texPath;
+				if (!from->GetTextureCount(type)) return SourceImage();
+				from->GetTexture(type, 0, &texPath);
+				return SourceImage{ texPath.C_Str() };
+			};
+
+			aiColor3D diffuse(0.f, 0.f, 0.f);
+			aiColor3D specular(0.f, 0.f, 0.f);
+			from->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+			from->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+
+			auto& material = source.Materials.emplace_back();
+			material.Albedo = getTexture(aiTextureType_DIFFUSE);
+			material.Specular = getTexture(aiTextureType_AMBIENT);
+			material.Bump = getTexture(aiTextureType_HEIGHT);
+			material.Diffuse = { diffuse.r, diffuse.g, diffuse.b };
+			material.SpecularColor = { specular.r, specular.g, specular.b };
+		}
+		return source;
+	}
+
+	SourceScene Load(const std::string& path, ImportStats& stats, bool forceAssimp)
+	{
+		if (!forceAssimp && ObjLoader::IsObj(path)) return ObjLoader::Load(path, stats);
+		if (!forceAssimp && GltfLoader::IsGltf(path)) return GltfLoader::Load(path, stats);
+		return LoadAssimp(path, stats);
+	}
+
+	SceneData Import(const std::string& path, const ImportOptions& options, LoadProgress* progress, const SceneView* previous)
+	{
+		SceneData data;
+		data.Stats.Progress = progress;
+
+		auto source = Load(path, data.Stats);
+		auto& meshes = source.Meshes;
+		uint32_t meshCount = uint32_t(meshes.size());
+		uint32_t materialCount = uint32_t(source.Materials.size());
+		uint64_t rawVertices = 0;
+		for (const auto& mesh : meshes)
+		{
+			if (mesh.Material >= materialCount) throw std::runtime_error("Mesh uses a material that doesn't exist");
+			rawVertices += mesh.Vertices.size();
+		}
+
+		{
+			ScopedStage stage(data.Stats, "Weld", meshCount);
+			Jobs::ParallelFor(meshCount, [&](uint32_t i)
+				{
+					data.Stats.Step();
+					Geometry::Weld(meshes[i].Vertices, meshes[i].Indices);
+				});
+		}
+		uint32_t generatedNormals = 0;
+		{
+			ScopedStage stage(data.Stats, "Normals", meshCount);
+			Jobs::ParallelFor(meshCount, [&](uint32_t i)
+				{
+					data.Stats.Step();
+					if (!meshes[i].HasNormals) Geometry::GenerateNormals(meshes[i].Vertices, meshes[i].Indices);
+				});
+			for (const auto& mesh : meshes)
+			{
+				generatedNormals += !mesh.HasNormals;
+			}
+		}
+		{
+			ScopedStage stage(data.Stats, "Tangents", meshCount);
+			Jobs::ParallelFor(meshCount, [&](uint32_t i)
+				{
+					data.Stats.Step();
+					if (meshes[i].HasUVs) Geometry::GenerateTangents(meshes[i].Vertices, meshes[i].Indices);
+				});
+		}
+		uint64_t weldedVertices = 0;
+		for (const auto& mesh : meshes)
+		{
+			weldedVertices += mesh.Vertices.size();
+		}
+		data.Stats.Add("Vertices before weld", double(rawVertices));
+		data.Stats.Add("Vertices after weld", double(weldedVertices));
+		data.Stats.Add("Meshes with generated normals", generatedNormals);
+
+		// Mirroring placements turn the triangles inside out. Baked meshes are flipped when they move into world space,
+		// instances share their indices, so a mesh placed both ways gets a second batch with flipped indices over the same
+		// vertices for its mirrored placements.
+		std::vector<bool> mirrored(meshCount, false);
+		// Placements before the mirrored ones, for meshes placed both ways
+		std::vector<uint32_t> upright(meshCount, 0);
+		uint32_t mirroredMeshes = 0;
+		for (uint32_t i = 0; i < meshCount; i++)
+		{
+			auto& placements = meshes[i].Placements;
+			if (placements.size() < 2) continue;
+
+			auto split = std::stable_partition(placements.begin(), placements.end(), [](const XMFLOAT4X4& world)
+				{
+					return XMVectorGetX(XMMatrixDeterminant(XMLoadFloat4x4(&world))) >= 0.f;
+				});
+			if (split == placements.end()) continue;
+			mirroredMeshes++;
+			if (split == placements.begin())
+			{
+				mirrored[i] = true;
+				continue;
+			}
+			upright[i] = uint32_t(split - placements.begin());
+		}
+		data.Stats.Add("Mirrored instanced meshes", mirroredMeshes);
+
+		// Textures load before batching, atlases turn materials that only differed by their textures into one batch.
+		// Decoding is its own stage so all materials' images go through the job pool at once.
+		std::string basePath = std::filesystem::path(path).parent_path().string() + "/";
+		std::vector<Textures::Source> textures;
+		std::vector<Textures::Pack> packs;
+		std::vector<uint32_t> albedos(materialCount, ~0u);
+		std::vector<uint32_t> surfaces(materialCount, ~0u);
+		{
+			std::vector<bool> used(materialCount, false);
+			for (const auto& mesh : meshes)
+			{
+				used[mesh.Material] = true;
+			}
+			for (uint32_t m = 0; m < materialCount; m++)
+			{
+				if (!used[m]) continue;
+
+				const auto& from = source.Materials[m];
+				auto addTexture = [&](const SourceImage& image, Textures::Usage usage, XMFLOAT3 color)
+				{
+					textures.push_back({ {}, { uint8_t(color.x * 255), uint8_t(color.y * 255), uint8_t(color.z * 255), 255 }, usage, image.Bytes });
+					if (image.Path.size()) textures.back().Path = basePath + image.Path;
+					return uint32_t(textures.size() - 1);
+				};
+
+				albedos[m] = addTexture(from.Albedo, Textures::Usage::Albedo, from.Diffuse);
+				uint32_t specular = addTexture(from.Specular, Textures::Usage::Specular, from.SpecularColor);
+				packs.push_back({ specular, addTexture(from.Bump, Textures::Usage::Bump, { 0.5f, 0.5f, 0.5f }) });
+				surfaces[m] = uint32_t(packs.size() - 1);
+			}
+		}
+		// Atlases can't be split back into the textures they hold, so an atlased import decodes everything again
+		auto loaded = Textures::Load(textures, packs, data.Stats, options.AtlasTextures ? nullptr : previous);
+		for (uint32_t m = 0; m < materialCount; m++)
+		{
+			if (albedos[m] == ~0u) continue;
+			albedos[m] = loaded.Indices[albedos[m]];
+			surfaces[m] = loaded.Packs[surfaces[m]];
+		}
+		if (options.AtlasTextures)
+		{
+			Atlas::Pack(source, albedos, surfaces, loaded, data.Stats);
+		}
+
+		// Count pass: bucket the meshes by material and give each its exact place in the final arrays.
+		// Meshes placed once are baked into one batch per material, every mesh placed more often is a batch of its own.
+		struct MeshRange
+		{
+			uint32_t BaseVertex;
+			uint32_t BaseIndex;
+			// Start of the mesh inside its batch's vertex range, added to its indices
+			uint32_t VertexOffset;
+			// Of the flipped indices, for meshes placed both ways
+			uint32_t MirroredBaseIndex;
+		};
+		std::vector<MeshRange> ranges(meshCount);
+		std::vector<uint32_t> sortedMeshes(meshCount);
+		std::vector<uint32_t> materialStarts(materialCount + 1, 0);
+		std::vector<uint32_t> triangleCounts(meshCount, 0);
+		{
+			ScopedStage stage(data.Stats, "Geometry count");
+			for (uint32_t i = 0; i < meshCount; i++)
+			{
+				triangleCounts[i] = uint32_t(meshes[i].Indices.size() / 3);
+				materialStarts[meshes[i].Material + 1]++;
+			}
+
+			// Stable, meshes keep their file order inside a material, baked ones first
+			for (uint32_t m = 0; m < materialCount; m++)
+			{
+				materialStarts[m + 1] += materialStarts[m];
+			}
+			std::vector<uint32_t> fill(materialStarts.begin(), materialStarts.end() - 1);
+			for (bool instanced : { false, true })
+			{
+				for (uint32_t i = 0; i < meshCount; i++)
+				{
+					if ((meshes[i].Placements.size() > 1) == instanced) sortedMeshes[fill[meshes[i].Material]++] = i;
+				}
+			}
+		}
+
+		uint32_t baseVertex = 0;
+		uint32_t baseIndex = 0;
+		uint32_t instancedMeshes = 0;
+		uint32_t instancedCount = 0;
+		uint64_t savedBytes = 0;
+		// What Scene uploads per vertex
+		uint64_t vertexStride = options.CompactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+		for (uint32_t m = 0; m < materialCount; m++)
+		{
+			if (materialStarts[m] == materialStarts[m + 1]) continue;
+
+			// Shared by all of the material's batches
+			MaterialData material{};
+			material.Albedo = albedos[m];
+			material.Surface = surfaces[m];
+			material.Masked = loaded.Masked[albedos[m]];
+
+			for (uint32_t s = materialStarts[m]; s < materialStarts[m + 1];)
+			{
+				uint32_t vertexCount = 0;
+				uint32_t indexCount = 0;
+				uint32_t end = s;
+				do
+				{
+					uint32_t i = sortedMeshes[end++];
+					ranges[i] = { baseVertex + vertexCount, baseIndex + indexCount, vertexCount, 0 };
+					vertexCount += uint32_t(meshes[i].Vertices.size());
+					indexCount += triangleCounts[i] * 3;
+				} while (end < materialStarts[m + 1] && meshes[sortedMeshes[end]].Placements.size() == 1);
+
+				material.BaseVertex = baseVertex;
+				material.BaseIndex = baseIndex;
+				material.IndexCount = indexCount;
+				material.VertexCount = vertexCount;
+				material.BaseInstance = uint32_t(data.Instances.size());
+
+				// Baked batches are already in world space
+				uint32_t mesh = sortedMeshes[s];
+				const auto& placement = meshes[mesh].Placements;
+				if (placement.size() == 1)
+				{
+					InstanceData instance;
+					XMStoreFloat3x4(&instance.Transform, XMMatrixIdentity());
+					data.Instances.push_back(instance);
+				}
+				else
+				{
+					// Mirrored placements start a second batch, which only stores the indices again
+					for (uint32_t p = 0; p < placement.size(); p++)
+					{
+						if (upright[mesh] && p == upright[mesh])
+						{
+							material.InstanceCount = uint32_t(data.Instances.size()) - material.BaseInstance;
+							data.Materials.emplace_back(material);
+							material.BaseIndex += indexCount;
+							material.BaseInstance = uint32_t(data.Instances.size());
+							ranges[mesh].MirroredBaseIndex = material.BaseIndex;
+						}
+
+						InstanceData instance;
+						XMStoreFloat3x4(&instance.Transform, XMLoadFloat4x4(&placement[p]));
+						data.Instances.push_back(instance);
+					}
+					instancedMeshes++;
+					instancedCount += uint32_t(placement.size());
+
+					// Against baking every placement
+					uint64_t batches = upright[mesh] ? 2 : 1;
+					savedBytes += (placement.size() - 1) * vertexCount * vertexStride + (placement.size() - batches) * indexCount * sizeof(uint32_t);
+					indexCount *= uint32_t(batches);
+				}
+				material.InstanceCount = uint32_t(data.Instances.size()) - material.BaseInstance;
+				data.Materials.emplace_back(material);
+
+				baseVertex += vertexCount;
+				baseIndex += indexCount;
+				s = end;
+			}
+		}
+
+		// Fill pass: every mesh moves into its own slice of the final arrays and is freed
+		{
+			ScopedStage stage(data.Stats, "Geometry fill", meshCount);
+			data.Vertices.resize(baseVertex);
+			data.Indices.resize(baseIndex);
+			Jobs::ParallelFor(meshCount, [&](uint32_t i)
+				{
+					data.Stats.Step();
+					auto mesh = std::move(meshes[i]);
+					const auto& range = ranges[i];
+
+					Vertex* vertex = data.Vertices.data() + range.BaseVertex;
+					std::copy(mesh.Vertices.begin(), mesh.Vertices.end(), vertex);
+					uint32_t vertexCount = uint32_t(mesh.Vertices.size());
+
+					bool flip = mirrored[i];
+					XMMATRIX world = XMLoadFloat4x4(&mesh.Placements[0]);
+					if (mesh.Placements.size() == 1 && !XMMatrixIsIdentity(world))
+					{
+						XMMATRIX normalMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+						flip = XMVectorGetX(XMMatrixDeterminant(world)) < 0.f;
+						for (uint32_t j = 0; j < vertexCount; j++)
+						{
+							XMStoreFloat3(&vertex[j].Position, XMVector3Transform(XMLoadFloat3(&vertex[j].Position), world));
+							XMStoreFloat3(&vertex[j].Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex[j].Normal), normalMatrix)));
+							XMStoreFloat3(&vertex[j].Tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex[j].Tangent), world)));
+							XMStoreFloat3(&vertex[j].Bitangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex[j].Bitangent), world)));
+						}
+					}
+
+					auto fill = [&](uint32_t first, bool flipped)
+					{
+						uint32_t* index = data.Indices.data() + first;
+						for (size_t j = 0; j + 2 < mesh.Indices.size(); j += 3)
+						{
+							*index++ = mesh.Indices[j] + range.VertexOffset;
+							*index++ = mesh.Indices[flipped ? j + 2 : j + 1] + range.VertexOffset;
+							*index++ = mesh.Indices[flipped ? j + 1 : j + 2] + range.VertexOffset;
+						}
+					};
+					fill(range.BaseIndex, flip);
+					if (upright[i]) fill(range.MirroredBaseIndex, true);
+				});
+		}
+		constexpr double mib = 1024.0 * 1024.0;
+		data.Stats.Add("Geometry (MiB)", double(data.Vertices.size() * sizeof(Vertex) + data.Indices.size() * sizeof(uint32_t)) / mib);
+		data.Stats.Add("Instanced meshes", instancedMeshes);
+		data.Stats.Add("Instances", instancedCount);
+		data.Stats.Add("Instancing saved (MiB)", double(savedBytes) / mib);
+		data.Stats.Add("Peak RSS after geometry (MiB)", double(Memory::GetPeakResidentBytes()) / mib);
+
+		MeshOptimizer::OptimizeScene(data);
+		{
+			ScopedStage stage(data.Stats, "Cluster BVH");
+			data.ClusterBvh = SceneBvh::BuildClusters(data.View());
+		}
+		data.Stats.Add("Cluster BVH nodes", double(data.ClusterBvh.Nodes.size()));
+		{
+			ScopedStage stage(data.Stats, "Scene bounds");
+			data.Bounds = SceneBvh::GetSceneBounds(data.View());
+		}
+		data.Stats.Add("Scene size X", double(data.Bounds.Max.x - data.Bounds.Min.x));
+		data.Stats.Add("Scene size Y", double(data.Bounds.Max.y - data.Bounds.Min.y));
+		data.Stats.Add("Scene size Z", double(data.Bounds.Max.z - data.Bounds.Min.z));
+		Simplifier::BuildLods(data);
+		if (options.CompactVertices)
+		{
+			VertexFormat::CompactScene(data);
+		}
+
+		data.Textures = std::move(loaded.Textures);
+		data.TextureSources = std::move(loaded.Sources);
+		data.Dependencies = std::move(source.Dependencies);
+		for (auto& dependency : data.Dependencies)
+		{
+			dependency.Path = Textures::GetCanonicalPath(dependency.Path);
+		}
+		uint32_t masked = 0;
+		for (const auto& material : data.Materials)
+		{
+			masked += material.Masked;
+		}
+		data.Stats.Add("Masked batches", double(masked));
+
+		// Over what Scene uploads, in the final layout
+		for (size_t m = 0; m < data.Materials.size(); m++)
+		{
+			auto& material = data.Materials[m];
+			uint64_t hash = Hash::Bytes(data.Indices.data() + material.BaseIndex, material.IndexCount * sizeof(uint32_t));
+			if (options.CompactVertices)
+			{
+				hash = Hash::Bytes(data.CompactVertices.data() + material.BaseVertex, material.VertexCount * sizeof(CompactVertex), hash);
+				hash = Hash::Bytes(&data.Quantization[m], sizeof(VertexQuantization), hash);
+			}
+			else
+			{
+				hash = Hash::Bytes(data.Vertices.data() + material.BaseVertex, material.VertexCount * sizeof(Vertex), hash);
+			}
+			material.Hash = Hash::Bytes(data.Instances.data() + material.BaseInstance, material.InstanceCount * sizeof(InstanceData), hash);
+		}
+
+		data.Stats.Add("Peak RSS (MiB)", double(Memory::GetPeakResidentBytes()) / mib);
+		data.Stats.Progress = nullptr;
+		return data;
+	}
+
+}
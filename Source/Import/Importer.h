@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "SceneData.h"
+#include "SourceScene.h"
+
+// Source asset import through the native OBJ and glTF loaders or assimp, and stb. CPU only, the result is uploaded by Scene.
+namespace Importer
+{
+
+	// progress is optional, it is polled for cancellation and receives every stage.
+	// previous is an earlier import of the same file, its textures are reused where the image files didn't change.
+	SceneData Import(const std::string& path, const ImportOptions& options = {}, LoadProgress* progress = nullptr,
+		const SceneView* previous = nullptr);
+
+	// Only reads the file into raw meshes. OBJ and glTF files go through their own loaders unless forceAssimp,
+	// everything else through assimp.
+	SourceScene Load(const std::string& path, ImportStats& stats, bool forceAssimp = false);
+
+}
@@ -0,0 +1,375 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Clusters.h"
+#include "Jobs.h"
+
+namespace MeshOptimizer
+{
+
+	using namespace DirectX;
+
+	// Clusters are split further where their running ACMR is already this close to the whole cluster's
+	constexpr float m_OverdrawThreshold = 1.05f;
+
+	CacheStats Analyze(std::span<const uint32_t> indices, uint32_t vertexCount)
+	{
+		CacheStats stats;
+		stats.Triangles = indices.size() / 3;
+
+		// Timestamp of the entry into the FIFO, a vertex is cached if it entered less than CacheSize misses ago
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = CacheSize + 1;
+		for (uint32_t index : indices)
+		{
+			if (cacheTime[index] == 0) stats.Vertices++;
+			if (time - cacheTime[index] > CacheSize)
+			{
+				cacheTime[index] = time++;
+				stats.Misses++;
+			}
+		}
+		return stats;
+	}
+
+	CacheStats Analyze(const SceneView& scene)
+	{
+		std::vector<CacheStats> materials(scene.Materials.size());
+		Jobs::ParallelFor(uint32_t(materials.size()), [&](uint32_t i)
+			{
+				const auto& material = scene.Materials[i];
+				materials[i] = Analyze(scene.Indices.subspan(material.BaseIndex, material.IndexCount), material.VertexCount);
+			});
+
+		CacheStats total;
+		for (const auto& stats : materials)
+		{
+			total.Triangles += stats.Triangles;
+			total.Vertices += stats.Vertices;
+			total.Misses += stats.Misses;
+		}
+		return total;
+	}
+
+	Adjacency BuildAdjacency(std::span<const uint32_t> indices, uint32_t vertexCount)
+	{
+		Adjacency adjacency;
+		adjacency.Live.assign(vertexCount, 0);
+		for (uint32_t index : indices)
+		{
+			adjacency.Live[index]++;
+		}
+
+		adjacency.Offsets.resize(vertexCount + 1);
+		adjacency.Offsets[0] = 0;
+		std::partial_sum(adjacency.Live.begin(), adjacency.Live.end(), adjacency.Offsets.begin() + 1);
+
+		adjacency.Triangles.resize(indices.size());
+		std::vector<uint32_t> fill(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++)
+		{
+			adjacency.Triangles[fill[indices[i]]++] = i / 3;
+		}
+		return adjacency;
+	}
+
+	// Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+	// Returns the new triangle order and the triangles where the fan had to restart from a dead end.
+	std::vector<uint32_t> Tipsify(std::span<const uint32_t> indices, uint32_t vertexCount, std::vector<uint32_t>& hardBoundaries)
+	{
+		uint32_t triangleCount = uint32_t(indices.size() / 3);
+		auto adjacency = BuildAdjacency(indices, vertexCount);
+		auto& live = adjacency.Live;
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> order;
+		order.reserve(triangleCount);
+
+		uint32_t time = CacheSize + 1;
+		uint32_t cursor = 0;
+		int64_t fan = vertexCount ? 0 : -1;
+		bool restarted = true;
+		while (fan >= 0)
+		{
+			if (restarted)
+			{
+				hardBoundaries.push_back(uint32_t(order.size()));
+				restarted = false;
+			}
+
+			candidates.clear();
+			for (uint32_t a = adjacency.Offsets[fan]; a < adjacency.Offsets[fan + 1]; a++)
+			{
+				uint32_t triangle = adjacency.Triangles[a];
+				if (emitted[triangle]) continue;
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+					if (time - cacheTime[vertex] > CacheSize)
+					{
+						cacheTime[vertex] = time++;
+					}
+				}
+				emitted[triangle] = true;
+				order.push_back(triangle);
+			}
+
+			// Prefer the candidate that stays in the cache the longest while its remaining fan is emitted
+			fan = -1;
+			int64_t best = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (!live[vertex]) continue;
+
+				int64_t priority = 0;
+				if (time - cacheTime[vertex] + 2 * live[vertex] <= CacheSize)
+				{
+					priority = time - cacheTime[vertex];
+				}
+				if (priority > best)
+				{
+					best = priority;
+					fan = vertex;
+				}
+			}
+
+			if (fan < 0)
+			{
+				restarted = true;
+				while (!deadEnd.empty() && fan < 0)
+				{
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+					if (live[vertex]) fan = vertex;
+				}
+				while (fan < 0 && cursor < vertexCount)
+				{
+					if (live[cursor]) fan = cursor;
+					cursor++;
+				}
+			}
+		}
+		return order;
+	}
+
+	// Splits each hard cluster where its running ACMR first drops under the threshold, so there are
+	// more clusters to sort without giving back much of the cache locality
+	std::vector<uint32_t> GetSoftBoundaries(std::span<const uint32_t> indices, std::span<const uint32_t> order,
+		std::span<const uint32_t> hardBoundaries, uint32_t vertexCount)
+	{
+		std::vector<uint32_t> boundaries;
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = CacheSize + 1;
+		auto simulate = [&](uint32_t triangle)
+		{
+			uint32_t misses = 0;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				if (time - cacheTime[vertex] > CacheSize)
+				{
+					cacheTime[vertex] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		};
+
+		for (size_t h = 0; h < hardBoundaries.size(); h++)
+		{
+			uint32_t start = hardBoundaries[h];
+			uint32_t end = h + 1 < hardBoundaries.size() ? hardBoundaries[h + 1] : uint32_t(order.size());
+
+			// Whole cluster first for its ACMR, with a cold cache as it would be after any reordering
+			time += CacheSize + 1;
+			uint32_t clusterMisses = 0;
+			for (uint32_t t = start; t < end; t++)
+			{
+				clusterMisses += simulate(order[t]);
+			}
+			float threshold = m_OverdrawThreshold * float(clusterMisses) / float(end - start);
+
+			time += CacheSize + 1;
+			boundaries.push_back(start);
+			uint32_t subStart = start;
+			uint32_t misses = 0;
+			for (uint32_t t = start; t < end; t++)
+			{
+				misses += simulate(order[t]);
+				if (t + 1 < end && float(misses) / float(t + 1 - subStart) <= threshold)
+				{
+					boundaries.push_back(t + 1);
+					subStart = t + 1;
+					misses = 0;
+					time += CacheSize + 1;
+				}
+			}
+		}
+		return boundaries;
+	}
+
+	void OptimizeTriangles(std::span<uint32_t> indices, std::span<const Vertex> vertices)
+	{
+		uint32_t vertexCount = uint32_t(vertices.size());
+		if (indices.size() < 6) return;
+
+		std::vector<uint32_t> hardBoundaries;
+		auto order = Tipsify(indices, vertexCount, hardBoundaries);
+		auto boundaries = GetSoftBoundaries(indices, order, hardBoundaries, vertexCount);
+
+		auto getPosition = [&](uint32_t triangle, uint32_t corner)
+		{
+			return XMLoadFloat3(&vertices[indices[triangle * 3 + corner]].Position);
+		};
+
+		// Clusters facing away from the mesh centroid are on its outside and likely to occlude the rest
+		XMVECTOR meshCentroid = XMVectorZero();
+		float meshArea = 0.f;
+		struct Cluster
+		{
+			XMVECTOR Centroid;
+			XMVECTOR Normal;
+			float Area;
+		};
+		std::vector<Cluster> clusters(boundaries.size());
+		for (size_t c = 0; c < boundaries.size(); c++)
+		{
+			uint32_t end = c + 1 < boundaries.size() ? boundaries[c + 1] : uint32_t(order.size());
+			Cluster cluster{ XMVectorZero(), XMVectorZero(), 0.f };
+			for (uint32_t t = boundaries[c]; t < end; t++)
+			{
+				XMVECTOR p0 = getPosition(order[t], 0);
+				XMVECTOR p1 = getPosition(order[t], 1);
+				XMVECTOR p2 = getPosition(order[t], 2);
+				XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+				float area = XMVectorGetX(XMVector3Length(normal));
+				XMVECTOR centroid = XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), 1.f / 3.f);
+
+				cluster.Centroid = XMVectorAdd(cluster.Centroid, XMVectorScale(centroid, area));
+				cluster.Normal = XMVectorAdd(cluster.Normal, normal);
+				cluster.Area += area;
+			}
+			meshCentroid = XMVectorAdd(meshCentroid, cluster.Centroid);
+			meshArea += cluster.Area;
+			if (cluster.Area > 0.f) cluster.Centroid = XMVectorScale(cluster.Centroid, 1.f / cluster.Area);
+			clusters[c] = cluster;
+		}
+		if (meshArea > 0.f) meshCentroid = XMVectorScale(meshCentroid, 1.f / meshArea);
+
+		std::vector<float> sortKeys(clusters.size());
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			XMVECTOR normal = XMVector3Normalize(clusters[c].Normal);
+			sortKeys[c] = XMVectorGetX(XMVector3Dot(XMVectorSubtract(clusters[c].Centroid, meshCentroid), normal));
+		}
+
+		std::vector<uint32_t> clusterOrder(clusters.size());
+		std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (uint32_t c : clusterOrder)
+		{
+			uint32_t end = c + 1 < boundaries.size() ? boundaries[c + 1] : uint32_t(order.size());
+			for (uint32_t t = boundaries[c]; t < end; t++)
+			{
+				result.insert(result.end(), indices.begin() + order[t] * 3, indices.begin() + order[t] * 3 + 3);
+			}
+		}
+		std::copy(result.begin(), result.end(), indices.begin());
+	}
+
+	void OptimizeFetch(std::span<uint32_t> indices, std::span<Vertex> vertices)
+	{
+		constexpr uint32_t unused = ~0u;
+		std::vector<uint32_t> remap(vertices.size(), unused);
+		uint32_t next = 0;
+		for (auto& index : indices)
+		{
+			if (remap[index] == unused) remap[index] = next++;
+			index = remap[index];
+		}
+		for (auto& index : remap)
+		{
+			if (index == unused) index = next++;
+		}
+
+		std::vector<Vertex> reordered(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			reordered[remap[i]] = vertices[i];
+		}
+		std::copy(reordered.begin(), reordered.end(), vertices.begin());
+	}
+
+	void OptimizeScene(SceneData& data)
+	{
+		ScopedStage stage(data.Stats, "Mesh optimization", uint32_t(data.Materials.size()));
+
+		auto before = Analyze(data.View());
+		std::vector<std::vector<ClusterData>> clusters(data.Materials.size());
+		data.Positions.resize(data.Vertices.size());
+		Jobs::ParallelFor(uint32_t(data.Materials.size()), [&](uint32_t i)
+			{
+				data.Stats.Step();
+				if (SharesVertices(data.Materials, i)) return;
+
+				const auto& material = data.Materials[i];
+				std::span<uint32_t> indices(data.Indices.data() + material.BaseIndex, material.IndexCount);
+				std::span<Vertex> vertices(data.Vertices.data() + material.BaseVertex, material.VertexCount);
+				OptimizeTriangles(indices, vertices);
+				// Clusters keep the triangle order inside them, fetch order has to follow the clustering
+				Clusters::Build(indices, vertices, i, clusters[i]);
+				OptimizeFetch(indices, vertices);
+				// Nothing reorders vertices after this
+				for (uint32_t v = 0; v < material.VertexCount; v++)
+				{
+					data.Positions[material.BaseVertex + v] = vertices[v].Position;
+				}
+
+				// The mirrored batch follows the new vertex order, triangle for triangle
+				if (i + 1 < data.Materials.size() && SharesVertices(data.Materials, i + 1))
+				{
+					std::span<uint32_t> mirrored(data.Indices.data() + data.Materials[i + 1].BaseIndex, indices.size());
+					for (size_t j = 0; j + 2 < indices.size(); j += 3)
+					{
+						mirrored[j] = indices[j];
+						mirrored[j + 1] = indices[j + 2];
+						mirrored[j + 2] = indices[j + 1];
+					}
+					Clusters::Build(mirrored, vertices, i + 1, clusters[i + 1]);
+				}
+			});
+		auto after = Analyze(data.View());
+
+		data.Clusters.clear();
+		for (uint32_t i = 0; i < data.Materials.size(); i++)
+		{
+			auto& material = data.Materials[i];
+			material.BaseCluster = uint32_t(data.Clusters.size());
+			material.ClusterCount = uint32_t(clusters[i].size());
+			for (auto& cluster : clusters[i])
+			{
+				cluster.BaseIndex += material.BaseIndex;
+				data.Clusters.push_back(cluster);
+			}
+		}
+		Clusters::AddStats(data.Clusters, data.Stats);
+
+		data.Stats.Add("ACMR before", before.GetACMR());
+		data.Stats.Add("ACMR after", after.GetACMR());
+		data.Stats.Add("ATVR before", before.GetATVR());
+		data.Stats.Add("ATVR after", after.GetATVR());
+	}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <span>
+
+#include "SceneData.h"
+
+// Import-time reordering of each material's triangles and vertices for the post-transform cache,
+// overdraw and vertex fetch. Materials keep their ranges, only the order inside them changes.
+namespace MeshOptimizer
+{
+
+	// Simulated FIFO post-transform cache, the size most hardware behaves like
+	constexpr uint32_t CacheSize = 16;
+
+	struct CacheStats
+	{
+		uint64_t Triangles = 0;
+		uint64_t Vertices = 0;
+		uint64_t Misses = 0;
+
+		// Average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+		double GetACMR() const { return Triangles ? double(Misses) / Triangles : 0.0; }
+		// Average transform to vertex ratio, transformed vertices per referenced vertex (1 is ideal)
+		double GetATVR() const { return Vertices ? double(Misses) / Vertices : 0.0; }
+	};
+
+	// Triangles using each vertex: Triangles[Offsets[v]] .. Triangles[Offsets[v + 1] - 1].
+	// Live starts as the number of triangles per vertex, for algorithms that count down as they emit.
+	struct Adjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Triangles;
+		std::vector<uint32_t> Live;
+	};
+
+	Adjacency BuildAdjacency(std::span<const uint32_t> indices, uint32_t vertexCount);
+
+	// indices are relative to the start of their vertex range, vertexCount is the size of that range
+	CacheStats Analyze(std::span<const uint32_t> indices, uint32_t vertexCount);
+	CacheStats Analyze(const SceneView& scene);
+
+	// Tipsify vertex cache order, then its clusters sorted front to back from the outside of the mesh.
+	void OptimizeTriangles(std::span<uint32_t> indices, std::span<const Vertex> vertices);
+	// Renumbers vertices in first use order, unreferenced ones go to the end.
+	void OptimizeFetch(std::span<uint32_t> indices, std::span<Vertex> vertices);
+
+	// Both of the above on every material in parallel, with the clusters built in between into data.Clusters.
+	// Fills data.Positions from the reordered vertices. Records ACMR/ATVR before and after in data.Stats.
+	void OptimizeScene(SceneData& data);
+
+}
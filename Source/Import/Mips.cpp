@@ -0,0 +1,193 @@
+#include "Mips.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace Mips
+{
+
+	using namespace DirectX;
+
+	struct Tables
+	{
+		float ToLinear[256];
+		uint8_t ToSRGB[4096];
+
+		Tables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float c = i / 255.f;
+				ToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < 4096; i++)
+			{
+				float c = i / 4095.f;
+				c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+				ToSRGB[i] = uint8_t(c * 255.f + 0.5f);
+			}
+		}
+	};
+
+	const Tables& GetTables()
+	{
+		static Tables tables;
+		return tables;
+	}
+
+	uint32_t GetLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			levels++;
+		}
+		return levels;
+	}
+
+	template<bool SRGB>
+	void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		const auto& tables = GetTables();
+		const XMVECTOR scale = SRGB ? XMVectorSet(0.25f, 0.25f, 0.25f, 0.25f / 255.f) : XMVectorReplicate(0.25f / 255.f);
+
+		auto load = [&](uint32_t x, uint32_t y)
+		{
+			const uint8_t* p = src + (size_t(y) * srcWidth + x) * 4;
+			if constexpr (SRGB)
+			{
+				return XMVectorSet(tables.ToLinear[p[0]], tables.ToLinear[p[1]], tables.ToLinear[p[2]], float(p[3]));
+			}
+			else
+			{
+				return XMVectorSet(float(p[0]), float(p[1]), float(p[2]), float(p[3]));
+			}
+		};
+
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			// Odd sizes clamp, so the last row/column of the source is not dropped
+			uint32_t y0 = std::min(y * 2, srcHeight - 1);
+			uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				uint32_t x0 = std::min(x * 2, srcWidth - 1);
+				uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+				XMVECTOR sum = XMVectorAdd(XMVectorAdd(load(x0, y0), load(x1, y0)), XMVectorAdd(load(x0, y1), load(x1, y1)));
+				XMFLOAT4 average;
+				XMStoreFloat4(&average, XMVectorSaturate(XMVectorMultiply(sum, scale)));
+
+				uint8_t* out = dst + (size_t(y) * dstWidth + x) * 4;
+				if constexpr (SRGB)
+				{
+					out[0] = tables.ToSRGB[uint32_t(average.x * 4095.f + 0.5f)];
+					out[1] = tables.ToSRGB[uint32_t(average.y * 4095.f + 0.5f)];
+					out[2] = tables.ToSRGB[uint32_t(average.z * 4095.f + 0.5f)];
+				}
+				else
+				{
+					out[0] = uint8_t(average.x * 255.f + 0.5f);
+					out[1] = uint8_t(average.y * 255.f + 0.5f);
+					out[2] = uint8_t(average.z * 255.f + 0.5f);
+				}
+				out[3] = uint8_t(average.w * 255.f + 0.5f);
+			}
+		}
+	}
+
+	void Generate(TextureData& texture)
+	{
+		texture.MipLevels = GetLevelCount(texture.Width, texture.Height);
+
+		size_t total = 0;
+		for (uint32_t level = 0, w = texture.Width, h = texture.Height; level < texture.MipLevels; level++)
+		{
+			total += GetMipSize(texture.Format, w, h);
+			w = std::max(w / 2, 1u);
+			h = std::max(h / 2, 1u);
+		}
+		texture.Pixels.resize(total);
+
+		size_t offset = 0;
+		uint32_t width = texture.Width;
+		uint32_t height = texture.Height;
+		for (uint32_t level = 1; level < texture.MipLevels; level++)
+		{
+			uint32_t nextWidth = std::max(width / 2, 1u);
+			uint32_t nextHeight = std::max(height / 2, 1u);
+			size_t nextOffset = offset + GetMipSize(texture.Format, width, height);
+
+			const uint8_t* src = texture.Pixels.data() + offset;
+			uint8_t* dst = texture.Pixels.data() + nextOffset;
+			if (texture.Format == TextureFormat::RGBA8_SRGB)
+			{
+				Downsample<true>(src, width, height, dst, nextWidth, nextHeight);
+			}
+			else
+			{
+				Downsample<false>(src, width, height, dst, nextWidth, nextHeight);
+			}
+
+			offset = nextOffset;
+			width = nextWidth;
+			height = nextHeight;
+		}
+	}
+
+	void PreserveCoverage(TextureData& texture, uint8_t cutoff)
+	{
+		uint32_t counts[257] = {};
+		auto countAlpha = [&](const uint8_t* pixels, size_t texels)
+		{
+			std::fill(std::begin(counts), std::end(counts), 0u);
+			for (size_t i = 0; i < texels; i++)
+			{
+				counts[pixels[i * 4 + 3]]++;
+			}
+			// Texels at or above each value
+			for (uint32_t value = 255; value-- > 0;)
+			{
+				counts[value] += counts[value + 1];
+			}
+		};
+
+		size_t texels = size_t(texture.Width) * texture.Height;
+		countAlpha(texture.Pixels.data(), texels);
+		double coverage = double(counts[cutoff]) / double(texels);
+
+		size_t offset = GetMipSize(texture.Format, texture.Width, texture.Height);
+		for (uint32_t level = 1; level < texture.MipLevels; level++)
+		{
+			uint32_t width = std::max(texture.Width >> level, 1u);
+			uint32_t height = std::max(texture.Height >> level, 1u);
+			uint8_t* pixels = texture.Pixels.data() + offset;
+			offset += GetMipSize(texture.Format, width, height);
+
+			// The lowest alpha that has to pass for the closest coverage, 256 when nothing should. Ties go to more
+			// coverage, and the highest alpha with the same result keeps the scale closest to 1.
+			texels = size_t(width) * height;
+			countAlpha(pixels, texels);
+			int64_t target = int64_t(coverage * double(texels) + 0.5);
+			uint32_t threshold = 256;
+			for (uint32_t value = 256; value-- > 1;)
+			{
+				int64_t error = std::abs(int64_t(counts[value]) - target);
+				int64_t best = std::abs(int64_t(counts[threshold]) - target);
+				if (error < best || (error == best && counts[value] > counts[threshold])) threshold = value;
+			}
+
+			float scale = float(cutoff) / float(threshold);
+			for (size_t i = 0; i < texels; i++)
+			{
+				uint8_t& alpha = pixels[i * 4 + 3];
+				uint32_t scaled = std::min(uint32_t(alpha * scale + 0.5f), 255u);
+				alpha = uint8_t(alpha >= threshold ? std::max(scaled, uint32_t(cutoff)) : std::min(scaled, cutoff - 1u));
+			}
+		}
+	}
+
+}
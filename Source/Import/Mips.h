@@ -0,0 +1,18 @@
+#pragma once
+
+#include "SceneData.h"
+
+namespace Mips
+{
+
+	uint32_t GetLevelCount(uint32_t width, uint32_t height);
+
+	// Appends the full chain below level 0 of an uncompressed texture, down to 1x1.
+	// RGBA8_SRGB color channels are filtered in linear space, alpha is always linear.
+	void Generate(TextureData& texture);
+
+	// Rescales the alpha of every level below 0 so as many of its texels pass an alpha test against cutoff as in level 0.
+	// Averaging alone pulls the edges of alpha tested foliage and fences under the cutoff, so they thin out with distance.
+	void PreserveCoverage(TextureData& texture, uint8_t cutoff);
+
+}
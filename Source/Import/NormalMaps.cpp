@@ -0,0 +1,109 @@
+#include "NormalMaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace NormalMaps
+{
+
+	// GBufferWritePS scaled its one texel height differences by this
+	constexpr float m_Strength = 3.f;
+
+	// Heights of row y as floats, with the wrapped neighbour on each side and room for the last vector to read past
+	void LoadRow(const TextureData& texture, uint32_t y, float* row)
+	{
+		const uint8_t* pixels = texture.Pixels.data() + size_t(y) * texture.Width * 4;
+		for (uint32_t x = 0; x < texture.Width; x++)
+		{
+			row[x + 1] = pixels[x * 4] / 255.f;
+		}
+		row[0] = row[texture.Width];
+		row[texture.Width + 1] = row[1];
+	}
+
+	void FromHeight(TextureData& texture)
+	{
+		uint32_t width = texture.Width;
+		uint32_t height = texture.Height;
+		size_t pitch = size_t(width) + 5;
+
+		// Row 0 is overwritten before the last row reads it
+		std::vector<float> rows(pitch * 4, 0.f);
+		float* first = rows.data() + pitch * 3;
+		LoadRow(texture, 0, first);
+		float* above = rows.data();
+		float* center = rows.data() + pitch;
+		float* below = rows.data() + pitch * 2;
+		LoadRow(texture, height - 1, above);
+		memcpy(center, first, pitch * sizeof(float));
+
+		// Sobel over 8 is the slope per texel, like the shader's differences
+		XMVECTOR scale = XMVectorReplicate(-m_Strength / 8.f);
+		XMVECTOR two = XMVectorReplicate(2.f);
+		XMVECTOR one = XMVectorSplatOne();
+		XMVECTOR half = XMVectorReplicate(127.5f);
+		XMVECTOR round = XMVectorReplicate(128.f);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			if (y + 1 < height) LoadRow(texture, y + 1, below);
+			else memcpy(below, first, pitch * sizeof(float));
+
+			uint8_t* pixels = texture.Pixels.data() + size_t(y) * width * 4;
+			for (uint32_t x = 0; x < width; x += 4)
+			{
+				auto load = [&](const float* row, uint32_t offset) { return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x + offset)); };
+				XMVECTOR aboveLeft = load(above, 0), aboveCenter = load(above, 1), aboveRight = load(above, 2);
+				XMVECTOR belowLeft = load(below, 0), belowCenter = load(below, 1), belowRight = load(below, 2);
+				XMVECTOR gx = XMVectorAdd(XMVectorAdd(XMVectorSubtract(aboveRight, aboveLeft), XMVectorSubtract(belowRight, belowLeft)),
+					XMVectorMultiply(two, XMVectorSubtract(load(center, 2), load(center, 0))));
+				XMVECTOR gy = XMVectorSubtract(XMVectorAdd(XMVectorAdd(belowLeft, belowRight), XMVectorMultiply(two, belowCenter)),
+					XMVectorAdd(XMVectorAdd(aboveLeft, aboveRight), XMVectorMultiply(two, aboveCenter)));
+
+				XMVECTOR nx = XMVectorMultiply(gx, scale);
+				XMVECTOR nz = XMVectorMultiply(gy, scale);
+				XMVECTOR length = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(nz, nz, one)));
+
+				XMFLOAT4 encoded[3];
+				XMStoreFloat4(&encoded[0], XMVectorMultiplyAdd(XMVectorMultiply(nx, length), half, round));
+				XMStoreFloat4(&encoded[1], XMVectorMultiplyAdd(XMVectorMultiply(nz, length), half, round));
+				XMStoreFloat4(&encoded[2], XMVectorMultiplyAdd(length, half, round));
+				for (uint32_t i = 0; i < (std::min)(width - x, 4u); i++)
+				{
+					uint8_t* texel = pixels + size_t(x + i) * 4;
+					texel[0] = uint8_t((&encoded[0].x)[i]);
+					texel[1] = uint8_t((&encoded[1].x)[i]);
+					texel[2] = uint8_t((&encoded[2].x)[i]);
+					texel[3] = 255;
+				}
+			}
+
+			std::swap(above, center);
+			std::swap(center, below);
+		}
+		texture.Format = TextureFormat::RGBA8;
+	}
+
+	XMFLOAT3 GetShaderNormal(const TextureData& height, uint32_t x, uint32_t y)
+	{
+		auto sample = [&](uint32_t sx, uint32_t sy) { return height.Pixels[(size_t(sy % height.Height) * height.Width + sx % height.Width) * 4] / 255.f; };
+		float current = sample(x, y);
+		float dx = sample(x + 1, y) - current;
+		float dy = sample(x, y + 1) - current;
+
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(-m_Strength * dx, 1.f, -m_Strength * dy, 0.f)));
+		return normal;
+	}
+
+	XMFLOAT3 Decode(const uint8_t* texel)
+	{
+		float x = texel[0] / 255.f * 2.f - 1.f;
+		float z = texel[1] / 255.f * 2.f - 1.f;
+		return { x, std::sqrt(std::clamp(1.f - x * x - z * z, 0.f, 1.f)), z };
+	}
+
+}
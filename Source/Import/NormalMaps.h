@@ -0,0 +1,22 @@
+#pragma once
+
+#include "SceneData.h"
+
+// Bump maps are turned into tangent space normal maps at import, so the GBuffer pass fetches its normal once instead
+// of differencing three height samples. Normals use the GBuffer's tangent frame: x along the tangent, y along the
+// surface normal, z along the bitangent. Only x and z are kept, y is always positive. They are written to red and
+// green here and moved to the surface texture's channels when it is packed, see MaterialLayout.h.
+namespace NormalMaps
+{
+
+	// Replaces level 0 of a linear RGBA8 height map (red channel) with its normal map, before mips are generated.
+	// Slopes come from a 3x3 Sobel filter with wrapped edges, four texels at a time.
+	void FromHeight(TextureData& texture);
+
+	// The normal GBufferWritePS used to compute from the height map at texel x, y, for checking FromHeight against.
+	DirectX::XMFLOAT3 GetShaderNormal(const TextureData& height, uint32_t x, uint32_t y);
+
+	// The normal GBufferWritePS reconstructs from a texel of a normal map
+	DirectX::XMFLOAT3 Decode(const uint8_t* texel);
+
+}
@@ -0,0 +1,526 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "Geometry.h"
+#include "Hash.h"
+#include "Jobs.h"
+#include "MappedFile.h"
+
+using namespace DirectX;
+
+namespace ObjLoader
+{
+
+	// Position, UV and normal, 0 based into the whole file's arrays, -1 when missing
+	struct Corner
+	{
+		int32_t Position;
+		int32_t UV;
+		int32_t Normal;
+	};
+
+	// usemtl, o or g before a chunk's face
+	struct Group
+	{
+		uint32_t Face;
+		std::string Material;
+		bool IsObject;
+	};
+
+	struct Chunk
+	{
+		const char* Begin;
+		const char* End;
+		// Counted in the first pass, where they start in the file's arrays after it
+		uint32_t Positions = 0;
+		uint32_t UVs = 0;
+		uint32_t Normals = 0;
+		uint32_t FirstPosition = 0;
+		uint32_t FirstUV = 0;
+		uint32_t FirstNormal = 0;
+
+		std::vector<Corner> Corners;
+		// First corner of every face, and one past the last
+		std::vector<uint32_t> Faces = { 0 };
+		std::vector<Group> Groups;
+		std::vector<std::string> Libraries;
+	};
+
+	// Faces of one chunk that belong to a mesh
+	struct Range
+	{
+		uint32_t Chunk;
+		uint32_t FirstFace;
+		uint32_t EndFace;
+	};
+
+	struct MeshRanges
+	{
+		std::string Material;
+		std::vector<Range> Ranges;
+	};
+
+	constexpr double m_Powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	bool IsDigit(char c)
+	{
+		return uint8_t(c - '0') < 10;
+	}
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+		return p;
+	}
+
+	bool IsObj(const std::string& path)
+	{
+		auto extension = std::filesystem::u8path(path).extension().u8string();
+		return extension.size() == 4 && extension[0] == '.' && (extension[1] | 0x20) == 'o' &&
+			(extension[2] | 0x20) == 'b' && (extension[3] | 0x20) == 'j';
+	}
+
+	const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+		// Up to 19 significant digits fit the mantissa, the rest only moves the exponent
+		uint64_t mantissa = 0;
+		int32_t exponent = 0;
+		uint32_t digits = 0;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + uint32_t(*p - '0');
+				digits += mantissa != 0;
+			}
+			else exponent++;
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && IsDigit(*p); p++)
+			{
+				if (digits >= 19) continue;
+				mantissa = mantissa * 10 + uint32_t(*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+		}
+		if (p < end && (*p | 0x20) == 'e')
+		{
+			const char* q = p + 1;
+			bool negativeExponent = false;
+			if (q < end && (*q == '-' || *q == '+')) negativeExponent = *q++ == '-';
+			if (q < end && IsDigit(*q))
+			{
+				int32_t e = 0;
+				for (; q < end && IsDigit(*q); q++)
+				{
+					e = (std::min)(e * 10 + (*q - '0'), 100000);
+				}
+				exponent += negativeExponent ? -e : e;
+				p = q;
+			}
+		}
+
+		double result = double(mantissa);
+		if (mantissa && exponent)
+		{
+			uint32_t magnitude = uint32_t(std::abs(exponent));
+			double power = magnitude < std::size(m_Powers) ? m_Powers[magnitude] : std::pow(10.0, double(magnitude));
+			result = exponent < 0 ? result / power : result * power;
+		}
+		value = float(negative ? -result : result);
+		return p;
+	}
+
+	const char* ParseIndex(const char* p, const char* end, int64_t& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+		value = 0;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			value = (std::min)(value * 10 + (*p - '0'), int64_t(INT32_MAX));
+		}
+		if (negative) value = -value;
+		return p;
+	}
+
+	// Trimmed rest of the line
+	std::string_view GetRest(const char* p, const char* end)
+	{
+		p = SkipSpaces(p, end);
+		while (end > p && IsSpace(end[-1])) end--;
+		return { p, size_t(end - p) };
+	}
+
+	// 1 based, negative counts back from the last element before the face. Turned into 0 based, -1 for none.
+	int32_t Resolve(int64_t index, uint32_t count)
+	{
+		if (index > 0) return int32_t(index - 1);
+		if (index < 0) return int32_t(int64_t(count) + index);
+		return -1;
+	}
+
+	void CountChunk(Chunk& chunk)
+	{
+		for (const char* line = chunk.Begin; line < chunk.End;)
+		{
+			auto next = static_cast<const char*>(memchr(line, '\n', size_t(chunk.End - line)));
+			const char* lineEnd = next ? next : chunk.End;
+			const char* p = SkipSpaces(line, lineEnd);
+			if (lineEnd - p >= 2 && p[0] == 'v')
+			{
+				chunk.Positions += IsSpace(p[1]);
+				chunk.UVs += p[1] == 't';
+				chunk.Normals += p[1] == 'n';
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	void ParseChunk(Chunk& chunk, XMFLOAT3* positions, XMFLOAT2* uvs, XMFLOAT3* normals)
+	{
+		uint32_t position = chunk.FirstPosition;
+		uint32_t uv = chunk.FirstUV;
+		uint32_t normal = chunk.FirstNormal;
+		for (const char* line = chunk.Begin; line < chunk.End;)
+		{
+			auto next = static_cast<const char*>(memchr(line, '\n', size_t(chunk.End - line)));
+			const char* end = next ? next : chunk.End;
+			const char* p = SkipSpaces(line, end);
+			line = end + 1;
+			if (end - p < 2) continue;
+
+			// The importer's left handed conversion: z mirrored, V flipped, faces reversed
+			if (p[0] == 'v' && IsSpace(p[1]))
+			{
+				XMFLOAT3& out = positions[position++];
+				p = ParseFloat(SkipSpaces(p + 2, end), end, out.x);
+				p = ParseFloat(SkipSpaces(p, end), end, out.y);
+				ParseFloat(SkipSpaces(p, end), end, out.z);
+				out.z = -out.z;
+			}
+			else if (p[0] == 'v' && p[1] == 't')
+			{
+				XMFLOAT2& out = uvs[uv++];
+				p = ParseFloat(SkipSpaces(p + 2, end), end, out.x);
+				ParseFloat(SkipSpaces(p, end), end, out.y);
+				out.y = 1.f - out.y;
+			}
+			else if (p[0] == 'v' && p[1] == 'n')
+			{
+				XMFLOAT3& out = normals[normal++];
+				p = ParseFloat(SkipSpaces(p + 2, end), end, out.x);
+				p = ParseFloat(SkipSpaces(p, end), end, out.y);
+				ParseFloat(SkipSpaces(p, end), end, out.z);
+				out.z = -out.z;
+			}
+			else if (p[0] == 'f' && IsSpace(p[1]))
+			{
+				for (p = SkipSpaces(p + 2, end); p < end && (IsDigit(*p) || *p == '-' || *p == '+'); p = SkipSpaces(p, end))
+				{
+					int64_t indices[3] = {};
+					p = ParseIndex(p, end, indices[0]);
+					for (uint32_t i = 1; i < 3 && p < end && *p == '/'; i++)
+					{
+						p = ParseIndex(p + 1, end, indices[i]);
+					}
+					chunk.Corners.push_back({ Resolve(indices[0], position), Resolve(indices[1], uv), Resolve(indices[2], normal) });
+				}
+				chunk.Faces.push_back(uint32_t(chunk.Corners.size()));
+			}
+			else if (end - p > 6 && !strncmp(p, "usemtl", 6) && IsSpace(p[6]))
+			{
+				chunk.Groups.push_back({ uint32_t(chunk.Faces.size() - 1), std::string(GetRest(p + 6, end)), false });
+			}
+			else if ((p[0] == 'o' || p[0] == 'g') && IsSpace(p[1]))
+			{
+				chunk.Groups.push_back({ uint32_t(chunk.Faces.size() - 1), {}, true });
+			}
+			else if (end - p > 6 && !strncmp(p, "mtllib", 6) && IsSpace(p[6]))
+			{
+				chunk.Libraries.emplace_back(GetRest(p + 6, end));
+			}
+		}
+	}
+
+	// Options like -bm 0.5 come before the file, which is the last word then
+	std::string GetTexturePath(std::string_view rest)
+	{
+		if (rest.size() && rest[0] == '-')
+		{
+			size_t space = rest.find_last_of(" \t");
+			if (space != std::string_view::npos) rest = rest.substr(space + 1);
+		}
+		return std::string(rest);
+	}
+
+	// A library that can't be opened is skipped, and isn't a dependency either
+	void ParseLibrary(const std::string& path, SourceScene& scene, std::unordered_map<std::string, uint32_t>& names)
+	{
+		MappedFile file;
+		try { file = MappedFile(path); }
+		catch (const std::exception&) { return; }
+		scene.Dependencies.push_back({ path, Hash::Bytes(file.Data, file.Size) });
+		auto& materials = scene.Materials;
+
+		SourceMaterial* material = nullptr;
+		auto data = reinterpret_cast<const char*>(file.Data);
+		for (const char* line = data; line < data + file.Size;)
+		{
+			auto next = static_cast<const char*>(memchr(line, '\n', size_t(data + file.Size - line)));
+			const char* end = next ? next : data + file.Size;
+			const char* p = SkipSpaces(line, end);
+			line = end + 1;
+
+			const char* word = p;
+			while (p < end && !IsSpace(*p)) p++;
+			std::string_view key(word, size_t(p - word));
+			if (key == "newmtl")
+			{
+				std::string name(GetRest(p, end));
+				auto [it, inserted] = names.try_emplace(name, uint32_t(materials.size()));
+				// Assimp's default diffuse for materials without Kd
+				if (inserted)
+				{
+					materials.push_back({});
+					materials.back().Diffuse = { 0.6f, 0.6f, 0.6f };
+				}
+				material = &materials[it->second];
+			}
+			else if (!material) continue;
+			else if (key == "Kd" || key == "Ks")
+			{
+				XMFLOAT3& color = key == "Kd" ? material->Diffuse : material->SpecularColor;
+				p = ParseFloat(SkipSpaces(p, end), end, color.x);
+				p = ParseFloat(SkipSpaces(p, end), end, color.y);
+				ParseFloat(SkipSpaces(p, end), end, color.z);
+			}
+			// The importer reads specular from the ambient slot, like assimp's mapping of map_Ka
+			else if (key == "map_Kd") material->Albedo.Path = GetTexturePath(GetRest(p, end));
+			else if (key == "map_Ka") material->Specular.Path = GetTexturePath(GetRest(p, end));
+			else if (key == "map_bump" || key == "map_Bump" || key == "bump") material->Bump.Path = GetTexturePath(GetRest(p, end));
+		}
+	}
+
+	// Corners that repeat the same position, UV and normal share a vertex, like assimp's reader
+	SourceMesh BuildMesh(const MeshRanges& ranges, uint32_t material, const std::vector<Chunk>& chunks, const std::vector<XMFLOAT3>& positions,
+		const std::vector<XMFLOAT2>& uvs, const std::vector<XMFLOAT3>& normals)
+	{
+		SourceMesh mesh;
+		mesh.Material = material;
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		mesh.Placements.push_back(identity);
+
+		uint32_t cornerCount = 0;
+		for (const auto& range : ranges.Ranges)
+		{
+			const auto& faces = chunks[range.Chunk].Faces;
+			cornerCount += faces[range.EndFace] - faces[range.FirstFace];
+		}
+		uint32_t mask = std::bit_ceil((std::max)(cornerCount * 2, 2u)) - 1;
+		std::vector<uint32_t> table(size_t(mask) + 1, ~0u);
+		std::vector<Corner> keys;
+		keys.reserve(cornerCount);
+
+		mesh.HasNormals = true;
+		std::vector<uint32_t> polygon;
+		for (const auto& range : ranges.Ranges)
+		{
+			const auto& chunk = chunks[range.Chunk];
+			for (uint32_t f = range.FirstFace; f < range.EndFace; f++)
+			{
+				polygon.clear();
+				for (uint32_t c = chunk.Faces[f]; c < chunk.Faces[f + 1]; c++)
+				{
+					const Corner& corner = chunk.Corners[c];
+					if (uint32_t(corner.Position) >= positions.size() || (corner.UV >= 0 && uint32_t(corner.UV) >= uvs.size()) ||
+						(corner.Normal >= 0 && uint32_t(corner.Normal) >= normals.size()))
+					{
+						throw std::runtime_error("OBJ face references a vertex that doesn't exist");
+					}
+
+					uint32_t hash = uint32_t((corner.Position * 0x9e3779b1u) ^ (corner.UV * 0x85ebca6bu) ^ (corner.Normal * 0xc2b2ae35u));
+					uint32_t slot = (hash ^ hash >> 15) & mask;
+					while (table[slot] != ~0u && memcmp(&keys[table[slot]], &corner, sizeof(Corner)))
+					{
+						slot = (slot + 1) & mask;
+					}
+					if (table[slot] == ~0u)
+					{
+						table[slot] = uint32_t(keys.size());
+						keys.push_back(corner);
+
+						Vertex vertex{};
+						vertex.Position = positions[corner.Position];
+						if (corner.Normal >= 0) vertex.Normal = normals[corner.Normal];
+						if (corner.UV >= 0) vertex.UV = uvs[corner.UV];
+						mesh.Vertices.push_back(vertex);
+						mesh.HasNormals &= corner.Normal >= 0;
+						mesh.HasUVs |= corner.UV >= 0;
+					}
+					polygon.push_back(table[slot]);
+				}
+
+				// With the winding reversed
+				std::reverse(polygon.begin(), polygon.end());
+				Geometry::Triangulate(mesh.Vertices, polygon, mesh.Indices);
+			}
+		}
+		return mesh;
+	}
+
+	SourceScene Load(const std::string& path, ImportStats& stats)
+	{
+		MappedFile file(path);
+		auto data = reinterpret_cast<const char*>(file.Data);
+
+		// Line aligned chunks, enough of them to balance lines of different cost
+		std::vector<Chunk> chunks;
+		{
+			constexpr size_t minChunk = 1 << 20;
+			size_t count = std::clamp(file.Size / minChunk, size_t(1), size_t(Jobs::ThreadCount()) * 8);
+			const char* begin = data;
+			for (size_t i = 1; i <= count && begin < data + file.Size; i++)
+			{
+				const char* end = data + file.Size * i / count;
+				if (i < count)
+				{
+					auto newline = static_cast<const char*>(memchr(end, '\n', size_t(data + file.Size - end)));
+					end = newline ? newline + 1 : data + file.Size;
+				}
+				if (end <= begin) continue;
+				chunks.push_back({ begin, end });
+				begin = end;
+			}
+		}
+		uint32_t chunkCount = uint32_t(chunks.size());
+
+		{
+			ScopedStage stage(stats, "OBJ count", chunkCount);
+			Jobs::ParallelFor(chunkCount, [&](uint32_t i)
+				{
+					stats.Step();
+					CountChunk(chunks[i]);
+				});
+		}
+		uint32_t positionCount = 0;
+		uint32_t uvCount = 0;
+		uint32_t normalCount = 0;
+		for (auto& chunk : chunks)
+		{
+			chunk.FirstPosition = positionCount;
+			chunk.FirstUV = uvCount;
+			chunk.FirstNormal = normalCount;
+			positionCount += chunk.Positions;
+			uvCount += chunk.UVs;
+			normalCount += chunk.Normals;
+		}
+
+		std::vector<XMFLOAT3> positions(positionCount);
+		std::vector<XMFLOAT2> uvs(uvCount);
+		std::vector<XMFLOAT3> normals(normalCount);
+		{
+			ScopedStage stage(stats, "OBJ parse", chunkCount);
+			auto start = std::chrono::high_resolution_clock::now();
+			Jobs::ParallelFor(chunkCount, [&](uint32_t i)
+				{
+					stats.Step();
+					ParseChunk(chunks[i], positions.data(), uvs.data(), normals.data());
+				});
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			stats.Add("OBJ parse (MiB/s)", double(file.Size) / (1024.0 * 1024.0) / (std::max)(seconds, 1e-9));
+		}
+
+		SourceScene scene;
+		std::unordered_map<std::string, uint32_t> names;
+		{
+			ScopedStage stage(stats, "MTL");
+			auto directory = std::filesystem::u8path(path).parent_path();
+			for (const auto& chunk : chunks)
+			{
+				for (const auto& library : chunk.Libraries)
+				{
+					auto libraryPath = (directory / std::filesystem::u8path(library)).u8string();
+					std::string path(libraryPath.begin(), libraryPath.end());
+					// Chunks that each name the same library read it once
+					auto read = [&](const SourceDependency& dependency) { return dependency.Path == path; };
+					if (std::none_of(scene.Dependencies.begin(), scene.Dependencies.end(), read)) ParseLibrary(path, scene, names);
+				}
+			}
+		}
+
+		// A new mesh at every object, group or material change, continuing across chunks
+		std::vector<MeshRanges> meshes(1);
+		for (uint32_t c = 0; c < chunkCount; c++)
+		{
+			const auto& chunk = chunks[c];
+			uint32_t faceCount = uint32_t(chunk.Faces.size() - 1);
+			uint32_t first = 0;
+			auto close = [&](uint32_t end)
+			{
+				if (end > first) meshes.back().Ranges.push_back({ c, first, end });
+				first = end;
+			};
+			for (const auto& group : chunk.Groups)
+			{
+				close(group.Face);
+				auto material = group.IsObject ? meshes.back().Material : group.Material;
+				if (meshes.back().Ranges.size()) meshes.push_back({ std::move(material) });
+				else meshes.back().Material = std::move(material);
+			}
+			close(faceCount);
+		}
+		if (meshes.back().Ranges.empty()) meshes.pop_back();
+
+		// Faces before any usemtl or with an unknown one get a default material, as with assimp
+		std::vector<uint32_t> materials(meshes.size());
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			auto it = names.find(meshes[m].Material);
+			if (it == names.end())
+			{
+				it = names.try_emplace("", uint32_t(scene.Materials.size())).first;
+				if (it->second == scene.Materials.size())
+				{
+					scene.Materials.push_back({});
+					scene.Materials.back().Diffuse = { 0.6f, 0.6f, 0.6f };
+				}
+			}
+			materials[m] = it->second;
+		}
+
+		{
+			ScopedStage stage(stats, "OBJ meshes", uint32_t(meshes.size()));
+			scene.Meshes.resize(meshes.size());
+			Jobs::ParallelFor(uint32_t(meshes.size()), [&](uint32_t m)
+				{
+					stats.Step();
+					scene.Meshes[m] = BuildMesh(meshes[m], materials[m], chunks, positions, uvs, normals);
+				});
+		}
+		stats.Add("OBJ chunks", chunkCount);
+		return scene;
+	}
+
+}
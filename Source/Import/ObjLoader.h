@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+#include "SourceScene.h"
+
+// Wavefront OBJ and MTL without assimp. The file is mapped and split into chunks at line boundaries that are
+// counted, then parsed on every thread, so nothing but the final arrays is allocated per element.
+// The result matches assimp's reader with the importer's left handed conversion.
+namespace ObjLoader
+{
+
+	bool IsObj(const std::string& path);
+
+	// One mesh per run of faces with the same object, group and material, each placed once where it is.
+	// Throws std::runtime_error for faces that reference elements that don't exist.
+	SourceScene Load(const std::string& path, ImportStats& stats);
+
+	// Locale independent decimal parser, returns the first character after the number
+	const char* ParseFloat(const char* begin, const char* end, float& value);
+
+}
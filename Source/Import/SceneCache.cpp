@@ -0,0 +1,383 @@
+#include "SceneCache.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "Hash.h"
+
+namespace SceneCache
+{
+
+	constexpr uint32_t m_Magic = uint32_t('V') | uint32_t('X') << 8 | uint32_t('S') << 16 | uint32_t('C') << 24;
+	constexpr uint64_t m_Alignment = 64;
+
+	enum SectionID : uint32_t
+	{
+		Vertices,
+		Positions,
+		CompactVertices,
+		Quantization,
+		Indices,
+		Materials,
+		Instances,
+		Clusters,
+		BvhNodes,
+		BvhPrimitives,
+		Lods,
+		Textures,
+		Pixels,
+		TextureSources,
+		Dependencies,
+		Strings,
+		SectionCount
+	};
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SourceSize;
+		int64_t SourceTime;
+		uint64_t SourceHash;
+		uint32_t SectionCount;
+		uint32_t Options;
+		Box Bounds;
+	};
+
+	struct Section
+	{
+		uint32_t ID;
+		uint32_t Stride;
+		uint64_t Offset;
+		uint64_t Size;
+	};
+
+	struct CachedTexture
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t MipLevels;
+		TextureFormat Format;
+		uint64_t Offset;
+		uint64_t Size;
+	};
+
+	// Size and time as in Header, Path is a range of the Strings section
+	struct CachedSource
+	{
+		uint64_t Size;
+		int64_t Time;
+		uint64_t Hash;
+		uint64_t PathOffset;
+		uint32_t PathSize;
+		uint32_t Texture;
+		TextureUsage Usage;
+		uint8_t Padding[7];
+	};
+
+	struct CachedDependency
+	{
+		uint64_t Size;
+		int64_t Time;
+		uint64_t Hash;
+		uint64_t PathOffset;
+		uint32_t PathSize;
+		uint32_t Padding;
+	};
+
+	struct SourceInfo
+	{
+		uint64_t Size;
+		int64_t Time;
+	};
+
+	SourceInfo GetSourceInfo(const std::string& sourcePath)
+	{
+		auto path = std::filesystem::u8path(sourcePath);
+		return {
+			uint64_t(std::filesystem::file_size(path)),
+			int64_t(std::filesystem::last_write_time(path).time_since_epoch().count())
+		};
+	}
+
+	// Zeros for a file that can't be read
+	SourceInfo GetFileInfo(const std::string& filePath)
+	{
+		std::error_code sizeError, timeError;
+		auto path = std::filesystem::u8path(filePath);
+		auto size = std::filesystem::file_size(path, sizeError);
+		auto time = std::filesystem::last_write_time(path, timeError);
+		return { sizeError ? 0 : uint64_t(size), timeError ? 0 : int64_t(time.time_since_epoch().count()) };
+	}
+
+	// A file that was deleted counts as changed. The salt is what the cached hash was xored with.
+	bool IsFileChanged(const std::string& path, uint64_t size, int64_t time, uint64_t hash, uint64_t salt)
+	{
+		std::error_code error;
+		auto currentSize = std::filesystem::file_size(std::filesystem::u8path(path), error);
+		if (error || currentSize != size) return true;
+
+		auto currentTime = std::filesystem::last_write_time(std::filesystem::u8path(path), error);
+		if (error) return true;
+		if (int64_t(currentTime.time_since_epoch().count()) == time) return false;
+
+		MappedFile file(path);
+		return (Hash::Bytes(file.Data, file.Size) ^ salt) != hash;
+	}
+
+	// Solid colors have no file, they change with the scene file
+	bool IsSourceChanged(const std::string& path, const CachedSource& source)
+	{
+		return !path.empty() && IsFileChanged(path, source.Size, source.Time, source.Hash, uint64_t(source.Usage) << 56);
+	}
+
+	uint64_t HashSource(const std::string& sourcePath)
+	{
+		MappedFile source(sourcePath);
+		return Hash::Bytes(source.Data, source.Size);
+	}
+
+	std::string GetPath(const std::string& sourcePath)
+	{
+		return sourcePath + ".vxscene";
+	}
+
+	template<typename T>
+	std::span<const T> GetSection(const MappedFile& file, const Section& section)
+	{
+		return { reinterpret_cast<const T*>(file.Data + section.Offset), size_t(section.Size / sizeof(T)) };
+	}
+
+	std::optional<File> Open(const std::string& sourcePath, const ImportOptions& options, bool checkSources)
+	{
+		auto cachePath = GetPath(sourcePath);
+		if (!std::filesystem::exists(std::filesystem::u8path(cachePath))) return std::nullopt;
+
+		File file{ MappedFile(cachePath) };
+		const auto& mapping = file.Mapping;
+		if (mapping.Size < sizeof(Header)) return std::nullopt;
+
+		auto header = reinterpret_cast<const Header*>(mapping.Data);
+		if (header->Magic != m_Magic || header->Version != Version || header->SectionCount != SectionCount ||
+			(checkSources ? header->Options != options.GetFlags() : (header->Options ^ options.GetFlags()) & ImportOptions::AtlasFlag))
+		{
+			return std::nullopt;
+		}
+
+		// mtime is the fast path, the hash catches files that were touched or copied without changing
+		if (checkSources)
+		{
+			auto source = GetSourceInfo(sourcePath);
+			if (source.Size != header->SourceSize) return std::nullopt;
+			if (source.Time != header->SourceTime && HashSource(sourcePath) != header->SourceHash) return std::nullopt;
+		}
+
+		auto sections = reinterpret_cast<const Section*>(mapping.Data + sizeof(Header));
+		if (sizeof(Header) + sizeof(Section) * SectionCount > mapping.Size) return std::nullopt;
+
+		const uint32_t strides[] = {
+			sizeof(Vertex), sizeof(DirectX::XMFLOAT3), sizeof(CompactVertex), sizeof(VertexQuantization),
+			sizeof(uint32_t), sizeof(MaterialData), sizeof(InstanceData), sizeof(ClusterData), sizeof(BvhNode), sizeof(uint32_t),
+			sizeof(LodData), sizeof(CachedTexture), 1, sizeof(CachedSource), sizeof(CachedDependency), 1
+		};
+		for (uint32_t i = 0; i < SectionCount; i++)
+		{
+			if (sections[i].ID != i || sections[i].Stride != strides[i] ||
+				sections[i].Offset + sections[i].Size > mapping.Size)
+			{
+				return std::nullopt;
+			}
+		}
+
+		file.View.Vertices = GetSection<Vertex>(mapping, sections[Vertices]);
+		file.View.Positions = GetSection<DirectX::XMFLOAT3>(mapping, sections[Positions]);
+		if (file.View.Positions.size() != file.View.Vertices.size()) return std::nullopt;
+		file.View.CompactVertices = GetSection<CompactVertex>(mapping, sections[CompactVertices]);
+		file.View.Quantization = GetSection<VertexQuantization>(mapping, sections[Quantization]);
+		file.View.Indices = GetSection<uint32_t>(mapping, sections[Indices]);
+		file.View.Materials = GetSection<MaterialData>(mapping, sections[Materials]);
+		file.View.Instances = GetSection<InstanceData>(mapping, sections[Instances]);
+		file.View.Clusters = GetSection<ClusterData>(mapping, sections[Clusters]);
+		file.View.ClusterNodes = GetSection<BvhNode>(mapping, sections[BvhNodes]);
+		file.View.ClusterOrder = GetSection<uint32_t>(mapping, sections[BvhPrimitives]);
+		file.View.Lods = GetSection<LodData>(mapping, sections[Lods]);
+		file.View.Bounds = header->Bounds;
+
+		auto pixels = GetSection<uint8_t>(mapping, sections[Pixels]);
+		auto textures = GetSection<CachedTexture>(mapping, sections[Textures]);
+		file.View.Textures.reserve(textures.size());
+		for (const auto& texture : textures)
+		{
+			if (texture.Offset + texture.Size > pixels.size() || !texture.MipLevels || texture.MipLevels > 15) return std::nullopt;
+			file.View.Textures.push_back({
+				texture.Width, texture.Height, texture.MipLevels, texture.Format, pixels.subspan(texture.Offset, texture.Size)
+			});
+		}
+
+		auto strings = GetSection<char>(mapping, sections[Strings]);
+		auto sources = GetSection<CachedSource>(mapping, sections[TextureSources]);
+		file.View.TextureSources.reserve(sources.size());
+		for (const auto& source : sources)
+		{
+			if (source.PathOffset + source.PathSize > strings.size() || source.Texture >= textures.size()) return std::nullopt;
+
+			std::string path(strings.data() + source.PathOffset, source.PathSize);
+			if (checkSources && IsSourceChanged(path, source)) return std::nullopt;
+			file.View.TextureSources.push_back({ std::move(path), source.Usage, source.Texture, source.Hash });
+		}
+
+		auto dependencies = GetSection<CachedDependency>(mapping, sections[Dependencies]);
+		file.View.Dependencies.reserve(dependencies.size());
+		for (const auto& dependency : dependencies)
+		{
+			if (dependency.PathOffset + dependency.PathSize > strings.size()) return std::nullopt;
+
+			std::string path(strings.data() + dependency.PathOffset, dependency.PathSize);
+			if (checkSources && IsFileChanged(path, dependency.Size, dependency.Time, dependency.Hash, 0)) return std::nullopt;
+			file.View.Dependencies.push_back({ std::move(path), dependency.Hash });
+		}
+
+		return file;
+	}
+
+	void Write(const std::string& sourcePath, const SceneView& scene, const ImportOptions& options)
+	{
+		auto source = GetSourceInfo(sourcePath);
+
+		std::vector<CachedTexture> textures;
+		textures.reserve(scene.Textures.size());
+		uint64_t pixelSize = 0;
+		for (const auto& texture : scene.Textures)
+		{
+			textures.push_back({ texture.Width, texture.Height, texture.MipLevels, texture.Format, pixelSize, texture.Pixels.size() });
+			pixelSize += texture.Pixels.size();
+		}
+
+		std::vector<CachedSource> sources;
+		sources.reserve(scene.TextureSources.size());
+		std::string strings;
+		for (const auto& source : scene.TextureSources)
+		{
+			auto info = GetFileInfo(source.Path);
+			sources.push_back({
+				.Size = info.Size,
+				.Time = info.Time,
+				.Hash = source.Hash,
+				.PathOffset = strings.size(),
+				.PathSize = uint32_t(source.Path.size()),
+				.Texture = source.Texture,
+				.Usage = source.Usage
+			});
+			strings += source.Path;
+		}
+
+		std::vector<CachedDependency> dependencies;
+		dependencies.reserve(scene.Dependencies.size());
+		for (const auto& dependency : scene.Dependencies)
+		{
+			auto info = GetFileInfo(dependency.Path);
+			dependencies.push_back({ info.Size, info.Time, dependency.Hash, strings.size(), uint32_t(dependency.Path.size()) });
+			strings += dependency.Path;
+		}
+
+		Header header{
+			.Magic = m_Magic,
+			.Version = Version,
+			.SourceSize = source.Size,
+			.SourceTime = source.Time,
+			.SourceHash = HashSource(sourcePath),
+			.SectionCount = SectionCount,
+			.Options = options.GetFlags(),
+			.Bounds = scene.Bounds
+		};
+
+		Section sections[SectionCount] = {
+			{ Vertices, sizeof(Vertex), 0, scene.Vertices.size_bytes() },
+			{ Positions, sizeof(DirectX::XMFLOAT3), 0, scene.Positions.size_bytes() },
+			{ CompactVertices, sizeof(CompactVertex), 0, scene.CompactVertices.size_bytes() },
+			{ Quantization, sizeof(VertexQuantization), 0, scene.Quantization.size_bytes() },
+			{ Indices, sizeof(uint32_t), 0, scene.Indices.size_bytes() },
+			{ Materials, sizeof(MaterialData), 0, scene.Materials.size_bytes() },
+			{ Instances, sizeof(InstanceData), 0, scene.Instances.size_bytes() },
+			{ Clusters, sizeof(ClusterData), 0, scene.Clusters.size_bytes() },
+			{ BvhNodes, sizeof(BvhNode), 0, scene.ClusterNodes.size_bytes() },
+			{ BvhPrimitives, sizeof(uint32_t), 0, scene.ClusterOrder.size_bytes() },
+			{ Lods, sizeof(LodData), 0, scene.Lods.size_bytes() },
+			{ Textures, sizeof(CachedTexture), 0, textures.size() * sizeof(CachedTexture) },
+			{ Pixels, 1, 0, pixelSize },
+			{ TextureSources, sizeof(CachedSource), 0, sources.size() * sizeof(CachedSource) },
+			{ Dependencies, sizeof(CachedDependency), 0, dependencies.size() * sizeof(CachedDependency) },
+			{ Strings, 1, 0, strings.size() }
+		};
+		uint64_t offset = sizeof(Header) + sizeof(sections);
+		for (auto& section : sections)
+		{
+			offset = (offset + m_Alignment - 1) & ~(m_Alignment - 1);
+			section.Offset = offset;
+			offset += section.Size;
+		}
+
+		// Written to a temporary first so a crash never leaves a truncated cache that looks valid
+		auto cachePath = std::filesystem::u8path(GetPath(sourcePath));
+		auto tempPath = cachePath;
+		tempPath += ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out) return;
+
+			auto pad = [&](uint64_t to)
+			{
+				static const char zeros[m_Alignment] = {};
+				out.write(zeros, std::streamsize(to - uint64_t(out.tellp())));
+			};
+			auto write = [&](const void* data, uint64_t size)
+			{
+				out.write(static_cast<const char*>(data), std::streamsize(size));
+			};
+
+			write(&header, sizeof(header));
+			write(sections, sizeof(sections));
+			pad(sections[Vertices].Offset);
+			write(scene.Vertices.data(), sections[Vertices].Size);
+			pad(sections[Positions].Offset);
+			write(scene.Positions.data(), sections[Positions].Size);
+			pad(sections[CompactVertices].Offset);
+			write(scene.CompactVertices.data(), sections[CompactVertices].Size);
+			pad(sections[Quantization].Offset);
+			write(scene.Quantization.data(), sections[Quantization].Size);
+			pad(sections[Indices].Offset);
+			write(scene.Indices.data(), sections[Indices].Size);
+			pad(sections[Materials].Offset);
+			write(scene.Materials.data(), sections[Materials].Size);
+			pad(sections[Instances].Offset);
+			write(scene.Instances.data(), sections[Instances].Size);
+			pad(sections[Clusters].Offset);
+			write(scene.Clusters.data(), sections[Clusters].Size);
+			pad(sections[BvhNodes].Offset);
+			write(scene.ClusterNodes.data(), sections[BvhNodes].Size);
+			pad(sections[BvhPrimitives].Offset);
+			write(scene.ClusterOrder.data(), sections[BvhPrimitives].Size);
+			pad(sections[Lods].Offset);
+			write(scene.Lods.data(), sections[Lods].Size);
+			pad(sections[Textures].Offset);
+			write(textures.data(), sections[Textures].Size);
+			pad(sections[Pixels].Offset);
+			for (const auto& texture : scene.Textures)
+			{
+				write(texture.Pixels.data(), texture.Pixels.size());
+			}
+			pad(sections[TextureSources].Offset);
+			write(sources.data(), sections[TextureSources].Size);
+			pad(sections[Dependencies].Offset);
+			write(dependencies.data(), sections[Dependencies].Size);
+			pad(sections[Strings].Offset);
+			write(strings.data(), sections[Strings].Size);
+
+			if (!out) return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+	}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "MappedFile.h"
+#include "SceneData.h"
+
+// Baked .vxscene files, written next to the source asset after an import.
+// Layout: Header, Section table, then 64 byte aligned section payloads that are used in place through a mapping.
+namespace SceneCache
+{
+
+	constexpr uint32_t Version = 15;
+
+	struct File
+	{
+		MappedFile Mapping;
+		SceneView View;
+	};
+
+	std::string GetPath(const std::string& sourcePath);
+
+	// Returns nothing if there is no cache, or if it is from another version, different options or a different source file,
+	// texture or SourceDependency. Without checkSources only the version and ImportOptions::AtlasTextures are checked, for reusing the
+	// textures of an outdated cache.
+	std::optional<File> Open(const std::string& sourcePath, const ImportOptions& options = {}, bool checkSources = true);
+	void Write(const std::string& sourcePath, const SceneView& scene, const ImportOptions& options = {});
+
+}
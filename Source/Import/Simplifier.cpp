@@ -0,0 +1,521 @@
+#include "Simplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <unordered_map>
+
+#include "Jobs.h"
+#include "MeshOptimizer.h"
+
+namespace Simplifier
+{
+
+	using namespace DirectX;
+
+	// Open edges resist being moved this much more than surfaces do
+	constexpr double m_BoundaryWeight = 10.0;
+	// How far off the line through its border neighbours an open edge vertex may be and still collapse, relative to
+	// their distance
+	constexpr float m_MaxBorderSine = 1e-4f;
+	// Triangles whose normal turns further than this on a collapse are folding over
+	constexpr float m_MinNormalDot = 0.2f;
+
+	// Symmetric 4x4 matrix of the sum of squared distances to a set of planes
+	struct Quadric
+	{
+		double A2 = 0.0, AB = 0.0, AC = 0.0, AD = 0.0;
+		double B2 = 0.0, BC = 0.0, BD = 0.0;
+		double C2 = 0.0, CD = 0.0;
+		double D2 = 0.0;
+
+		void AddPlane(double a, double b, double c, double d, double weight)
+		{
+			A2 += a * a * weight; AB += a * b * weight; AC += a * c * weight; AD += a * d * weight;
+			B2 += b * b * weight; BC += b * c * weight; BD += b * d * weight;
+			C2 += c * c * weight; CD += c * d * weight;
+			D2 += d * d * weight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			A2 += other.A2; AB += other.AB; AC += other.AC; AD += other.AD;
+			B2 += other.B2; BC += other.BC; BD += other.BD;
+			C2 += other.C2; CD += other.CD;
+			D2 += other.D2;
+		}
+
+		double Evaluate(const XMFLOAT3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double error = A2 * x * x + 2.0 * AB * x * y + 2.0 * AC * x * z + 2.0 * AD * x
+				+ B2 * y * y + 2.0 * BC * y * z + 2.0 * BD * y
+				+ C2 * z * z + 2.0 * CD * z
+				+ D2;
+			return (std::max)(error, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		double Cost;
+		uint32_t From;
+		uint32_t To;
+		uint32_t FromVersion;
+		uint32_t ToVersion;
+
+		bool operator>(const Collapse& other) const { return Cost > other.Cost; }
+	};
+
+	class Mesh
+	{
+	public:
+		Mesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+			: m_Vertices(vertices)
+		{
+			Weld();
+
+			m_Triangles.reserve(indices.size() / 3);
+			m_Corners.reserve(indices.size());
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				uint32_t a = m_Weld[indices[i]], b = m_Weld[indices[i + 1]], c = m_Weld[indices[i + 2]];
+				if (a == b || b == c || a == c) continue;
+
+				m_Triangles.push_back({ a, b, c });
+				m_Corners.insert(m_Corners.end(), { indices[i], indices[i + 1], indices[i + 2] });
+			}
+			m_Dead.assign(m_Triangles.size(), false);
+			m_Live = uint32_t(m_Triangles.size());
+
+			m_Adjacency.resize(m_Positions.size());
+			for (uint32_t t = 0; t < m_Triangles.size(); t++)
+			{
+				for (uint32_t v : m_Triangles[t]) m_Adjacency[v].push_back(t);
+			}
+
+			BuildQuadrics();
+			m_Version.assign(m_Positions.size(), 0);
+			m_Removed.assign(m_Positions.size(), false);
+			for (uint32_t t = 0; t < m_Triangles.size(); t++)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t a = m_Triangles[t][k], b = m_Triangles[t][(k + 1) % 3];
+					// Each interior edge is seen from both triangles, only push it once
+					if (a < b || IsBoundary(a, b)) Push(a, b);
+				}
+			}
+		}
+
+		uint32_t GetLive() const { return m_Live; }
+
+		// Collapses the cheapest edges until at most target triangles are left. False if nothing more can collapse.
+		bool Reduce(uint32_t target)
+		{
+			while (m_Live > target)
+			{
+				if (m_Queue.empty()) return false;
+
+				auto collapse = m_Queue.top();
+				m_Queue.pop();
+				if (m_Removed[collapse.From] || m_Removed[collapse.To] ||
+					m_Version[collapse.From] != collapse.FromVersion || m_Version[collapse.To] != collapse.ToVersion)
+				{
+					continue;
+				}
+				if (!CanCollapse(collapse.From, collapse.To)) continue;
+
+				Apply(collapse.From, collapse.To);
+				m_Error = (std::max)(m_Error, collapse.Cost);
+			}
+			return true;
+		}
+
+		Level GetLevel() const
+		{
+			Level level;
+			level.Indices.reserve(size_t(m_Live) * 3);
+			for (uint32_t t = 0; t < m_Triangles.size(); t++)
+			{
+				if (m_Dead[t]) continue;
+				level.Indices.insert(level.Indices.end(), m_Corners.begin() + t * 3, m_Corners.begin() + t * 3 + 3);
+			}
+			level.Error = float(std::sqrt(m_Error));
+			return level;
+		}
+
+	private:
+		// Vertices split for UVs or normals become one, the simplification works on positions
+		void Weld()
+		{
+			m_Weld.resize(m_Vertices.size());
+			std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+			for (uint32_t v = 0; v < m_Vertices.size(); v++)
+			{
+				const auto& position = m_Vertices[v].Position;
+				uint32_t bits[3];
+				memcpy(bits, &position, sizeof(bits));
+				uint64_t key = (uint64_t(bits[0]) * 0x9e3779b1u) ^ (uint64_t(bits[1]) << 21) ^ (uint64_t(bits[2]) * 0x85ebca6bull << 7);
+
+				auto& bucket = buckets[key];
+				auto it = std::find_if(bucket.begin(), bucket.end(), [&](uint32_t w)
+					{
+						const auto& other = m_Positions[w];
+						return other.x == position.x && other.y == position.y && other.z == position.z;
+					});
+				if (it != bucket.end())
+				{
+					m_Weld[v] = *it;
+					continue;
+				}
+
+				m_Weld[v] = uint32_t(m_Positions.size());
+				bucket.push_back(m_Weld[v]);
+				m_Positions.push_back(position);
+			}
+
+			m_Members.resize(m_Positions.size());
+			for (uint32_t v = 0; v < m_Vertices.size(); v++)
+			{
+				m_Members[m_Weld[v]].push_back(v);
+			}
+		}
+
+		bool IsBoundary(uint32_t a, uint32_t b) const
+		{
+			uint32_t shared = 0;
+			for (uint32_t t : m_Adjacency[a])
+			{
+				if (m_Dead[t]) continue;
+				const auto& triangle = m_Triangles[t];
+				if (triangle[0] == b || triangle[1] == b || triangle[2] == b) shared++;
+			}
+			return shared == 1;
+		}
+
+		bool IsOnBorder(uint32_t v) const
+		{
+			for (uint32_t t : m_Adjacency[v])
+			{
+				if (m_Dead[t]) continue;
+				for (uint32_t other : m_Triangles[t])
+				{
+					if (other != v && IsBoundary(v, other)) return true;
+				}
+			}
+			return false;
+		}
+
+		// From lies between the two, on the line through them
+		bool IsBetween(uint32_t previous, uint32_t from, uint32_t to) const
+		{
+			XMVECTOR start = XMLoadFloat3(&m_Positions[previous]);
+			XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&m_Positions[to]), start);
+			XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&m_Positions[from]), start);
+			float lengthSq = XMVectorGetX(XMVector3LengthSq(edge));
+			float along = XMVectorGetX(XMVector3Dot(edge, offset));
+			float across = XMVectorGetX(XMVector3Length(XMVector3Cross(edge, offset)));
+			return along > 0.f && along < lengthSq && across <= m_MaxBorderSine * lengthSq;
+		}
+
+		XMVECTOR GetNormal(uint32_t t, uint32_t replace = ~0u, uint32_t with = ~0u) const
+		{
+			XMVECTOR p[3];
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t v = m_Triangles[t][k] == replace ? with : m_Triangles[t][k];
+				p[k] = XMLoadFloat3(&m_Positions[v]);
+			}
+			return XMVector3Cross(XMVectorSubtract(p[1], p[0]), XMVectorSubtract(p[2], p[0]));
+		}
+
+		void BuildQuadrics()
+		{
+			m_Quadrics.resize(m_Positions.size());
+			for (uint32_t t = 0; t < m_Triangles.size(); t++)
+			{
+				const auto& triangle = m_Triangles[t];
+				XMVECTOR normal = GetNormal(t);
+				float length = XMVectorGetX(XMVector3Length(normal));
+				if (length <= 0.f) continue;
+				normal = XMVectorScale(normal, 1.f / length);
+
+				XMFLOAT3 n;
+				XMStoreFloat3(&n, normal);
+				const auto& p0 = m_Positions[triangle[0]];
+				double d = -(double(n.x) * p0.x + double(n.y) * p0.y + double(n.z) * p0.z);
+				for (uint32_t v : triangle)
+				{
+					m_Quadrics[v].AddPlane(n.x, n.y, n.z, d, 1.0);
+				}
+
+				// A plane through each open edge, perpendicular to the triangle, keeps the border from moving inwards
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t a = triangle[k], b = triangle[(k + 1) % 3];
+					if (!IsBoundary(a, b)) continue;
+
+					XMVECTOR pa = XMLoadFloat3(&m_Positions[a]);
+					XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&m_Positions[b]), pa);
+					XMVECTOR side = XMVector3Normalize(XMVector3Cross(edge, normal));
+					XMFLOAT3 s, pa3;
+					XMStoreFloat3(&s, side);
+					XMStoreFloat3(&pa3, pa);
+					double sd = -(double(s.x) * pa3.x + double(s.y) * pa3.y + double(s.z) * pa3.z);
+					m_Quadrics[a].AddPlane(s.x, s.y, s.z, sd, m_BoundaryWeight);
+					m_Quadrics[b].AddPlane(s.x, s.y, s.z, sd, m_BoundaryWeight);
+				}
+			}
+		}
+
+		// Vertices can only move onto their neighbours, so the cheaper direction of the edge is queued. Border vertices
+		// mostly can't move at all, edges from one into the surface go towards it.
+		void Push(uint32_t a, uint32_t b)
+		{
+			Quadric sum = m_Quadrics[a];
+			sum.Add(m_Quadrics[b]);
+			double toB = sum.Evaluate(m_Positions[b]);
+			double toA = sum.Evaluate(m_Positions[a]);
+			bool aOnBorder = IsOnBorder(a), bOnBorder = IsOnBorder(b);
+			if (aOnBorder != bOnBorder ? bOnBorder : toB <= toA)
+			{
+				m_Queue.push({ toB, a, b, m_Version[a], m_Version[b] });
+			}
+			else
+			{
+				m_Queue.push({ toA, b, a, m_Version[b], m_Version[a] });
+			}
+		}
+
+		void GetNeighbours(uint32_t v, std::vector<uint32_t>& neighbours) const
+		{
+			neighbours.clear();
+			for (uint32_t t : m_Adjacency[v])
+			{
+				if (m_Dead[t]) continue;
+				for (uint32_t other : m_Triangles[t])
+				{
+					if (other != v) neighbours.push_back(other);
+				}
+			}
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		}
+
+		bool CanCollapse(uint32_t from, uint32_t to)
+		{
+			// Link condition: more than the two opposite vertices in common would pinch the surface
+			GetNeighbours(from, m_FromNeighbours);
+			GetNeighbours(to, m_ToNeighbours);
+			size_t shared = 0;
+			for (size_t i = 0, j = 0; i < m_FromNeighbours.size() && j < m_ToNeighbours.size();)
+			{
+				if (m_FromNeighbours[i] < m_ToNeighbours[j]) i++;
+				else if (m_FromNeighbours[i] > m_ToNeighbours[j]) j++;
+				else { shared++; i++; j++; }
+			}
+			if (shared > 2) return false;
+
+			// Open edges stay where they are, as the neighbouring material's border is simplified on its own. A border
+			// vertex only goes when it lies on a straight run of the border and moves along it, which leaves the
+			// border's shape as it was.
+			uint32_t border[2];
+			uint32_t borderCount = 0;
+			for (uint32_t neighbour : m_FromNeighbours)
+			{
+				if (!IsBoundary(from, neighbour)) continue;
+				if (borderCount == 2) return false;
+				border[borderCount++] = neighbour;
+			}
+			if (borderCount == 1) return false;
+			if (borderCount == 2)
+			{
+				if (border[0] != to && border[1] != to) return false;
+				if (!IsBetween(border[0] == to ? border[1] : border[0], from, to)) return false;
+			}
+
+			for (uint32_t t : m_Adjacency[from])
+			{
+				if (m_Dead[t]) continue;
+				const auto& triangle = m_Triangles[t];
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+				XMVECTOR before = XMVector3Normalize(GetNormal(t));
+				XMVECTOR after = GetNormal(t, from, to);
+				float length = XMVectorGetX(XMVector3Length(after));
+				if (length <= 0.f) return false;
+				if (XMVectorGetX(XMVector3Dot(before, after)) < m_MinNormalDot * length) return false;
+			}
+			return true;
+		}
+
+		// Picks the vertex at the new position whose UV is closest to the one the corner had
+		uint32_t GetCorner(uint32_t corner, uint32_t to) const
+		{
+			const auto& uv = m_Vertices[corner].UV;
+			uint32_t best = m_Members[to][0];
+			float bestDistance = FLT_MAX;
+			for (uint32_t v : m_Members[to])
+			{
+				float du = m_Vertices[v].UV.x - uv.x, dv = m_Vertices[v].UV.y - uv.y;
+				if (du * du + dv * dv < bestDistance)
+				{
+					bestDistance = du * du + dv * dv;
+					best = v;
+				}
+			}
+			return best;
+		}
+
+		void Apply(uint32_t from, uint32_t to)
+		{
+			for (uint32_t t : m_Adjacency[from])
+			{
+				if (m_Dead[t]) continue;
+				auto& triangle = m_Triangles[t];
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				{
+					m_Dead[t] = true;
+					m_Live--;
+					continue;
+				}
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					if (triangle[k] != from) continue;
+					triangle[k] = to;
+					m_Corners[t * 3 + k] = GetCorner(m_Corners[t * 3 + k], to);
+				}
+				m_Adjacency[to].push_back(t);
+			}
+			m_Adjacency[from].clear();
+			m_Removed[from] = true;
+			m_Quadrics[to].Add(m_Quadrics[from]);
+
+			// Dead triangles are dropped here too, so adjacency lists do not keep growing
+			auto& adjacency = m_Adjacency[to];
+			adjacency.erase(std::remove_if(adjacency.begin(), adjacency.end(), [&](uint32_t t) { return m_Dead[t]; }), adjacency.end());
+
+			m_Version[to]++;
+			GetNeighbours(to, m_ToNeighbours);
+			for (uint32_t neighbour : m_ToNeighbours)
+			{
+				Push(to, neighbour);
+			}
+		}
+
+		std::span<const Vertex> m_Vertices;
+		std::vector<uint32_t> m_Weld;
+		std::vector<XMFLOAT3> m_Positions;
+		std::vector<std::vector<uint32_t>> m_Members;
+
+		std::vector<std::array<uint32_t, 3>> m_Triangles;
+		std::vector<uint32_t> m_Corners;
+		std::vector<bool> m_Dead;
+		uint32_t m_Live;
+		std::vector<std::vector<uint32_t>> m_Adjacency;
+
+		std::vector<Quadric> m_Quadrics;
+		std::vector<uint32_t> m_Version;
+		std::vector<bool> m_Removed;
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_Queue;
+		double m_Error = 0.0;
+
+		std::vector<uint32_t> m_FromNeighbours;
+		std::vector<uint32_t> m_ToNeighbours;
+	};
+
+	std::vector<Level> BuildChain(std::span<const uint32_t> indices, std::span<const Vertex> vertices)
+	{
+		std::vector<Level> levels;
+		if (indices.size() / 3 < MinTriangles * 2) return levels;
+
+		Mesh mesh(indices, vertices);
+		uint32_t previous = uint32_t(indices.size() / 3);
+		while (levels.size() < MaxLods && previous / 2 >= MinTriangles)
+		{
+			bool reached = mesh.Reduce(previous / 2);
+			// Stuck meshes still give a level if they got at least a quarter smaller
+			if (!reached && mesh.GetLive() > previous * 3 / 4) break;
+
+			levels.push_back(mesh.GetLevel());
+			previous = mesh.GetLive();
+			if (!reached) break;
+		}
+		return levels;
+	}
+
+	void BuildLods(SceneData& data)
+	{
+		ScopedStage stage(data.Stats, "LOD generation", uint32_t(data.Materials.size()));
+
+		std::vector<std::vector<Level>> chains(data.Materials.size());
+		Jobs::ParallelFor(uint32_t(data.Materials.size()), [&](uint32_t i)
+			{
+				data.Stats.Step();
+				const auto& material = data.Materials[i];
+				std::span<const uint32_t> indices(data.Indices.data() + material.BaseIndex, material.IndexCount);
+				std::span<const Vertex> vertices(data.Vertices.data() + material.BaseVertex, material.VertexCount);
+				chains[i] = BuildChain(indices, vertices);
+
+				// Instanced materials are simplified in object space, their error grows with the largest instance
+				float scale = 1.f;
+				for (uint32_t j = material.BaseInstance; material.InstanceCount > 1 && j < material.BaseInstance + material.InstanceCount; j++)
+				{
+					const auto& m = data.Instances[j].Transform.m;
+					for (uint32_t axis = 0; axis < 3; axis++)
+					{
+						scale = (std::max)(scale, std::sqrt(m[0][axis] * m[0][axis] + m[1][axis] * m[1][axis] + m[2][axis] * m[2][axis]));
+					}
+				}
+				for (auto& level : chains[i])
+				{
+					level.Error *= scale;
+					MeshOptimizer::OptimizeTriangles(level.Indices, vertices);
+				}
+			});
+
+		double triangles[MaxLods] = {};
+		float errors[MaxLods] = {};
+		uint32_t counts[MaxLods] = {};
+		data.Lods.clear();
+		for (uint32_t i = 0; i < data.Materials.size(); i++)
+		{
+			for (uint32_t l = 0; l < chains[i].size(); l++)
+			{
+				auto& level = chains[i][l];
+				data.Lods.push_back({ uint32_t(data.Indices.size()), uint32_t(level.Indices.size()), i, level.Error });
+				data.Indices.insert(data.Indices.end(), level.Indices.begin(), level.Indices.end());
+
+				triangles[l] += double(level.Indices.size() / 3);
+				errors[l] = (std::max)(errors[l], level.Error);
+				counts[l]++;
+			}
+		}
+
+		// Materials without a level draw full detail instead, so they count towards every level
+		double full = 0.0;
+		for (const auto& material : data.Materials)
+		{
+			full += material.IndexCount / 3;
+		}
+		for (uint32_t l = 0; l < MaxLods && counts[l]; l++)
+		{
+			double drawn = triangles[l];
+			for (uint32_t i = 0; i < data.Materials.size(); i++)
+			{
+				if (chains[i].size() <= l) drawn += chains[i].empty() ? data.Materials[i].IndexCount / 3 : chains[i].back().Indices.size() / 3;
+			}
+			auto name = "LOD " + std::to_string(l + 1);
+			data.Stats.Add(name + " materials", counts[l]);
+			data.Stats.Add(name + " triangles (%)", full ? drawn / full * 100.0 : 0.0);
+			data.Stats.Add(name + " max error", errors[l]);
+		}
+	}
+
+}
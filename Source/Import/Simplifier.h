@@ -0,0 +1,32 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "SceneData.h"
+
+// Import-time LOD chains from quadric error edge collapse (Garland and Heckbert). Levels only remove triangles
+// and reuse the material's existing vertices, so they are just extra index ranges over the same vertex range.
+namespace Simplifier
+{
+
+	constexpr uint32_t MaxLods = 4;
+	// Materials smaller than this are not worth the extra draws
+	constexpr uint32_t MinTriangles = 64;
+
+	struct Level
+	{
+		// Relative to the material's vertex range
+		std::vector<uint32_t> Indices;
+		// Upper bound of the distance from the original surface, in scene units
+		float Error;
+	};
+
+	// Each level has about half the triangles of the one before it. Vertices on open borders only collapse along
+	// straight runs of the border, so neighbouring materials do not separate.
+	std::vector<Level> BuildChain(std::span<const uint32_t> indices, std::span<const Vertex> vertices);
+
+	// Every material's chain, appended to data.Indices after the full detail ranges, into data.Lods.
+	void BuildLods(SceneData& data);
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "SceneData.h"
+
+// What a file loader hands to the importer: triangle lists in left handed space with clockwise triangles and
+// V pointing down, as they come out of the file. Welding, normals and tangents are left to the importer.
+struct SourceMesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<uint32_t> Indices;
+	uint32_t Material = 0;
+	// Without them, the importer generates smooth normals and leaves the tangents empty
+	bool HasNormals = false;
+	bool HasUVs = false;
+	// World transforms of every place the mesh is drawn, at least one
+	std::vector<DirectX::XMFLOAT4X4> Placements;
+};
+
+// A file relative to the scene file's directory, empty for none. Images stored inside the scene file also have
+// their encoded bytes, Path is then only a name for them.
+struct SourceImage
+{
+	std::string Path;
+	std::span<const uint8_t> Bytes;
+};
+
+struct SourceMaterial
+{
+	SourceImage Albedo;
+	SourceImage Specular;
+	SourceImage Bump;
+	DirectX::XMFLOAT3 Diffuse = { 0.f, 0.f, 0.f };
+	DirectX::XMFLOAT3 SpecularColor = { 0.f, 0.f, 0.f };
+};
+
+struct SourceScene
+{
+	std::vector<SourceMesh> Meshes;
+	std::vector<SourceMaterial> Materials;
+	// What embedded images point into
+	std::vector<MappedFile> Files;
+	std::vector<std::vector<uint8_t>> Buffers;
+	// Paths as the loader opened them, the importer makes them canonical
+	std::vector<SourceDependency> Dependencies;
+};
@@ -0,0 +1,527 @@
+#include "Textures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "BlockCompression.h"
+#include "Hash.h"
+#include "Jobs.h"
+#include "MaterialLayout.h"
+#include "Mips.h"
+#include "NormalMaps.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace Textures
+{
+
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream file(std::filesystem::u8path(path), std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			throw std::runtime_error("Failed to open texture " + path);
+		}
+
+		std::vector<uint8_t> bytes(size_t(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size()));
+		return bytes;
+	}
+
+	TextureData Decode(std::span<const uint8_t> bytes, const std::string& path)
+	{
+		int width, height, comp;
+		uint8_t* data = stbi_load_from_memory(bytes.data(), int(bytes.size()), &width, &height, &comp, 4);
+		if (!data)
+		{
+			throw std::runtime_error("Failed to decode texture " + path);
+		}
+
+		TextureData texture{ uint32_t(width), uint32_t(height) };
+		texture.Pixels.assign(data, data + size_t(width) * height * 4);
+		stbi_image_free(data);
+		return texture;
+	}
+
+	std::string GetCanonicalPath(const std::string& path)
+	{
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(std::filesystem::u8path(path), error);
+		if (error) return path;
+
+		auto string = canonical.u8string();
+		return std::string(string.begin(), string.end());
+	}
+
+	// The same image used as albedo and as a bump map ends up encoded differently, so usage is part of the key
+	std::string GetKey(const Source& source)
+	{
+		std::string usage(1, char('0' + uint32_t(source.Use)));
+		if (source.Path.empty())
+		{
+			char color[16];
+			snprintf(color, sizeof(color), "#%02x%02x%02x%02x", source.Color[0], source.Color[1], source.Color[2], source.Color[3]);
+			return usage + color;
+		}
+
+		return usage + GetCanonicalPath(source.Path);
+	}
+
+	// Specular and bump were always sampled through an sRGB view. They are stored linear now so they can use BC4,
+	// the values are converted once here to keep what the shaders see the same.
+	void ToLinear(TextureData& texture)
+	{
+		uint8_t table[256];
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			float c = i / 255.f;
+			c = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			table[i] = uint8_t(c * 255.f + 0.5f);
+		}
+
+		for (size_t i = 0; i < texture.Pixels.size(); i += 4)
+		{
+			texture.Pixels[i] = table[texture.Pixels[i]];
+			texture.Pixels[i + 1] = table[texture.Pixels[i + 1]];
+			texture.Pixels[i + 2] = table[texture.Pixels[i + 2]];
+		}
+		texture.Format = TextureFormat::RGBA8;
+	}
+
+	// GBufferWritePS discards albedo alpha below 0.5
+	constexpr uint8_t m_AlphaCutoff = 128;
+
+	// Whether the alpha test discards any texel of level 0. Below the cutoff is the top bit of a texel clear,
+	// so four texels at a time are and-ed together, with a check after every block.
+	bool IsMasked(const TextureData& texture)
+	{
+		using namespace DirectX;
+
+		const uint32_t* texels = reinterpret_cast<const uint32_t*>(texture.Pixels.data());
+		size_t count = size_t(texture.Width) * texture.Height;
+		constexpr size_t blockSize = 4096;
+		for (size_t start = 0; start < count; start += blockSize)
+		{
+			size_t end = (std::min)(start + blockSize, count);
+			XMVECTOR all = XMVectorTrueInt();
+			size_t i = start;
+			for (; i + 4 <= end; i += 4)
+			{
+				all = XMVectorAndInt(all, XMLoadInt4(texels + i));
+			}
+			uint32_t rest = ~0u;
+			for (; i < end; i++)
+			{
+				rest &= texels[i];
+			}
+
+			XMUINT4 lanes;
+			XMStoreUInt4(&lanes, all);
+			if (!(lanes.x & lanes.y & lanes.z & lanes.w & rest & 0x80000000u)) return true;
+		}
+		return false;
+	}
+
+	// Opaque albedo drops its alpha, nothing but the alpha test reads it
+	TextureFormat GetCompressedFormat(Usage usage, bool masked)
+	{
+		if (usage == Usage::Bump) return TextureFormat::BC5;
+		if (usage != Usage::Albedo) return TextureFormat::BC4;
+		return masked ? TextureFormat::BC3_SRGB : TextureFormat::BC1_SRGB;
+	}
+
+	// Level 0 of a texture at another size, bilinear with wrapped edges
+	std::vector<uint8_t> Resample(const TextureData& texture, uint32_t width, uint32_t height)
+	{
+		std::vector<uint8_t> pixels(size_t(width) * height * 4);
+		auto getTaps = [](uint32_t to, uint32_t from, uint32_t size, uint32_t& first, uint32_t& second)
+		{
+			float position = (to + 0.5f) * size / from - 0.5f;
+			float floor = std::floor(position);
+			first = uint32_t(int64_t(floor) + size) % size;
+			second = (first + 1) % size;
+			return position - floor;
+		};
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			uint32_t y0, y1;
+			float wy = getTaps(y, height, texture.Height, y0, y1);
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint32_t x0, x1;
+				float wx = getTaps(x, width, texture.Width, x0, x1);
+				auto texel = [&](uint32_t tx, uint32_t ty) { return texture.Pixels.data() + (size_t(ty) * texture.Width + tx) * 4; };
+				const uint8_t* a = texel(x0, y0);
+				const uint8_t* b = texel(x1, y0);
+				const uint8_t* c = texel(x0, y1);
+				const uint8_t* d = texel(x1, y1);
+				uint8_t* out = pixels.data() + (size_t(y) * width + x) * 4;
+				for (uint32_t channel = 0; channel < 4; channel++)
+				{
+					float top = a[channel] + (b[channel] - a[channel]) * wx;
+					float bottom = c[channel] + (d[channel] - c[channel]) * wx;
+					out[channel] = uint8_t(top + (bottom - top) * wy + 0.5f);
+				}
+			}
+		}
+		return pixels;
+	}
+
+	// Specular from red and the normal from red and green of its converted parts, see MaterialLayout.h
+	TextureData PackSurface(const TextureData& specular, const TextureData& normal)
+	{
+		uint32_t width = (std::max)(specular.Width, normal.Width);
+		uint32_t height = (std::max)(specular.Height, normal.Height);
+
+		const TextureData* parts[] = { &specular, &normal };
+		std::vector<uint8_t> resampled[2];
+		const uint8_t* pixels[2];
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			if (parts[i]->Width != width || parts[i]->Height != height) resampled[i] = Resample(*parts[i], width, height);
+			pixels[i] = resampled[i].empty() ? parts[i]->Pixels.data() : resampled[i].data();
+		}
+
+		TextureData packed{ width, height, 1, TextureFormat::RGBA8, std::vector<uint8_t>(size_t(width) * height * 4) };
+		for (size_t i = 0; i < size_t(width) * height; i++)
+		{
+			uint8_t* texel = packed.Pixels.data() + i * 4;
+			texel[SURFACE_SPECULAR] = pixels[0][i * 4];
+			texel[SURFACE_NORMAL_X] = pixels[1][i * 4];
+			texel[SURFACE_NORMAL_Z] = pixels[1][i * 4 + 1];
+			texel[SURFACE_UNUSED] = 0;
+		}
+		return packed;
+	}
+
+	// What a texture of this size took as its own mip chain, before surfaces were packed
+	size_t GetChainSize(uint32_t width, uint32_t height, TextureFormat format)
+	{
+		if (width % 4 || height % 4) format = TextureFormat::RGBA8;
+
+		size_t size = 0;
+		for (uint32_t level = 0; level < Mips::GetLevelCount(width, height); level++)
+		{
+			size += GetMipSize(format, (std::max)(width >> level, 1u), (std::max)(height >> level, 1u));
+		}
+		return size;
+	}
+
+	LoadResult Load(const std::vector<Source>& sources, const std::vector<Pack>& packs, ImportStats& stats, const SceneView* previous)
+	{
+		LoadResult result;
+		result.Indices.assign(sources.size(), ~0u);
+		result.Packs.resize(packs.size());
+
+		// Pass 1: same resolved path or same solid color
+		std::vector<uint32_t> bySource(sources.size());
+		std::vector<uint32_t> uniquePaths;
+		{
+			ScopedStage stage(stats, "Texture resolve");
+			std::unordered_map<std::string, uint32_t> registry;
+			for (uint32_t i = 0; i < sources.size(); i++)
+			{
+				auto [it, inserted] = registry.try_emplace(GetKey(sources[i]), uint32_t(uniquePaths.size()));
+				if (inserted) uniquePaths.push_back(i);
+				bySource[i] = it->second;
+			}
+		}
+
+		// Embedded images aren't copied, files only holds what is read from disk
+		std::vector<std::vector<uint8_t>> files(uniquePaths.size());
+		std::vector<std::span<const uint8_t>> encoded(uniquePaths.size());
+		std::vector<uint64_t> hashes(uniquePaths.size());
+		{
+			ScopedStage stage(stats, "Texture read", uint32_t(uniquePaths.size()));
+			Jobs::ParallelFor(uint32_t(uniquePaths.size()), [&](uint32_t i)
+				{
+					stats.Step();
+					const auto& source = sources[uniquePaths[i]];
+					if (source.Path.size())
+					{
+						if (source.Bytes.size()) encoded[i] = source.Bytes;
+						else encoded[i] = files[i] = ReadFile(source.Path);
+						hashes[i] = Hash::Bytes(encoded[i].data(), encoded[i].size());
+					}
+					else
+					{
+						hashes[i] = Hash::Bytes(source.Color, sizeof(source.Color));
+					}
+					hashes[i] ^= uint64_t(source.Use) << 56;
+				});
+		}
+
+		// Pass 2: different paths with identical bytes, e.g. copies of a shared atlas
+		std::vector<uint32_t> byPath(uniquePaths.size());
+		std::vector<uint32_t> uniqueContent;
+		{
+			std::unordered_multimap<uint64_t, uint32_t> registry;
+			for (uint32_t i = 0; i < uniquePaths.size(); i++)
+			{
+				const auto& source = sources[uniquePaths[i]];
+				auto range = registry.equal_range(hashes[i]);
+				auto match = std::find_if(range.first, range.second, [&](const auto& entry)
+					{
+						const auto& other = sources[uniquePaths[uniqueContent[entry.second]]];
+						if (source.Path.empty() || other.Path.empty())
+						{
+							return source.Path.empty() && other.Path.empty() && other.Use == source.Use &&
+								!memcmp(source.Color, other.Color, sizeof(source.Color));
+						}
+						return other.Use == source.Use && std::ranges::equal(encoded[uniqueContent[entry.second]], encoded[i]);
+					});
+
+				if (match != range.second)
+				{
+					byPath[i] = match->second;
+					files[i] = {};
+					encoded[i] = {};
+				}
+				else
+				{
+					byPath[i] = uint32_t(uniqueContent.size());
+					registry.emplace(hashes[i], uint32_t(uniqueContent.size()));
+					uniqueContent.push_back(i);
+				}
+			}
+		}
+
+		// Images used on their own get a texture each, then every unique pair of images gets a surface texture
+		std::vector<bool> packed(sources.size(), false);
+		for (const auto& pack : packs)
+		{
+			packed[pack.Specular] = packed[pack.Bump] = true;
+		}
+		std::vector<uint32_t> direct;
+		std::vector<uint32_t> byContent(uniqueContent.size(), ~0u);
+		for (uint32_t i = 0; i < sources.size(); i++)
+		{
+			if (packed[i]) continue;
+			uint32_t content = byPath[bySource[i]];
+			if (byContent[content] == ~0u)
+			{
+				byContent[content] = uint32_t(direct.size());
+				direct.push_back(content);
+			}
+			result.Indices[i] = byContent[content];
+		}
+		uint32_t directCount = uint32_t(direct.size());
+		std::vector<std::pair<uint32_t, uint32_t>> uniquePacks;
+		{
+			std::unordered_map<uint64_t, uint32_t> registry;
+			for (uint32_t p = 0; p < packs.size(); p++)
+			{
+				uint32_t specular = byPath[bySource[packs[p].Specular]];
+				uint32_t bump = byPath[bySource[packs[p].Bump]];
+				auto [it, inserted] = registry.try_emplace(uint64_t(specular) << 32 | bump, directCount + uint32_t(uniquePacks.size()));
+				if (inserted) uniquePacks.emplace_back(specular, bump);
+				result.Packs[p] = it->second;
+			}
+		}
+
+		// Unchanged files of an earlier import, the usage is part of the hash.
+		// A surface texture is unchanged when both of its parts' hashes lead to it.
+		uint32_t textureCount = directCount + uint32_t(uniquePacks.size());
+		result.Textures.resize(textureCount);
+		std::vector<bool> reused(textureCount, false);
+		uint32_t reusedCount = 0;
+		if (previous)
+		{
+			std::unordered_multimap<uint64_t, uint32_t> registry;
+			for (const auto& source : previous->TextureSources)
+			{
+				if (source.Texture < previous->Textures.size()) registry.emplace(source.Hash, source.Texture);
+			}
+			auto reuse = [&](uint32_t t, uint32_t from)
+			{
+				const auto& texture = previous->Textures[from];
+				result.Textures[t] = { texture.Width, texture.Height, texture.MipLevels, texture.Format,
+					std::vector<uint8_t>(texture.Pixels.begin(), texture.Pixels.end()) };
+				reused[t] = true;
+				reusedCount++;
+			};
+
+			for (uint32_t t = 0; t < directCount; t++)
+			{
+				auto it = registry.find(hashes[uniqueContent[direct[t]]]);
+				if (sources[uniquePaths[uniqueContent[direct[t]]]].Path.size() && it != registry.end()) reuse(t, it->second);
+			}
+			for (uint32_t p = 0; p < uniquePacks.size(); p++)
+			{
+				auto speculars = registry.equal_range(hashes[uniqueContent[uniquePacks[p].first]]);
+				auto bumps = registry.equal_range(hashes[uniqueContent[uniquePacks[p].second]]);
+				auto match = std::find_if(speculars.first, speculars.second, [&](const auto& entry)
+					{
+						return std::any_of(bumps.first, bumps.second, [&](const auto& other) { return other.second == entry.second; });
+					});
+				if (match != speculars.second) reuse(directCount + p, match->second);
+			}
+		}
+
+		std::vector<bool> needed(uniqueContent.size(), false);
+		for (uint32_t t = 0; t < directCount; t++)
+		{
+			if (!reused[t]) needed[direct[t]] = true;
+		}
+		for (uint32_t p = 0; p < uniquePacks.size(); p++)
+		{
+			if (!reused[directCount + p]) needed[uniquePacks[p].first] = needed[uniquePacks[p].second] = true;
+		}
+
+		// Specular and bump maps are converted before packing, mips come after
+		std::vector<TextureData> images(uniqueContent.size());
+		{
+			ScopedStage stage(stats, "Texture decode", uint32_t(uniqueContent.size()));
+			Jobs::ParallelFor(uint32_t(uniqueContent.size()), [&](uint32_t i)
+				{
+					stats.Step();
+					const auto& source = sources[uniquePaths[uniqueContent[i]]];
+					if (needed[i])
+					{
+						if (source.Path.empty()) images[i] = { 1, 1, 1, TextureFormat::RGBA8_SRGB, { source.Color, source.Color + 4 } };
+						else images[i] = Decode(encoded[uniqueContent[i]], source.Path);
+						if (source.Use != Usage::Albedo) ToLinear(images[i]);
+						if (source.Use == Usage::Bump) NormalMaps::FromHeight(images[i]);
+					}
+					files[uniqueContent[i]] = {};
+					encoded[uniqueContent[i]] = {};
+				});
+		}
+
+		std::vector<size_t> separateBytes(uniquePacks.size(), 0);
+		{
+			ScopedStage stage(stats, "Texture pack", uint32_t(uniquePacks.size()));
+			Jobs::ParallelFor(uint32_t(uniquePacks.size()), [&](uint32_t p)
+				{
+					stats.Step();
+					if (reused[directCount + p]) return;
+					const auto& specular = images[uniquePacks[p].first];
+					const auto& bump = images[uniquePacks[p].second];
+					result.Textures[directCount + p] = PackSurface(specular, bump);
+					separateBytes[p] = GetChainSize(specular.Width, specular.Height, TextureFormat::BC4) +
+						GetChainSize(bump.Width, bump.Height, TextureFormat::BC5);
+				});
+		}
+		for (uint32_t t = 0; t < directCount; t++)
+		{
+			if (!reused[t]) result.Textures[t] = std::move(images[direct[t]]);
+		}
+		images = {};
+
+		// Reused albedo is masked exactly when it kept its alpha. Bytes, the jobs write them concurrently.
+		std::vector<uint8_t> masked(textureCount, 0);
+		{
+			ScopedStage stage(stats, "Texture mips", textureCount);
+			Jobs::ParallelFor(textureCount, [&](uint32_t t)
+				{
+					stats.Step();
+					auto& texture = result.Textures[t];
+					bool albedo = t < directCount && sources[uniquePaths[uniqueContent[direct[t]]]].Use == Usage::Albedo;
+					masked[t] = albedo && (texture.Format == TextureFormat::BC3_SRGB || (!IsBlockCompressed(texture.Format) && IsMasked(texture)));
+					if (reused[t]) return;
+
+					Mips::Generate(texture);
+					if (masked[t]) Mips::PreserveCoverage(texture, m_AlphaCutoff);
+				});
+		}
+		result.Masked.assign(masked.begin(), masked.end());
+
+		std::vector<double> psnr(textureCount, 0.0);
+		{
+			ScopedStage stage(stats, "Texture compress", textureCount);
+			Jobs::ParallelFor(textureCount, [&](uint32_t t)
+				{
+					stats.Step();
+					auto& texture = result.Textures[t];
+					if (reused[t] || texture.Width % 4 || texture.Height % 4) return;
+
+					auto format = t >= directCount ? TextureFormat::BC3 :
+						GetCompressedFormat(sources[uniquePaths[uniqueContent[direct[t]]]].Use, result.Masked[t]);
+					auto compressed = BlockCompression::Compress(texture, format);
+
+					uint32_t channels = format == TextureFormat::BC1_SRGB ? 0b0111 : format == TextureFormat::BC3_SRGB ? 0b1111 :
+						format == TextureFormat::BC5 ? 0b0011 : format == TextureFormat::BC4 ? 0b0001 :
+						1 << SURFACE_SPECULAR | 1 << SURFACE_NORMAL_X | 1 << SURFACE_NORMAL_Z;
+					auto decoded = BlockCompression::Decode(compressed);
+					psnr[t] = BlockCompression::PSNR(texture.Pixels.data(), decoded.data(), size_t(texture.Width) * texture.Height, channels);
+
+					texture = std::move(compressed);
+				});
+		}
+
+		// Every pack that uses an image, to list its file once per surface texture
+		std::vector<std::vector<uint32_t>> imagePacks(uniqueContent.size());
+		for (uint32_t p = 0; p < uniquePacks.size(); p++)
+		{
+			imagePacks[uniquePacks[p].first].push_back(directCount + p);
+			if (uniquePacks[p].second != uniquePacks[p].first) imagePacks[uniquePacks[p].second].push_back(directCount + p);
+		}
+		for (uint32_t i = 0; i < uniquePaths.size(); i++)
+		{
+			const auto& source = sources[uniquePaths[i]];
+			if (source.Bytes.size()) continue;
+
+			auto path = source.Path.size() ? GetCanonicalPath(source.Path) : std::string();
+			if (path.size() && byContent[byPath[i]] != ~0u) result.Sources.push_back({ path, source.Use, byContent[byPath[i]], hashes[i] });
+			for (uint32_t t : imagePacks[byPath[i]])
+			{
+				result.Sources.push_back({ path, source.Use, t, hashes[i] });
+			}
+		}
+
+		uint64_t referencedBytes = 0;
+		for (uint32_t i = 0; i < sources.size(); i++)
+		{
+			if (result.Indices[i] != ~0u) referencedBytes += result.Textures[result.Indices[i]].Pixels.size();
+		}
+		for (uint32_t t : result.Packs)
+		{
+			referencedBytes += result.Textures[t].Pixels.size();
+		}
+		uint64_t uniqueBytes = 0;
+		for (const auto& texture : result.Textures)
+		{
+			uniqueBytes += texture.Pixels.size();
+		}
+		int64_t packingSaved = 0;
+		for (uint32_t p = 0; p < uniquePacks.size(); p++)
+		{
+			if (separateBytes[p]) packingSaved += int64_t(separateBytes[p]) - int64_t(result.Textures[directCount + p].Pixels.size());
+		}
+
+		double psnrMin = 99.0;
+		double psnrSum = 0.0;
+		uint32_t compressed = 0;
+		for (double value : psnr)
+		{
+			if (value == 0.0) continue;
+			psnrMin = std::min(psnrMin, value);
+			psnrSum += value;
+			compressed++;
+		}
+
+		stats.Add("Texture references", double(sources.size()));
+		stats.Add("Unique textures", double(result.Textures.size()));
+		stats.Add("Texture memory saved (MiB)", double(referencedBytes - uniqueBytes) / (1024.0 * 1024.0));
+		stats.Add("Surface textures", double(uniquePacks.size()));
+		stats.Add("Masked textures", double(std::count(result.Masked.begin(), result.Masked.end(), true)));
+		stats.Add("Surface packing saved (MiB)", double(packingSaved) / (1024.0 * 1024.0));
+		stats.Add("Compressed textures", double(compressed));
+		stats.Add("Reused textures", double(reusedCount));
+		stats.Add("Texture memory (MiB)", double(uniqueBytes) / (1024.0 * 1024.0));
+		stats.Add("Compression PSNR min (dB)", compressed ? psnrMin : 0.0);
+		stats.Add("Compression PSNR avg (dB)", compressed ? psnrSum / compressed : 0.0);
+
+		return result;
+	}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include "SceneData.h"
+
+// Texture import stage. Runs once for the whole scene so every material's images are decoded together.
+namespace Textures
+{
+
+	using Usage = TextureUsage;
+
+	// What TextureSource::Path and SourceDependency::Path hold: weakly canonical, or path itself if that fails
+	std::string GetCanonicalPath(const std::string& path);
+
+	// A material texture slot: a file, or a solid color when Path is empty.
+	// Images embedded in the scene file are decoded from Bytes, which must outlive Load, Path only names them.
+	struct Source
+	{
+		std::string Path;
+		uint8_t Color[4];
+		Usage Use;
+		std::span<const uint8_t> Bytes;
+	};
+
+	// A material's specular and bump map, indices into Load's sources. Both end up in one surface texture.
+	struct Pack
+	{
+		uint32_t Specular;
+		uint32_t Bump;
+	};
+
+	struct LoadResult
+	{
+		// One entry per unique image, then one per unique pack
+		std::vector<TextureData> Textures;
+		// Index into Textures for every source, ~0u for sources that are only part of packs
+		std::vector<uint32_t> Indices;
+		// Index into Textures for every pack
+		std::vector<uint32_t> Packs;
+		// Indexed like Textures, albedo whose alpha test discards texels. Only these keep their alpha.
+		std::vector<bool> Masked;
+		// One per unique file, embedded images are reloaded with their scene.
+		// Both parts of every unique pack are listed as well, solid colors with an empty path.
+		std::vector<TextureSource> Sources;
+	};
+
+	// Sources are deduplicated by resolved path, then by content hash, so each image is read and decoded once.
+	// The unique images are then decoded, given mip chains and block compressed across the job pool:
+	// albedo to BC1 (BC3 with coverage preserving alpha mips when masked), specular to BC4, bump maps become normal
+	// maps in BC5.
+	// Packs are laid out as MaterialLayout.h describes and stored as linear BC3, their parts are resampled
+	// to the larger size. Textures whose sources' hashes all match previous' are copied from it instead.
+	LoadResult Load(const std::vector<Source>& sources, const std::vector<Pack>& packs, ImportStats& stats,
+		const SceneView* previous = nullptr);
+
+}
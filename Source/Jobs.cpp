@@ -0,0 +1,144 @@
+#include "Jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Jobs
+{
+
+	struct Batch
+	{
+		const std::function<void(uint32_t)>* Func;
+		uint32_t Count;
+		std::atomic<uint32_t> Next = 0;
+		uint32_t Done = 0;
+		uint32_t Workers = 0;
+		std::exception_ptr Error;
+	};
+
+	class Pool
+	{
+	public:
+		Pool()
+		{
+			uint32_t count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				m_Threads.emplace_back([this] { WorkerLoop(); });
+			}
+		}
+
+		~Pool()
+		{
+			{
+				std::lock_guard lock(m_Mutex);
+				m_Quit = true;
+			}
+			m_Wake.notify_all();
+			for (auto& thread : m_Threads)
+			{
+				thread.join();
+			}
+		}
+
+		uint32_t ThreadCount() const { return uint32_t(m_Threads.size()) + 1; }
+
+		void Run(Batch& batch)
+		{
+			{
+				std::lock_guard lock(m_Mutex);
+				m_Batches.push_back(&batch);
+				batch.Workers++;
+			}
+			m_Wake.notify_all();
+
+			Work(batch);
+
+			std::unique_lock lock(m_Mutex);
+			m_Finished.wait(lock, [&] { return batch.Done == batch.Count && batch.Workers == 0; });
+		}
+
+	private:
+		void WorkerLoop()
+		{
+			for (;;)
+			{
+				Batch* batch;
+				{
+					std::unique_lock lock(m_Mutex);
+					m_Wake.wait(lock, [&] { return m_Quit || !m_Batches.empty(); });
+					if (m_Quit) return;
+
+					batch = m_Batches.front();
+					batch->Workers++;
+				}
+
+				Work(*batch);
+			}
+		}
+
+		// Claims indices until the batch runs dry, then drops it from the queue
+		void Work(Batch& batch)
+		{
+			uint32_t done = 0;
+			for (uint32_t i = batch.Next++; i < batch.Count; i = batch.Next++)
+			{
+				try { (*batch.Func)(i); }
+				catch (...)
+				{
+					std::lock_guard lock(m_Mutex);
+					if (!batch.Error) batch.Error = std::current_exception();
+				}
+				done++;
+			}
+
+			{
+				std::lock_guard lock(m_Mutex);
+				auto it = std::find(m_Batches.begin(), m_Batches.end(), &batch);
+				if (it != m_Batches.end()) m_Batches.erase(it);
+				batch.Done += done;
+				batch.Workers--;
+			}
+			m_Finished.notify_all();
+		}
+
+		std::vector<std::thread> m_Threads;
+		std::deque<Batch*> m_Batches;
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::condition_variable m_Finished;
+		bool m_Quit = false;
+	};
+
+	Pool& GetPool()
+	{
+		static Pool pool;
+		return pool;
+	}
+
+	uint32_t ThreadCount()
+	{
+		return GetPool().ThreadCount();
+	}
+
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+	{
+		if (count == 0) return;
+		if (count == 1)
+		{
+			func(0);
+			return;
+		}
+
+		Batch batch{ .Func = &func, .Count = count };
+		GetPool().Run(batch);
+		if (batch.Error) std::rethrow_exception(batch.Error);
+	}
+
+}
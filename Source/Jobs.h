@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Shared worker pool for import and other CPU work. Created on first use.
+namespace Jobs
+{
+
+	uint32_t ThreadCount();
+
+	// Runs func(0) .. func(count - 1) across the pool and the calling thread, and returns once all are done.
+	// Safe to call from inside a job. The first exception thrown by func is rethrown here.
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+}
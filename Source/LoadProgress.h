@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// Thrown out of an import once LoadProgress::Cancel has been called.
+class LoadCancelled : public std::runtime_error
+{
+public:
+	LoadCancelled() : std::runtime_error("Load cancelled") {}
+};
+
+// Shared between a load running on another thread and the UI polling it.
+class LoadProgress
+{
+public:
+	void Cancel() { m_Cancelled = true; }
+	bool IsCancelled() const { return m_Cancelled; }
+
+	// Throws LoadCancelled. Checked at every stage and step, so cancelling takes effect within one of them.
+	void Check() const
+	{
+		if (m_Cancelled) throw LoadCancelled();
+	}
+
+	void BeginStage(const std::string& name, uint32_t steps)
+	{
+		Check();
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Stage = name;
+		}
+		m_Done = 0;
+		m_Steps = steps;
+	}
+
+	void Step()
+	{
+		Check();
+		m_Done++;
+	}
+
+	std::string GetStage() const
+	{
+		std::lock_guard lock(m_Mutex);
+		return m_Stage;
+	}
+
+	// Fraction of the current stage that is done, negative if it did not say how many steps it has
+	float GetFraction() const
+	{
+		uint32_t steps = m_Steps;
+		return steps ? float(m_Done) / float(steps) : -1.f;
+	}
+
+private:
+	std::atomic<bool> m_Cancelled = false;
+	std::atomic<uint32_t> m_Done = 0;
+	std::atomic<uint32_t> m_Steps = 0;
+	mutable std::mutex m_Mutex;
+	std::string m_Stage;
+};
@@ -1,5 +1,7 @@
+#include <cstdio>
 #include <filesystem>
 
+#include "Import/Benchmark.h"
 #include "Renderer/Renderer.h"
 
 void RunLoop()
@@ -53,8 +55,59 @@ std::wstring GetPath(HINSTANCE hInstance)
 	}
 }
 
+std::string ToUTF8(const std::wstring& string)
+{
+	int size = WideCharToMultiByte(CP_UTF8, 0, string.c_str(), int(string.size()), nullptr, 0, nullptr, nullptr);
+	std::string result(size, 0);
+	WideCharToMultiByte(CP_UTF8, 0, string.c_str(), int(string.size()), result.data(), size, nullptr, nullptr);
+	return result;
+}
+
+// Voxel.exe -benchmark <scene> [iterations] [-compact] [-atlas]
+// Runs without a window or device and reports to the console it was started from.
+bool RunBenchmark(LPWSTR cmdLine)
+{
+	int argc;
+	LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+	if (!argv || argc < 2 || std::wstring(argv[0]) != L"-benchmark")
+	{
+		LocalFree(argv);
+		return false;
+	}
+
+	if (AttachConsole(ATTACH_PARENT_PROCESS) || AllocConsole())
+	{
+		FILE* stream;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+	}
+
+	std::string path = ToUTF8(argv[1]);
+	uint32_t iterations = 10;
+	ImportOptions options;
+	for (int i = 2; i < argc; i++)
+	{
+		std::wstring arg = argv[i];
+		if (arg == L"-compact") options.CompactVertices = true;
+		else if (arg == L"-atlas") options.AtlasTextures = true;
+		else if (_wtoi(argv[i]) > 0) iterations = uint32_t(_wtoi(argv[i]));
+	}
+	LocalFree(argv);
+
+	try { Benchmark::Run(path, iterations, options); }
+	catch (const std::exception& e)
+	{
+		printf("Error: %s\n", e.what());
+	}
+	return true;
+}
+
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR lpCmdLine, int nShowCmd)
 {
+	if (*lpCmdLine && RunBenchmark(lpCmdLine))
+	{
+		return 0;
+	}
+
 	std::wstring path = GetPath(hInstance);
 	std::filesystem::path execPath = path;
 	std::filesystem::current_path(execPath.parent_path());
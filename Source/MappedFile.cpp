@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileW(std::filesystem::u8path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	Size = size_t(size.QuadPart);
+	m_File = file;
+	if (!Size) return;
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map " + path);
+	}
+	m_Mapping = mapping;
+	Data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	struct stat info;
+	fstat(file, &info);
+	Size = size_t(info.st_size);
+	m_File = reinterpret_cast<void*>(intptr_t(file) + 1);
+	if (!Size) return;
+
+	void* data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED)
+	{
+		close(file);
+		m_File = nullptr;
+		throw std::runtime_error("Failed to map " + path);
+	}
+	m_Mapping = data;
+	Data = static_cast<const uint8_t*>(data);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	this->~MappedFile();
+
+	Data = other.Data;
+	other.Data = nullptr;
+	Size = other.Size;
+	other.Size = 0;
+	m_File = other.m_File;
+	other.m_File = nullptr;
+	m_Mapping = other.m_Mapping;
+	other.m_Mapping = nullptr;
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (Data) UnmapViewOfFile(Data);
+	if (m_Mapping) CloseHandle(m_Mapping);
+	if (m_File) CloseHandle(m_File);
+#else
+	if (m_Mapping) munmap(m_Mapping, Size);
+	if (m_File) close(int(reinterpret_cast<intptr_t>(m_File) - 1));
+#endif
+	Data = nullptr;
+	m_Mapping = nullptr;
+	m_File = nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Read-only view of a whole file. The mapping stays valid until the object is destroyed.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const std::string& path);
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+
+	~MappedFile();
+
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+
+private:
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+};
@@ -0,0 +1,13 @@
+// Channels of a material's surface texture, where the importer packs its specular map and the normal map derived from
+// its bump map. Only defines, so the shaders include this same file and read the channels the importer wrote.
+// Stored as BC3: the normal's x gets the alpha block to itself, z and specular share the color block.
+// Include guards instead of #pragma once, for fxc.
+#ifndef MATERIAL_LAYOUT_H
+#define MATERIAL_LAYOUT_H
+
+#define SURFACE_SPECULAR 0
+#define SURFACE_NORMAL_Z 1
+#define SURFACE_UNUSED 2
+#define SURFACE_NORMAL_X 3
+
+#endif
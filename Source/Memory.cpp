@@ -0,0 +1,27 @@
+#include "Memory.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Memory
+{
+
+	uint64_t GetPeakResidentBytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{ .cb = sizeof(counters) };
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage)) return 0;
+		// Linux reports KiB
+		return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+	}
+
+}
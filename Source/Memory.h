@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Memory
+{
+
+	// Highest resident set (working set on Windows) of the process so far, in bytes.
+	uint64_t GetPeakResidentBytes();
+
+}
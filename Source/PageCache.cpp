@@ -0,0 +1,270 @@
+#include "PageCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Pages
+{
+
+	bool IsPageable(uint32_t width, uint32_t height, uint32_t mipLevels, TextureFormat format)
+	{
+		if (!IsBlockCompressed(format) || width % 4 || height % 4) return false;
+		if ((std::max)(width, height) <= Size || (std::max)(width, height) > Size * 256) return false;
+		return mipLevels >= Layout::Create(width, height).Mips;
+	}
+
+	Layout Layout::Create(uint32_t width, uint32_t height)
+	{
+		Layout layout{ width, height };
+		for (uint32_t mip = 0; mip < MaxMips; mip++)
+		{
+			uint32_t w = (std::max)(width >> mip, 1u);
+			uint32_t h = (std::max)(height >> mip, 1u);
+			layout.PagesX[mip] = (w + Size - 1) / Size;
+			layout.PagesY[mip] = (h + Size - 1) / Size;
+			layout.Offsets[mip] = layout.PageCount;
+			layout.PageCount += layout.PagesX[mip] * layout.PagesY[mip];
+			layout.Mips = mip + 1;
+			if (w <= Size && h <= Size) break;
+		}
+		return layout;
+	}
+
+	void CopyPage(const TextureView& texture, uint32_t mip, uint32_t x, uint32_t y, uint8_t* out)
+	{
+		size_t offset = 0;
+		for (uint32_t level = 0; level < mip; level++)
+		{
+			offset += GetMipSize(texture.Format, (std::max)(texture.Width >> level, 1u), (std::max)(texture.Height >> level, 1u));
+		}
+
+		uint32_t blockSize = GetElementSize(texture.Format);
+		uint32_t pitch = GetRowPitch(texture.Format, (std::max)(texture.Width >> mip, 1u));
+		uint32_t blocksX = pitch / blockSize;
+		uint32_t blocksY = ((std::max)(texture.Height >> mip, 1u) + 3) / 4;
+		const uint8_t* pixels = texture.Pixels.data() + offset;
+
+		// In blocks, relative to the page's first
+		constexpr int32_t border = int32_t(Border / 4);
+		constexpr int32_t slotBlocks = int32_t(SlotSize / 4);
+		int32_t firstX = int32_t(x * Size / 4) - border;
+		int32_t firstY = int32_t(y * Size / 4) - border;
+		for (int32_t row = 0; row < slotBlocks; row++)
+		{
+			uint32_t sourceY = uint32_t((firstY + row) % int32_t(blocksY) + int32_t(blocksY)) % blocksY;
+			for (int32_t column = 0; column < slotBlocks; column++)
+			{
+				uint32_t sourceX = uint32_t((firstX + column) % int32_t(blocksX) + int32_t(blocksX)) % blocksX;
+				memcpy(out + (size_t(row) * slotBlocks + column) * blockSize, pixels + size_t(sourceY) * pitch + size_t(sourceX) * blockSize, blockSize);
+			}
+		}
+	}
+
+	PageCache::PageCache(std::vector<Layout> textures, uint32_t slots)
+		: m_Textures(std::move(textures))
+	{
+		uint32_t pageCount = 0;
+		for (const auto& layout : m_Textures)
+		{
+			m_Offsets.push_back(pageCount);
+			pageCount += layout.PageCount;
+		}
+		m_Indirection.resize(pageCount);
+		m_Resident.assign(pageCount, m_None);
+		m_IsDirty.assign(m_Textures.size(), false);
+
+		uint32_t textureCount = uint32_t(m_Textures.size());
+		m_Slots.resize((std::max)(slots, textureCount + 1));
+		for (uint32_t slot = uint32_t(m_Slots.size()); slot-- > textureCount;)
+		{
+			m_Free.push_back(slot);
+		}
+
+		for (uint32_t texture = 0; texture < textureCount; texture++)
+		{
+			uint32_t tail = m_Textures[texture].Mips - 1;
+			m_Slots[texture] = { texture, m_Textures[texture].Offsets[tail], m_None, m_None, 0 };
+			m_Resident[m_Offsets[texture] + m_Textures[texture].Offsets[tail]] = texture;
+			Uploads.push_back({ texture, tail, 0, 0, texture });
+			MarkDirty(texture);
+			BuildIndirection(texture);
+		}
+		Stats.Uploads = textureCount;
+		Stats.Resident = textureCount;
+		Stats.Slots = uint32_t(m_Slots.size());
+	}
+
+	void PageCache::Update(std::span<const uint32_t> requests, uint32_t maxUploads)
+	{
+		m_Frame++;
+		for (uint32_t texture : Dirty)
+		{
+			m_IsDirty[texture] = false;
+		}
+		Dirty.clear();
+		Uploads.clear();
+		Stats = {};
+		Stats.Slots = uint32_t(m_Slots.size());
+
+		// Every ancestor as well, so a page that was just loaded always has a parent to fall back to later
+		// Feedback repeats the same few pages a lot, so they are made unique before and after
+		std::vector<uint32_t> unique(requests.begin(), requests.end());
+		std::sort(unique.begin(), unique.end());
+		unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+		std::vector<uint32_t> pages;
+		pages.reserve(unique.size() * 2);
+		for (uint32_t request : unique)
+		{
+			if (request == NoRequest) continue;
+
+			uint32_t texture = request >> 20;
+			uint32_t mip = (request >> 16) & 0xf;
+			uint32_t y = (request >> 8) & 0xff;
+			uint32_t x = request & 0xff;
+			if (texture >= m_Textures.size()) continue;
+
+			const auto& layout = m_Textures[texture];
+			if (mip >= layout.Mips || x >= layout.PagesX[mip] || y >= layout.PagesY[mip]) continue;
+			for (; mip + 1 < layout.Mips; mip++)
+			{
+				pages.push_back(EncodeRequest(texture, mip, x, y));
+				x = (std::min)(x / 2, layout.PagesX[mip + 1] - 1);
+				y = (std::min)(y / 2, layout.PagesY[mip + 1] - 1);
+			}
+		}
+		std::sort(pages.begin(), pages.end());
+		pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+		Stats.Requested = uint32_t(pages.size());
+
+		std::vector<uint32_t> missing;
+		for (uint32_t request : pages)
+		{
+			uint32_t slot = m_Resident[GetPage(request >> 20, (request >> 16) & 0xf, request & 0xff, (request >> 8) & 0xff)];
+			if (slot == m_None)
+			{
+				missing.push_back(request);
+				continue;
+			}
+
+			Unlink(slot);
+			PushFront(slot);
+			m_Slots[slot].LastUsed = m_Frame;
+			Stats.Hits++;
+		}
+		Stats.Misses = uint32_t(missing.size());
+
+		// Coarse pages first, they cover the most screen for their size and become the fallback of finer ones
+		std::stable_sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return ((a >> 16) & 0xf) > ((b >> 16) & 0xf); });
+		for (uint32_t i = 0; i < missing.size(); i++)
+		{
+			if (Uploads.size() == maxUploads)
+			{
+				Stats.Deferred = uint32_t(missing.size()) - i;
+				break;
+			}
+
+			uint32_t slot;
+			if (m_Free.size())
+			{
+				slot = m_Free.back();
+				m_Free.pop_back();
+			}
+			else if (m_Tail != m_None && m_Slots[m_Tail].LastUsed != m_Frame)
+			{
+				slot = m_Tail;
+				Unlink(slot);
+				m_Resident[m_Offsets[m_Slots[slot].Texture] + m_Slots[slot].Page] = m_None;
+				MarkDirty(m_Slots[slot].Texture);
+				Stats.Evictions++;
+			}
+			else
+			{
+				Stats.Dropped = uint32_t(missing.size()) - i;
+				break;
+			}
+
+			uint32_t request = missing[i];
+			Assign(slot, request >> 20, (request >> 16) & 0xf, request & 0xff, (request >> 8) & 0xff);
+		}
+
+		for (uint32_t texture : Dirty)
+		{
+			BuildIndirection(texture);
+		}
+		Stats.Uploads = uint32_t(Uploads.size());
+		Stats.Resident = uint32_t(m_Slots.size() - m_Free.size());
+	}
+
+	uint32_t PageCache::GetPage(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y) const
+	{
+		const auto& layout = m_Textures[texture];
+		return m_Offsets[texture] + layout.Offsets[mip] + y * layout.PagesX[mip] + x;
+	}
+
+	void PageCache::Unlink(uint32_t slot)
+	{
+		auto& entry = m_Slots[slot];
+		if (entry.Previous != m_None) m_Slots[entry.Previous].Next = entry.Next;
+		else if (m_Head == slot) m_Head = entry.Next;
+		if (entry.Next != m_None) m_Slots[entry.Next].Previous = entry.Previous;
+		else if (m_Tail == slot) m_Tail = entry.Previous;
+		entry.Previous = m_None;
+		entry.Next = m_None;
+	}
+
+	void PageCache::PushFront(uint32_t slot)
+	{
+		auto& entry = m_Slots[slot];
+		entry.Previous = m_None;
+		entry.Next = m_Head;
+		if (m_Head != m_None) m_Slots[m_Head].Previous = slot;
+		m_Head = slot;
+		if (m_Tail == m_None) m_Tail = slot;
+	}
+
+	void PageCache::Assign(uint32_t slot, uint32_t texture, uint32_t mip, uint32_t x, uint32_t y)
+	{
+		uint32_t page = GetPage(texture, mip, x, y);
+		m_Slots[slot].Texture = texture;
+		m_Slots[slot].Page = page - m_Offsets[texture];
+		m_Slots[slot].LastUsed = m_Frame;
+		m_Resident[page] = slot;
+		PushFront(slot);
+		Uploads.push_back({ texture, mip, x, y, slot });
+		MarkDirty(texture);
+	}
+
+	void PageCache::MarkDirty(uint32_t texture)
+	{
+		if (m_IsDirty[texture]) return;
+		m_IsDirty[texture] = true;
+		Dirty.push_back(texture);
+	}
+
+	void PageCache::BuildIndirection(uint32_t texture)
+	{
+		const auto& layout = m_Textures[texture];
+		uint32_t offset = m_Offsets[texture];
+		for (uint32_t mip = layout.Mips; mip-- > 0;)
+		{
+			for (uint32_t y = 0; y < layout.PagesY[mip]; y++)
+			{
+				for (uint32_t x = 0; x < layout.PagesX[mip]; x++)
+				{
+					uint32_t page = offset + layout.Offsets[mip] + y * layout.PagesX[mip] + x;
+					if (m_Resident[page] != m_None)
+					{
+						m_Indirection[page] = EncodeEntry(m_Resident[page], mip);
+						continue;
+					}
+
+					// The tail is always resident, so there is a parent
+					uint32_t parentX = (std::min)(x / 2, layout.PagesX[mip + 1] - 1);
+					uint32_t parentY = (std::min)(y / 2, layout.PagesY[mip + 1] - 1);
+					m_Indirection[page] = m_Indirection[offset + layout.Offsets[mip + 1] + parentY * layout.PagesX[mip + 1] + parentX];
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "SceneData.h"
+
+// CPU side of software virtual texturing, no D3D. A paged texture is split into square pages of every mip level
+// down to the first one that fits a single page, its tail. Only the pages that feedback asks for are kept in a fixed
+// number of physical slots, least recently used first out. The tail is always resident so there is a fallback.
+// The encodings are shared with Shaders/VirtualTexture.hlsli.
+namespace Pages
+{
+
+	constexpr uint32_t Size = 128;
+	// One block of neighbouring texels on every side, enough for bilinear filtering without seams
+	constexpr uint32_t Border = 4;
+	constexpr uint32_t SlotSize = Size + 2 * Border;
+	// A pool is an array of square layers of slots
+	constexpr uint32_t SlotsPerSide = 16;
+	constexpr uint32_t SlotsPerLayer = SlotsPerSide * SlotsPerSide;
+	constexpr uint32_t MaxMips = 16;
+
+	// Feedback: texture 12 bits, mip 4, page x and y 8 each
+	constexpr uint32_t NoRequest = ~0u;
+
+	inline uint32_t EncodeRequest(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y)
+	{
+		return texture << 20 | mip << 16 | y << 8 | x;
+	}
+
+	// Indirection: slot 20 bits, mip of the page in it above
+	inline uint32_t EncodeEntry(uint32_t slot, uint32_t mip)
+	{
+		return slot | mip << 20;
+	}
+
+	// Only block compressed textures with mips beyond one page are worth paging, the border is copied in blocks
+	bool IsPageable(uint32_t width, uint32_t height, uint32_t mipLevels, TextureFormat format);
+
+	struct Layout
+	{
+		uint32_t Width;
+		uint32_t Height;
+		// Paged mips, the last one is the tail
+		uint32_t Mips;
+		uint32_t PagesX[MaxMips];
+		uint32_t PagesY[MaxMips];
+		// Of each mip's first page, from the texture's first
+		uint32_t Offsets[MaxMips];
+		uint32_t PageCount;
+
+		static Layout Create(uint32_t width, uint32_t height);
+	};
+
+	// Blocks of one page with its border, wrapping around the texture's edges. out holds SlotSize / 4 rows of GetSlotPitch bytes.
+	void CopyPage(const TextureView& texture, uint32_t mip, uint32_t x, uint32_t y, uint8_t* out);
+
+	inline uint32_t GetSlotPitch(TextureFormat format)
+	{
+		return SlotSize / 4 * GetElementSize(format);
+	}
+
+	struct Upload
+	{
+		uint32_t Texture;
+		uint32_t Mip;
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Slot;
+	};
+
+	// Of the last Update, counted in unique pages
+	struct CacheStats
+	{
+		// With the ancestors of every requested page
+		uint32_t Requested = 0;
+		uint32_t Hits = 0;
+		uint32_t Misses = 0;
+		uint32_t Uploads = 0;
+		uint32_t Evictions = 0;
+		// Over the upload limit, asked for again by the next feedback
+		uint32_t Deferred = 0;
+		// Every slot is in use by pages requested this frame
+		uint32_t Dropped = 0;
+		uint32_t Resident = 0;
+		uint32_t Slots = 0;
+	};
+
+	class PageCache
+	{
+	public:
+		PageCache() = default;
+		// slots includes one pinned slot per texture for its tail, the tails are the first uploads
+		PageCache(std::vector<Layout> textures, uint32_t slots);
+
+		// Requests are in any order, duplicates, NoRequest and pages that don't exist are skipped. Resident pages
+		// are marked used, then at most maxUploads missing ones get a slot, coarsest first.
+		void Update(std::span<const uint32_t> requests, uint32_t maxUploads);
+
+		// Every texture's page table, back to back, see GetOffset. A resident page points at its own slot,
+		// a missing one at its closest resident ancestor.
+		const std::vector<uint32_t>& GetIndirection() const { return m_Indirection; }
+		uint32_t GetOffset(uint32_t texture) const { return m_Offsets[texture]; }
+		const Layout& GetLayout(uint32_t texture) const { return m_Textures[texture]; }
+		uint32_t GetTextureCount() const { return uint32_t(m_Textures.size()); }
+		uint32_t GetSlotCount() const { return uint32_t(m_Slots.size()); }
+
+		// Pages to copy into their slots, and the textures whose indirection changed since the last Update
+		std::vector<Upload> Uploads;
+		std::vector<uint32_t> Dirty;
+		CacheStats Stats;
+
+	private:
+		struct Slot
+		{
+			uint32_t Texture;
+			uint32_t Page;
+			uint32_t Previous;
+			uint32_t Next;
+			uint64_t LastUsed;
+		};
+
+		static constexpr uint32_t m_None = ~0u;
+
+		uint32_t GetPage(uint32_t texture, uint32_t mip, uint32_t x, uint32_t y) const;
+		// LRU list, most recent first. Tail slots are never in it.
+		void Unlink(uint32_t slot);
+		void PushFront(uint32_t slot);
+		void Assign(uint32_t slot, uint32_t texture, uint32_t mip, uint32_t x, uint32_t y);
+		void MarkDirty(uint32_t texture);
+		void BuildIndirection(uint32_t texture);
+
+		std::vector<Layout> m_Textures;
+		std::vector<uint32_t> m_Offsets;
+		std::vector<uint32_t> m_Indirection;
+		// Slot of every page or m_None, same indexing as m_Indirection
+		std::vector<uint32_t> m_Resident;
+		std::vector<Slot> m_Slots;
+		std::vector<uint32_t> m_Free;
+		std::vector<bool> m_IsDirty;
+		uint32_t m_Head = m_None;
+		uint32_t m_Tail = m_None;
+		uint64_t m_Frame = 0;
+	};
+
+}
@@ -1,5 +1,8 @@
 #include "GBuffer.h"
 
+#include "VertexFormat.h"
+#include "VirtualTexture.h"
+
 namespace GBuffer
 {
 
@@ -11,10 +14,16 @@ namespace GBuffer
 
 	D3D11_VIEWPORT Viewport;
 	ID3D11InputLayout* Layout = nullptr;
+	ID3D11InputLayout* CompactLayout = nullptr;
+	ID3D11InputLayout* DepthLayout = nullptr;
 	ID3D11VertexShader* WriteVS = nullptr;
+	ID3D11VertexShader* WriteCompactVS = nullptr;
+	ID3D11VertexShader* DepthVS = nullptr;
 	ID3D11PixelShader* m_WritePS = nullptr;
+	// Same, with the alpha test
+	ID3D11PixelShader* m_WriteMaskedPS = nullptr;
 	ID3D11Buffer* CameraBuffer = nullptr;
-	ID3D11Buffer* m_WritePSBuffer = nullptr;
+	Frustum ViewFrustum;
 
 	ID3D11VertexShader* ReadVS = nullptr;
 	ID3D11PixelShader* m_ReadPS = nullptr;
@@ -23,36 +32,63 @@ namespace GBuffer
 	DirectX::XMMATRIX m_Projection;
 	uint32_t m_RenderMode;
 
+	DXGI_FORMAT GetFormat(VertexFormat::AttributeFormat format)
+	{
+		switch (format)
+		{
+		case VertexFormat::AttributeFormat::Float2: return DXGI_FORMAT_R32G32_FLOAT;
+		case VertexFormat::AttributeFormat::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+		case VertexFormat::AttributeFormat::Float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		case VertexFormat::AttributeFormat::UNorm16x4: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case VertexFormat::AttributeFormat::SNorm16x2: return DXGI_FORMAT_R16G16_SNORM;
+		case VertexFormat::AttributeFormat::Half2: return DXGI_FORMAT_R16G16_FLOAT;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	// Vertex attributes in slot 0, the instance transforms and quantization in slot 1
+	ID3D11InputLayout* CreateLayout(const VertexFormat::Attribute* attributes, size_t count, ID3DBlob* blob)
+	{
+		std::vector<D3D11_INPUT_ELEMENT_DESC> iaDesc;
+		for (size_t i = 0; i < count; i++)
+		{
+			iaDesc.push_back({ attributes[i].Semantic, 0, GetFormat(attributes[i].Format),
+				0, attributes[i].Offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		}
+		for (const auto& attribute : VertexFormat::Instance)
+		{
+			iaDesc.push_back({ attribute.Semantic, 0, GetFormat(attribute.Format),
+				1, attribute.Offset, D3D11_INPUT_PER_INSTANCE_DATA, 1 });
+		}
+
+		ID3D11InputLayout* layout;
+		Window::Device->CreateInputLayout(
+			iaDesc.data(), UINT(iaDesc.size()),
+			blob->GetBufferPointer(), blob->GetBufferSize(), &layout
+		);
+		return layout;
+	}
+
 	void Initialize()
 	{
 		ID3DBlob* blob;
 		D3DReadFileToBlob(L"GBufferWriteVS.cso", &blob);
 		Window::Device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &WriteVS);
 
-		D3D11_INPUT_ELEMENT_DESC iaDesc[] =
-		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		Layout = CreateLayout(VertexFormat::Full, std::size(VertexFormat::Full), blob);
 
-			{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		D3DReadFileToBlob(L"GBufferWriteCompactVS.cso", &blob);
+		Window::Device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &WriteCompactVS);
+		CompactLayout = CreateLayout(VertexFormat::Compact, std::size(VertexFormat::Compact), blob);
 
-			{ "BITANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-
-			{ "UV", 0, DXGI_FORMAT_R32G32_FLOAT,
-			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-		};
-		Window::Device->CreateInputLayout(
-			iaDesc, sizeof(iaDesc) / sizeof(iaDesc[0]),
-			blob->GetBufferPointer(), blob->GetBufferSize(), &Layout
-		);
+		D3DReadFileToBlob(L"DepthVS.cso", &blob);
+		Window::Device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &DepthVS);
+		DepthLayout = CreateLayout(VertexFormat::Position, std::size(VertexFormat::Position), blob);
 
 		D3DReadFileToBlob(L"GBufferWritePS.cso", &blob);
 		Window::Device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_WritePS);
+		D3DReadFileToBlob(L"GBufferWriteMaskedPS.cso", &blob);
+		Window::Device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_WriteMaskedPS);
 		D3DReadFileToBlob(L"GBufferReadVS.cso", &blob);
 		Window::Device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &ReadVS);
 		D3DReadFileToBlob(L"GBufferReadPS.cso", &blob);
@@ -75,7 +111,6 @@ namespace GBuffer
 		};
 		Window::Device->CreateBuffer(&cDesc, nullptr, &CameraBuffer);
 		cDesc.ByteWidth = 16;
-		Window::Device->CreateBuffer(&cDesc, nullptr, &m_WritePSBuffer);
 		Window::Device->CreateBuffer(&cDesc, nullptr, &m_ReadPSBuffer);
 
 		D3D11_SAMPLER_DESC sDesc{
@@ -92,11 +127,15 @@ namespace GBuffer
 	void Shutdown()
 	{
 		Layout->Release();
+		CompactLayout->Release();
+		DepthLayout->Release();
 		SamplerState->Release();
 		WriteVS->Release();
+		WriteCompactVS->Release();
+		DepthVS->Release();
 		m_WritePS->Release();
+		m_WriteMaskedPS->Release();
 		CameraBuffer->Release();
-		m_WritePSBuffer->Release();
 
 		ReadVS->Release();
 		m_ReadPS->Release();
@@ -129,6 +168,7 @@ namespace GBuffer
 		using namespace DirectX;
 
 		XMMATRIX viewProj = matrix * m_Projection;
+		ViewFrustum = Frustum::FromMatrix(viewProj);
 		XMFLOAT4X4 viewProjection;
 		XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(viewProj));
 		XMMATRIX inv = XMMatrixInverse(nullptr, viewProj);
@@ -142,7 +182,27 @@ namespace GBuffer
 		Window::Context->Unmap(CameraBuffer, 0);
 	}
 
-	void Write(Scene* scene)
+	void SetGeometry(Scene* scene)
+	{
+		ID3D11Buffer* buffers[] = { scene->VertexBuffer, scene->InstanceBuffer };
+		UINT strides[] = { scene->VertexStride, sizeof(VertexFormat::InstanceRecord) };
+		UINT offsets[] = { 0, 0 };
+		Window::Context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		Window::Context->IASetIndexBuffer(scene->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		Window::Context->IASetInputLayout(scene->Compact ? CompactLayout : Layout);
+	}
+
+	void SetPositions(Scene* scene)
+	{
+		ID3D11Buffer* buffers[] = { scene->PositionBuffer, scene->InstanceBuffer };
+		UINT strides[] = { sizeof(DirectX::XMFLOAT3), sizeof(VertexFormat::InstanceRecord) };
+		UINT offsets[] = { 0, 0 };
+		Window::Context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		Window::Context->IASetIndexBuffer(scene->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		Window::Context->IASetInputLayout(DepthLayout);
+	}
+
+	void Write(Scene* scene, const DrawList& draws)
 	{
 		Window::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -151,32 +211,37 @@ namespace GBuffer
 		Window::Context->ClearRenderTargetView(m_Buffers[0], clear);
 		Window::Context->ClearRenderTargetView(m_Buffers[1], clear);
 
-		Window::Context->OMSetRenderTargets(2, m_Buffers, m_DepthBuffer);
+		Window::Context->OMSetRenderTargetsAndUnorderedAccessViews(2, m_Buffers, m_DepthBuffer, 2, 1, &VirtualTexture::FeedbackView, nullptr);
 		Window::Context->OMSetDepthStencilState(DepthState, 0);
-		Window::Context->VSSetShader(WriteVS, nullptr, 0);
+		Window::Context->VSSetShader(scene->Compact ? WriteCompactVS : WriteVS, nullptr, 0);
 		Window::Context->GSSetShader(nullptr, nullptr, 0);
 		Window::Context->PSSetShader(m_WritePS, nullptr, 0);
 		Window::Context->RSSetViewports(1, &Viewport);
-		UINT offset = 0;
-		UINT stride = sizeof(Vertex);
-		Window::Context->IASetVertexBuffers(0, 1, &scene->VertexBuffer, &stride, &offset);
-		Window::Context->IASetIndexBuffer(scene->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-		Window::Context->IASetInputLayout(Layout);
+		SetGeometry(scene);
 		Window::Context->VSSetConstantBuffers(0, 1, &CameraBuffer);
-		Window::Context->PSSetConstantBuffers(0, 1, &m_WritePSBuffer);
 		Window::Context->PSSetSamplers(0, 1, &SamplerState);
+		VirtualTexture::Bind();
 
-		for (const auto& material : scene->Materials)
+		uint32_t bound = ~0u;
+		auto submit = [&](const std::vector<DrawRange>& list)
 		{
-			D3D11_MAPPED_SUBRESOURCE sub;
-			Window::Context->Map(m_WritePSBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &sub);
-			memcpy(sub.pData, &material.BumpMapSize, sizeof(material.BumpMapSize));
-			Window::Context->Unmap(m_WritePSBuffer, 0);
-
-			Window::Context->PSSetShaderResources(0, 3, &material.Albedo);
-			Window::Context->DrawIndexed(material.IndexCount, material.BaseIndex, material.BaseVertex);
-		}
-		Window::Context->OMSetRenderTargets(0, nullptr, nullptr);
+			for (const auto& draw : list)
+			{
+				const auto& material = scene->Materials[draw.Material];
+				if (draw.Material != bound)
+				{
+					Window::Context->PSSetShaderResources(0, 2, &material.Albedo);
+					VirtualTexture::SetMaterial(material);
+					bound = draw.Material;
+				}
+				Window::Context->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.BaseIndex, material.BaseVertex, draw.BaseInstance);
+			}
+		};
+		// Opaque first with early depth, the alpha tested ones are then rejected by their depth where they are hidden
+		submit(draws.Draws);
+		Window::Context->PSSetShader(m_WriteMaskedPS, nullptr, 0);
+		submit(draws.MaskedDraws);
+		Window::Context->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 0, nullptr, nullptr);
 	}
 
 	void DrawDebug()
@@ -11,18 +11,30 @@ namespace GBuffer
 	void SetDebugMode(uint32_t mode);
 	void SetViewMatrix(const DirectX::XMMATRIX& matrix);
 
-	void Write(Scene* scene);
+	// Binds the scene's vertex, instance and index buffers with the matching input layout.
+	// Draws pass their first instance as StartInstanceLocation.
+	void SetGeometry(Scene* scene);
+	// Same with the position stream in place of the vertices, for DepthVS
+	void SetPositions(Scene* scene);
+
+	void Write(Scene* scene, const DrawList& draws);
 	void DrawDebug();
 
 	void Resize(uint32_t width, uint32_t height);
 
 	extern ID3D11Buffer* CameraBuffer;
 	extern ID3D11VertexShader* WriteVS;
+	extern ID3D11VertexShader* WriteCompactVS;
+	// Transforms Scene::PositionBuffer only, for passes without a pixel shader
+	extern ID3D11VertexShader* DepthVS;
 	extern ID3D11InputLayout* Layout;
+	extern ID3D11InputLayout* CompactLayout;
 	extern ID3D11ShaderResourceView* Views[3];
 	extern ID3D11VertexShader* ReadVS;
 	extern D3D11_VIEWPORT Viewport;
 	extern ID3D11SamplerState* SamplerState;
 	extern ID3D11DepthStencilState* DepthState;
+	// Camera frustum from the last SetViewMatrix
+	extern Frustum ViewFrustum;
 
 }
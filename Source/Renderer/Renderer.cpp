@@ -8,26 +8,50 @@
 #include "Voxel.h"
 #include "Finalizer.h"
 #include "ShadowMap.h"
+#include "VirtualTexture.h"
+#include "HotReload.h"
+#include "SceneLoader.h"
+#include "Jobs.h"
 
 namespace Renderer
 {
 	std::string m_CurrentScenePath;
+	std::string m_LoadingScenePath;
 	Scene m_CurrentScene;
+	ImportOptions m_ImportOptions;
 
 	Camera m_Camera;
 
 	Light m_Light;
 
+	// Shadow, voxel and camera passes
+	DrawList m_Draws[3];
+	bool m_UseLods = true;
+
+	// Of the virtual texture pools, in MiB
+	int m_PageBudget = 256;
+	// Of the voxel grid, in MiB
+	int m_VoxelBudget = 64;
+	// What the shadow map and the voxel grid were last fitted to
+	Box m_FittedBounds = {};
+
+	void FitScene()
+	{
+		m_FittedBounds = m_CurrentScene.Bounds;
+		ShadowMap::SetLight(m_Light, m_FittedBounds);
+		Voxel::Fit(m_FittedBounds, uint64_t(m_VoxelBudget) << 20);
+	}
+
 	void Initialize()
 	{
 		GBuffer::Initialize();
 		ShadowMap::Initialize();
 		Voxel::Initialize();
 		Finalizer::Initialize();
+		VirtualTexture::Initialize();
 
-		Voxel::Resize(128, 16.f);
 		ShadowMap::Resize(4096);
-		ShadowMap::SetLight(m_Light);
+		FitScene();
 
 		m_Camera.Position = DirectX::XMVectorSet(0.f, 0.f, 0.f, 1.f);
 		m_Camera.Rotation = DirectX::XMVectorSet(0.f, 0.f, 0.f, 1.f);
@@ -35,6 +59,9 @@ namespace Renderer
 
 	void Shutdown()
 	{
+		SceneLoader::Shutdown();
+		HotReload::Shutdown();
+		VirtualTexture::Shutdown();
 		Finalizer::Shutdown();
 		Voxel::Shutdown();
 		ShadowMap::Shutdown();
@@ -96,7 +123,7 @@ namespace Renderer
 
 		if (change)
 		{
-			ShadowMap::SetLight(m_Light);
+			ShadowMap::SetLight(m_Light, m_FittedBounds);
 		}
 	}
 
@@ -107,23 +134,85 @@ namespace Renderer
 
 		float deltaTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - lastTickTime).count();
 
+		// Nothing has been recorded for this frame yet, the old scene is released with its last frame done
+		std::string loadError;
+		if (SceneLoader::Poll(m_CurrentScene, loadError))
+		{
+			m_CurrentScenePath = std::move(m_LoadingScenePath);
+			HotReload::Watch(m_CurrentScenePath, m_ImportOptions);
+			VirtualTexture::SetScene(&m_CurrentScene, uint64_t(m_PageBudget) << 20);
+		}
+		else if (loadError.size())
+		{
+			MessageBoxA(nullptr, loadError.c_str(), "Error", MB_OK | MB_ICONERROR);
+		}
+		else if (!SceneLoader::IsLoading() && HotReload::Update(m_CurrentScene))
+		{
+			m_LoadingScenePath = m_CurrentScenePath;
+			SceneLoader::Start(m_LoadingScenePath, m_ImportOptions);
+		}
+
 		if (ImGui::Begin("Tools"))
 		{
 			ImGui::Text("Delta Time: %.1fms", deltaTime * 1000.f);
 			ImGui::Text("FPS: %.3f", 1 / deltaTime);
-			if (ImGui::Button("Load"))
+			if (SceneLoader::IsLoading())
 			{
-				m_CurrentScenePath = Window::FileDialog();
-				if (m_CurrentScenePath.size())
+				if (ImGui::Button("Cancel"))
 				{
-					try { m_CurrentScene = Scene(m_CurrentScenePath); }
-					catch (const std::exception& e)
+					SceneLoader::Cancel();
+				}
+				ImGui::SameLine();
+				float fraction = SceneLoader::GetFraction();
+				auto stage = SceneLoader::GetStage();
+				ImGui::ProgressBar(fraction < 0.f ? 0.f : fraction, ImVec2(-1.f, 0.f), stage.c_str());
+			}
+			else
+			{
+				if (ImGui::Button("Load"))
+				{
+					m_LoadingScenePath = Window::FileDialog();
+					if (m_LoadingScenePath.size())
 					{
-						MessageBoxA(nullptr, e.what(), "Error", MB_OK | MB_ICONERROR);
+						SceneLoader::Start(m_LoadingScenePath, m_ImportOptions);
 					}
 				}
+				ImGui::SameLine();
+				ImGui::Checkbox("Compact Vertices", &m_ImportOptions.CompactVertices);
+				ImGui::SameLine();
+				ImGui::Checkbox("Atlas Textures", &m_ImportOptions.AtlasTextures);
+				ImGui::SameLine();
+				ImGui::Checkbox("Virtual Textures", &m_ImportOptions.VirtualTextures);
 			}
 			ImGui::Text("%s", m_CurrentScenePath.c_str());
+			if (m_CurrentScene.Stats.Stages.size() && ImGui::TreeNode("Import Stats"))
+			{
+				for (const auto& stage : m_CurrentScene.Stats.Stages)
+				{
+					ImGui::Text("%s: %.1fms", stage.Name.c_str(), stage.Milliseconds);
+				}
+				for (const auto& counter : m_CurrentScene.Stats.Counters)
+				{
+					ImGui::Text("%s: %.2f", counter.Name.c_str(), counter.Value);
+				}
+				ImGui::TreePop();
+			}
+			if (HotReload::Error.size())
+			{
+				ImGui::Text("Hot reload: %s", HotReload::Error.c_str());
+			}
+			if (HotReload::Stats.Stages.size() && ImGui::TreeNode("Hot Reload Stats"))
+			{
+				for (const auto& stage : HotReload::Stats.Stages)
+				{
+					ImGui::Text("%s: %.1fms", stage.Name.c_str(), stage.Milliseconds);
+				}
+				for (const auto& counter : HotReload::Stats.Counters)
+				{
+					ImGui::Text("%s: %.2f", counter.Name.c_str(), counter.Value);
+				}
+				ImGui::TreePop();
+			}
 
 			DrawLight();
 
@@ -198,11 +287,70 @@ namespace Renderer
 
 		UpdateInput(deltaTime);
 
+		// Loads and hot reload patches both move the bounds
+		if (memcmp(&m_FittedBounds, &m_CurrentScene.Bounds, sizeof(Box)))
+		{
+			FitScene();
+		}
+		if (ImGui::TreeNode("Scene Fit"))
+		{
+			if (ImGui::SliderInt("Voxel Budget (MiB)", &m_VoxelBudget, 1, 512))
+			{
+				FitScene();
+			}
+			const auto& bounds = m_FittedBounds;
+			ImGui::Text("Bounds: %.2f x %.2f x %.2f", bounds.Max.x - bounds.Min.x, bounds.Max.y - bounds.Min.y, bounds.Max.z - bounds.Min.z);
+			ImGui::Text("Shadow texel: %.4f (%.2f texels per unit)", ShadowMap::TexelSize, 1.f / ShadowMap::TexelSize);
+			ImGui::Text("Voxel: %.4f (%.2f voxels per unit), %u^3, %.1f MiB", Voxel::VoxelSize, 1.f / Voxel::VoxelSize, Voxel::Resolution,
+				double(Voxel::Resolution) * Voxel::Resolution * Voxel::Resolution * Voxel::BytesPerVoxel / double(1 << 20));
+			ImGui::TreePop();
+		}
+
+		const Frustum* volumes[] = { &ShadowMap::LightVolume, &Voxel::Volume, &GBuffer::ViewFrustum };
+		Jobs::ParallelFor(3, [&](uint32_t i)
+			{
+				Culling::Cull(m_CurrentScene.CullingBounds, *volumes[i], m_Draws[i]);
+			});
+		// Shadows can't show detail below a texel, and voxelization below half a voxel
+		if (m_UseLods)
+		{
+			Culling::SelectLods(m_Draws[0], m_CurrentScene.Lods, ShadowMap::TexelSize);
+			Culling::SelectLods(m_Draws[1], m_CurrentScene.Lods, Voxel::VoxelSize * 0.5f);
+		}
+		if (ImGui::TreeNode("Virtual Textures"))
+		{
+			if (ImGui::SliderInt("Page Budget (MiB)", &m_PageBudget, 16, 4096))
+			{
+				VirtualTexture::SetScene(&m_CurrentScene, uint64_t(m_PageBudget) << 20);
+			}
+			int maxUploads = int(VirtualTexture::MaxUploads);
+			if (ImGui::SliderInt("Max Uploads", &maxUploads, 1, 256)) VirtualTexture::MaxUploads = uint32_t(maxUploads);
+			const auto& stats = VirtualTexture::Stats;
+			ImGui::Text("%u requested, %u hits, %u misses, %u uploads, %u evictions", stats.Requested, stats.Hits,
+				stats.Misses, stats.Uploads, stats.Evictions);
+			ImGui::Text("%u deferred, %u dropped, %u / %u slots resident", stats.Deferred, stats.Dropped, stats.Resident, stats.Slots);
+			ImGui::TreePop();
+		}
+		if (ImGui::TreeNode("Culling"))
+		{
+			ImGui::Checkbox("LODs", &m_UseLods);
+			const char* names[] = { "Shadow", "Voxel", "Camera" };
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				ImGui::Text("%s: %u visible, %u culled, %zu draws, %zu masked, %u triangles, %u LODs, %.3fms", names[i], m_Draws[i].Visible,
+					m_Draws[i].Culled, m_Draws[i].Draws.size(), m_Draws[i].MaskedDraws.size(), m_Draws[i].Triangles, m_Draws[i].Simplified,
+					m_Draws[i].Milliseconds);
+			}
+			ImGui::TreePop();
+		}
+
 		DirectX::XMFLOAT3 pos;
 		DirectX::XMStoreFloat3(&pos, m_Camera.Position);
-		ShadowMap::Write(&m_CurrentScene);
-		Voxel::Voxelize(&m_CurrentScene, pos);
-		GBuffer::Write(&m_CurrentScene);
+		VirtualTexture::Update();
+		ShadowMap::Write(&m_CurrentScene, m_Draws[0]);
+		Voxel::Voxelize(&m_CurrentScene, pos, m_Draws[1]);
+		GBuffer::Write(&m_CurrentScene, m_Draws[2]);
+		VirtualTexture::ResolveFeedback();
 
 		if (selected[0])
 		{
@@ -225,5 +373,6 @@ namespace Renderer
 	void OnResize(uint32_t width, uint32_t height)
 	{
 		GBuffer::Resize(width, height);
+		VirtualTexture::Resize(width, height);
 	}
 }
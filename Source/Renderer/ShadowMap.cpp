@@ -1,17 +1,28 @@
 #include "ShadowMap.h"
 
+#include <algorithm>
+
 #include "GBuffer.h"
+#include "VirtualTexture.h"
 
 namespace ShadowMap
 {
 
+	// Around the fitted box in texels, so filtering at the scene's edge stays inside the map
+	constexpr float m_BorderTexels = 2.f;
+
 	ID3D11Buffer* LightMatrix = nullptr;
 	ID3D11Buffer* LightBuffer = nullptr;
 	D3D11_VIEWPORT m_Viewport;
+	uint32_t m_Width = 1;
 	ID3D11ShaderResourceView* ShadowMapView = nullptr;
 	ID3D11SamplerState* Sampler = nullptr;
+	Frustum LightVolume;
+	float TexelSize = 1.f;
 	ID3D11DepthStencilView* m_ShadowMapDSV = nullptr;
 	ID3D11RasterizerState* m_RasterizerState = nullptr;
+	// Alpha test for masked batches, the others are drawn without a pixel shader
+	ID3D11PixelShader* m_MaskedPS = nullptr;
 
 	void Initialize()
 	{
@@ -47,6 +58,10 @@ namespace ShadowMap
 			.AntialiasedLineEnable = FALSE
 		};
 		Window::Device->CreateRasterizerState(&rDesc, &m_RasterizerState);
+
+		ID3DBlob* blob;
+		D3DReadFileToBlob(L"ShadowMaskedPS.cso", &blob);
+		Window::Device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_MaskedPS);
 	}
 
 	void Shutdown()
@@ -57,9 +72,10 @@ namespace ShadowMap
 		Sampler->Release();
 		m_ShadowMapDSV->Release();
 		m_RasterizerState->Release();
+		m_MaskedPS->Release();
 	}
 
-	void SetLight(const Light& light)
+	void SetLight(const Light& light, const Box& bounds)
 	{
 		D3D11_MAPPED_SUBRESOURCE sub;
 		Window::Context->Map(LightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &sub);
@@ -68,13 +84,37 @@ namespace ShadowMap
 
 		using namespace DirectX;
 
-		auto projection = XMMatrixOrthographicLH(3000.f, 3000.f, 8000.f, 0.1f);
 		auto direction = XMLoadFloat3(&light.Direction);
 		auto up = XMVector3Cross(XMVectorSet(1.f, 0.f, 0.f, 0.f), direction);
-		auto view = XMMatrixLookToLH(direction * 5000.f, -direction, up);
+		auto view = XMMatrixLookToLH(XMVectorZero(), -direction, up);
 
+		// The box around the scene's corners as the light sees them, nothing outside it casts or receives shadows
+		XMVECTOR min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			XMVECTOR corner = XMVectorSet(i & 1 ? bounds.Max.x : bounds.Min.x, i & 2 ? bounds.Max.y : bounds.Min.y,
+				i & 4 ? bounds.Max.z : bounds.Min.z, 1.f);
+			corner = XMVector3Transform(corner, view);
+			min = XMVectorMin(min, corner);
+			max = XMVectorMax(max, corner);
+		}
+		// A flat or empty scene still needs a box with some depth and area
+		float border = m_BorderTexels / float(m_Width);
+		XMVECTOR padding = XMVectorMultiply(XMVectorMax(XMVectorSubtract(max, min), XMVectorReplicate(1e-3f)), XMVectorSet(border, border, 1e-3f, 0.f));
+		min = XMVectorSubtract(min, padding);
+		max = XMVectorAdd(max, padding);
+		XMFLOAT3 size;
+		XMStoreFloat3(&size, XMVectorSubtract(max, min));
+		// The box needn't be square, the narrower side has the finer texels and LODs mustn't lose detail along it
+		TexelSize = (std::min)(size.x, size.y) / float(m_Width);
+
+		// Reversed Z like the camera, near and far swap
+		auto projection = XMMatrixOrthographicOffCenterLH(XMVectorGetX(min), XMVectorGetX(max), XMVectorGetY(min), XMVectorGetY(max),
+			XMVectorGetZ(max), XMVectorGetZ(min));
 		auto viewProj = view * projection;
 		auto inverse = XMMatrixInverse(nullptr, viewProj);
+		LightVolume = Frustum::FromMatrix(viewProj);
 
 		XMFLOAT4X4 data[2];
 		XMStoreFloat4x4(&data[0], XMMatrixTranspose(viewProj));
@@ -90,6 +130,7 @@ namespace ShadowMap
 		if (ShadowMapView) ShadowMapView->Release();
 		if (m_ShadowMapDSV) m_ShadowMapDSV->Release();
 
+		m_Width = width;
 		m_Viewport = D3D11_VIEWPORT{
 			.TopLeftX = 0.f,
 			.TopLeftY = 0.f,
@@ -130,7 +171,7 @@ namespace ShadowMap
 		depth->Release();
 	}
 
-	void Write(Scene* scene)
+	void Write(Scene* scene, const DrawList& draws)
 	{
 		Window::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -143,20 +184,39 @@ namespace ShadowMap
 		Window::Context->OMSetRenderTargets(2, views, m_ShadowMapDSV);
 		Window::Context->OMSetDepthStencilState(GBuffer::DepthState, 0);
 		Window::Context->RSSetState(m_RasterizerState);
-		Window::Context->VSSetShader(GBuffer::WriteVS, nullptr, 0);
+		Window::Context->VSSetShader(GBuffer::DepthVS, nullptr, 0);
 		Window::Context->GSSetShader(nullptr, nullptr, 0);
 		Window::Context->PSSetShader(nullptr, nullptr, 0);
 		Window::Context->RSSetViewports(1, &m_Viewport);
-		UINT offset = 0;
-		UINT stride = sizeof(Vertex);
-		Window::Context->IASetVertexBuffers(0, 1, &scene->VertexBuffer, &stride, &offset);
-		Window::Context->IASetIndexBuffer(scene->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-		Window::Context->IASetInputLayout(GBuffer::Layout);
+		GBuffer::SetPositions(scene);
 		Window::Context->VSSetConstantBuffers(0, 1, &LightMatrix);
 
-		for (const auto& material : scene->Materials)
+		for (const auto& draw : draws.Draws)
+		{
+			const auto& material = scene->Materials[draw.Material];
+			Window::Context->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.BaseIndex, material.BaseVertex, draw.BaseInstance);
+		}
+
+		// The alpha test needs UVs, so masked batches read the full vertices
+		if (draws.MaskedDraws.size())
 		{
-			Window::Context->DrawIndexed(material.IndexCount, material.BaseIndex, material.BaseVertex);
+			Window::Context->VSSetShader(scene->Compact ? GBuffer::WriteCompactVS : GBuffer::WriteVS, nullptr, 0);
+			GBuffer::SetGeometry(scene);
+			Window::Context->PSSetShader(m_MaskedPS, nullptr, 0);
+			Window::Context->PSSetSamplers(0, 1, &GBuffer::SamplerState);
+			VirtualTexture::Bind();
+			uint32_t bound = ~0u;
+			for (const auto& draw : draws.MaskedDraws)
+			{
+				const auto& material = scene->Materials[draw.Material];
+				if (draw.Material != bound)
+				{
+					Window::Context->PSSetShaderResources(0, 1, &material.Albedo);
+					VirtualTexture::SetMaterial(material);
+					bound = draw.Material;
+				}
+				Window::Context->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.BaseIndex, material.BaseVertex, draw.BaseInstance);
+			}
 		}
 		Window::Context->OMSetRenderTargets(0, nullptr, nullptr);
 	}
@@ -20,13 +20,19 @@ namespace ShadowMap
 	void Initialize();
 	void Shutdown();
 
-	void SetLight(const Light& light);
+	// Fits the light's ortho box tightly around bounds as seen along the light, call again when either changes.
+	// Resize first, the fit depends on the width.
+	void SetLight(const Light& light, const Box& bounds);
 	void Resize(uint32_t width);
 
-	void Write(Scene* scene);
+	void Write(Scene* scene, const DrawList& draws);
 
 	extern ID3D11Buffer* LightBuffer;
 	extern ID3D11Buffer* LightMatrix;
 	extern ID3D11ShaderResourceView* ShadowMapView;
 	extern ID3D11SamplerState* Sampler;
+	// The light's ortho box, for culling
+	extern Frustum LightVolume;
+	// World space size of one shadow map texel, along the box's narrower side
+	extern float TexelSize;
 }
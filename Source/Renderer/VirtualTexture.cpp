@@ -0,0 +1,410 @@
+#include "VirtualTexture.h"
+
+namespace VirtualTexture
+{
+
+	ID3D11UnorderedAccessView* FeedbackView = nullptr;
+	Pages::CacheStats Stats;
+	uint32_t MaxUploads = 32;
+
+	// Matches PagedTexture in VirtualTexture.hlsli
+	struct PagedTexture
+	{
+		uint32_t Pool;
+		uint32_t Offset;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Mips;
+	};
+
+	struct Pool
+	{
+		TextureFormat Format;
+		DXGI_FORMAT DxgiFormat;
+		ID3D11Texture2D* Texture = nullptr;
+		ID3D11ShaderResourceView* View = nullptr;
+		Pages::PageCache Cache;
+		// Scene texture of every texture in Cache
+		std::vector<uint32_t> Textures;
+		// Of the cache's indirection in the page table
+		uint32_t TableOffset = 0;
+		std::vector<uint32_t> Requests;
+	};
+
+	// Feedback is written at a fraction of the resolution and read back this many frames late
+	constexpr uint32_t m_FeedbackScale = 8;
+	constexpr uint32_t m_Latency = 3;
+	constexpr uint32_t m_PoolSize = Pages::SlotsPerSide * Pages::SlotSize;
+	constexpr uint32_t m_MaxLayers = D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION;
+
+	Pool m_Pools[] = {
+		{ TextureFormat::BC1_SRGB, DXGI_FORMAT_BC1_UNORM_SRGB },
+		{ TextureFormat::BC3_SRGB, DXGI_FORMAT_BC3_UNORM_SRGB },
+		{ TextureFormat::BC4, DXGI_FORMAT_BC4_UNORM },
+		{ TextureFormat::BC5, DXGI_FORMAT_BC5_UNORM },
+		{ TextureFormat::BC3, DXGI_FORMAT_BC3_UNORM }
+	};
+	Scene* m_Scene = nullptr;
+	// Pool and index in its cache of every scene texture, m_NotPaged for resident ones
+	std::vector<std::pair<uint32_t, uint32_t>> m_Local;
+	constexpr uint32_t m_NotPaged = ~0u;
+	bool m_HasPages = false;
+
+	ID3D11Buffer* m_PagedTextures = nullptr;
+	ID3D11ShaderResourceView* m_PagedTexturesView = nullptr;
+	ID3D11Buffer* m_PageTable = nullptr;
+	ID3D11ShaderResourceView* m_PageTableView = nullptr;
+	ID3D11Buffer* m_FeedbackBuffer = nullptr;
+	ID3D11Buffer* m_MaterialBuffer = nullptr;
+	ID3D11SamplerState* m_Sampler = nullptr;
+
+	ID3D11Texture2D* m_Feedback = nullptr;
+	ID3D11Texture2D* m_Staging[m_Latency] = {};
+	bool m_IsPending[m_Latency] = {};
+	uint32_t m_FeedbackWidth = 0;
+	uint32_t m_FeedbackHeight = 0;
+	uint64_t m_Frame = 0;
+	std::vector<uint8_t> m_PageData;
+
+	struct
+	{
+		uint32_t FeedbackOffset[2];
+		uint32_t FeedbackScale;
+		uint32_t FeedbackSlot;
+	} m_CBuffer;
+
+	template<typename T>
+	void SafeRelease(T*& resource)
+	{
+		if (resource) resource->Release();
+		resource = nullptr;
+	}
+
+	void Initialize()
+	{
+		D3D11_BUFFER_DESC cDesc{
+			.ByteWidth = 16,
+			.Usage = D3D11_USAGE_DYNAMIC,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE
+		};
+		Window::Device->CreateBuffer(&cDesc, nullptr, &m_FeedbackBuffer);
+		Window::Device->CreateBuffer(&cDesc, nullptr, &m_MaterialBuffer);
+
+		// The borders are wrapped already, clamping keeps bilinear taps inside the slot
+		D3D11_SAMPLER_DESC sDesc{
+			.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR,
+			.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP,
+			.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP,
+			.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP
+		};
+		Window::Device->CreateSamplerState(&sDesc, &m_Sampler);
+	}
+
+	void ReleaseScene()
+	{
+		for (auto& pool : m_Pools)
+		{
+			SafeRelease(pool.Texture);
+			SafeRelease(pool.View);
+			pool.Cache = {};
+			pool.Textures.clear();
+		}
+		SafeRelease(m_PagedTextures);
+		SafeRelease(m_PagedTexturesView);
+		SafeRelease(m_PageTable);
+		SafeRelease(m_PageTableView);
+		m_Local.clear();
+		m_HasPages = false;
+		Stats = {};
+	}
+
+	void ReleaseFeedback()
+	{
+		SafeRelease(m_Feedback);
+		SafeRelease(FeedbackView);
+		for (auto& staging : m_Staging)
+		{
+			SafeRelease(staging);
+		}
+	}
+
+	void Shutdown()
+	{
+		ReleaseScene();
+		ReleaseFeedback();
+		m_FeedbackBuffer->Release();
+		m_MaterialBuffer->Release();
+		m_Sampler->Release();
+	}
+
+	// Copies the cache's new pages into their slots and its changed page tables
+	void Upload(Pool& pool)
+	{
+		uint32_t pitch = Pages::GetSlotPitch(pool.Format);
+		m_PageData.resize(size_t(pitch) * (Pages::SlotSize / 4));
+		for (const auto& upload : pool.Cache.Uploads)
+		{
+			// Replaced by hot reload, nothing samples it anymore
+			const auto& texture = m_Scene->PagedTextures[pool.Textures[upload.Texture]];
+			if (texture.Pixels.empty()) continue;
+
+			Pages::CopyPage(texture, upload.Mip, upload.X, upload.Y, m_PageData.data());
+			uint32_t layer = upload.Slot / Pages::SlotsPerLayer;
+			uint32_t x = upload.Slot % Pages::SlotsPerSide * Pages::SlotSize;
+			uint32_t y = upload.Slot / Pages::SlotsPerSide % Pages::SlotsPerSide * Pages::SlotSize;
+			D3D11_BOX box{ x, y, 0, x + Pages::SlotSize, y + Pages::SlotSize, 1 };
+			Window::Context->UpdateSubresource(pool.Texture, D3D11CalcSubresource(0, layer, 1), &box, m_PageData.data(), pitch, 0);
+		}
+
+		const auto& indirection = pool.Cache.GetIndirection();
+		for (uint32_t texture : pool.Cache.Dirty)
+		{
+			uint32_t offset = pool.Cache.GetOffset(texture);
+			uint32_t first = (pool.TableOffset + offset) * sizeof(uint32_t);
+			D3D11_BOX box{ first, 0, 0, first + pool.Cache.GetLayout(texture).PageCount * uint32_t(sizeof(uint32_t)), 1, 1 };
+			Window::Context->UpdateSubresource(m_PageTable, 0, &box, indirection.data() + offset, 0, 0);
+		}
+	}
+
+	ID3D11ShaderResourceView* CreateStructuredBuffer(const void* data, uint32_t stride, uint32_t count, ID3D11Buffer** buffer)
+	{
+		D3D11_BUFFER_DESC desc{
+			.ByteWidth = stride * count,
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+			.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+			.StructureByteStride = stride
+		};
+		D3D11_SUBRESOURCE_DATA init{ .pSysMem = data };
+		Window::Device->CreateBuffer(&desc, &init, buffer);
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC rDesc{
+			.Format = DXGI_FORMAT_UNKNOWN,
+			.ViewDimension = D3D11_SRV_DIMENSION_BUFFER,
+			.Buffer = D3D11_BUFFER_SRV{ .FirstElement = 0, .NumElements = count }
+		};
+		ID3D11ShaderResourceView* view;
+		Window::Device->CreateShaderResourceView(*buffer, &rDesc, &view);
+		return view;
+	}
+
+	void SetScene(Scene* scene, uint64_t budget)
+	{
+		ReleaseScene();
+		m_Scene = scene;
+		for (auto& pending : m_IsPending)
+		{
+			pending = false;
+		}
+		if (!scene) return;
+
+		// Every pool gets a share of the budget by how much of the scene's paged data it holds
+		m_Local.assign(scene->PagedTextures.size(), { m_NotPaged, 0 });
+		uint64_t poolBytes[std::size(m_Pools)] = {};
+		uint64_t totalBytes = 0;
+		for (uint32_t t = 0; t < scene->PagedTextures.size(); t++)
+		{
+			const auto& texture = scene->PagedTextures[t];
+			if (texture.Pixels.empty()) continue;
+
+			for (uint32_t p = 0; p < std::size(m_Pools); p++)
+			{
+				if (m_Pools[p].Format != texture.Format) continue;
+				m_Local[t] = { p, uint32_t(m_Pools[p].Textures.size()) };
+				m_Pools[p].Textures.push_back(t);
+				poolBytes[p] += texture.Pixels.size();
+				totalBytes += texture.Pixels.size();
+			}
+		}
+		if (!totalBytes) return;
+		m_HasPages = true;
+
+		uint32_t tableSize = 0;
+		for (uint32_t p = 0; p < std::size(m_Pools); p++)
+		{
+			auto& pool = m_Pools[p];
+			if (pool.Textures.empty()) continue;
+
+			std::vector<Pages::Layout> layouts;
+			uint32_t pageCount = 0;
+			for (uint32_t t : pool.Textures)
+			{
+				const auto& texture = scene->PagedTextures[t];
+				layouts.push_back(Pages::Layout::Create(texture.Width, texture.Height));
+				pageCount += layouts.back().PageCount;
+			}
+
+			// Never more slots than pages, and at least one besides the tails
+			uint64_t slotBytes = GetMipSize(pool.Format, Pages::SlotSize, Pages::SlotSize);
+			uint64_t slots = uint64_t(double(budget) * poolBytes[p] / totalBytes / slotBytes);
+			slots = (std::min)(slots, uint64_t(pageCount));
+			slots = (std::max)(slots, uint64_t(pool.Textures.size() + 1));
+			slots = (std::min)(slots, uint64_t(m_MaxLayers) * Pages::SlotsPerLayer);
+			pool.Cache = Pages::PageCache(std::move(layouts), uint32_t(slots));
+			pool.TableOffset = tableSize;
+			tableSize += uint32_t(pool.Cache.GetIndirection().size());
+
+			D3D11_TEXTURE2D_DESC desc{
+				.Width = m_PoolSize,
+				.Height = m_PoolSize,
+				.MipLevels = 1,
+				.ArraySize = uint32_t((slots + Pages::SlotsPerLayer - 1) / Pages::SlotsPerLayer),
+				.Format = pool.DxgiFormat,
+				.SampleDesc = DXGI_SAMPLE_DESC{ .Count = 1, .Quality = 0 },
+				.Usage = D3D11_USAGE_DEFAULT,
+				.BindFlags = D3D11_BIND_SHADER_RESOURCE
+			};
+			Window::Device->CreateTexture2D(&desc, nullptr, &pool.Texture);
+			Window::Device->CreateShaderResourceView(pool.Texture, nullptr, &pool.View);
+		}
+
+		std::vector<uint32_t> table;
+		table.reserve(tableSize);
+		std::vector<PagedTexture> textures(scene->PagedTextures.size());
+		for (uint32_t p = 0; p < std::size(m_Pools); p++)
+		{
+			const auto& pool = m_Pools[p];
+			if (pool.Textures.empty()) continue;
+
+			table.insert(table.end(), pool.Cache.GetIndirection().begin(), pool.Cache.GetIndirection().end());
+			for (uint32_t local = 0; local < pool.Textures.size(); local++)
+			{
+				const auto& layout = pool.Cache.GetLayout(local);
+				textures[pool.Textures[local]] = { p, pool.TableOffset + pool.Cache.GetOffset(local), layout.Width, layout.Height, layout.Mips };
+			}
+		}
+		m_PagedTexturesView = CreateStructuredBuffer(textures.data(), sizeof(PagedTexture), uint32_t(textures.size()), &m_PagedTextures);
+		m_PageTableView = CreateStructuredBuffer(table.data(), sizeof(uint32_t), tableSize, &m_PageTable);
+
+		// The tails
+		for (auto& pool : m_Pools)
+		{
+			if (pool.Texture) Upload(pool);
+		}
+	}
+
+	void Update()
+	{
+		uint32_t jitter = uint32_t(m_Frame * 37 % (m_FeedbackScale * m_FeedbackScale));
+		m_CBuffer = { { jitter % m_FeedbackScale, jitter / m_FeedbackScale }, m_FeedbackScale, uint32_t(m_Frame % 2) };
+		D3D11_MAPPED_SUBRESOURCE sub;
+		Window::Context->Map(m_FeedbackBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &sub);
+		memcpy(sub.pData, &m_CBuffer, sizeof(m_CBuffer));
+		Window::Context->Unmap(m_FeedbackBuffer, 0);
+
+		if (!m_HasPages || !m_Feedback) return;
+
+		uint32_t clear[] = { Pages::NoRequest, Pages::NoRequest, Pages::NoRequest, Pages::NoRequest };
+		Window::Context->ClearUnorderedAccessViewUint(FeedbackView, clear);
+
+		// The oldest copy, without stalling when the GPU is further behind than that
+		uint32_t oldest = uint32_t((m_Frame + 1) % m_Latency);
+		if (!m_IsPending[oldest]) return;
+		if (Window::Context->Map(m_Staging[oldest], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &sub) != S_OK) return;
+		m_IsPending[oldest] = false;
+
+		for (auto& pool : m_Pools)
+		{
+			pool.Requests.clear();
+		}
+		for (uint32_t y = 0; y < m_FeedbackHeight; y++)
+		{
+			auto row = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(sub.pData) + size_t(y) * sub.RowPitch);
+			for (uint32_t x = 0; x < m_FeedbackWidth; x++)
+			{
+				uint32_t request = row[x];
+				if (request == Pages::NoRequest || (request >> 20) >= m_Local.size()) continue;
+
+				auto [pool, local] = m_Local[request >> 20];
+				if (pool != m_NotPaged) m_Pools[pool].Requests.push_back(local << 20 | (request & 0xfffff));
+			}
+		}
+		Window::Context->Unmap(m_Staging[oldest], 0);
+
+		Stats = {};
+		for (auto& pool : m_Pools)
+		{
+			if (!pool.Texture) continue;
+
+			pool.Cache.Update(pool.Requests, MaxUploads);
+			Upload(pool);
+			const auto& stats = pool.Cache.Stats;
+			Stats.Requested += stats.Requested;
+			Stats.Hits += stats.Hits;
+			Stats.Misses += stats.Misses;
+			Stats.Uploads += stats.Uploads;
+			Stats.Evictions += stats.Evictions;
+			Stats.Deferred += stats.Deferred;
+			Stats.Dropped += stats.Dropped;
+			Stats.Resident += stats.Resident;
+			Stats.Slots += stats.Slots;
+		}
+	}
+
+	void Bind()
+	{
+		ID3D11ShaderResourceView* views[] = { m_PagedTexturesView, m_PageTableView,
+			m_Pools[0].View, m_Pools[1].View, m_Pools[2].View, m_Pools[3].View, m_Pools[4].View };
+		Window::Context->PSSetShaderResources(5, UINT(std::size(views)), views);
+		Window::Context->PSSetSamplers(3, 1, &m_Sampler);
+		ID3D11Buffer* buffers[] = { m_FeedbackBuffer, m_MaterialBuffer };
+		Window::Context->PSSetConstantBuffers(4, 2, buffers);
+	}
+
+	void SetMaterial(const Material& material)
+	{
+		D3D11_MAPPED_SUBRESOURCE sub;
+		Window::Context->Map(m_MaterialBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &sub);
+		memcpy(sub.pData, material.Pages, sizeof(material.Pages));
+		Window::Context->Unmap(m_MaterialBuffer, 0);
+	}
+
+	void ResolveFeedback()
+	{
+		if (!m_HasPages || !m_Feedback) return;
+
+		uint32_t index = uint32_t(m_Frame % m_Latency);
+		Window::Context->CopyResource(m_Staging[index], m_Feedback);
+		m_IsPending[index] = true;
+		m_Frame++;
+	}
+
+	void Resize(uint32_t width, uint32_t height)
+	{
+		if (!width || !height) return;
+
+		ReleaseFeedback();
+		for (auto& pending : m_IsPending)
+		{
+			pending = false;
+		}
+		m_FeedbackWidth = (width + m_FeedbackScale - 1) / m_FeedbackScale;
+		m_FeedbackHeight = (height + m_FeedbackScale - 1) / m_FeedbackScale;
+
+		D3D11_TEXTURE2D_DESC desc{
+			.Width = m_FeedbackWidth,
+			.Height = m_FeedbackHeight,
+			.MipLevels = 1,
+			.ArraySize = 1,
+			.Format = DXGI_FORMAT_R32_UINT,
+			.SampleDesc = DXGI_SAMPLE_DESC{ .Count = 1, .Quality = 0 },
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_UNORDERED_ACCESS
+		};
+		Window::Device->CreateTexture2D(&desc, nullptr, &m_Feedback);
+		Window::Device->CreateUnorderedAccessView(m_Feedback, nullptr, &FeedbackView);
+
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		for (auto& staging : m_Staging)
+		{
+			Window::Device->CreateTexture2D(&desc, nullptr, &staging);
+		}
+
+		uint32_t clear[] = { Pages::NoRequest, Pages::NoRequest, Pages::NoRequest, Pages::NoRequest };
+		Window::Context->ClearUnorderedAccessViewUint(FeedbackView, clear);
+	}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "PageCache.h"
+#include "Scene.h"
+
+// GPU side of the scene's paged textures: one pool of page slots per block compressed format, the page tables and
+// the feedback the GBuffer pass writes. Feedback is read back a few frames late, turned into page uploads by each
+// pool's PageCache and applied before the next frame's passes.
+namespace VirtualTexture
+{
+
+	void Initialize();
+	void Shutdown();
+
+	// Recreates the pools for scene's paged textures, splitting budget bytes between them. Only the tails are resident afterwards.
+	void SetScene(Scene* scene, uint64_t budget);
+
+	// Once per frame before any pass samples materials: reads the oldest finished feedback and uploads the pages it asks for.
+	void Update();
+	// Pools, page tables and constant buffers for the pixel shader
+	void Bind();
+	void SetMaterial(const Material& material);
+	// After the GBuffer pass, queues this frame's feedback for reading back
+	void ResolveFeedback();
+
+	void Resize(uint32_t width, uint32_t height);
+
+	// Bound after the GBuffer targets
+	extern ID3D11UnorderedAccessView* FeedbackView;
+	// Of the last Update, summed over the pools
+	extern Pages::CacheStats Stats;
+	// Per pool and frame
+	extern uint32_t MaxUploads;
+
+}
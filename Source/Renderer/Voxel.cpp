@@ -1,7 +1,10 @@
 #include "Voxel.h"
 
+#include <algorithm>
+
 #include "GBuffer.h"
 #include "ShadowMap.h"
+#include "VirtualTexture.h"
 
 namespace Voxel 
 {
@@ -16,9 +19,16 @@ namespace Voxel
 	ID3D11UnorderedAccessView* m_VoxelView = nullptr;
 	ID3D11RasterizerState2* m_RasterizerState = nullptr;
 	D3D11_VIEWPORT m_Viewport;
+	// Grid resolutions Fit chooses between, the largest takes about 340 MiB
+	constexpr uint32_t m_MinResolution = 16;
+	constexpr uint32_t m_MaxResolution = 256;
 
 	ID3D11Buffer* ConstantBuffer = nullptr;
+	Frustum Volume;
+	float VoxelSize = 1.f;
+	uint32_t Resolution = 0;
 	ID3D11VertexShader* m_VS = nullptr;
+	ID3D11VertexShader* m_CompactVS = nullptr;
 	ID3D11GeometryShader* m_GS = nullptr;
 	ID3D11PixelShader* m_PS = nullptr;
 	ID3D11ComputeShader* m_CopyCS = nullptr;
@@ -33,6 +43,7 @@ namespace Voxel
 		DirectX::XMFLOAT3 CameraPosition;
 		float VoxelHalfExtent;
 		float VoxelGridRes;
+		DirectX::XMFLOAT3 VoxelCenter;
 	} m_CBuffer;
 
 	void Initialize()
@@ -56,6 +67,8 @@ namespace Voxel
 		ID3DBlob* blob;
 		D3DReadFileToBlob(L"VoxelizationVS.cso", &blob);
 		Window::Device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_VS);
+		D3DReadFileToBlob(L"VoxelizationCompactVS.cso", &blob);
+		Window::Device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_CompactVS);
 		D3DReadFileToBlob(L"VoxelizationGS.cso", &blob);
 		Window::Device->CreateGeometryShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, &m_GS);
 		D3DReadFileToBlob(L"VoxelizationPS.cso", &blob);
@@ -95,6 +108,7 @@ namespace Voxel
 		m_VoxelView->Release();
 
 		m_VS->Release();
+		m_CompactVS->Release();
 		m_GS->Release();
 		m_PS->Release();
 		m_CopyCS->Release();
@@ -104,7 +118,7 @@ namespace Voxel
 		m_DebugPS->Release();
 	}
 
-	void Voxelize(Scene* scene, DirectX::XMFLOAT3 cameraPosition)
+	void Voxelize(Scene* scene, DirectX::XMFLOAT3 cameraPosition, const DrawList& draws)
 	{
 		m_CBuffer.CameraPosition = cameraPosition;
 
@@ -118,15 +132,11 @@ namespace Voxel
 		Window::Context->RSSetState(m_RasterizerState);
 		Window::Context->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 1, &m_VoxelView, nullptr);
 
-		Window::Context->VSSetShader(m_VS, nullptr, 0);
+		Window::Context->VSSetShader(scene->Compact ? m_CompactVS : m_VS, nullptr, 0);
 		Window::Context->GSSetShader(m_GS, nullptr, 0);
 		Window::Context->PSSetShader(m_PS, nullptr, 0);
 
-		UINT offset = 0;
-		UINT stride = sizeof(Vertex);
-		Window::Context->IASetVertexBuffers(0, 1, &scene->VertexBuffer, &stride, &offset);
-		Window::Context->IASetIndexBuffer(scene->IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-		Window::Context->IASetInputLayout(GBuffer::Layout);
+		GBuffer::SetGeometry(scene);
 		Window::Context->GSSetConstantBuffers(1, 1, &ConstantBuffer);
 		Window::Context->PSSetConstantBuffers(1, 1, &ConstantBuffer);
 		Window::Context->PSSetConstantBuffers(2, 1, &ShadowMap::LightBuffer);
@@ -134,11 +144,23 @@ namespace Voxel
 		Window::Context->PSSetShaderResources(4, 1, &ShadowMap::ShadowMapView);
 		Window::Context->PSSetSamplers(0, 1, &GBuffer::SamplerState);
 		Window::Context->PSSetSamplers(2, 1, &ShadowMap::Sampler);
+		VirtualTexture::Bind();
 
-		for (const auto& material : scene->Materials)
+		// Voxels take the albedo's color only, masked batches go through the same shader
+		uint32_t bound = ~0u;
+		for (const auto* list : { &draws.Draws, &draws.MaskedDraws })
 		{
-			Window::Context->PSSetShaderResources(0, 1, &material.Albedo);
-			Window::Context->DrawIndexed(material.IndexCount, material.BaseIndex, material.BaseVertex);
+			for (const auto& draw : *list)
+			{
+				const auto& material = scene->Materials[draw.Material];
+				if (draw.Material != bound)
+				{
+					Window::Context->PSSetShaderResources(0, 1, &material.Albedo);
+					VirtualTexture::SetMaterial(material);
+					bound = draw.Material;
+				}
+				Window::Context->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, draw.BaseIndex, material.BaseVertex, draw.BaseInstance);
+			}
 		}
 
 		Window::Context->RSSetState(nullptr);
@@ -190,7 +212,7 @@ namespace Voxel
 		Window::Context->VSSetShaderResources(0, 1, views);
 	}
 
-	void Resize(uint32_t res, float halfExtent)
+	void Resize(uint32_t res)
 	{
 		if (m_DiffuseTexture) m_DiffuseTexture->Release();
 		if (DiffuseReadView) DiffuseReadView->Release();
@@ -253,7 +275,34 @@ namespace Voxel
 		m_Viewport.TopLeftY = 0.f;
 
 		m_CBuffer.VoxelGridRes = float(res);
+		Resolution = res;
+	}
+
+	void Fit(const Box& bounds, uint64_t budget)
+	{
+		// Powers of two keep every mip of the grid aligned with the one above for cone tracing
+		uint32_t res = m_MinResolution;
+		while (res < m_MaxResolution && double(res * 2) * (res * 2) * (res * 2) * BytesPerVoxel <= double(budget))
+		{
+			res *= 2;
+		}
+		if (res != Resolution) Resize(res);
+
+		// A cube around the scene's longest side with a voxel to spare on each side for conservative rasterization
+		using namespace DirectX;
+		XMVECTOR min = XMLoadFloat3(&bounds.Min);
+		XMVECTOR max = XMLoadFloat3(&bounds.Max);
+		XMVECTOR size = XMVectorSubtract(max, min);
+		float longest = (std::max)(XMVectorGetX(XMVectorMax(XMVectorMax(size, XMVectorSplatY(size)), XMVectorSplatZ(size))), 1e-3f);
+		float halfExtent = longest / float(res - 2) * 0.5f;
+		XMStoreFloat3(&m_CBuffer.VoxelCenter, XMVectorScale(XMVectorAdd(min, max), 0.5f));
 		m_CBuffer.VoxelHalfExtent = halfExtent;
+		VoxelSize = halfExtent * 2.f;
+
+		// Same mapping as VoxelizationGS
+		const auto& center = m_CBuffer.VoxelCenter;
+		float extent = halfExtent * float(res);
+		Volume = Frustum::FromBox({ { center.x - extent, center.y - extent, center.z - extent }, { center.x + extent, center.y + extent, center.z + extent } });
 	}
 
 }
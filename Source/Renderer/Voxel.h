@@ -8,12 +8,23 @@ namespace Voxel
 	void Initialize();
 	void Shutdown();
 
-	void Voxelize(Scene* scene, DirectX::XMFLOAT3 cameraPosition);
+	void Voxelize(Scene* scene, DirectX::XMFLOAT3 cameraPosition, const DrawList& draws);
 	void DrawDebug();
 
-	void Resize(uint32_t res, float halfExtent);
+	// The voxel buffer and both textures with their mips
+	inline constexpr double BytesPerVoxel = 12.0 + 2.0 * 4.0 * 8.0 / 7.0;
+
+	void Resize(uint32_t res);
+	// Centers the grid on bounds with the finest resolution whose resources fit in budget bytes, and sizes the voxels
+	// so the grid covers bounds' longest side. Only recreates the resources when the resolution changes.
+	void Fit(const Box& bounds, uint64_t budget);
 
 	extern ID3D11ShaderResourceView* DiffuseReadView;
 	extern ID3D11Buffer* ConstantBuffer;
+	// Everything the grid covers, for culling
+	extern Frustum Volume;
+	extern float VoxelSize;
+	// Voxels along each side of the grid
+	extern uint32_t Resolution;
 
 }
@@ -1,267 +1,210 @@
 #include "Scene.h"
 
-#undef max
-#undef min
-#include <algorithm>
-#include <filesystem>
-#include <iterator>
-#include <set>
+#include <optional>
 
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/postprocess.h"
+#include "Import/Importer.h"
+#include "Import/MeshOptimizer.h"
+#include "Import/SceneCache.h"
+#include "PageCache.h"
+#include "VertexFormat.h"
 
-#define STBI_WINDOWS_UTF8
-#include "stb_image.h"
-
-struct Model
-{
-	std::vector<Vertex> Vertices;
-	std::vector<uint32_t> Indices;
-	uint32_t MaterialID;
-};
-
-struct Texture
+DXGI_FORMAT GetFormat(TextureFormat format)
 {
-	void* Data;
-	uint32_t Width, Height;
-
-	static Texture Load(const std::string& path)
+	switch (format)
 	{
-		int width, height, comp;
-		uint8_t* data = stbi_load(path.c_str(), &width, &height, &comp, 4);
-		return { data, uint32_t(width), uint32_t(height) };
+	case TextureFormat::RGBA8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case TextureFormat::RGBA8_SRGB: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	case TextureFormat::BC1_SRGB: return DXGI_FORMAT_BC1_UNORM_SRGB;
+	case TextureFormat::BC3_SRGB: return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case TextureFormat::BC4: return DXGI_FORMAT_BC4_UNORM;
+	case TextureFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+	case TextureFormat::BC3: return DXGI_FORMAT_BC3_UNORM;
+	default: return DXGI_FORMAT_UNKNOWN;
 	}
-};
-
-bool operator<(const Model& first, const Model& second)
-{
-	return first.MaterialID < second.MaterialID;
 }
 
-Scene::Scene(const std::string& path)
+Scene::Scene(const std::string& path, const ImportOptions& options, LoadProgress* progress)
 {
-	Assimp::Importer importer;
-	importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_OptimizeGraph |
-		aiProcess_ConvertToLeftHanded | aiProcess_TransformUVCoords | aiProcess_GenUVCoords |
-		aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals |
-		aiProcess_Triangulate);
-
-	auto scene = importer.GetScene();
-	if (!scene)
+	ImportStats stats;
+	stats.Progress = progress;
+	std::optional<SceneCache::File> cache;
 	{
-		throw std::exception("Invalid scene file");
+		ScopedStage stage(stats, "Cache open");
+		cache = SceneCache::Open(path, options);
 	}
-	std::multiset<Model> models;
 
-	for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+	if (cache)
 	{
-		Model model;
-		aiMesh* mesh = scene->mMeshes[i];
-		
-		if (!mesh->HasNormals())
-		{
-			throw std::exception("Mesh does not have normals");
-		}
-
-		model.Vertices.reserve(mesh->mNumVertices);
-		for (uint32_t j = 0; j < mesh->mNumVertices; j++)
-		{
-			Vertex vertex;
-			vertex.Position = { mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z };
-			vertex.Normal = { mesh->mNormals[j].x, mesh->mNormals[j].y, mesh->mNormals[j].z };
-			if (mesh->HasTangentsAndBitangents())
-			{
-				vertex.Tangent = { mesh->mTangents[j].x, mesh->mTangents[j].y, mesh->mTangents[j].z };
-				vertex.Bitangent = { mesh->mBitangents[j].x, mesh->mBitangents[j].y, mesh->mBitangents[j].z };
-			}
-			if (mesh->HasTextureCoords(0))
-			{
-				vertex.UV = { mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y };
-			}
-			model.Vertices.push_back(vertex);
-		}
-
-		model.Indices.reserve(mesh->mNumFaces * 3);
-		for (uint32_t j = 0; j < mesh->mNumFaces; j++)
+		// Paged textures are streamed straight from the mapping, so it lives as long as the scene
+		auto file = std::make_shared<SceneCache::File>(std::move(*cache));
 		{
-			if (mesh->mFaces[j].mNumIndices == 3)
-			{
-				model.Indices.push_back(mesh->mFaces[j].mIndices[0]);
-				model.Indices.push_back(mesh->mFaces[j].mIndices[1]);
-				model.Indices.push_back(mesh->mFaces[j].mIndices[2]);
-			}
+			ScopedStage stage(stats, "Upload");
+			*this = Scene(file->View, options.VirtualTextures, file);
 		}
-
-		model.MaterialID = mesh->mMaterialIndex;
-
-		models.emplace(std::move(model));
+		auto cacheStats = MeshOptimizer::Analyze(file->View);
+		stats.Add("ACMR", cacheStats.GetACMR());
+		stats.Add("ATVR", cacheStats.GetATVR());
+		stats.Progress = nullptr;
+		Stats = std::move(stats);
+		return;
 	}
 
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-
-	uint32_t baseVertex = 0;
-	uint32_t baseIndex = 0;
-	for (auto it = models.begin(); it != models.end();)
+	// An outdated cache still has the textures whose files didn't change, it has to be closed before the new one is written
+	SceneData data;
 	{
-		uint32_t lastMatID;
-		uint32_t maxIndex = 0;
-		uint32_t vertexCount = 0;
-		uint32_t indexCount = 0;
-		do
-		{
-			lastMatID = it->MaterialID;
-
-			vertices.insert(vertices.end(), it->Vertices.begin(), it->Vertices.end());
-			indices.reserve(it->Indices.size());
-			uint32_t currMaxIndex = 0;
-			std::transform(it->Indices.begin(), it->Indices.end(), std::back_inserter(indices), [&](uint32_t index)
-				{
-					currMaxIndex = std::max(currMaxIndex, index);
-					return index + maxIndex;
-				});
-			maxIndex += currMaxIndex;
-			indexCount += uint32_t(it->Indices.size());
-			vertexCount += uint32_t(it->Vertices.size());
-
-			it++;
-		} while (it != models.end() && it->MaterialID == lastMatID);
+		auto previous = SceneCache::Open(path, options, false);
+		data = Importer::Import(path, options, progress, previous ? &previous->View : nullptr);
+	}
+	stats.Stages.insert(stats.Stages.end(), data.Stats.Stages.begin(), data.Stats.Stages.end());
+	stats.Counters = std::move(data.Stats.Counters);
 
-		Material material;
-		material.BaseVertex = baseVertex;
-		material.BaseIndex = baseIndex;
-		material.IndexCount = indexCount;
+	auto view = data.View();
+	{
+		ScopedStage stage(stats, "Cache write");
+		SceneCache::Write(path, view, options);
+	}
+	{
+		ScopedStage stage(stats, "Upload");
+		*this = Scene(view, options.VirtualTextures);
+	}
+	stats.Progress = nullptr;
+	Stats = std::move(stats);
+}
 
-		aiString texPath;
-		std::string basePath = std::filesystem::path(path).parent_path().string() + "/";
-		aiMaterial* mat = scene->mMaterials[lastMatID];
+ID3D11ShaderResourceView* CreateTexture(const TextureView& texture)
+{
+	D3D11_TEXTURE2D_DESC desc{
+		.Width = texture.Width,
+		.Height = texture.Height,
+		.MipLevels = texture.MipLevels,
+		.ArraySize = 1,
+		.Format = GetFormat(texture.Format),
+		.SampleDesc = DXGI_SAMPLE_DESC{.Count = 1, .Quality = 0 },
+		.Usage = D3D11_USAGE_IMMUTABLE,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE
+	};
 
-		Texture albedo;
-		Texture specular;
-		Texture bump;
-		bool albedoTex = false;
-		bool specularTex = false;
-		bool bumpTex = false;
-		uint8_t albedoColor[4];
-		uint8_t specularColor[4];
-		uint8_t bumpColor[4];
+	D3D11_SUBRESOURCE_DATA data[D3D11_REQ_MIP_LEVELS];
+	size_t offset = 0;
+	for (uint32_t level = 0, w = texture.Width, h = texture.Height; level < texture.MipLevels; level++)
+	{
+		data[level] = {
+			.pSysMem = texture.Pixels.data() + offset,
+			.SysMemPitch = GetRowPitch(texture.Format, w)
+		};
+		offset += GetMipSize(texture.Format, w, h);
+		w = (std::max)(w / 2, 1u);
+		h = (std::max)(h / 2, 1u);
+	}
 
-		if (mat->GetTextureCount(aiTextureType_DIFFUSE))
-		{
-			albedoTex = true;
-			mat->GetTexture(aiTextureType_DIFFUSE, 0, &texPath);
-			albedo = Texture::Load(basePath + texPath.C_Str());
-		}
-		else
-		{
-			aiColor3D color;
-			mat->Get(AI_MATKEY_COLOR_DIFFUSE, color);
-			albedoColor[0] = color.r * 255;
-			albedoColor[1] = color.g * 255;
-			albedoColor[2] = color.b * 255;
-			albedoColor[3] = 255;
+	ID3D11Texture2D* tex;
+	ID3D11ShaderResourceView* view;
+	Window::Device->CreateTexture2D(&desc, data, &tex);
+	Window::Device->CreateShaderResourceView(tex, nullptr, &view);
+	tex->Release();
+	return view;
+}
 
-			albedo.Data = albedoColor;
-			albedo.Width = albedo.Height = 1;
-		}
+VertexFormat::InstanceRecord GetInstanceRecord(const SceneView& view, size_t material, uint32_t instance)
+{
+	VertexFormat::InstanceRecord record{};
+	record.Transform = view.Instances[instance].Transform;
+	if (view.Quantization.size()) record.Quantization = view.Quantization[material];
+	return record;
+}
 
-		if (mat->GetTextureCount(aiTextureType_AMBIENT))
+Scene::Scene(const SceneView& view, bool pageTextures, std::shared_ptr<const void> storage)
+{
+	PagedTextures.resize(view.Textures.size());
+	size_t pagedSize = 0;
+	for (size_t i = 0; i < view.Textures.size(); i++)
+	{
+		const auto& texture = view.Textures[i];
+		if (!pageTextures || !Pages::IsPageable(texture.Width, texture.Height, texture.MipLevels, texture.Format)) continue;
+		PagedTextures[i] = texture;
+		pagedSize += texture.Pixels.size();
+	}
+	if (pagedSize && !storage)
+	{
+		auto copy = std::make_shared<std::vector<uint8_t>>();
+		copy->reserve(pagedSize);
+		for (auto& texture : PagedTextures)
 		{
-			specularTex = true;
-			mat->GetTexture(aiTextureType_AMBIENT, 0, &texPath);
-			specular = Texture::Load(basePath + texPath.C_Str());
+			size_t offset = copy->size();
+			copy->insert(copy->end(), texture.Pixels.begin(), texture.Pixels.end());
+			texture.Pixels = { copy->data() + offset, texture.Pixels.size() };
 		}
-		else
-		{
-			aiColor3D color;
-			mat->Get(AI_MATKEY_COLOR_SPECULAR, color);
-			specularColor[0] = color.r * 255;
-			specularColor[1] = color.g * 255;
-			specularColor[2] = color.b * 255;
-			specularColor[3] = 255;
+		storage = std::move(copy);
+	}
+	if (pagedSize) PagedStorage = std::move(storage);
 
-			specular.Data = specularColor;
-			specular.Width = specular.Height = 1;
-		}
+	// One view per unique texture that isn't paged. Every Material holds its own reference as well.
+	for (size_t i = 0; i < view.Textures.size(); i++)
+	{
+		Textures.push_back(PagedTextures[i].Pixels.empty() ? CreateTexture(view.Textures[i]) : nullptr);
+	}
+	TextureSources = view.TextureSources;
+	Dependencies = view.Dependencies;
 
-		if (mat->GetTextureCount(aiTextureType_HEIGHT))
-		{
-			bumpTex = true;
-			mat->GetTexture(aiTextureType_HEIGHT, 0, &texPath);
-			bump = Texture::Load(basePath + texPath.C_Str());
-		}
-		else
+	for (const auto& materialData : view.Materials)
+	{
+		Material material{
+			.BaseIndex = materialData.BaseIndex,
+			.IndexCount = materialData.IndexCount,
+			.BaseVertex = materialData.BaseVertex,
+			.BaseCluster = materialData.BaseCluster,
+			.ClusterCount = materialData.ClusterCount,
+			.Albedo = Textures[materialData.Albedo],
+			.Surface = Textures[materialData.Surface],
+			.Hash = materialData.Hash
+		};
+		uint32_t textures[] = { materialData.Albedo, materialData.Surface };
+		for (uint32_t slot = 0; slot < 2; slot++)
 		{
-			bumpColor[0] = 127;
-			bumpColor[1] = 127;
-			bumpColor[2] = 127;
-			bumpColor[3] = 255;
-
-			bump.Data = bumpColor;
-			bump.Width = bump.Height = 1;
+			auto view = (&material.Albedo)[slot];
+			material.Pages[slot] = view ? Pages::NoRequest : textures[slot];
+			if (view) view->AddRef();
 		}
-
-		D3D11_TEXTURE2D_DESC desc{
-			.Width = albedo.Width,
-			.Height = albedo.Height,
-			.MipLevels = 1,
-			.ArraySize = 1,
-			.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
-			.SampleDesc = DXGI_SAMPLE_DESC{.Count = 1, .Quality = 0 },
-			.Usage = D3D11_USAGE_DEFAULT,
-			.BindFlags = D3D11_BIND_SHADER_RESOURCE
-		};
-		D3D11_SUBRESOURCE_DATA data{
-			.pSysMem = albedo.Data,
-			.SysMemPitch = albedo.Width * sizeof(uint32_t)
-		};
-
-		ID3D11Texture2D* tex;
-		Window::Device->CreateTexture2D(&desc, &data, &tex);
-		Window::Device->CreateShaderResourceView(tex, nullptr, &material.Albedo);
-		tex->Release();
-
-		desc.Width = specular.Width;
-		desc.Height = specular.Height;
-		data.pSysMem = specular.Data;
-		data.SysMemPitch = specular.Width * sizeof(uint32_t);
-		Window::Device->CreateTexture2D(&desc, &data, &tex);
-		Window::Device->CreateShaderResourceView(tex, nullptr, &material.Specular);
-		tex->Release();
-
-		desc.Width = bump.Width;
-		desc.Height = bump.Height;
-		data.pSysMem = bump.Data;
-		data.SysMemPitch = bump.Width * sizeof(uint32_t);
-		Window::Device->CreateTexture2D(&desc, &data, &tex);
-		Window::Device->CreateShaderResourceView(tex, nullptr, &material.Bump);
-		tex->Release();
-
-		material.BumpMapSize = { float(bump.Width), float(bump.Height) };
-
-		if (albedoTex) stbi_image_free(albedo.Data);
-		if (specularTex) stbi_image_free(specular.Data);
-		if (bumpTex) stbi_image_free(bump.Data);
-
 		Materials.emplace_back(material);
-
-		baseVertex += vertexCount;
-		baseIndex += indexCount;
 	}
 
+	ClusterBvh = Bvh(view.ClusterNodes, view.ClusterOrder);
+	CullingBounds = Culling::Prepare(view);
+	Lods.assign(view.Lods.begin(), view.Lods.end());
+	Bounds = view.Bounds;
+
+	// Straight from the importer's arrays or the cache mapping, no intermediate copies
+	Compact = !view.CompactVertices.empty();
+	VertexStride = Compact ? sizeof(CompactVertex) : sizeof(Vertex);
 	D3D11_BUFFER_DESC desc{
-		.ByteWidth = uint32_t(vertices.size() * sizeof(Vertex)),
+		.ByteWidth = uint32_t(Compact ? view.CompactVertices.size_bytes() : view.Vertices.size_bytes()),
 		.Usage = D3D11_USAGE_DEFAULT,
 		.BindFlags = D3D11_BIND_VERTEX_BUFFER
 	};
 	D3D11_SUBRESOURCE_DATA data{
-		.pSysMem = vertices.data()
+		.pSysMem = Compact ? static_cast<const void*>(view.CompactVertices.data()) : view.Vertices.data()
 	};
 	Window::Device->CreateBuffer(&desc, &data, &VertexBuffer);
-	desc.ByteWidth = uint32_t(indices.size() * sizeof(uint32_t));
+	desc.ByteWidth = uint32_t(view.Positions.size_bytes());
+	data.pSysMem = view.Positions.data();
+	Window::Device->CreateBuffer(&desc, &data, &PositionBuffer);
+
+	// The full format ignores the quantization, but both layouts read slot 1
+	std::vector<VertexFormat::InstanceRecord> instances((std::max)(view.Instances.size(), size_t(1)));
+	for (size_t m = 0; m < view.Materials.size(); m++)
+	{
+		const auto& material = view.Materials[m];
+		for (uint32_t i = material.BaseInstance; i < material.BaseInstance + material.InstanceCount; i++)
+		{
+			instances[i] = GetInstanceRecord(view, m, i);
+		}
+	}
+	desc.ByteWidth = uint32_t(instances.size() * sizeof(VertexFormat::InstanceRecord));
+	data.pSysMem = instances.data();
+	Window::Device->CreateBuffer(&desc, &data, &InstanceBuffer);
+	desc.ByteWidth = uint32_t(view.Indices.size_bytes());
 	desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	data.pSysMem = indices.data();
+	data.pSysMem = view.Indices.data();
 	Window::Device->CreateBuffer(&desc, &data, &IndexBuffer);
 }
 
@@ -269,9 +212,25 @@ Scene::Scene(Scene&& other)
 {
 	VertexBuffer = other.VertexBuffer;
 	other.VertexBuffer = nullptr;
+	PositionBuffer = other.PositionBuffer;
+	other.PositionBuffer = nullptr;
 	IndexBuffer = other.IndexBuffer;
 	other.IndexBuffer = nullptr;
+	InstanceBuffer = other.InstanceBuffer;
+	other.InstanceBuffer = nullptr;
+	VertexStride = other.VertexStride;
+	Compact = other.Compact;
 	Materials = std::move(other.Materials);
+	Textures = std::move(other.Textures);
+	TextureSources = std::move(other.TextureSources);
+	Dependencies = std::move(other.Dependencies);
+	PagedTextures = std::move(other.PagedTextures);
+	PagedStorage = std::move(other.PagedStorage);
+	ClusterBvh = std::move(other.ClusterBvh);
+	CullingBounds = std::move(other.CullingBounds);
+	Lods = std::move(other.Lods);
+	Bounds = other.Bounds;
+	Stats = std::move(other.Stats);
 }
 
 Scene& Scene::operator=(Scene&& other)
@@ -280,9 +239,25 @@ Scene& Scene::operator=(Scene&& other)
 
 	VertexBuffer = other.VertexBuffer;
 	other.VertexBuffer = nullptr;
+	PositionBuffer = other.PositionBuffer;
+	other.PositionBuffer = nullptr;
 	IndexBuffer = other.IndexBuffer;
 	other.IndexBuffer = nullptr;
+	InstanceBuffer = other.InstanceBuffer;
+	other.InstanceBuffer = nullptr;
+	VertexStride = other.VertexStride;
+	Compact = other.Compact;
 	Materials = std::move(other.Materials);
+	Textures = std::move(other.Textures);
+	TextureSources = std::move(other.TextureSources);
+	Dependencies = std::move(other.Dependencies);
+	PagedTextures = std::move(other.PagedTextures);
+	PagedStorage = std::move(other.PagedStorage);
+	ClusterBvh = std::move(other.ClusterBvh);
+	CullingBounds = std::move(other.CullingBounds);
+	Lods = std::move(other.Lods);
+	Bounds = other.Bounds;
+	Stats = std::move(other.Stats);
 
 	return *this;
 }
@@ -292,13 +267,114 @@ Scene::~Scene()
 	if (VertexBuffer)
 	{
 		VertexBuffer->Release();
+		PositionBuffer->Release();
 		IndexBuffer->Release();
+		InstanceBuffer->Release();
 	}
 
 	for (const auto& material : Materials)
 	{
-		material.Albedo->Release();
-		material.Specular->Release();
-		material.Bump->Release();
+		if (material.Albedo) material.Albedo->Release();
+		if (material.Surface) material.Surface->Release();
+	}
+	for (auto texture : Textures)
+	{
+		if (texture) texture->Release();
+	}
+}
+
+void Scene::ReplaceTexture(uint32_t index, const TextureView& texture)
+{
+	auto previous = Textures[index];
+	Textures[index] = CreateTexture(texture);
+	PagedTextures[index] = {};
+	for (auto& material : Materials)
+	{
+		for (uint32_t slot = 0; slot < 2; slot++)
+		{
+			auto& view = (&material.Albedo)[slot];
+			if (previous ? view != previous : material.Pages[slot] != index) continue;
+			if (view) view->Release();
+			view = Textures[index];
+			view->AddRef();
+			material.Pages[slot] = Pages::NoRequest;
+		}
+	}
+	if (previous) previous->Release();
+}
+
+bool Scene::Patch(const SceneView& view, uint32_t& patched)
+{
+	// Same ranges everywhere, so only the contents of changed batches need to move
+	auto sameBatch = [](const MaterialData& a, const MaterialData& b)
+	{
+		return a.BaseIndex == b.BaseIndex && a.IndexCount == b.IndexCount && a.BaseVertex == b.BaseVertex &&
+			a.VertexCount == b.VertexCount && a.BaseInstance == b.BaseInstance && a.InstanceCount == b.InstanceCount &&
+			a.Albedo == b.Albedo && a.Surface == b.Surface;
+	};
+	auto sameLod = [](const LodData& a, const LodData& b)
+	{
+		return a.BaseIndex == b.BaseIndex && a.IndexCount == b.IndexCount && a.Material == b.Material;
+	};
+	auto sameSource = [](const TextureSource& a, const TextureSource& b)
+	{
+		return a.Path == b.Path && a.Usage == b.Usage && a.Texture == b.Texture;
+	};
+	const auto& current = CullingBounds.Materials;
+	if (Compact == view.CompactVertices.empty() || view.Textures.size() != Textures.size() ||
+		!std::equal(current.begin(), current.end(), view.Materials.begin(), view.Materials.end(), sameBatch) ||
+		!std::equal(Lods.begin(), Lods.end(), view.Lods.begin(), view.Lods.end(), sameLod) ||
+		!std::equal(TextureSources.begin(), TextureSources.end(), view.TextureSources.begin(), view.TextureSources.end(), sameSource))
+	{
+		return false;
 	}
+
+	const uint8_t* vertices = Compact ? reinterpret_cast<const uint8_t*>(view.CompactVertices.data()) :
+		reinterpret_cast<const uint8_t*>(view.Vertices.data());
+	auto update = [](ID3D11Buffer* buffer, const void* data, size_t offset, size_t size)
+	{
+		if (!size) return;
+		D3D11_BOX box{ uint32_t(offset), 0, 0, uint32_t(offset + size), 1, 1 };
+		Window::Context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+	};
+
+	patched = 0;
+	for (size_t m = 0; m < view.Materials.size(); m++)
+	{
+		const auto& materialData = view.Materials[m];
+		auto& material = Materials[m];
+		material.BaseCluster = materialData.BaseCluster;
+		material.ClusterCount = materialData.ClusterCount;
+		if (material.Hash == materialData.Hash) continue;
+
+		size_t vertexOffset = size_t(materialData.BaseVertex) * VertexStride;
+		update(VertexBuffer, vertices + vertexOffset, vertexOffset, size_t(materialData.VertexCount) * VertexStride);
+		update(PositionBuffer, view.Positions.data() + materialData.BaseVertex, size_t(materialData.BaseVertex) * sizeof(DirectX::XMFLOAT3),
+			size_t(materialData.VertexCount) * sizeof(DirectX::XMFLOAT3));
+		update(IndexBuffer, view.Indices.data() + materialData.BaseIndex,
+			materialData.BaseIndex * sizeof(uint32_t), materialData.IndexCount * sizeof(uint32_t));
+		for (const auto& lod : view.Lods)
+		{
+			if (lod.Material != m) continue;
+			update(IndexBuffer, view.Indices.data() + lod.BaseIndex, lod.BaseIndex * sizeof(uint32_t), lod.IndexCount * sizeof(uint32_t));
+		}
+
+		std::vector<VertexFormat::InstanceRecord> instances;
+		for (uint32_t i = materialData.BaseInstance; i < materialData.BaseInstance + materialData.InstanceCount; i++)
+		{
+			instances.push_back(GetInstanceRecord(view, m, i));
+		}
+		update(InstanceBuffer, instances.data(), materialData.BaseInstance * sizeof(VertexFormat::InstanceRecord),
+			instances.size() * sizeof(VertexFormat::InstanceRecord));
+
+		material.Hash = materialData.Hash;
+		patched++;
+	}
+
+	// Clusters are rebuilt by every import, they only live on the CPU
+	ClusterBvh = Bvh(view.ClusterNodes, view.ClusterOrder);
+	CullingBounds = Culling::Prepare(view);
+	Lods.assign(view.Lods.begin(), view.Lods.end());
+	Bounds = view.Bounds;
+	return true;
 }
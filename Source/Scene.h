@@ -1,9 +1,12 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <DirectXMath.h>
 
+#include "Culling.h"
+#include "SceneData.h"
 #include "Window.h"
 
 struct Material
@@ -11,33 +14,60 @@ struct Material
 	uint32_t BaseIndex;
 	uint32_t IndexCount;
 	int32_t BaseVertex;
+	uint32_t BaseCluster;
+	uint32_t ClusterCount;
+	// Null when the texture is paged
 	ID3D11ShaderResourceView* Albedo;
-	ID3D11ShaderResourceView* Specular;
-	ID3D11ShaderResourceView* Bump;
-	DirectX::XMFLOAT2 BumpMapSize;
-};
-
-struct Vertex
-{
-	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT3 Normal;
-	DirectX::XMFLOAT3 Tangent = {};
-	DirectX::XMFLOAT3 Bitangent = {};
-	DirectX::XMFLOAT2 UV = {};
+	// Specular and normal, see MaterialLayout.h
+	ID3D11ShaderResourceView* Surface;
+	// MaterialData::Hash
+	uint64_t Hash;
+	// Scene texture of albedo and surface when it is paged, Pages::NoRequest otherwise
+	uint32_t Pages[2];
 };
 
 class Scene
 {
 public:
 	Scene() = default;
-	Scene(const std::string& path);
+	// Loads the baked .vxscene next to path if it is still valid, otherwise imports and bakes it.
+	// Can run on any thread, it only touches the device. Throws LoadCancelled if progress gets cancelled.
+	Scene(const std::string& path, const ImportOptions& options = {}, LoadProgress* progress = nullptr);
+	// With pageTextures, large block compressed textures get no SRV and are streamed into VirtualTexture's pools
+	// from PagedTextures instead. Their pixels are copied unless storage owns the view's memory.
+	Scene(const SceneView& view, bool pageTextures = false, std::shared_ptr<const void> storage = nullptr);
 	Scene(Scene&& other);
 	Scene& operator=(Scene&& other);
 
 	~Scene();
 
+	// Swaps the image of Textures[index] for texture in every material that uses it. A paged texture becomes a regular one.
+	void ReplaceTexture(uint32_t index, const TextureView& texture);
+	// Uploads the batches of view whose hash differs from the scene's, patched is how many.
+	// Returns false without touching anything when view's buffers are laid out differently, that needs a full reload.
+	bool Patch(const SceneView& view, uint32_t& patched);
+
 	ID3D11Buffer* VertexBuffer = nullptr;
+	// Float3 positions in VertexBuffer's order, for passes that only write depth
+	ID3D11Buffer* PositionBuffer = nullptr;
 	ID3D11Buffer* IndexBuffer = nullptr;
+	// One VertexFormat::InstanceRecord per instance, bound as per-instance data
+	ID3D11Buffer* InstanceBuffer = nullptr;
+	uint32_t VertexStride = sizeof(Vertex);
+	bool Compact = false;
 	std::vector<Material> Materials;
-	float MaxLength;
+	// One reference each, the materials hold their own
+	std::vector<ID3D11ShaderResourceView*> Textures;
+	std::vector<TextureSource> TextureSources;
+	std::vector<SourceDependency> Dependencies;
+	// Indexed like Textures, without pixels unless the texture is paged
+	std::vector<TextureView> PagedTextures;
+	std::shared_ptr<const void> PagedStorage;
+	Bvh ClusterBvh;
+	// Kept on the CPU, index ranges into IndexBuffer
+	CullingData CullingBounds;
+	std::vector<LodData> Lods;
+	ImportStats Stats;
+	// World space, the renderer fits the shadow map and the voxel grid to it
+	Box Bounds = {};
 };
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "Bvh.h"
+#include "LoadProgress.h"
+
+// CPU side scene representation, shared by the importer, the scene cache and GPU upload.
+// Nothing in here may depend on D3D.
+
+struct Vertex
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Normal;
+	DirectX::XMFLOAT3 Tangent = {};
+	DirectX::XMFLOAT3 Bitangent = {};
+	DirectX::XMFLOAT2 UV = {};
+};
+
+// 20 byte alternative to Vertex, see VertexFormat.h for the encoding.
+struct CompactVertex
+{
+	// xyz quantized to the material's bounds, w is the bitangent sign (0 or 65535)
+	uint16_t Position[4];
+	// Octahedral, snorm
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	// Half floats
+	uint16_t UV[2];
+};
+
+// Maps a CompactVertex position back to the material's local bounds: Offset + Position * Scale.
+struct VertexQuantization
+{
+	DirectX::XMFLOAT3 Offset = { 0.f, 0.f, 0.f };
+	DirectX::XMFLOAT3 Scale = { 1.f, 1.f, 1.f };
+};
+
+struct ImportOptions
+{
+	bool CompactVertices = false;
+	// Packs small material textures into atlases and merges the batches that then share textures, see Atlas.h
+	bool AtlasTextures = false;
+	// Only changes how Scene uploads the textures, not part of the flags
+	bool VirtualTextures = false;
+
+	static constexpr uint32_t CompactFlag = 1;
+	static constexpr uint32_t AtlasFlag = 2;
+	uint32_t GetFlags() const { return (CompactVertices ? CompactFlag : 0u) | (AtlasTextures ? AtlasFlag : 0u); }
+};
+
+// A material's geometry. Meshes placed once are baked into world space and merged into one range per material,
+// a mesh placed several times keeps a range of its own in object space and is drawn once per instance. When some of
+// those placements mirror it, they are the next batch, over the same vertices with an index range of flipped triangles.
+struct MaterialData
+{
+	uint32_t BaseIndex;
+	uint32_t IndexCount;
+	int32_t BaseVertex;
+	uint32_t VertexCount;
+	uint32_t BaseCluster;
+	uint32_t ClusterCount;
+	uint32_t BaseInstance;
+	uint32_t InstanceCount;
+	uint32_t Albedo;
+	// Specular and normal, packed as MaterialLayout.h describes
+	uint32_t Surface;
+	// Nonzero when the albedo's alpha test discards texels, such batches are drawn apart from the opaque ones
+	uint32_t Masked;
+	// Content hash of the batch's uploaded vertices, indices and instances, hot reload only patches batches where it changed
+	uint64_t Hash;
+};
+
+// The mirrored batch of the one before it, whose vertices it draws. Work on vertices is done once, by the first.
+inline bool SharesVertices(std::span<const MaterialData> materials, size_t m)
+{
+	return m > 0 && materials[m].VertexCount && materials[m].BaseVertex == materials[m - 1].BaseVertex &&
+		materials[m].VertexCount == materials[m - 1].VertexCount;
+}
+
+// Object to world transform, the transpose of the upper 4x3 of a row vector matrix (see XMStoreFloat3x4)
+struct InstanceData
+{
+	DirectX::XMFLOAT3X4 Transform;
+};
+
+// A run of at most Clusters::MaxTriangles triangles inside one material's index range, the unit of culling.
+struct ClusterData
+{
+	uint32_t BaseIndex;
+	uint32_t IndexCount;
+	uint32_t Material;
+	uint32_t VertexCount;
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+	// Every triangle faces away from eye if dot(Center - eye, ConeAxis) >= ConeCutoff * length(Center - eye) + Radius.
+	// ConeCutoff is 1 when the normals are too spread out for that to ever hold.
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// A simplified copy of a material's triangles over the same vertices, see Simplifier.
+struct LodData
+{
+	uint32_t BaseIndex;
+	uint32_t IndexCount;
+	uint32_t Material;
+	// Distance from the full detail surface it stays within, in scene units
+	float Error;
+};
+
+enum class TextureFormat : uint32_t
+{
+	RGBA8,
+	RGBA8_SRGB,
+	BC1_SRGB,
+	BC3_SRGB,
+	BC4,
+	BC5,
+	BC3
+};
+
+inline bool IsBlockCompressed(TextureFormat format)
+{
+	return format >= TextureFormat::BC1_SRGB;
+}
+
+// Bytes per pixel, or per 4x4 block for block compressed formats.
+inline uint32_t GetElementSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1_SRGB:
+	case TextureFormat::BC4:
+		return 8;
+	case TextureFormat::BC3_SRGB:
+	case TextureFormat::BC5:
+	case TextureFormat::BC3:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+inline uint32_t GetRowPitch(TextureFormat format, uint32_t width)
+{
+	return IsBlockCompressed(format) ? (std::max)((width + 3) / 4, 1u) * GetElementSize(format) : width * GetElementSize(format);
+}
+
+inline size_t GetMipSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+	uint32_t rows = IsBlockCompressed(format) ? (std::max)((height + 3) / 4, 1u) : height;
+	return size_t(GetRowPitch(format, width)) * rows;
+}
+
+// Decides the filtering and compression of a texture. Specular and bump maps only end up in surface textures.
+enum class TextureUsage : uint8_t
+{
+	Albedo,
+	Specular,
+	// A height map, stored as the tangent space normal map derived from it
+	Bump
+};
+
+// The image file a texture was decoded from, solid colors have none. Several sources can share a texture
+// when their files are identical. Both parts of a surface texture are listed, solid colors with an empty Path.
+struct TextureSource
+{
+	// Canonical
+	std::string Path;
+	TextureUsage Usage;
+	uint32_t Texture;
+	// Hash::Bytes of the file, xor the usage in the top byte
+	uint64_t Hash;
+};
+
+// A file the loader read besides the scene file, like a glTF's external buffers or an OBJ's material libraries.
+// A change to one is a change to the scene.
+struct SourceDependency
+{
+	// Canonical
+	std::string Path;
+	// Hash::Bytes of the file
+	uint64_t Hash;
+};
+
+// Non-owning. Pixels holds every mip level back to back, largest first.
+struct TextureView
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipLevels;
+	TextureFormat Format;
+	std::span<const uint8_t> Pixels;
+};
+
+struct TextureData
+{
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipLevels = 1;
+	TextureFormat Format = TextureFormat::RGBA8_SRGB;
+	std::vector<uint8_t> Pixels;
+};
+
+struct ImportStage
+{
+	std::string Name;
+	double Milliseconds;
+};
+
+struct ImportCounter
+{
+	std::string Name;
+	double Value;
+};
+
+struct ImportStats
+{
+	std::vector<ImportStage> Stages;
+	std::vector<ImportCounter> Counters;
+	// Set when the import runs in the background, every stage and step reports to it
+	LoadProgress* Progress = nullptr;
+
+	void Add(std::string name, double value)
+	{
+		Counters.push_back({ std::move(name), value });
+	}
+
+	// One of the current stage's steps is done. Safe to call from jobs, throws LoadCancelled.
+	void Step()
+	{
+		if (Progress) Progress->Step();
+	}
+};
+
+// Appends the lifetime of the object to stats as a named stage.
+class ScopedStage
+{
+public:
+	ScopedStage(ImportStats& stats, std::string name, uint32_t steps = 0)
+		: m_Stats(stats), m_Name(std::move(name)), m_Start(std::chrono::high_resolution_clock::now())
+	{
+		if (m_Stats.Progress) m_Stats.Progress->BeginStage(m_Name, steps);
+	}
+
+	~ScopedStage()
+	{
+		auto time = std::chrono::high_resolution_clock::now() - m_Start;
+		m_Stats.Stages.push_back({ std::move(m_Name), std::chrono::duration<double, std::milli>(time).count() });
+	}
+
+private:
+	ImportStats& m_Stats;
+	std::string m_Name;
+	std::chrono::high_resolution_clock::time_point m_Start;
+};
+
+// Everything needed to create a Scene on the GPU. Either points into a SceneData or into a mapped cache file.
+struct SceneView
+{
+	std::span<const Vertex> Vertices;
+	// Vertices' positions on their own, in the same order. Read by depth-only passes and CPU geometry code.
+	std::span<const DirectX::XMFLOAT3> Positions;
+	// Empty unless ImportOptions::CompactVertices was set, one VertexQuantization per material
+	std::span<const CompactVertex> CompactVertices;
+	std::span<const VertexQuantization> Quantization;
+	std::span<const uint32_t> Indices;
+	std::span<const MaterialData> Materials;
+	std::span<const InstanceData> Instances;
+	std::span<const ClusterData> Clusters;
+	// Tree over Clusters, see Bvh
+	std::span<const BvhNode> ClusterNodes;
+	std::span<const uint32_t> ClusterOrder;
+	// Sorted by material, then from finest to coarsest. Their indices follow the full detail ones.
+	std::span<const LodData> Lods;
+	// World space, see SceneBvh::GetSceneBounds
+	Box Bounds = {};
+	std::vector<TextureView> Textures;
+	std::vector<TextureSource> TextureSources;
+	std::vector<SourceDependency> Dependencies;
+};
+
+struct SceneData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<CompactVertex> CompactVertices;
+	std::vector<VertexQuantization> Quantization;
+	std::vector<uint32_t> Indices;
+	std::vector<MaterialData> Materials;
+	std::vector<InstanceData> Instances;
+	std::vector<ClusterData> Clusters;
+	Bvh ClusterBvh;
+	std::vector<LodData> Lods;
+	Box Bounds = {};
+	std::vector<TextureData> Textures;
+	std::vector<TextureSource> TextureSources;
+	std::vector<SourceDependency> Dependencies;
+
+	ImportStats Stats;
+
+	SceneView View() const
+	{
+		SceneView view{ Vertices, Positions, CompactVertices, Quantization, Indices, Materials, Instances, Clusters, ClusterBvh.Nodes, ClusterBvh.Primitives, Lods, Bounds };
+		view.Textures.reserve(Textures.size());
+		for (const auto& texture : Textures)
+		{
+			view.Textures.push_back({ texture.Width, texture.Height, texture.MipLevels, texture.Format, texture.Pixels });
+		}
+		view.TextureSources = TextureSources;
+		view.Dependencies = Dependencies;
+		return view;
+	}
+};
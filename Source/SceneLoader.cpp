@@ -0,0 +1,83 @@
+#include "SceneLoader.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+
+namespace SceneLoader
+{
+
+	std::thread m_Thread;
+	std::unique_ptr<LoadProgress> m_Progress;
+	std::atomic<bool> m_Finished = false;
+	std::optional<Scene> m_Result;
+	std::string m_Error;
+
+	void Start(const std::string& path, const ImportOptions& options)
+	{
+		if (m_Thread.joinable()) return;
+
+		m_Progress = std::make_unique<LoadProgress>();
+		m_Finished = false;
+		m_Result.reset();
+		m_Error.clear();
+
+		// m_Result and m_Error are only touched by the main thread again after m_Finished is seen
+		m_Thread = std::thread([path, options, progress = m_Progress.get()]
+			{
+				try { m_Result.emplace(path, options, progress); }
+				catch (const LoadCancelled&) {}
+				catch (const std::exception& e)
+				{
+					m_Error = e.what();
+				}
+				m_Finished = true;
+			});
+	}
+
+	void Cancel()
+	{
+		if (m_Progress) m_Progress->Cancel();
+	}
+
+	bool IsLoading()
+	{
+		return m_Thread.joinable();
+	}
+
+	std::string GetStage()
+	{
+		return m_Progress ? m_Progress->GetStage() : std::string();
+	}
+
+	float GetFraction()
+	{
+		return m_Progress ? m_Progress->GetFraction() : -1.f;
+	}
+
+	bool Poll(Scene& scene, std::string& error)
+	{
+		if (!m_Thread.joinable() || !m_Finished) return false;
+
+		m_Thread.join();
+		m_Progress.reset();
+		error = std::move(m_Error);
+		if (!m_Result) return false;
+
+		scene = std::move(*m_Result);
+		m_Result.reset();
+		return true;
+	}
+
+	void Shutdown()
+	{
+		if (!m_Thread.joinable()) return;
+
+		Cancel();
+		m_Thread.join();
+		m_Progress.reset();
+		m_Result.reset();
+	}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+#include "Scene.h"
+
+// Loads one scene at a time on a background thread. The render thread keeps using its current scene
+// and swaps in the new one through Poll, between frames.
+namespace SceneLoader
+{
+
+	// Does nothing if a load is already running.
+	void Start(const std::string& path, const ImportOptions& options);
+	// The load stops at its next stage or step, Poll then reports it as cancelled.
+	void Cancel();
+	bool IsLoading();
+
+	std::string GetStage();
+	// Fraction of the current stage, negative if unknown
+	float GetFraction();
+
+	// Once the load has finished, moves the result into scene and returns true. On failure scene is left as it was
+	// and error is set, empty if the load was cancelled.
+	bool Poll(Scene& scene, std::string& error);
+
+	// Cancels and waits for the loader thread.
+	void Shutdown();
+
+}
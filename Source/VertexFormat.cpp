@@ -0,0 +1,205 @@
+#include "VertexFormat.h"
+
+#include <atomic>
+#include <cmath>
+
+#include <DirectXPackedVector.h>
+
+#include "Jobs.h"
+
+namespace VertexFormat
+{
+
+	using namespace DirectX;
+
+	int16_t ToSNorm(float value)
+	{
+		return int16_t(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f));
+	}
+
+	float FromSNorm(int16_t value)
+	{
+		return std::max(value / 32767.f, -1.f);
+	}
+
+	void OctEncode(const XMFLOAT3& vector, int16_t (&out)[2])
+	{
+		float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+		if (length == 0.f)
+		{
+			out[0] = out[1] = 0;
+			return;
+		}
+
+		float x = vector.x / length;
+		float y = vector.y / length;
+		if (vector.z < 0.f)
+		{
+			float wrappedX = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+			float wrappedY = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+			x = wrappedX;
+			y = wrappedY;
+		}
+		out[0] = ToSNorm(x);
+		out[1] = ToSNorm(y);
+	}
+
+	XMFLOAT3 OctDecode(const int16_t (&encoded)[2])
+	{
+		float x = FromSNorm(encoded[0]);
+		float y = FromSNorm(encoded[1]);
+		float z = 1.f - std::abs(x) - std::abs(y);
+		float t = std::max(-z, 0.f);
+		x += x >= 0.f ? -t : t;
+		y += y >= 0.f ? -t : t;
+
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3Normalize(XMVectorSet(x, y, z, 0.f)));
+		return result;
+	}
+
+	CompactVertex Encode(const Vertex& vertex, const VertexQuantization& quantization)
+	{
+		CompactVertex result;
+
+		const float position[] = { vertex.Position.x, vertex.Position.y, vertex.Position.z };
+		const float offset[] = { quantization.Offset.x, quantization.Offset.y, quantization.Offset.z };
+		const float scale[] = { quantization.Scale.x, quantization.Scale.y, quantization.Scale.z };
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			float normalized = std::clamp((position[i] - offset[i]) / scale[i], 0.f, 1.f);
+			result.Position[i] = uint16_t(std::lround(normalized * 65535.f));
+		}
+
+		XMVECTOR normal = XMLoadFloat3(&vertex.Normal);
+		XMVECTOR tangent = XMLoadFloat3(&vertex.Tangent);
+		XMVECTOR bitangent = XMLoadFloat3(&vertex.Bitangent);
+		float handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), bitangent));
+		result.Position[3] = handedness < 0.f ? 0 : 65535;
+
+		OctEncode(vertex.Normal, result.Normal);
+		OctEncode(vertex.Tangent, result.Tangent);
+
+		result.UV[0] = PackedVector::XMConvertFloatToHalf(vertex.UV.x);
+		result.UV[1] = PackedVector::XMConvertFloatToHalf(vertex.UV.y);
+
+		return result;
+	}
+
+	Vertex Decode(const CompactVertex& vertex, const VertexQuantization& quantization)
+	{
+		Vertex result;
+		result.Position = {
+			quantization.Offset.x + vertex.Position[0] / 65535.f * quantization.Scale.x,
+			quantization.Offset.y + vertex.Position[1] / 65535.f * quantization.Scale.y,
+			quantization.Offset.z + vertex.Position[2] / 65535.f * quantization.Scale.z
+		};
+		result.Normal = OctDecode(vertex.Normal);
+		result.Tangent = OctDecode(vertex.Tangent);
+
+		float sign = vertex.Position[3] ? 1.f : -1.f;
+		XMVECTOR bitangent = XMVector3Cross(XMLoadFloat3(&result.Normal), XMLoadFloat3(&result.Tangent));
+		XMStoreFloat3(&result.Bitangent, XMVectorScale(bitangent, sign));
+
+		result.UV = {
+			PackedVector::XMConvertHalfToFloat(vertex.UV[0]),
+			PackedVector::XMConvertHalfToFloat(vertex.UV[1])
+		};
+		return result;
+	}
+
+	VertexQuantization GetQuantization(std::span<const Vertex> vertices)
+	{
+		if (vertices.empty()) return {};
+
+		XMVECTOR min = XMLoadFloat3(&vertices[0].Position);
+		XMVECTOR max = min;
+		for (const auto& vertex : vertices)
+		{
+			XMVECTOR position = XMLoadFloat3(&vertex.Position);
+			min = XMVectorMin(min, position);
+			max = XMVectorMax(max, position);
+		}
+
+		// Flat meshes still need a non-zero scale on the flat axis
+		XMVECTOR extent = XMVectorMax(XMVectorSubtract(max, min), XMVectorReplicate(1e-6f));
+
+		VertexQuantization quantization;
+		XMStoreFloat3(&quantization.Offset, min);
+		XMStoreFloat3(&quantization.Scale, extent);
+		return quantization;
+	}
+
+	float AngleBetween(const XMFLOAT3& first, const XMFLOAT3& second)
+	{
+		XMVECTOR a = XMLoadFloat3(&first);
+		XMVECTOR b = XMLoadFloat3(&second);
+		float lengths = XMVectorGetX(XMVector3Length(a)) * XMVectorGetX(XMVector3Length(b));
+		if (lengths == 0.f) return 0.f;
+
+		float cosine = std::clamp(XMVectorGetX(XMVector3Dot(a, b)) / lengths, -1.f, 1.f);
+		return std::acos(cosine) * (180.f / 3.14159265f);
+	}
+
+	// Stores the larger value, error bounds are gathered from every job
+	void AtomicMax(std::atomic<float>& target, float value)
+	{
+		float current = target.load();
+		while (value > current && !target.compare_exchange_weak(current, value)) {}
+	}
+
+	void CompactScene(SceneData& data)
+	{
+		ScopedStage stage(data.Stats, "Vertex compaction", uint32_t(data.Materials.size()));
+
+		data.CompactVertices.resize(data.Vertices.size());
+		data.Quantization.resize(data.Materials.size());
+
+		std::atomic<float> positionError = 0.f;
+		std::atomic<float> normalError = 0.f;
+		std::atomic<float> tangentError = 0.f;
+		std::atomic<float> uvError = 0.f;
+		Jobs::ParallelFor(uint32_t(data.Materials.size()), [&](uint32_t i)
+			{
+				data.Stats.Step();
+				if (SharesVertices(data.Materials, i)) return;
+
+				const auto& material = data.Materials[i];
+				std::span<const Vertex> vertices(data.Vertices.data() + material.BaseVertex, material.VertexCount);
+				auto& quantization = data.Quantization[i];
+				quantization = GetQuantization(vertices);
+
+				float maxPosition = 0.f, maxNormal = 0.f, maxTangent = 0.f, maxUV = 0.f;
+				for (uint32_t v = 0; v < material.VertexCount; v++)
+				{
+					const auto& source = vertices[v];
+					auto& compact = data.CompactVertices[material.BaseVertex + v];
+					compact = Encode(source, quantization);
+
+					auto decoded = Decode(compact, quantization);
+					maxPosition = std::max({ maxPosition, std::abs(decoded.Position.x - source.Position.x),
+						std::abs(decoded.Position.y - source.Position.y), std::abs(decoded.Position.z - source.Position.z) });
+					maxNormal = std::max(maxNormal, AngleBetween(decoded.Normal, source.Normal));
+					maxTangent = std::max(maxTangent, AngleBetween(decoded.Tangent, source.Tangent));
+					maxUV = std::max({ maxUV, std::abs(decoded.UV.x - source.UV.x), std::abs(decoded.UV.y - source.UV.y) });
+				}
+
+				AtomicMax(positionError, maxPosition);
+				AtomicMax(normalError, maxNormal);
+				AtomicMax(tangentError, maxTangent);
+				AtomicMax(uvError, maxUV);
+			});
+		for (size_t i = 1; i < data.Materials.size(); i++)
+		{
+			if (SharesVertices(data.Materials, i)) data.Quantization[i] = data.Quantization[i - 1];
+		}
+
+		data.Stats.Add("Vertex bytes (full)", double(data.Vertices.size() * sizeof(Vertex)));
+		data.Stats.Add("Vertex bytes (compact)", double(data.CompactVertices.size() * sizeof(CompactVertex)));
+		data.Stats.Add("Max position error", positionError);
+		data.Stats.Add("Max normal error (deg)", normalError);
+		data.Stats.Add("Max tangent error (deg)", tangentError);
+		data.Stats.Add("Max UV error", uvError);
+	}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+
+#include "SceneData.h"
+
+// Vertex layouts, shared by the importer (encoding) and the renderer (input layouts).
+// The compact decode is mirrored in Shaders/VertexFormat.hlsli.
+namespace VertexFormat
+{
+
+	enum class AttributeFormat
+	{
+		Float2,
+		Float3,
+		Float4,
+		UNorm16x4,
+		SNorm16x2,
+		Half2
+	};
+
+	struct Attribute
+	{
+		const char* Semantic;
+		AttributeFormat Format;
+		uint32_t Offset;
+	};
+
+	inline constexpr Attribute Full[] = {
+		{ "POSITION", AttributeFormat::Float3, offsetof(Vertex, Position) },
+		{ "NORMAL", AttributeFormat::Float3, offsetof(Vertex, Normal) },
+		{ "TANGENT", AttributeFormat::Float3, offsetof(Vertex, Tangent) },
+		{ "BITANGENT", AttributeFormat::Float3, offsetof(Vertex, Bitangent) },
+		{ "UV", AttributeFormat::Float2, offsetof(Vertex, UV) }
+	};
+
+	inline constexpr Attribute Compact[] = {
+		{ "POSITION", AttributeFormat::UNorm16x4, offsetof(CompactVertex, Position) },
+		{ "NORMAL", AttributeFormat::SNorm16x2, offsetof(CompactVertex, Normal) },
+		{ "TANGENT", AttributeFormat::SNorm16x2, offsetof(CompactVertex, Tangent) },
+		{ "UV", AttributeFormat::Half2, offsetof(CompactVertex, UV) }
+	};
+
+	// SceneView::Positions, bound instead of either format by depth-only passes
+	inline constexpr Attribute Position[] = {
+		{ "POSITION", AttributeFormat::Float3, 0 }
+	};
+
+	// One per InstanceData, with its material's quantization so both vertex formats share a layout
+	struct InstanceRecord
+	{
+		DirectX::XMFLOAT3X4 Transform;
+		VertexQuantization Quantization;
+	};
+
+	// Fed as per-instance data, draws select their instances with StartInstanceLocation.
+	inline constexpr Attribute Instance[] = {
+		{ "TRANSFORM_X", AttributeFormat::Float4, offsetof(InstanceRecord, Transform) },
+		{ "TRANSFORM_Y", AttributeFormat::Float4, offsetof(InstanceRecord, Transform) + 16 },
+		{ "TRANSFORM_Z", AttributeFormat::Float4, offsetof(InstanceRecord, Transform) + 32 },
+		{ "QUANT_OFFSET", AttributeFormat::Float3, offsetof(InstanceRecord, Quantization) + offsetof(VertexQuantization, Offset) },
+		{ "QUANT_SCALE", AttributeFormat::Float3, offsetof(InstanceRecord, Quantization) + offsetof(VertexQuantization, Scale) }
+	};
+
+	CompactVertex Encode(const Vertex& vertex, const VertexQuantization& quantization);
+	// Bitangent comes back as sign * cross(normal, tangent).
+	Vertex Decode(const CompactVertex& vertex, const VertexQuantization& quantization);
+
+	VertexQuantization GetQuantization(std::span<const Vertex> vertices);
+
+	// Fills data.CompactVertices and data.Quantization from data.Vertices, one quantization range per material,
+	// and records the worst case error of the round trip in data.Stats.
+	void CompactScene(SceneData& data);
+
+}
@@ -0,0 +1,177 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "Check.h"
+
+// BlockCompression::Decode on hand made blocks with known texels, then Compress and Decode round trips of synthetic
+// images in every format the importer ships, each of which has to stay above a PSNR floor. The floors are a few dB below
+// what plain bounding box endpoints reach, which stb_dxt improves on, while a broken encoder or decoder lands far below.
+
+struct Format
+{
+	const char* Name;
+	TextureFormat Format;
+	// Channels it stores, as BlockCompression::PSNR takes them
+	uint32_t Channels;
+	double MinPSNR;
+};
+
+struct Image
+{
+	const char* Name;
+	TextureData Texture;
+};
+
+static TextureData MakeTexture(uint32_t size)
+{
+	return { size, size, 1, TextureFormat::RGBA8, std::vector<uint8_t>(size_t(size) * size * 4) };
+}
+
+static uint8_t ToByte(float value)
+{
+	return uint8_t(std::fmin(std::fmax(value, 0.f), 255.f) + 0.5f);
+}
+
+static std::vector<Image> MakeImages()
+{
+	constexpr uint32_t size = 64;
+	std::vector<Image> images;
+
+	// Every channel changing slowly in its own direction
+	auto& gradient = images.emplace_back(Image{ "gradient", MakeTexture(size) }).Texture;
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			uint8_t* texel = &gradient.Pixels[(size_t(y) * size + x) * 4];
+			texel[0] = ToByte(x * 4.f);
+			texel[1] = ToByte(y * 4.f);
+			texel[2] = ToByte((x + y) * 2.f);
+			texel[3] = ToByte(255.f - y * 3.f);
+		}
+	}
+
+	// Grain on top of a gradient, like most material textures
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> grain(-12.f, 12.f);
+	auto& noise = images.emplace_back(Image{ "noise", MakeTexture(size) }).Texture;
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			uint8_t* texel = &noise.Pixels[(size_t(y) * size + x) * 4];
+			float base = 64.f + x * 2.f;
+			texel[0] = ToByte(base + grain(random));
+			texel[1] = ToByte(base * 0.8f + grain(random));
+			texel[2] = ToByte(base * 0.5f + grain(random));
+			texel[3] = ToByte(200.f + grain(random));
+		}
+	}
+
+	// Cut out foliage: a solid colour with a hard diagonal alpha edge through the middle of blocks
+	auto& edge = images.emplace_back(Image{ "alpha edge", MakeTexture(size) }).Texture;
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			uint8_t* texel = &edge.Pixels[(size_t(y) * size + x) * 4];
+			bool inside = x + 2 * y < size + 5;
+			texel[0] = inside ? 40 : 0;
+			texel[1] = inside ? 160 : 0;
+			texel[2] = inside ? 60 : 0;
+			texel[3] = inside ? 255 : 0;
+		}
+	}
+	return images;
+}
+
+// Texels the decoder has to produce exactly for blocks written by hand, per the D3D block layouts
+static void TestKnownBlocks()
+{
+	auto decode = [](TextureFormat format, std::vector<uint8_t> block)
+	{
+		TextureData texture{ 4, 4, 1, format, std::move(block) };
+		return BlockCompression::Decode(texture);
+	};
+	auto expect = [](const std::vector<uint8_t>& pixels, uint32_t texel, uint32_t channel, int expected, const char* block)
+	{
+		int actual = pixels[texel * 4 + channel];
+		Test::Check(std::abs(actual - expected) <= 1, "%s: texel %u channel %u is %d, not %d", block, texel, channel, actual, expected);
+	};
+
+	// Red and blue endpoints in four colour mode, indices 0, 1, 2, 3 along every row
+	auto bc1 = decode(TextureFormat::BC1_SRGB, { 0x00, 0xf8, 0x1f, 0x00, 0xe4, 0xe4, 0xe4, 0xe4 });
+	for (uint32_t row = 0; row < 4; row++)
+	{
+		uint32_t t = row * 4;
+		expect(bc1, t, 0, 255, "BC1"), expect(bc1, t, 2, 0, "BC1"), expect(bc1, t, 3, 255, "BC1");
+		expect(bc1, t + 1, 0, 0, "BC1"), expect(bc1, t + 1, 2, 255, "BC1");
+		expect(bc1, t + 2, 0, 170, "BC1"), expect(bc1, t + 2, 2, 85, "BC1");
+		expect(bc1, t + 3, 0, 85, "BC1"), expect(bc1, t + 3, 2, 170, "BC1");
+	}
+	// The same endpoints swapped select three colour mode, where index 3 is transparent black
+	auto bc1Alpha = decode(TextureFormat::BC1_SRGB, { 0x1f, 0x00, 0x00, 0xf8, 0xe4, 0xe4, 0xe4, 0xe4 });
+	expect(bc1Alpha, 2, 0, 127, "BC1 3 colour"), expect(bc1Alpha, 2, 2, 127, "BC1 3 colour"), expect(bc1Alpha, 2, 3, 255, "BC1 3 colour");
+	expect(bc1Alpha, 3, 0, 0, "BC1 3 colour"), expect(bc1Alpha, 3, 3, 0, "BC1 3 colour");
+
+	// 200 and 100 in eight value mode, indices 0 to 7 twice: 200, 100, then six steps of 100 / 7
+	std::vector<uint8_t> bc4Block = { 200, 100, 0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa };
+	auto bc4 = decode(TextureFormat::BC4, bc4Block);
+	int eight[] = { 200, 100, 185, 171, 157, 142, 128, 114 };
+	for (uint32_t t = 0; t < 16; t++)
+	{
+		expect(bc4, t, 0, eight[t % 8], "BC4");
+	}
+	// 50 and 150 in six value mode, where 6 and 7 are 0 and 255
+	auto bc4Six = decode(TextureFormat::BC4, { 50, 150, 0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa });
+	int six[] = { 50, 150, 70, 90, 110, 130, 0, 255 };
+	for (uint32_t t = 0; t < 16; t++)
+	{
+		expect(bc4Six, t, 0, six[t % 8], "BC4 6 value");
+	}
+
+	// Red from the first half, green from the second
+	std::vector<uint8_t> bc5Block = bc4Block;
+	bc5Block.insert(bc5Block.end(), { 10, 20, 0, 0, 0, 0, 0, 0 });
+	auto bc5 = decode(TextureFormat::BC5, bc5Block);
+	expect(bc5, 2, 0, 185, "BC5"), expect(bc5, 2, 1, 10, "BC5");
+
+	// Alpha before colour
+	std::vector<uint8_t> bc3Block = bc4Block;
+	bc3Block.insert(bc3Block.end(), { 0x00, 0xf8, 0x1f, 0x00, 0xe4, 0xe4, 0xe4, 0xe4 });
+	auto bc3 = decode(TextureFormat::BC3, bc3Block);
+	expect(bc3, 1, 2, 255, "BC3"), expect(bc3, 1, 3, 100, "BC3"), expect(bc3, 2, 0, 170, "BC3"), expect(bc3, 2, 3, 185, "BC3");
+}
+
+int main()
+{
+	TestKnownBlocks();
+
+	const Format formats[] = {
+		{ "BC1", TextureFormat::BC1_SRGB, 0b0111, 30.0 },
+		{ "BC3", TextureFormat::BC3, 0b1111, 30.0 },
+		{ "BC3 sRGB", TextureFormat::BC3_SRGB, 0b1111, 30.0 },
+		{ "BC4", TextureFormat::BC4, 0b0001, 40.0 },
+		{ "BC5", TextureFormat::BC5, 0b0011, 40.0 },
+	};
+	for (const auto& image : MakeImages())
+	{
+		const auto& source = image.Texture;
+		size_t pixelCount = size_t(source.Width) * source.Height;
+		for (const auto& format : formats)
+		{
+			auto compressed = BlockCompression::Compress(source, format.Format);
+			Test::Check(compressed.Format == format.Format && compressed.Pixels.size() == GetMipSize(format.Format, source.Width, source.Height),
+				"%s %s: wrong format or size", image.Name, format.Name);
+			auto decoded = BlockCompression::Decode(compressed);
+			double psnr = BlockCompression::PSNR(source.Pixels.data(), decoded.data(), pixelCount, format.Channels);
+			Test::Check(psnr >= format.MinPSNR, "%s %s: %.1f dB, under %.1f", image.Name, format.Name, psnr, format.MinPSNR);
+			printf("%-10s %-8s %5.1f dB\n", image.Name, format.Name, psnr);
+		}
+	}
+	return Test::Report();
+}
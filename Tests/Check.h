@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Shared by the headless tests: Check counts failed conditions and prints the first few, Report ends main with
+// the exit code ctest reads.
+namespace Test
+{
+
+	inline uint32_t Failures = 0;
+	constexpr uint32_t MaxPrinted = 20;
+
+	template<typename... Args>
+	void Check(bool condition, const char* format, Args... args)
+	{
+		if (condition) return;
+		if (Failures++ < MaxPrinted)
+		{
+			printf(format, args...);
+			printf("\n");
+		}
+	}
+
+	inline int Report()
+	{
+		if (Failures) printf("%u checks failed\n", Failures);
+		return Failures ? 1 : 0;
+	}
+
+}
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "Clusters.h"
+
+// Clusters::Build on synthetic meshes: every cluster within the meshlet limits, every triangle in exactly one cluster,
+// and bounds and normal cones that hold every triangle of their cluster.
+
+using namespace DirectX;
+
+struct Mesh
+{
+	std::string Name;
+	std::vector<Vertex> Vertices;
+	std::vector<uint32_t> Indices;
+};
+
+static void Check(bool condition, const Mesh& mesh, const char* what, size_t cluster)
+{
+	Test::Check(condition, "%s, cluster %zu: %s", mesh.Name.c_str(), cluster, what);
+}
+
+static Vertex MakeVertex(float x, float y, float z)
+{
+	Vertex vertex{};
+	vertex.Position = { x, y, z };
+	return vertex;
+}
+
+// Clockwise from the front like the importer's triangles, facing -z
+static Mesh MakeGrid(uint32_t size)
+{
+	Mesh mesh{ "grid" };
+	for (uint32_t y = 0; y <= size; y++)
+	{
+		for (uint32_t x = 0; x <= size; x++)
+		{
+			mesh.Vertices.push_back(MakeVertex(float(x), float(y), 0.f));
+		}
+	}
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			uint32_t v = y * (size + 1) + x;
+			mesh.Indices.insert(mesh.Indices.end(), { v, v + size + 1, v + 1, v + 1, v + size + 1, v + size + 2 });
+		}
+	}
+	return mesh;
+}
+
+static Mesh MakeSphere(uint32_t rings, uint32_t segments)
+{
+	Mesh mesh{ "sphere" };
+	for (uint32_t r = 0; r <= rings; r++)
+	{
+		float theta = XM_PI * r / rings;
+		for (uint32_t s = 0; s <= segments; s++)
+		{
+			float phi = XM_2PI * s / segments;
+			mesh.Vertices.push_back(MakeVertex(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+		}
+	}
+	for (uint32_t r = 0; r < rings; r++)
+	{
+		for (uint32_t s = 0; s < segments; s++)
+		{
+			uint32_t v = r * (segments + 1) + s;
+			mesh.Indices.insert(mesh.Indices.end(), { v, v + 1, v + segments + 1, v + 1, v + segments + 2, v + segments + 1 });
+		}
+	}
+	return mesh;
+}
+
+// One vertex shared by more triangles than fit a cluster
+static Mesh MakeFan(uint32_t triangles)
+{
+	Mesh mesh{ "fan" };
+	mesh.Vertices.push_back(MakeVertex(0.f, 0.f, 0.f));
+	for (uint32_t t = 0; t <= triangles; t++)
+	{
+		float angle = XM_2PI * t / triangles;
+		mesh.Vertices.push_back(MakeVertex(std::cos(angle), std::sin(angle), 0.1f * t));
+	}
+	for (uint32_t t = 0; t < triangles; t++)
+	{
+		mesh.Indices.insert(mesh.Indices.end(), { 0, t + 2, t + 1 });
+	}
+	return mesh;
+}
+
+// Unconnected triangles in random places and orientations, with some degenerate ones
+static Mesh MakeSoup(uint32_t triangles, std::mt19937& random)
+{
+	Mesh mesh{ "soup" };
+	std::uniform_real_distribution<float> position(-10.f, 10.f);
+	for (uint32_t t = 0; t < triangles; t++)
+	{
+		uint32_t base = uint32_t(mesh.Vertices.size());
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			mesh.Vertices.push_back(MakeVertex(position(random), position(random), position(random)));
+		}
+		if (t % 17 == 0) mesh.Vertices[base + 2] = mesh.Vertices[base];
+		mesh.Indices.insert(mesh.Indices.end(), { base, base + 1, base + 2 });
+	}
+	return mesh;
+}
+
+static XMVECTOR GetPosition(const Mesh& mesh, std::span<const uint32_t> indices, size_t i)
+{
+	return XMLoadFloat3(&mesh.Vertices[indices[i]].Position);
+}
+
+static void TestMesh(Mesh mesh, std::mt19937& random)
+{
+	std::vector<std::array<uint32_t, 3>> before;
+	for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+	{
+		before.push_back({ mesh.Indices[i], mesh.Indices[i + 1], mesh.Indices[i + 2] });
+	}
+
+	std::vector<ClusterData> clusters;
+	Clusters::Build(mesh.Indices, mesh.Vertices, 7, clusters);
+
+	// Back to back, so every index is in exactly one cluster
+	uint32_t next = 0;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const auto& cluster = clusters[c];
+		Check(cluster.BaseIndex == next, mesh, "clusters are not back to back", c);
+		Check(cluster.IndexCount > 0 && cluster.IndexCount % 3 == 0, mesh, "not whole triangles", c);
+		Check(cluster.IndexCount / 3 <= Clusters::MaxTriangles, mesh, "too many triangles", c);
+		Check(cluster.Material == 7, mesh, "wrong material", c);
+		next = cluster.BaseIndex + cluster.IndexCount;
+	}
+	Check(next == mesh.Indices.size(), mesh, "clusters don't cover the indices", clusters.size());
+	if (next != mesh.Indices.size()) return;
+
+	// Same triangles, each with its own winding
+	std::vector<std::array<uint32_t, 3>> after;
+	for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+	{
+		after.push_back({ mesh.Indices[i], mesh.Indices[i + 1], mesh.Indices[i + 2] });
+	}
+	std::sort(before.begin(), before.end());
+	std::sort(after.begin(), after.end());
+	Check(before == after, mesh, "triangles were lost, duplicated or rewound", 0);
+
+	std::uniform_real_distribution<float> eye(-30.f, 30.f);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const auto& cluster = clusters[c];
+		auto indices = std::span<const uint32_t>(mesh.Indices).subspan(cluster.BaseIndex, cluster.IndexCount);
+
+		std::vector<uint32_t> unique(indices.begin(), indices.end());
+		std::sort(unique.begin(), unique.end());
+		unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+		Check(unique.size() == cluster.VertexCount, mesh, "wrong vertex count", c);
+		Check(unique.size() <= Clusters::MaxVertices, mesh, "too many vertices", c);
+
+		XMVECTOR min = XMLoadFloat3(&cluster.Min);
+		XMVECTOR max = XMLoadFloat3(&cluster.Max);
+		XMVECTOR center = XMLoadFloat3(&cluster.Center);
+		float slack = 1e-4f * (1.f + cluster.Radius);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			XMVECTOR p = GetPosition(mesh, indices, i);
+			Check(XMVector3GreaterOrEqual(p, min) && XMVector3LessOrEqual(p, max), mesh, "vertex outside the box", c);
+			Check(XMVectorGetX(XMVector3Length(XMVectorSubtract(p, center))) <= cluster.Radius + slack, mesh, "vertex outside the sphere", c);
+		}
+
+		if (cluster.ConeCutoff >= 1.f) continue;
+		XMVECTOR axis = XMLoadFloat3(&cluster.ConeAxis);
+		float minDot = std::sqrt(1.f - cluster.ConeCutoff * cluster.ConeCutoff);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR p0 = GetPosition(mesh, indices, i);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(GetPosition(mesh, indices, i + 1), p0), XMVectorSubtract(GetPosition(mesh, indices, i + 2), p0));
+			if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.f) continue;
+			Check(XMVectorGetX(XMVector3Dot(XMVector3Normalize(normal), axis)) >= minDot - 1e-4f, mesh, "normal outside the cone", c);
+		}
+
+		// What Culling relies on: wherever the cone test passes, every triangle faces away from the eye
+		for (uint32_t e = 0; e < 64; e++)
+		{
+			XMVECTOR position = XMVectorSet(eye(random), eye(random), eye(random), 0.f);
+			XMVECTOR toCenter = XMVectorSubtract(center, position);
+			float distance = XMVectorGetX(XMVector3Length(toCenter));
+			if (XMVectorGetX(XMVector3Dot(toCenter, axis)) < cluster.ConeCutoff * distance + cluster.Radius) continue;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				XMVECTOR p0 = GetPosition(mesh, indices, i);
+				XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(GetPosition(mesh, indices, i + 1), p0),
+					XMVectorSubtract(GetPosition(mesh, indices, i + 2), p0)));
+				Check(XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(p0, position))) >= -slack, mesh, "cone culled a front face", c);
+			}
+		}
+	}
+	printf("%-8s %6zu triangles in %4zu clusters\n", mesh.Name.c_str(), mesh.Indices.size() / 3, clusters.size());
+}
+
+int main()
+{
+	std::mt19937 random(1234);
+	TestMesh(MakeGrid(40), random);
+	TestMesh(MakeSphere(24, 48), random);
+	TestMesh(MakeFan(300), random);
+	TestMesh(MakeSoup(2000, random), random);
+	TestMesh(Mesh{ "empty" }, random);
+
+	return Test::Report();
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "Check.h"
+#include "NormalMaps.h"
+
+// NormalMaps::FromHeight against the normal GBufferWritePS computed from the same height map. The Sobel filter is
+// centered where the shader's differences look one texel ahead, so smooth surfaces only agree to within a degree or so.
+
+using namespace DirectX;
+
+constexpr float m_MaxDegrees = 2.f;
+
+struct Field
+{
+	const char* Name;
+	uint32_t Width;
+	uint32_t Height;
+	// Texels this far from the edges aren't compared, for fields that don't wrap seamlessly
+	uint32_t Margin;
+	std::function<float(uint32_t, uint32_t)> Height01;
+};
+
+static void TestField(const Field& field)
+{
+	TextureData height{ field.Width, field.Height, 1, TextureFormat::RGBA8, std::vector<uint8_t>(size_t(field.Width) * field.Height * 4, 255) };
+	for (uint32_t y = 0; y < field.Height; y++)
+	{
+		for (uint32_t x = 0; x < field.Width; x++)
+		{
+			height.Pixels[(size_t(y) * field.Width + x) * 4] = uint8_t(std::clamp(field.Height01(x, y), 0.f, 1.f) * 255.f + 0.5f);
+		}
+	}
+	TextureData normals = height;
+	NormalMaps::FromHeight(normals);
+	Test::Check(normals.Format == TextureFormat::RGBA8 && normals.Pixels.size() == height.Pixels.size(), "%s: wrong format or size", field.Name);
+
+	float maxError = 0.f;
+	uint32_t worstX = 0, worstY = 0;
+	for (uint32_t y = field.Margin; y + field.Margin < field.Height; y++)
+	{
+		for (uint32_t x = field.Margin; x + field.Margin < field.Width; x++)
+		{
+			const uint8_t* texel = &normals.Pixels[(size_t(y) * field.Width + x) * 4];
+			XMFLOAT3 expected = NormalMaps::GetShaderNormal(height, x, y);
+			XMFLOAT3 actual = NormalMaps::Decode(texel);
+			float cosine = std::clamp(expected.x * actual.x + expected.y * actual.y + expected.z * actual.z, -1.f, 1.f);
+			float error = std::acos(cosine) * 57.29578f;
+			if (error > maxError)
+			{
+				maxError = error;
+				worstX = x;
+				worstY = y;
+			}
+			Test::Check(texel[3] == 255, "%s: alpha at %u, %u isn't 255", field.Name, x, y);
+		}
+	}
+	Test::Check(maxError <= m_MaxDegrees, "%s: %.2f deg at %u, %u, over %.1f", field.Name, maxError, worstX, worstY, m_MaxDegrees);
+	printf("%-10s %4ux%-4u %.2f deg max\n", field.Name, field.Width, field.Height, maxError);
+}
+
+int main()
+{
+	constexpr float tau = 6.2831853f;
+	std::vector<Field> fields = {
+		{ "flat", 64, 64, 0, [](uint32_t, uint32_t) { return 0.5f; } },
+		// Exact slopes away from where the ramp wraps back to 0
+		{ "ramp", 64, 64, 2, [](uint32_t x, uint32_t y) { return (2.f * x + y) / 255.f; } },
+		{ "sine", 512, 512, 0, [=](uint32_t x, uint32_t y) { return 0.5f + 0.45f * std::sin(x * tau / 128.f) * std::cos(y * tau / 256.f); } },
+		// Periodic over sizes that aren't a multiple of the 4 texels FromHeight does at once, so the wrapped neighbours
+		// and the last partial vector both matter
+		{ "wrap", 90, 75, 0, [=](uint32_t x, uint32_t y) { return 0.5f + 0.2f * std::sin(x * tau / 90.f) + 0.2f * std::cos(y * tau / 75.f); } },
+		{ "narrow", 3, 130, 0, [=](uint32_t, uint32_t y) { return 0.5f + 0.3f * std::sin(y * tau / 130.f); } },
+	};
+	for (const auto& field : fields)
+	{
+		TestField(field);
+	}
+	return Test::Report();
+}
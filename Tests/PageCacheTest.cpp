@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "PageCache.h"
+
+// PageCache::Update on synthetic feedback streams, mirroring the cache from its uploads: the tails stay resident,
+// no page asked for this frame is evicted, and every indirection entry points at the closest resident ancestor.
+
+using namespace Pages;
+
+static constexpr uint32_t m_None = ~0u;
+
+static void Check(bool condition, const char* test, uint32_t frame, const char* what)
+{
+	Test::Check(condition, "%s, frame %u: %s", test, frame, what);
+}
+
+static uint32_t GetPage(const Layout& layout, uint32_t mip, uint32_t x, uint32_t y)
+{
+	return layout.Offsets[mip] + y * layout.PagesX[mip] + x;
+}
+
+// Unlike Update, keeps requests for the tail so the chain always ends in a resident page
+static std::vector<uint32_t> GetChain(const Layout& layout, uint32_t mip, uint32_t x, uint32_t y)
+{
+	std::vector<uint32_t> chain;
+	for (; mip < layout.Mips; mip++)
+	{
+		chain.push_back(GetPage(layout, mip, x, y));
+		if (mip + 1 == layout.Mips) break;
+		x = (std::min)(x / 2, layout.PagesX[mip + 1] - 1);
+		y = (std::min)(y / 2, layout.PagesY[mip + 1] - 1);
+	}
+	return chain;
+}
+
+struct Stream
+{
+	const char* Name;
+	uint32_t SlotPercent;
+	uint32_t MaxUploads;
+	// Random pages anywhere instead of a window drifting over each texture
+	bool Scattered;
+};
+
+static void TestStream(const Stream& stream, const std::vector<Layout>& layouts, std::mt19937& random)
+{
+	uint32_t textureCount = uint32_t(layouts.size());
+	uint32_t pageCount = 0;
+	for (const auto& layout : layouts)
+	{
+		pageCount += layout.PageCount;
+	}
+	PageCache cache(layouts, (std::max)(pageCount * stream.SlotPercent / 100, textureCount + 1));
+
+	// What every slot holds, from the uploads alone: texture and page within it
+	std::vector<std::pair<uint32_t, uint32_t>> slots(cache.GetSlotCount(), { m_None, m_None });
+	std::vector<std::vector<uint32_t>> resident(textureCount);
+	for (uint32_t texture = 0; texture < textureCount; texture++)
+	{
+		resident[texture].assign(layouts[texture].PageCount, m_None);
+	}
+	auto apply = [&](uint32_t frame)
+	{
+		for (const auto& upload : cache.Uploads)
+		{
+			Check(upload.Slot < slots.size(), stream.Name, frame, "upload to a slot that doesn't exist");
+			if (upload.Slot >= slots.size()) continue;
+			auto [oldTexture, oldPage] = slots[upload.Slot];
+			if (oldTexture != m_None) resident[oldTexture][oldPage] = m_None;
+			uint32_t page = GetPage(layouts[upload.Texture], upload.Mip, upload.X, upload.Y);
+			Check(resident[upload.Texture][page] == m_None, stream.Name, frame, "page uploaded twice");
+			slots[upload.Slot] = { upload.Texture, page };
+			resident[upload.Texture][page] = upload.Slot;
+		}
+	};
+	apply(0);
+	Check(cache.Uploads.size() == textureCount, stream.Name, 0, "not one upload per tail");
+
+	std::uniform_real_distribution<float> uniform(0.f, 1.f);
+	std::vector<uint32_t> requests;
+	for (uint32_t frame = 1; frame <= 300; frame++)
+	{
+		requests.clear();
+		for (uint32_t v = 0; v < 12; v++)
+		{
+			uint32_t texture = (std::min)(uint32_t(textureCount * uniform(random) * uniform(random)), textureCount - 1);
+			const auto& layout = layouts[texture];
+			uint32_t mip = (std::min)(uint32_t(uniform(random) * layout.Mips), layout.Mips - 1);
+			float phase = frame * 0.01f + texture * 0.37f;
+			for (uint32_t i = 0; i < 32; i++)
+			{
+				float u = stream.Scattered ? uniform(random) : phase - static_cast<int>(phase) + (uniform(random) - 0.5f) * 0.1f;
+				float w = stream.Scattered ? uniform(random) : 0.5f + (uniform(random) - 0.5f) * 0.1f;
+				uint32_t x = (std::min)(uint32_t((std::max)(u, 0.f) * layout.PagesX[mip]), layout.PagesX[mip] - 1);
+				uint32_t y = (std::min)(uint32_t((std::max)(w, 0.f) * layout.PagesY[mip]), layout.PagesY[mip] - 1);
+				requests.push_back(EncodeRequest(texture, mip, x, y));
+			}
+		}
+		// What feedback also holds: pixels without a paged texture, and pages that don't exist
+		requests.push_back(NoRequest);
+		requests.push_back(EncodeRequest(textureCount, 0, 0, 0));
+		requests.push_back(EncodeRequest(0, layouts[0].Mips, 0, 0));
+		requests.push_back(EncodeRequest(0, 0, layouts[0].PagesX[0], 0));
+		std::shuffle(requests.begin(), requests.end(), random);
+
+		// Requested pages and their ancestors that are resident now, they must keep their slots
+		std::vector<std::pair<uint32_t, uint32_t>> kept;
+		for (uint32_t request : requests)
+		{
+			uint32_t texture = request >> 20, mip = (request >> 16) & 0xf, y = (request >> 8) & 0xff, x = request & 0xff;
+			if (request == NoRequest || texture >= textureCount) continue;
+			const auto& layout = layouts[texture];
+			if (mip >= layout.Mips || x >= layout.PagesX[mip] || y >= layout.PagesY[mip]) continue;
+			for (uint32_t page : GetChain(layout, mip, x, y))
+			{
+				if (resident[texture][page] != m_None) kept.push_back({ texture, page });
+			}
+		}
+		std::vector<std::vector<uint32_t>> before = resident;
+
+		cache.Update(requests, stream.MaxUploads);
+		Check(cache.Uploads.size() <= stream.MaxUploads, stream.Name, frame, "over the upload limit");
+		for (const auto& upload : cache.Uploads)
+		{
+			Check(upload.Slot >= textureCount, stream.Name, frame, "upload into a tail slot");
+		}
+		apply(frame);
+
+		for (auto [texture, page] : kept)
+		{
+			Check(resident[texture][page] == before[texture][page], stream.Name, frame, "evicted a page requested this frame");
+		}
+
+		const auto& indirection = cache.GetIndirection();
+		for (uint32_t texture = 0; texture < textureCount; texture++)
+		{
+			const auto& layout = layouts[texture];
+			uint32_t tail = GetPage(layout, layout.Mips - 1, 0, 0);
+			Check(resident[texture][tail] == texture, stream.Name, frame, "tail not in its pinned slot");
+			Check(cache.GetLayout(texture).PageCount == layout.PageCount, stream.Name, frame, "wrong layout");
+
+			for (uint32_t mip = 0; mip < layout.Mips; mip++)
+			{
+				for (uint32_t y = 0; y < layout.PagesY[mip]; y++)
+				{
+					for (uint32_t x = 0; x < layout.PagesX[mip]; x++)
+					{
+						// The closest resident page along the chain, the tail at worst
+						uint32_t expected = m_None, expectedMip = mip;
+						for (uint32_t page : GetChain(layout, mip, x, y))
+						{
+							if (resident[texture][page] != m_None)
+							{
+								expected = resident[texture][page];
+								break;
+							}
+							expectedMip++;
+						}
+						uint32_t entry = indirection[cache.GetOffset(texture) + GetPage(layout, mip, x, y)];
+						Check(entry == EncodeEntry(expected, expectedMip), stream.Name, frame, "entry isn't the closest resident ancestor");
+					}
+				}
+			}
+		}
+	}
+	printf("%-10s %3u%% slots, %2u uploads a frame: %u of %u slots resident\n", stream.Name, stream.SlotPercent, stream.MaxUploads,
+		cache.Stats.Resident, cache.Stats.Slots);
+}
+
+int main()
+{
+	// Square, wide, and sizes that aren't a multiple of a page, whose parents are clamped
+	std::vector<Layout> layouts;
+	for (auto [width, height] : { std::pair(4096u, 4096u), { 2048u, 512u }, { 1000u, 600u }, { 384u, 4096u }, { 256u, 256u } })
+	{
+		layouts.push_back(Layout::Create(width, height));
+	}
+
+	std::mt19937 random(1234);
+	for (const auto& stream : { Stream{ "tiny", 1, 4, false }, Stream{ "small", 10, 16, false }, Stream{ "scattered", 10, 64, true },
+		Stream{ "throttled", 50, 1, true }, Stream{ "everything", 100, 1024, true } })
+	{
+		TestStream(stream, layouts, random);
+	}
+
+	return Test::Report();
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.h"
+#include "VertexFormat.h"
+
+// VertexFormat::Encode and Decode round trips against the error bounds the compact format promises: positions to half
+// a 65535th of the quantized extent, octahedral normals and tangents to a fraction of a degree, UVs to half precision,
+// and the bitangent's side of the normal and tangent plane. Includes flat meshes and the octahedral seam at -z.
+
+using namespace DirectX;
+
+constexpr float m_MaxAngle = 0.01f;
+
+struct Mesh
+{
+	const char* Name;
+	std::vector<Vertex> Vertices;
+};
+
+// Through the sine as well, acos alone can't resolve the small angles that matter here
+static float GetAngle(XMVECTOR a, XMVECTOR b)
+{
+	float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(a, b)));
+	return std::atan2(sine, XMVectorGetX(XMVector3Dot(a, b))) * 57.29578f;
+}
+
+// Smallest spacing of half floats around value
+static float GetHalfStep(float value)
+{
+	return std::ldexp(1.f, (std::max)(std::ilogb((std::max)(std::abs(value), 1e-30f)), -14) - 10);
+}
+
+static Vertex MakeVertex(XMFLOAT3 position, XMVECTOR normal, XMVECTOR tangent, float sign, XMFLOAT2 uv)
+{
+	Vertex vertex{};
+	vertex.Position = position;
+	normal = XMVector3Normalize(normal);
+	tangent = XMVector3Normalize(XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent))));
+	XMStoreFloat3(&vertex.Normal, normal);
+	XMStoreFloat3(&vertex.Tangent, tangent);
+	XMStoreFloat3(&vertex.Bitangent, XMVectorScale(XMVector3Cross(normal, tangent), sign));
+	vertex.UV = uv;
+	return vertex;
+}
+
+static void TestMesh(const Mesh& mesh)
+{
+	auto quantization = VertexFormat::GetQuantization(mesh.Vertices);
+	const float* scale = &quantization.Scale.x;
+
+	float maxPosition = 0.f, maxNormal = 0.f, maxTangent = 0.f;
+	for (size_t v = 0; v < mesh.Vertices.size(); v++)
+	{
+		const auto& source = mesh.Vertices[v];
+		auto decoded = VertexFormat::Decode(VertexFormat::Encode(source, quantization), quantization);
+
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			float original = (&source.Position.x)[axis];
+			float error = std::abs((&decoded.Position.x)[axis] - original);
+			// Rounded to the nearest of 65535 steps over the extent, plus float rounding of the offset and scale
+			float bound = scale[axis] / 65535.f * 0.5f + (std::abs(original) + scale[axis]) * 4e-7f;
+			Test::Check(error <= bound, "%s, vertex %zu: position axis %u off by %g, over %g", mesh.Name, v, axis, error, bound);
+			maxPosition = (std::max)(maxPosition, error / scale[axis] * 65535.f);
+		}
+
+		XMVECTOR normal = XMLoadFloat3(&source.Normal);
+		XMVECTOR tangent = XMLoadFloat3(&source.Tangent);
+		float normalError = GetAngle(XMLoadFloat3(&decoded.Normal), normal);
+		float tangentError = GetAngle(XMLoadFloat3(&decoded.Tangent), tangent);
+		Test::Check(normalError <= m_MaxAngle, "%s, vertex %zu: normal off by %g deg", mesh.Name, v, normalError);
+		Test::Check(tangentError <= m_MaxAngle, "%s, vertex %zu: tangent off by %g deg", mesh.Name, v, tangentError);
+		maxNormal = (std::max)(maxNormal, normalError);
+		maxTangent = (std::max)(maxTangent, tangentError);
+
+		float side = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&decoded.Bitangent), XMLoadFloat3(&source.Bitangent)));
+		Test::Check(side > 0.9f, "%s, vertex %zu: bitangent flipped", mesh.Name, v);
+
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			float original = (&source.UV.x)[i];
+			float error = std::abs((&decoded.UV.x)[i] - original);
+			Test::Check(error <= GetHalfStep(original) * 0.5f, "%s, vertex %zu: UV off by %g", mesh.Name, v, error);
+		}
+	}
+	printf("%-8s %6zu vertices: position %.2f of a step, normal %.4f deg, tangent %.4f deg\n", mesh.Name, mesh.Vertices.size(), maxPosition,
+		maxNormal, maxTangent);
+}
+
+int main()
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+	auto randomDirection = [&]
+	{
+		XMVECTOR direction;
+		do direction = XMVectorSet(uniform(random), uniform(random), uniform(random), 0.f);
+		while (XMVectorGetX(XMVector3LengthSq(direction)) < 1e-4f);
+		return direction;
+	};
+
+	std::vector<Mesh> meshes;
+	auto& scattered = meshes.emplace_back(Mesh{ "random" }).Vertices;
+	for (uint32_t v = 0; v < 20000; v++)
+	{
+		XMFLOAT3 position = { uniform(random) * 50.f, uniform(random) * 3.f + 10.f, uniform(random) * 700.f };
+		XMFLOAT2 uv = { uniform(random) * 8.f, uniform(random) * 0.01f };
+		scattered.push_back(MakeVertex(position, randomDirection(), randomDirection(), v % 2 ? 1.f : -1.f, uv));
+	}
+
+	// A floor: all of y in one value, the quantization's scale on it is only a placeholder
+	auto& flat = meshes.emplace_back(Mesh{ "flat" }).Vertices;
+	for (uint32_t v = 0; v < 1000; v++)
+	{
+		XMFLOAT3 position = { 1000.f + uniform(random) * 20.f, -3.25f, uniform(random) * 20.f };
+		flat.push_back(MakeVertex(position, XMVectorSet(0.f, 1.f, 0.f, 0.f), XMVectorSet(1.f, 0.f, 0.f, 0.f), v % 2 ? 1.f : -1.f, { 0.f, 1.f }));
+	}
+	auto& point = meshes.emplace_back(Mesh{ "point" }).Vertices;
+	point.assign(4, MakeVertex({ 1.f, 2.f, 3.f }, XMVectorSet(0.f, 0.f, 1.f, 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f), -1.f, { 0.5f, 0.5f }));
+
+	// Where the octahedron folds: -z itself, and the edges of the unfolded square where x or y is 0 below the equator
+	auto& seam = meshes.emplace_back(Mesh{ "seam" }).Vertices;
+	XMVECTOR seamDirections[] = {
+		XMVectorSet(0.f, 0.f, -1.f, 0.f), XMVectorSet(0.f, 0.f, 1.f, 0.f),
+		XMVectorSet(0.6f, 0.f, -0.8f, 0.f), XMVectorSet(-0.6f, 0.f, -0.8f, 0.f), XMVectorSet(0.f, 0.6f, -0.8f, 0.f), XMVectorSet(0.f, -0.6f, -0.8f, 0.f),
+		XMVectorSet(1e-4f, -1e-4f, -1.f, 0.f), XMVectorSet(-1e-4f, 1e-4f, -1.f, 0.f), XMVectorSet(1.f, 0.f, -1e-6f, 0.f), XMVectorSet(0.f, -1.f, 0.f, 0.f),
+	};
+	for (XMVECTOR normal : seamDirections)
+	{
+		for (XMVECTOR tangent : seamDirections)
+		{
+			if (std::abs(XMVectorGetX(XMVector3Dot(normal, tangent))) > 0.5f) continue;
+			for (float sign : { 1.f, -1.f })
+			{
+				seam.push_back(MakeVertex({ 0.f, 0.f, float(seam.size()) }, normal, tangent, sign, { -2.f, 1e-5f }));
+			}
+		}
+	}
+
+	for (const auto& mesh : meshes)
+	{
+		TestMesh(mesh);
+	}
+	return Test::Report();
+}